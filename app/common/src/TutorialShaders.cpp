@@ -12,32 +12,43 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include "TutorialShaders.hpp"
+#include <stdio.h>
+#include <vector>
 
 extern VkDevice tutorialDevice;
 extern AAssetManager* tutorialAssetManager;
 
 VkResult loadShaderFromFile(const char* filePath, VkShaderModule* shaderOut,
                             ShaderType type) {
-  // Read the file:
+  // Read the file, in place when it is stored uncompressed in the APK:
   AAsset* file =
       AAssetManager_open(tutorialAssetManager, filePath, AASSET_MODE_BUFFER);
+  if (file == nullptr) {
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
   size_t fileLength = AAsset_getLength(file);
 
-  char* fileContent = new char[fileLength];
-
-  AAsset_read(file, fileContent, fileLength);
+  const void* fileContent = AAsset_getBuffer(file);
+  std::vector<uint32_t> fileCopy;
+  if (fileContent == nullptr ||
+      reinterpret_cast<uintptr_t>(fileContent) % sizeof(uint32_t) != 0) {
+    fileCopy.resize((fileLength + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+    AAsset_seek(file, 0, SEEK_SET);
+    AAsset_read(file, fileCopy.data(), fileLength);
+    fileContent = fileCopy.data();
+  }
 
   VkShaderModuleCreateInfo shaderModuleCreateInfo{
       .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
       .pNext = nullptr,
       .codeSize = fileLength,
-      .pCode = (const uint32_t*)fileContent,
+      .pCode = static_cast<const uint32_t*>(fileContent),
       .flags = 0,
   };
   VkResult result = vkCreateShaderModule(
       tutorialDevice, &shaderModuleCreateInfo, nullptr, shaderOut);
 
-  delete[] fileContent;
+  AAsset_close(file);
 
   return result;
 }
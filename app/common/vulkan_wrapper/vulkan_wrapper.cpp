@@ -17,6 +17,9 @@
 
 int InitVulkan(void) {
     void* libvulkan = dlopen("libvulkan.so", RTLD_NOW | RTLD_LOCAL);
+    // Desktop Linux only installs the versioned name without the development package
+    if (!libvulkan)
+        libvulkan = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
     if (!libvulkan)
         return 0;
 
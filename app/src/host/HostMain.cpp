@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "CpuProfiler.h"
+#include "VulkanMain.h"
+
+// Headless benchmark on a host Vulkan driver, ex) lavapipe:
+//   VARTIP_HEADLESS=300 VARTIP_FILTERS=gray vartip_headless [asset directory] [data directory]
+// The asset directory holds shaders/*.spv, the build's own when glslc was found or build_shaders.py's output. The
+// options are the environment variables the APK reads from its debug.vartip.* properties, traces go to the data
+// directory
+int main(int argc, char** argv) {
+    VARTIP_CPU_THREAD_NAME("headless");
+    if (getenv(VARTIP_HEADLESS_ENV) == nullptr) {
+        fprintf(stderr, "usage: %s=<frame count> %s [asset directory] [data directory]\n", VARTIP_HEADLESS_ENV,
+                argv[0]);
+        return 2;
+    }
+    AssetSource assets;
+    assets.directory = (argc > 1) ? argv[1] : "app/build/generated/assets/shaders";
+    const char* dataDirectory = (argc > 2) ? argv[2] : ".";
+    return RunHeadlessIfRequested(assets, dataDirectory) ? 0 : 1;
+}
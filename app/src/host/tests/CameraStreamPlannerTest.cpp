@@ -0,0 +1,157 @@
+#include "CameraStreamPlanner.h"
+#include "HostTest.h"
+
+#define FORMAT_YUV_420_888 0x23
+#define FORMAT_JPEG 0x100
+#define FORMAT_RAW16 0x20
+#define FPS_30_NS 33333333
+#define FPS_60_NS 16666666
+
+// The tables below are laid out like the characteristics a device reports, trimmed to the sizes that matter. They
+// are representative of the kinds of cameras the app runs on, not dumps of particular ones
+
+// A flagship back camera: full resolution YUV at 30, 1080p and below at 60, a stall listed for YUV too
+static CameraStreamTables FlagshipTables() {
+    CameraStreamTables tables;
+    tables.streamConfigurations = {
+        FORMAT_YUV_420_888, 4032, 3024, 0, FORMAT_YUV_420_888, 3840, 2160, 0, FORMAT_YUV_420_888, 1920, 1080, 0,
+        FORMAT_YUV_420_888, 1280, 720,  0, FORMAT_YUV_420_888, 640,  480,  0, FORMAT_YUV_420_888, 1920, 1080, 1,
+        FORMAT_JPEG,        4032, 3024, 0, FORMAT_JPEG,        1920, 1440, 0, FORMAT_RAW16,       4032, 3024, 0,
+    };
+    tables.minFrameDurations = {
+        FORMAT_YUV_420_888, 4032, 3024, FPS_30_NS, FORMAT_YUV_420_888, 3840, 2160, FPS_30_NS,
+        FORMAT_YUV_420_888, 1920, 1080, FPS_60_NS, FORMAT_YUV_420_888, 1280, 720,  FPS_60_NS,
+        FORMAT_YUV_420_888, 640,  480,  FPS_60_NS, FORMAT_JPEG,        4032, 3024, FPS_30_NS,
+        FORMAT_JPEG,        1920, 1440, FPS_30_NS, FORMAT_RAW16,       4032, 3024, FPS_30_NS,
+    };
+    // Stalls for YUV are not supposed to be listed, some devices do anyway
+    tables.stallDurations = {
+        FORMAT_YUV_420_888, 1920, 1080, FPS_30_NS,  FORMAT_JPEG, 4032, 3024, 200000000,
+        FORMAT_JPEG,        1920, 1440, 50000000, FORMAT_RAW16, 4032, 3024, 100000000,
+    };
+    tables.fpsRanges = {15, 30, 30, 30, 7, 30, 30, 60, 60, 60};
+    return tables;
+}
+
+// A budget phone: YUV up to 1080p at 30, the 16:9 sizes only at 30
+static CameraStreamTables BudgetTables() {
+    CameraStreamTables tables;
+    tables.streamConfigurations = {
+        FORMAT_YUV_420_888, 2592, 1944, 0, FORMAT_YUV_420_888, 1920, 1080, 0,
+        FORMAT_YUV_420_888, 1280, 960,  0, FORMAT_YUV_420_888, 1280, 720,  0,
+        FORMAT_YUV_420_888, 640,  480,  0, FORMAT_JPEG,        2592, 1944, 0,
+    };
+    tables.minFrameDurations = {
+        FORMAT_YUV_420_888, 2592, 1944, 66666666,  FORMAT_YUV_420_888, 1920, 1080, FPS_30_NS,
+        FORMAT_YUV_420_888, 1280, 960,  FPS_30_NS, FORMAT_YUV_420_888, 1280, 720,  FPS_30_NS,
+        FORMAT_YUV_420_888, 640,  480,  FPS_30_NS, FORMAT_JPEG,        2592, 1944, 66666666,
+    };
+    tables.stallDurations = {FORMAT_JPEG, 2592, 1944, 300000000};
+    tables.fpsRanges = {15, 15, 20, 20, 24, 24, 15, 30, 30, 30};
+    return tables;
+}
+
+// An old LEGACY level camera: a few YUV sizes, no durations for some of them and no stall table
+static CameraStreamTables LegacyTables() {
+    CameraStreamTables tables;
+    tables.streamConfigurations = {
+        FORMAT_YUV_420_888, 1280, 720, 0, FORMAT_YUV_420_888, 640, 480, 0, FORMAT_YUV_420_888, 320, 240, 0,
+    };
+    tables.minFrameDurations = {FORMAT_YUV_420_888, 640, 480, FPS_30_NS};
+    tables.fpsRanges = {15, 15, 20, 20, 24, 24, 7, 30};
+    return tables;
+}
+
+static CameraStreamRequest Request(int32_t format, int32_t width, int32_t height, int64_t pixelBudget,
+                                   int32_t targetFps) {
+    return {.format = format, .width = width, .height = height, .pixelBudget = pixelBudget, .targetFps = targetFps};
+}
+
+static void TestFlagship() {
+    CameraStreamTables tables = FlagshipTables();
+
+    // The YUV stall is ignored, 1080p still streams at 60
+    CameraStreamPlan plan = PlanCameraStream(tables, Request(FORMAT_YUV_420_888, 1920, 1080, 1920 * 1080, 60));
+    VARTIP_CHECK(plan.found && plan.sameRatio);
+    VARTIP_CHECK(plan.width == 1920 && plan.height == 1080);
+    VARTIP_CHECK(plan.frameDurationNs == FPS_60_NS);
+    VARTIP_CHECK_NEAR(plan.maxFps, 60.0, 0.01);
+    VARTIP_CHECK(plan.fpsMin == 60 && plan.fpsMax == 60 && plan.fixedFps == 60);
+
+    // At 30 the steadiest range reaching it wins
+    plan = PlanCameraStream(tables, Request(FORMAT_YUV_420_888, 1920, 1080, 1920 * 1080, 30));
+    VARTIP_CHECK(plan.width == 1920 && plan.height == 1080);
+    VARTIP_CHECK(plan.fpsMin == 30 && plan.fpsMax == 30 && plan.fixedFps == 30);
+    VARTIP_CHECK_NEAR(plan.pixelsPerSecond, 1920.0 * 1080 * 30, 1.0);
+
+    // 4:3 within a 1080p budget, the input configuration of the same size is not an output
+    plan = PlanCameraStream(tables, Request(FORMAT_YUV_420_888, 4, 3, 1920 * 1080, 30));
+    VARTIP_CHECK(plan.found && plan.sameRatio);
+    VARTIP_CHECK(plan.width == 640 && plan.height == 480);
+
+    // JPEG stalls count: full resolution takes 233 ms a frame, yet streams the most pixels
+    plan = PlanCameraStream(tables, Request(FORMAT_JPEG, 4, 3, 4032 * 3024, 30));
+    VARTIP_CHECK(plan.width == 4032 && plan.height == 3024);
+    VARTIP_CHECK(plan.frameDurationNs == FPS_30_NS + 200000000);
+    VARTIP_CHECK_NEAR(plan.maxFps, 4.29, 0.01);
+    // No range goes as low as the size can do
+    VARTIP_CHECK(plan.fpsMin == 0 && plan.fpsMax == 0 && plan.fixedFps == 0);
+
+    plan = PlanCameraStream(tables, Request(FORMAT_JPEG, 4, 3, 1920 * 1440, 30));
+    VARTIP_CHECK(plan.width == 1920 && plan.height == 1440);
+    VARTIP_CHECK(plan.frameDurationNs == FPS_30_NS + 50000000);
+    VARTIP_CHECK_NEAR(plan.maxFps, 12.0, 0.01);
+
+    // So do RAW ones
+    plan = PlanCameraStream(tables, Request(FORMAT_RAW16, 4, 3, 4032 * 3024, 30));
+    VARTIP_CHECK(plan.found);
+    VARTIP_CHECK(plan.frameDurationNs == FPS_30_NS + 100000000);
+}
+
+static void TestBudget() {
+    CameraStreamTables tables = BudgetTables();
+
+    // 60 can't be reached at any size, the most pixels per second at 30 wins
+    CameraStreamPlan plan = PlanCameraStream(tables, Request(FORMAT_YUV_420_888, 16, 9, 1920 * 1080, 60));
+    VARTIP_CHECK(plan.found && plan.sameRatio);
+    VARTIP_CHECK(plan.width == 1920 && plan.height == 1080);
+    VARTIP_CHECK(plan.fpsMin == 30 && plan.fpsMax == 30 && plan.fixedFps == 30);
+
+    // Full resolution 4:3 only does 15, the largest 4:3 size reaching 30 wins over it
+    plan = PlanCameraStream(tables, Request(FORMAT_YUV_420_888, 4, 3, 2592 * 1944, 30));
+    VARTIP_CHECK(plan.width == 1280 && plan.height == 960);
+    VARTIP_CHECK_NEAR(plan.maxFps, 30.0, 0.01);
+
+    // Nothing fits the budget
+    plan = PlanCameraStream(tables, Request(FORMAT_YUV_420_888, 4, 3, 320 * 240, 30));
+    VARTIP_CHECK(!plan.found);
+}
+
+static void TestLegacy() {
+    CameraStreamTables tables = LegacyTables();
+
+    // 1280x720 lists no duration and is taken to reach the target
+    CameraStreamPlan plan = PlanCameraStream(tables, Request(FORMAT_YUV_420_888, 16, 9, 1920 * 1080, 30));
+    VARTIP_CHECK(plan.found && plan.sameRatio);
+    VARTIP_CHECK(plan.width == 1280 && plan.height == 720);
+    VARTIP_CHECK(plan.frameDurationNs == 0);
+    VARTIP_CHECK(plan.fpsMin == 7 && plan.fpsMax == 30);
+    // No fixed range reaches 30, the highest one is next best
+    VARTIP_CHECK(plan.fixedFps == 24);
+
+    // No 16:9 size within the budget, the largest other one is picked
+    plan = PlanCameraStream(tables, Request(FORMAT_YUV_420_888, 16, 9, 640 * 480, 30));
+    VARTIP_CHECK(plan.found && !plan.sameRatio);
+    VARTIP_CHECK(plan.width == 640 && plan.height == 480);
+
+    // No JPEG at all
+    plan = PlanCameraStream(tables, Request(FORMAT_JPEG, 4, 3, 1280 * 720, 30));
+    VARTIP_CHECK(!plan.found);
+}
+
+int main() {
+    TestFlagship();
+    TestBudget();
+    TestLegacy();
+    return VARTIP_TEST_RESULT();
+}
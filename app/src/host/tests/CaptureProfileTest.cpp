@@ -0,0 +1,135 @@
+#include <vector>
+#include "CaptureProfile.h"
+#include "HostTest.h"
+
+// Tags and modes with their NdkCameraMetadataTags.h values
+#define TAG_AE_TARGET_FPS_RANGE 0x10005
+#define TAG_EDGE_MODE 0x30000
+#define TAG_NOISE_REDUCTION_MODE 0xA0000
+#define TAG_SENSOR_EXPOSURE_TIME 0xE0000
+#define TAG_SENSOR_FRAME_DURATION 0xE0001
+#define MODE_OFF 0
+#define MODE_FAST 1
+#define MODE_HIGH_QUALITY 2
+
+// A 1080p YUV stream on a camera listing [15, 30] and [30, 30]
+static CameraStreamPlan StreamPlan() {
+    CameraStreamPlan plan = {};
+    plan.found = true;
+    plan.width = 1920;
+    plan.height = 1080;
+    plan.sameRatio = true;
+    plan.frameDurationNs = 16666666;
+    plan.maxFps = 60.0;
+    plan.fpsMin = 15;
+    plan.fpsMax = 30;
+    plan.fixedFps = 30;
+    return plan;
+}
+
+// FULL cameras list every mode, LIMITED ones often no OFF
+static CaptureCapabilities FullCapabilities() {
+    CaptureCapabilities capabilities;
+    capabilities.noiseReductionModes = {MODE_OFF, MODE_FAST, MODE_HIGH_QUALITY};
+    capabilities.edgeModes = {MODE_OFF, MODE_FAST, MODE_HIGH_QUALITY};
+    return capabilities;
+}
+
+static CaptureCapabilities LimitedCapabilities() {
+    CaptureCapabilities capabilities;
+    capabilities.noiseReductionModes = {MODE_FAST, MODE_HIGH_QUALITY};
+    capabilities.edgeModes = {MODE_FAST};
+    return capabilities;
+}
+
+static bool HasValues(RecordingRequestWriter* writer, uint32_t tag, const std::vector<int64_t>& values) {
+    const std::vector<int64_t>* entry = writer->FindEntry(tag);
+    return entry != nullptr && *entry == values;
+}
+
+// The profile writes a single request, none of them turn AE off so none sets what only applies without it
+static void CheckRequest(const CaptureProfile& profile, const CameraStreamPlan& plan,
+                         const CaptureCapabilities& capabilities, RecordingRequestWriter* writer) {
+    VARTIP_CHECK(WriteCaptureRequest(profile, plan, capabilities, writer));
+    VARTIP_CHECK(writer->GetRequestCount() == 1);
+    VARTIP_CHECK(writer->GetTemplate() == profile.captureTemplate);
+    VARTIP_CHECK(writer->FindEntry(TAG_SENSOR_FRAME_DURATION) == nullptr);
+    VARTIP_CHECK(writer->FindEntry(TAG_SENSOR_EXPOSURE_TIME) == nullptr);
+}
+
+static void TestProfiles() {
+    VARTIP_CHECK(GetCaptureProfileCount() == 3);
+    for (uint32_t i = 0; i < GetCaptureProfileCount(); i++) {
+        VARTIP_CHECK(FindCaptureProfile(GetCaptureProfile(i).name) == &GetCaptureProfile(i));
+    }
+    VARTIP_CHECK(FindCaptureProfile(VARTIP_CAPTURE_PROFILE_DEFAULT) != nullptr);
+    VARTIP_CHECK(FindCaptureProfile("fastest") == nullptr);
+}
+
+// What the camera always streamed with: the record template and the planned range, the rest left to the template
+static void TestQuality() {
+    const CaptureProfile& profile = *FindCaptureProfile("quality");
+    RecordingRequestWriter writer;
+    CheckRequest(profile, StreamPlan(), FullCapabilities(), &writer);
+    VARTIP_CHECK(writer.GetTemplate() == CAPTURE_TEMPLATE_RECORD);
+    VARTIP_CHECK(writer.GetEntryCount() == 1);
+    VARTIP_CHECK(HasValues(&writer, TAG_AE_TARGET_FPS_RANGE, {15, 30}));
+}
+
+static void TestPreview() {
+    const CaptureProfile& profile = *FindCaptureProfile("preview");
+    RecordingRequestWriter writer;
+    CheckRequest(profile, StreamPlan(), FullCapabilities(), &writer);
+    VARTIP_CHECK(writer.GetTemplate() == CAPTURE_TEMPLATE_PREVIEW);
+    VARTIP_CHECK(writer.GetEntryCount() == 3);
+    VARTIP_CHECK(HasValues(&writer, TAG_AE_TARGET_FPS_RANGE, {15, 30}));
+    VARTIP_CHECK(HasValues(&writer, TAG_NOISE_REDUCTION_MODE, {MODE_FAST}));
+    VARTIP_CHECK(HasValues(&writer, TAG_EDGE_MODE, {MODE_FAST}));
+
+    // A camera listing no modes keeps the template's
+    RecordingRequestWriter bare;
+    CheckRequest(profile, StreamPlan(), CaptureCapabilities(), &bare);
+    VARTIP_CHECK(bare.GetEntryCount() == 1);
+}
+
+static void TestLowLatency() {
+    const CaptureProfile& profile = *FindCaptureProfile("lowlatency");
+    RecordingRequestWriter writer;
+    CheckRequest(profile, StreamPlan(), FullCapabilities(), &writer);
+    VARTIP_CHECK(writer.GetTemplate() == CAPTURE_TEMPLATE_PREVIEW);
+    VARTIP_CHECK(writer.GetEntryCount() == 3);
+    VARTIP_CHECK(HasValues(&writer, TAG_AE_TARGET_FPS_RANGE, {30, 30}));
+    VARTIP_CHECK(HasValues(&writer, TAG_NOISE_REDUCTION_MODE, {MODE_OFF}));
+    VARTIP_CHECK(HasValues(&writer, TAG_EDGE_MODE, {MODE_OFF}));
+
+    // Without OFF the second choice is taken
+    RecordingRequestWriter limited;
+    CheckRequest(profile, StreamPlan(), LimitedCapabilities(), &limited);
+    VARTIP_CHECK(HasValues(&limited, TAG_NOISE_REDUCTION_MODE, {MODE_FAST}));
+    VARTIP_CHECK(HasValues(&limited, TAG_EDGE_MODE, {MODE_FAST}));
+
+    // Without a fixed range the planned one is requested
+    CameraStreamPlan variable = StreamPlan();
+    variable.fixedFps = 0;
+    RecordingRequestWriter unfixed;
+    CheckRequest(profile, variable, FullCapabilities(), &unfixed);
+    VARTIP_CHECK(HasValues(&unfixed, TAG_AE_TARGET_FPS_RANGE, {15, 30}));
+
+    // Without any range the template picks
+    CameraStreamPlan noRanges = StreamPlan();
+    noRanges.fpsMin = 0;
+    noRanges.fpsMax = 0;
+    noRanges.fixedFps = 0;
+    RecordingRequestWriter templateRanges;
+    CheckRequest(profile, noRanges, FullCapabilities(), &templateRanges);
+    VARTIP_CHECK(templateRanges.FindEntry(TAG_AE_TARGET_FPS_RANGE) == nullptr);
+    VARTIP_CHECK(templateRanges.GetEntryCount() == 2);
+}
+
+int main() {
+    TestProfiles();
+    TestQuality();
+    TestPreview();
+    TestLowLatency();
+    return VARTIP_TEST_RESULT();
+}
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CpuProfiler.h"
+#include "HostTest.h"
+
+// Rings get their tid in the order their threads first record, main records first
+#define MAIN_TID 1
+#define RECORDER_TID 2
+#define FLUSH_COUNT 50
+// The slot the producer writes next may be halfway through being overwritten, a flush never has its oldest zone
+#define FLUSHED_ZONES (VARTIP_CPU_PROFILER_RING_SIZE - 1)
+
+struct TraceZone {
+    char name[32];
+    uint32_t tid;
+    double ts;
+    double dur;
+};
+
+// Zone events of a flush, one per line after the ",\n" each event starts with. Every line has to be a whole event
+static std::vector<TraceZone> FlushZones(uint32_t* written, bool* wellFormed) {
+    FILE* file = tmpfile();
+    *written = CpuProfilerWriteTraceEvents(file, 1);
+    rewind(file);
+
+    std::vector<TraceZone> zones;
+    *wellFormed = true;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (line[0] == ',' || line[0] == '\n') {
+            continue;
+        }
+        if (line[0] != '{' || strchr(line, '}') == nullptr) {
+            *wellFormed = false;
+            continue;
+        }
+        if (strstr(line, "\"ph\":\"X\"") == nullptr) {
+            continue;
+        }
+        TraceZone zone;
+        uint32_t pid;
+        if (sscanf(line, "{\"name\":\"%31[^\"]\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%lf,\"dur\":%lf}", zone.name,
+                   &pid, &zone.tid, &zone.ts, &zone.dur) != 5) {
+            *wellFormed = false;
+            continue;
+        }
+        zones.push_back(zone);
+    }
+    fclose(file);
+    return zones;
+}
+
+// More zones than the ring holds, the flush keeps the latest of them, oldest first
+static void TestRingWrap(void) {
+    const uint32_t extra = 100;
+    const uint32_t recorded = VARTIP_CPU_PROFILER_RING_SIZE + extra;
+    for (uint32_t i = 0; i < recorded; i++) {
+        CpuProfilerRecord("wrap", i * 1000ll, i * 1000ll + 500);
+    }
+
+    uint32_t written;
+    bool wellFormed;
+    std::vector<TraceZone> zones = FlushZones(&written, &wellFormed);
+    VARTIP_CHECK(wellFormed);
+    VARTIP_CHECK(written == FLUSHED_ZONES);
+    VARTIP_CHECK(zones.size() == FLUSHED_ZONES);
+    uint32_t first = recorded - FLUSHED_ZONES;
+    uint32_t outOfOrder = 0;
+    for (uint32_t i = 0; i < zones.size(); i++) {
+        outOfOrder += (zones[i].tid != MAIN_TID || zones[i].ts != first + i || zones[i].dur != 0.5) ? 1 : 0;
+    }
+    VARTIP_CHECK(outOfOrder == 0);
+}
+
+// Flushes while another thread keeps lapping its ring. Zone k of the recorder lasts k us and is named after its
+// parity, so a zone copied halfway through being overwritten shows up as a mismatch. What a flush keeps has to be
+// consecutive zones, the ones overwritten meanwhile are only ever the oldest
+static void TestFlushWhileRecording(void) {
+    std::atomic<bool> stop(false);
+    std::atomic<bool> started(false);
+    std::thread recorder([&stop, &started]() {
+        CpuProfilerSetThreadName("recorder");
+        for (int64_t k = 1; !stop.load(std::memory_order_relaxed); k++) {
+            CpuProfilerRecord((k & 1) ? "odd" : "even", k * 1000, k * 2000);
+            if (k == VARTIP_CPU_PROFILER_RING_SIZE) {
+                started.store(true, std::memory_order_relaxed);
+            }
+        }
+    });
+    // Flushes start with the ring full
+    while (!started.load(std::memory_order_relaxed)) {
+        std::this_thread::yield();
+    }
+
+    uint32_t malformed = 0;
+    uint32_t torn = 0;
+    uint32_t gaps = 0;
+    uint32_t overfull = 0;
+    for (uint32_t flush = 0; flush < FLUSH_COUNT; flush++) {
+        uint32_t written;
+        bool wellFormed;
+        std::vector<TraceZone> zones = FlushZones(&written, &wellFormed);
+        malformed += (wellFormed && written == zones.size()) ? 0 : 1;
+
+        uint32_t recorderZones = 0;
+        double last = 0.0;
+        for (uint32_t i = 0; i < zones.size(); i++) {
+            const TraceZone& zone = zones[i];
+            if (zone.tid != RECORDER_TID) {
+                continue;
+            }
+            int64_t k = static_cast<int64_t>(zone.ts);
+            const char* name = (k & 1) ? "odd" : "even";
+            torn += (zone.dur != zone.ts || strcmp(zone.name, name) != 0) ? 1 : 0;
+            gaps += (recorderZones > 0 && zone.ts != last + 1.0) ? 1 : 0;
+            last = zone.ts;
+            recorderZones++;
+        }
+        overfull += (recorderZones > FLUSHED_ZONES) ? 1 : 0;
+    }
+    stop.store(true, std::memory_order_relaxed);
+    recorder.join();
+
+    VARTIP_CHECK(malformed == 0);
+    VARTIP_CHECK(torn == 0);
+    VARTIP_CHECK(gaps == 0);
+    VARTIP_CHECK(overfull == 0);
+
+    // Once the recorder is done the whole ring is there again
+    uint32_t written;
+    bool wellFormed;
+    std::vector<TraceZone> zones = FlushZones(&written, &wellFormed);
+    uint32_t recorderZones = 0;
+    for (uint32_t i = 0; i < zones.size(); i++) {
+        recorderZones += (zones[i].tid == RECORDER_TID) ? 1 : 0;
+    }
+    VARTIP_CHECK(wellFormed);
+    VARTIP_CHECK(recorderZones == FLUSHED_ZONES);
+}
+
+int main() {
+    TestRingWrap();
+    TestFlushWhileRecording();
+    return VARTIP_TEST_RESULT();
+}
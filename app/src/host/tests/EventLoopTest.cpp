@@ -0,0 +1,50 @@
+#include <thread>
+#include "CpuProfiler.h"
+#include "EventLoop.h"
+#include "HostTest.h"
+
+#define TEST_IDENT 5
+
+// Events posted before a wait are taken as one, with the time of the first post
+static void TestPostBeforeWait() {
+    EventLoop loop;
+    FrameEvent event;
+    void* data;
+    VARTIP_CHECK(loop.AddFd(event.GetFd(), TEST_IDENT));
+    VARTIP_CHECK(loop.Wait(0, &data) == VARTIP_EVENT_NONE);
+
+    int64_t beforeNs = CpuProfilerNowNs();
+    event.Post();
+    event.Post();
+    int64_t afterNs = CpuProfilerNowNs();
+    VARTIP_CHECK(loop.Wait(1000, &data) == TEST_IDENT);
+    VARTIP_CHECK(data == nullptr);
+
+    int64_t postNs = 0;
+    VARTIP_CHECK(event.Take(&postNs) == 2);
+    VARTIP_CHECK(postNs >= beforeNs && postNs <= afterNs);
+    VARTIP_CHECK(event.Take(nullptr) == 0);
+    VARTIP_CHECK(loop.Wait(0, &data) == VARTIP_EVENT_NONE);
+
+    loop.RemoveFd(event.GetFd());
+    event.Post();
+    VARTIP_CHECK(loop.Wait(0, &data) == VARTIP_EVENT_NONE);
+}
+
+// A post from another thread wakes a loop sleeping without a timeout
+static void TestPostFromThread() {
+    EventLoop loop;
+    FrameEvent event;
+    void* data;
+    VARTIP_CHECK(loop.AddFd(event.GetFd(), TEST_IDENT));
+    std::thread poster([&event]() { event.Post(); });
+    VARTIP_CHECK(loop.Wait(-1, &data) == TEST_IDENT);
+    poster.join();
+    VARTIP_CHECK(event.Take(nullptr) == 1);
+}
+
+int main() {
+    TestPostBeforeWait();
+    TestPostFromThread();
+    return VARTIP_TEST_RESULT();
+}
@@ -0,0 +1,211 @@
+#include <vector>
+#include "FilterGraphPlanner.h"
+#include "HostTest.h"
+
+#define COMPUTE VARTIP_GRAPH_STAGE_COMPUTE_SHADER
+#define TRANSFER VARTIP_GRAPH_STAGE_TRANSFER
+#define FRAGMENT VARTIP_GRAPH_STAGE_FRAGMENT_SHADER
+
+// Declares resources and passes the way FilterGraph hands them to the planner
+struct TestGraph {
+    std::vector<GraphPlanResource> resources;
+    std::vector<GraphPlanPass> passes;
+
+    GraphResource Import(const char* name, uint32_t writeStage, uint32_t writeAccess) {
+        GraphPlanResource resource = {};
+        resource.name = name;
+        resource.imported = true;
+        resource.importStage = writeStage;
+        resource.importAccess = writeAccess;
+        resources.push_back(resource);
+        return static_cast<GraphResource>(resources.size() - 1);
+    }
+    GraphResource Transient(const char* name) {
+        GraphPlanResource resource = {};
+        resource.name = name;
+        resources.push_back(resource);
+        return static_cast<GraphResource>(resources.size() - 1);
+    }
+    GraphResource Persistent(const char* name) {
+        GraphResource resource = Transient(name);
+        resources[resource].persistent = true;
+        return resource;
+    }
+    void Output(GraphResource resource, uint32_t stage, uint32_t access) {
+        resources[resource].output = true;
+        resources[resource].outputStage = stage;
+        resources[resource].outputAccess = access;
+    }
+    void Pass(const char* name, const std::vector<GraphResource>& reads, const std::vector<GraphResource>& writes,
+              uint32_t stage = COMPUTE) {
+        passes.push_back({.name = name, .reads = reads, .writes = writes, .stage = stage});
+    }
+};
+
+// A blur chain off the camera with a pass nothing reads
+static void TestChain() {
+    TestGraph graph;
+    GraphResource camera = graph.Import("camera", TRANSFER, VARTIP_GRAPH_ACCESS_TRANSFER_WRITE);
+    GraphResource luma = graph.Transient("luma");
+    GraphResource blurH = graph.Transient("blurH");
+    GraphResource blurV = graph.Transient("blurV");
+    GraphResource unused = graph.Transient("unused");
+    GraphResource output = graph.Transient("output");
+    graph.Output(output, FRAGMENT, VARTIP_GRAPH_ACCESS_SHADER_READ);
+    graph.Pass("luma", {camera}, {luma});
+    graph.Pass("debug", {luma}, {unused});
+    graph.Pass("blurH", {luma}, {blurH});
+    graph.Pass("blurV", {blurH}, {blurV});
+    graph.Pass("compose", {blurV, camera}, {output});
+
+    FilterGraphPlan plan = PlanFilterGraph(graph.resources, graph.passes);
+    VARTIP_CHECK(plan.acyclic);
+    if (!plan.acyclic) {
+        return;
+    }
+    VARTIP_CHECK(plan.culledPassCount == 1);
+    std::vector<uint32_t> expectedOrder = {0, 2, 3, 4};
+    VARTIP_CHECK(plan.order == expectedOrder);
+
+    VARTIP_CHECK(plan.firstPass[camera] == 0 && plan.lastPass[camera] == 3);
+    VARTIP_CHECK(plan.firstPass[luma] == 0 && plan.lastPass[luma] == 1);
+    VARTIP_CHECK(plan.firstPass[blurV] == 2 && plan.lastPass[blurV] == 3);
+    VARTIP_CHECK(plan.firstPass[unused] == -1);
+    // Outputs outlive the graph
+    VARTIP_CHECK(plan.firstPass[output] == 3 && plan.lastPass[output] == 4);
+
+    // luma: the camera's transfer write made visible, and luma discarded
+    const GraphPlanBarrier& first = plan.barriers[0];
+    VARTIP_CHECK((first.srcStage & TRANSFER) && (first.srcAccess & VARTIP_GRAPH_ACCESS_TRANSFER_WRITE));
+    VARTIP_CHECK(first.dstStage == COMPUTE);
+    VARTIP_CHECK(first.dstAccess == VARTIP_GRAPH_ACCESS_SHADER_READ);
+    VARTIP_CHECK(first.discards.size() == 1 && first.discards[0] == luma);
+    VARTIP_CHECK(first.discardDstAccess == VARTIP_GRAPH_ACCESS_SHADER_WRITE);
+
+    // blurH: reads what luma wrote
+    const GraphPlanBarrier& second = plan.barriers[1];
+    VARTIP_CHECK((second.srcStage & COMPUTE) && (second.srcAccess & VARTIP_GRAPH_ACCESS_SHADER_WRITE));
+    VARTIP_CHECK(second.dstAccess & VARTIP_GRAPH_ACCESS_SHADER_READ);
+    VARTIP_CHECK(second.discards.size() == 1 && second.discards[0] == blurH);
+
+    // compose: the camera is already visible to compute, only blurV's write is waited for
+    const GraphPlanBarrier& last = plan.barriers[3];
+    VARTIP_CHECK(last.srcAccess == VARTIP_GRAPH_ACCESS_SHADER_WRITE);
+    VARTIP_CHECK(last.discards.size() == 1 && last.discards[0] == output);
+
+    VARTIP_CHECK(plan.outputBarrier.srcStage == COMPUTE);
+    VARTIP_CHECK(plan.outputBarrier.dstStage == FRAGMENT);
+    VARTIP_CHECK(plan.outputBarrier.dstAccess == VARTIP_GRAPH_ACCESS_SHADER_READ);
+    VARTIP_CHECK(plan.barrierCount == 5);
+}
+
+// Two passes each reading what the other writes
+static void TestCycle() {
+    TestGraph graph;
+    GraphResource a = graph.Transient("a");
+    GraphResource b = graph.Transient("b");
+    graph.Output(b, FRAGMENT, VARTIP_GRAPH_ACCESS_SHADER_READ);
+    graph.Pass("first", {a}, {b});
+    graph.Pass("second", {b}, {a});
+    FilterGraphPlan plan = PlanFilterGraph(graph.resources, graph.passes);
+    VARTIP_CHECK(!plan.acyclic);
+    VARTIP_CHECK(plan.order.empty());
+}
+
+// A temporal filter: the previous frame is read before the pass added after it writes the current one into it
+static void TestPersistent() {
+    TestGraph graph;
+    GraphResource camera = graph.Import("camera", TRANSFER, VARTIP_GRAPH_ACCESS_TRANSFER_WRITE);
+    GraphResource previous = graph.Persistent("previous");
+    GraphResource output = graph.Transient("output");
+    graph.Output(output, FRAGMENT, VARTIP_GRAPH_ACCESS_SHADER_READ);
+    graph.Pass("difference", {camera, previous}, {output});
+    graph.Pass("keep", {camera}, {previous}, TRANSFER);
+
+    FilterGraphPlan plan = PlanFilterGraph(graph.resources, graph.passes);
+    VARTIP_CHECK(plan.acyclic);
+    if (!plan.acyclic) {
+        return;
+    }
+    // keep writes nothing an output depends on this frame but is not culled
+    VARTIP_CHECK(plan.culledPassCount == 0);
+    std::vector<uint32_t> expectedOrder = {0, 1};
+    VARTIP_CHECK(plan.order == expectedOrder);
+
+    // The previous frame's writes to it are waited for before difference reads it
+    const GraphPlanBarrier& difference = plan.barriers[0];
+    VARTIP_CHECK((difference.srcStage & TRANSFER) && (difference.srcAccess & VARTIP_GRAPH_ACCESS_TRANSFER_WRITE));
+    VARTIP_CHECK(difference.discards.size() == 1 && difference.discards[0] == output);
+
+    // keep overwrites it after difference read it, and reads the camera in another stage than before
+    const GraphPlanBarrier& keep = plan.barriers[1];
+    VARTIP_CHECK(keep.srcStage & COMPUTE);
+    VARTIP_CHECK(keep.dstStage == TRANSFER);
+    VARTIP_CHECK(keep.dstAccess == (VARTIP_GRAPH_ACCESS_TRANSFER_READ | VARTIP_GRAPH_ACCESS_TRANSFER_WRITE));
+    VARTIP_CHECK(keep.discards.empty());
+}
+
+// No two images alive at the same time may overlap
+static bool PlacementIsValid(const std::vector<GraphMemoryRequest>& images, const std::vector<uint64_t>& offsets,
+                             uint64_t total) {
+    for (uint32_t i = 0; i < images.size(); i++) {
+        if (offsets[i] % images[i].alignment != 0 || offsets[i] + images[i].size > total) {
+            return false;
+        }
+        for (uint32_t j = 0; j < i; j++) {
+            bool aliveTogether = images[i].firstPass <= images[j].lastPass && images[j].firstPass <= images[i].lastPass;
+            bool overlaps = offsets[i] < offsets[j] + images[j].size && offsets[j] < offsets[i] + images[i].size;
+            if (aliveTogether && overlaps) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void TestAliasing() {
+    // The chain above: luma, blurH, blurV and output, each used by two passes in a row
+    const uint64_t size = 1280 * 720 * 4;
+    std::vector<GraphMemoryRequest> chain = {
+        {.size = size, .alignment = 256, .firstPass = 0, .lastPass = 1},
+        {.size = size, .alignment = 256, .firstPass = 1, .lastPass = 2},
+        {.size = size, .alignment = 256, .firstPass = 2, .lastPass = 3},
+        {.size = size, .alignment = 256, .firstPass = 3, .lastPass = 4},
+    };
+    std::vector<uint64_t> offsets;
+    uint64_t total = PlaceAliasedImages(chain, &offsets);
+    VARTIP_CHECK(PlacementIsValid(chain, offsets, total));
+    VARTIP_CHECK(total == 2 * size);
+    VARTIP_CHECK(offsets[0] == offsets[2] && offsets[1] == offsets[3]);
+
+    // Images all alive together get memory of their own
+    std::vector<GraphMemoryRequest> together = {
+        {.size = 1000, .alignment = 64, .firstPass = 0, .lastPass = 2},
+        {.size = 3000, .alignment = 256, .firstPass = 1, .lastPass = 2},
+        {.size = 500, .alignment = 1024, .firstPass = 0, .lastPass = 1},
+    };
+    total = PlaceAliasedImages(together, &offsets);
+    VARTIP_CHECK(PlacementIsValid(together, offsets, total));
+    // Largest first: 3000 at 0, 1000 at 3008, 500 at 4096
+    VARTIP_CHECK(offsets[1] == 0 && offsets[0] == 3008 && offsets[2] == 4096);
+    VARTIP_CHECK(total == 4596);
+
+    // A small image fits in the gap a dead large one leaves
+    std::vector<GraphMemoryRequest> gap = {
+        {.size = 4096, .alignment = 256, .firstPass = 0, .lastPass = 1},
+        {.size = 4096, .alignment = 256, .firstPass = 1, .lastPass = 3},
+        {.size = 1024, .alignment = 256, .firstPass = 2, .lastPass = 3},
+    };
+    total = PlaceAliasedImages(gap, &offsets);
+    VARTIP_CHECK(PlacementIsValid(gap, offsets, total));
+    VARTIP_CHECK(total == 8192);
+    VARTIP_CHECK(offsets[1] == 4096 && offsets[2] == 0);
+}
+
+int main() {
+    TestChain();
+    TestCycle();
+    TestPersistent();
+    TestAliasing();
+    return VARTIP_TEST_RESULT();
+}
@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <math.h>
+#include <vector>
+#include "FilterReference.h"
+#include "HostTest.h"
+
+#define EPSILON 1e-5f
+
+// sigma 1 and radius 1: the center tap is 1 and the side taps exp(-0.5) before normalizing by 1 + 2 exp(-0.5)
+#define CENTER_WEIGHT 0.4518628f
+#define SIDE_WEIGHT 0.2740686f
+
+static void TestGaussianWeights(void) {
+    float weights[VARTIP_BLUR_MAX_RADIUS + 1];
+    ComputeGaussianWeights(1.0f, 1, weights);
+    VARTIP_CHECK_NEAR(weights[0], CENTER_WEIGHT, EPSILON);
+    VARTIP_CHECK_NEAR(weights[1], SIDE_WEIGHT, EPSILON);
+
+    // Both sides of every tap but the center sum to 1
+    ComputeGaussianWeights(5.0f, 16, weights);
+    float sum = weights[0];
+    for (uint32_t i = 1; i <= 16; i++) {
+        sum += 2.0f * weights[i];
+        VARTIP_CHECK(weights[i] < weights[i - 1]);
+    }
+    VARTIP_CHECK_NEAR(sum, 1.0f, EPSILON);
+}
+
+// Bytes in memory order are red, green and blue, the pixels past the width in a row are not read
+static void TestLuma(void) {
+    const uint32_t pixels[] = {0x000000ffu, 0x0000ff00u, 0xdeadbeefu,  // red, green, padding
+                               0x00ff0000u, 0xff808080u, 0xdeadbeefu};  // blue, gray
+    float luma[4];
+    LumaReference(pixels, 3, 2, 2, luma);
+    VARTIP_CHECK_NEAR(luma[0], 0.299f, EPSILON);
+    VARTIP_CHECK_NEAR(luma[1], 0.587f, EPSILON);
+    VARTIP_CHECK_NEAR(luma[2], 0.114f, EPSILON);
+    VARTIP_CHECK_NEAR(luma[3], 128.0f / 255.0f, EPSILON);
+}
+
+static void TestGaussianBlur(void) {
+    // An impulse spreads into the outer product of the weights
+    std::vector<float> impulse(5 * 5, 0.0f);
+    std::vector<float> blurred(5 * 5);
+    impulse[2 * 5 + 2] = 1.0f;
+    GaussianBlurReference(impulse.data(), blurred.data(), 5, 5, 1.0f, 1);
+    VARTIP_CHECK_NEAR(blurred[2 * 5 + 2], CENTER_WEIGHT * CENTER_WEIGHT, EPSILON);
+    VARTIP_CHECK_NEAR(blurred[2 * 5 + 1], CENTER_WEIGHT * SIDE_WEIGHT, EPSILON);
+    VARTIP_CHECK_NEAR(blurred[1 * 5 + 2], CENTER_WEIGHT * SIDE_WEIGHT, EPSILON);
+    VARTIP_CHECK_NEAR(blurred[1 * 5 + 1], SIDE_WEIGHT * SIDE_WEIGHT, EPSILON);
+    VARTIP_CHECK_NEAR(blurred[0], 0.0f, EPSILON);
+
+    // The edge is clamped, a pixel at the border counts twice for its missing neighbour. A single row is unchanged by
+    // the vertical pass
+    const float row[] = {1.0f, 0.0f, 0.0f};
+    float rowBlurred[3];
+    GaussianBlurReference(row, rowBlurred, 3, 1, 1.0f, 1);
+    VARTIP_CHECK_NEAR(rowBlurred[0], CENTER_WEIGHT + SIDE_WEIGHT, EPSILON);
+    VARTIP_CHECK_NEAR(rowBlurred[1], SIDE_WEIGHT, EPSILON);
+    VARTIP_CHECK_NEAR(rowBlurred[2], 0.0f, EPSILON);
+
+    // A flat image stays flat at any radius
+    std::vector<float> flat(7 * 4, 0.25f);
+    std::vector<float> flatBlurred(7 * 4);
+    GaussianBlurReference(flat.data(), flatBlurred.data(), 7, 4, 3.0f, 9);
+    for (uint32_t i = 0; i < flatBlurred.size(); i++) {
+        VARTIP_CHECK_NEAR(flatBlurred[i], 0.25f, EPSILON);
+    }
+}
+
+// Luma * 255 rounded to the nearest bin: red 76.245, green 149.685, blue 29.07, the padding is not counted
+static void TestLumaHistogram(void) {
+    const uint32_t pixels[] = {0xff000000u, 0xffffffffu, 0x000000ffu, 0xdeadbeefu,   // black, white, red, padding
+                               0x0000ff00u, 0x00ff0000u, 0x000000ffu, 0xdeadbeefu};  // green, blue, red
+    uint32_t bins[256];
+    LumaHistogramReference(pixels, 4, 3, 2, bins);
+    VARTIP_CHECK(bins[0] == 1);
+    VARTIP_CHECK(bins[255] == 1);
+    VARTIP_CHECK(bins[76] == 2);
+    VARTIP_CHECK(bins[150] == 1);
+    VARTIP_CHECK(bins[29] == 1);
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < 256; i++) {
+        total += bins[i];
+    }
+    VARTIP_CHECK(total == 6);
+}
+
+// Bright points on black, 2 tiles wide. Every pixel of a point's circle is darker than it by more than the threshold,
+// its score is 16 x (value - threshold): 14.4 for 1.0 and 6.4 for 0.5. The black pixels around see the point at most
+// once on their circle, no arc
+static void TestFastCorners(void) {
+    const int32_t width = 2 * VARTIP_FAST_TILE_SIZE;
+    const int32_t height = VARTIP_FAST_TILE_SIZE;
+    const float threshold = 0.1f;
+    std::vector<float> luma(width * height, 0.0f);
+    float corners[4 * 3];
+    VARTIP_CHECK(FastCornersReference(luma.data(), width, height, threshold, 256, 4, corners) == 0);
+
+    luma[5 * width + 5] = 1.0f;
+    luma[10 * width + 10] = 0.5f;
+    luma[8 * width + 20] = 1.0f;
+    // Tile by tile, the strongest first
+    VARTIP_CHECK(FastCornersReference(luma.data(), width, height, threshold, 256, 4, corners) == 3);
+    VARTIP_CHECK(corners[0] == 5.0f && corners[1] == 5.0f);
+    VARTIP_CHECK_NEAR(corners[2], 14.4f, EPSILON);
+    VARTIP_CHECK(corners[3] == 10.0f && corners[4] == 10.0f);
+    VARTIP_CHECK_NEAR(corners[5], 6.4f, EPSILON);
+    VARTIP_CHECK(corners[6] == 20.0f && corners[7] == 8.0f);
+    VARTIP_CHECK_NEAR(corners[8], 14.4f, EPSILON);
+
+    // One per tile keeps the stronger corner of the first tile, the capacity cuts the list short
+    VARTIP_CHECK(FastCornersReference(luma.data(), width, height, threshold, 1, 4, corners) == 2);
+    VARTIP_CHECK(corners[0] == 5.0f && corners[1] == 5.0f);
+    VARTIP_CHECK(corners[3] == 20.0f && corners[4] == 8.0f);
+    VARTIP_CHECK(FastCornersReference(luma.data(), width, height, threshold, 256, 1, corners) == 1);
+
+    // Points closer to the border than the circle's radius are not scored
+    std::fill(luma.begin(), luma.end(), 0.0f);
+    luma[2 * width + 8] = 1.0f;
+    VARTIP_CHECK(FastCornersReference(luma.data(), width, height, threshold, 256, 4, corners) == 0);
+}
+
+// Luma of 1 to 6 over 255 in a 3x2 image, quantized back to 1 to 6
+static void TestIntegralImage(void) {
+    const float luma[] = {1 / 255.0f, 2 / 255.0f, 3 / 255.0f, 4 / 255.0f, 5 / 255.0f, 6 / 255.0f};
+    uint32_t sums[6];
+    uint32_t squares[6];
+    IntegralImageReference(luma, 3, 2, sums, squares);
+    const uint32_t expectedSums[] = {1, 3, 6, 5, 12, 21};
+    const uint32_t expectedSquares[] = {1, 5, 14, 17, 46, 91};
+    for (uint32_t i = 0; i < 6; i++) {
+        VARTIP_CHECK(sums[i] == expectedSums[i]);
+        VARTIP_CHECK(squares[i] == expectedSquares[i]);
+    }
+
+    // Boxes are cut at the border: the top left one is 1, 2, 4 and 5, the middle one the whole image and the right
+    // one 2, 3, 5 and 6
+    float output[6];
+    BoxFilterReference(sums, squares, 3, 2, 1, false, output);
+    VARTIP_CHECK_NEAR(output[0], 3.0f / 255.0f, EPSILON);
+    VARTIP_CHECK_NEAR(output[1], 3.5f / 255.0f, EPSILON);
+    VARTIP_CHECK_NEAR(output[2], 4.0f / 255.0f, EPSILON);
+    // Mean of the squares 46 / 4 less the squared mean 9
+    BoxFilterReference(sums, squares, 3, 2, 1, true, output);
+    VARTIP_CHECK_NEAR(output[0], sqrtf(2.5f) / 255.0f, EPSILON);
+
+    // Out of range luma is clamped before quantizing, squares can be skipped
+    const float outOfRange[] = {1.5f, -0.2f};
+    IntegralImageReference(outOfRange, 2, 1, sums, nullptr);
+    VARTIP_CHECK(sums[0] == 255 && sums[1] == 255);
+}
+
+// Two pixels over three frames with 2 warm up frames. The first pixel is steady at 0.5, then jumps to 0.9 once warmed
+// up: motion, the model moves by a tenth of 1/3. The second one jumps during the warm up, the model follows with
+// half of it and learns the variance instead
+static void TestBackgroundModel(void) {
+    const float rate = 0.05f;
+    const float threshold = 3.0f;
+    const float minVariance = 0.001f;
+    const float warmup = 2.0f;
+    const float frames[3][2] = {{0.5f, 0.5f}, {0.5f, 0.9f}, {0.9f, 0.9f}};
+    float model[2 * 3] = {};
+    uint8_t mask[2];
+
+    BackgroundModelReference(frames[0], 2, 1, rate, threshold, minVariance, warmup, model, mask);
+    VARTIP_CHECK(mask[0] == 0 && mask[1] == 0);
+    VARTIP_CHECK_NEAR(model[0], 0.5f, EPSILON);
+    VARTIP_CHECK_NEAR(model[1], 0.0f, EPSILON);
+    VARTIP_CHECK(model[2] == 1.0f);
+
+    BackgroundModelReference(frames[1], 2, 1, rate, threshold, minVariance, warmup, model, mask);
+    VARTIP_CHECK(mask[0] == 0 && mask[1] == 0);
+    VARTIP_CHECK_NEAR(model[3], 0.7f, EPSILON);
+    VARTIP_CHECK_NEAR(model[4], 0.5f * 0.5f * 0.16f, EPSILON);
+    VARTIP_CHECK(model[5] == warmup);
+
+    // 0.4^2 is over 3^2 x the minimum variance, 0.2^2 is under 3^2 x 0.04
+    BackgroundModelReference(frames[2], 2, 1, rate, threshold, minVariance, warmup, model, mask);
+    VARTIP_CHECK(mask[0] == 1 && mask[1] == 0);
+    const float alpha = 0.1f / 3.0f;
+    VARTIP_CHECK_NEAR(model[0], 0.5f + alpha * 0.4f, EPSILON);
+    VARTIP_CHECK_NEAR(model[1], (1.0f - alpha) * alpha * 0.16f, EPSILON);
+    VARTIP_CHECK(model[2] == warmup);
+}
+
+static void TestMorphology(void) {
+    std::vector<uint8_t> mask(5 * 5, 0);
+    std::vector<uint8_t> result(5 * 5);
+    mask[2 * 5 + 2] = 1;
+    // A single pixel is eroded away and dilated into a 3x3 square
+    MorphologyReference(mask.data(), 5, 5, 1, false, result.data());
+    VARTIP_CHECK(std::count(result.begin(), result.end(), 1) == 0);
+    MorphologyReference(mask.data(), 5, 5, 1, true, result.data());
+    VARTIP_CHECK(std::count(result.begin(), result.end(), 1) == 9);
+    VARTIP_CHECK(result[1 * 5 + 1] == 1 && result[3 * 5 + 3] == 1 && result[0] == 0 && result[4 * 5 + 4] == 0);
+
+    // Outside of the image does not count, a full mask survives erosion and a corner dilates into a 2x2 square
+    std::fill(mask.begin(), mask.end(), 1);
+    MorphologyReference(mask.data(), 5, 5, 2, false, result.data());
+    VARTIP_CHECK(std::count(result.begin(), result.end(), 1) == 25);
+    std::fill(mask.begin(), mask.end(), 0);
+    mask[0] = 1;
+    MorphologyReference(mask.data(), 5, 5, 1, true, result.data());
+    VARTIP_CHECK(std::count(result.begin(), result.end(), 1) == 4);
+    VARTIP_CHECK(result[0] == 1 && result[1] == 1 && result[5] == 1 && result[6] == 1);
+}
+
+int main() {
+    TestGaussianWeights();
+    TestLuma();
+    TestGaussianBlur();
+    TestLumaHistogram();
+    TestFastCorners();
+    TestIntegralImage();
+    TestBackgroundModel();
+    TestMorphology();
+    return VARTIP_TEST_RESULT();
+}
@@ -0,0 +1,22 @@
+#ifndef VARTIP_HOSTTEST_H_
+#define VARTIP_HOSTTEST_H_
+
+#include <stdio.h>
+
+// Checks for the host tests, one executable per test file. A failed check is reported and counted instead of
+// aborting so a run lists all of them, main returns VARTIP_TEST_RESULT()
+static int hostTestFailures = 0;
+
+#define VARTIP_CHECK(cond)                                                           \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            hostTestFailures++;                                                      \
+        }                                                                            \
+    } while (0)
+
+#define VARTIP_CHECK_NEAR(a, b, tolerance) VARTIP_CHECK(((a) - (b)) <= (tolerance) && ((b) - (a)) <= (tolerance))
+
+#define VARTIP_TEST_RESULT() ((hostTestFailures == 0) ? 0 : 1)
+
+#endif  // VARTIP_HOSTTEST_H_
@@ -0,0 +1,121 @@
+#include <vector>
+#include "HostTest.h"
+#include "QualityGovernor.h"
+#include "SyntheticFrameSource.h"
+
+#define FRAME_WIDTH 64
+#define FRAME_HEIGHT 48
+// Rows as far apart as the renderer's camera buffer, wider than the frame
+#define FRAME_STRIDE 72
+#define UNWRITTEN 0x12345678u
+
+// A subsampled frame is the top left pixel of every block of the full one, packed into a smaller image with the same
+// stride, and nothing past it is written
+static void CheckSubsampled(bool scrolling, int32_t step) {
+    SyntheticFrameSource full(FRAME_WIDTH, FRAME_HEIGHT);
+    SyntheticFrameSource reduced(FRAME_WIDTH, FRAME_HEIGHT);
+    if (scrolling) {
+        full.SetScroll(3, 2);
+        reduced.SetScroll(3, 2);
+    }
+    reduced.SetConversionStep(step);
+    std::vector<uint32_t> fullFrame(FRAME_STRIDE * FRAME_HEIGHT, UNWRITTEN);
+    std::vector<uint32_t> reducedFrame(FRAME_STRIDE * FRAME_HEIGHT, UNWRITTEN);
+    // A few frames in, so the bar and the scroll moved
+    for (int32_t i = 0; i < 5; i++) {
+        full.NextFrame(fullFrame.data(), FRAME_STRIDE);
+        reduced.NextFrame(reducedFrame.data(), FRAME_STRIDE);
+    }
+    VARTIP_CHECK(reduced.GetFrameCount() == 5);
+
+    int32_t reducedWidth = (FRAME_WIDTH + step - 1) / step;
+    int32_t reducedHeight = (FRAME_HEIGHT + step - 1) / step;
+    uint32_t mismatches = 0;
+    uint32_t written = 0;
+    for (int32_t y = 0; y < FRAME_HEIGHT; y++) {
+        for (int32_t x = 0; x < FRAME_STRIDE; x++) {
+            uint32_t pixel = reducedFrame[y * FRAME_STRIDE + x];
+            if (x < reducedWidth && y < reducedHeight) {
+                mismatches += (pixel != fullFrame[y * step * FRAME_STRIDE + x * step]) ? 1 : 0;
+            } else {
+                written += (pixel != UNWRITTEN) ? 1 : 0;
+            }
+        }
+    }
+    VARTIP_CHECK(mismatches == 0);
+    VARTIP_CHECK(written == 0);
+}
+
+static void TestSubsampledFrames(void) {
+    CheckSubsampled(false, 2);
+    CheckSubsampled(false, 4);
+    CheckSubsampled(true, 2);
+    CheckSubsampled(true, 4);
+}
+
+// Levels are capped and sizes scaled, nothing is put in front of the filters since the camera image already comes at
+// the converted size
+static void TestApplyQualityLevel(void) {
+    const char* filters = "gray,size=640x360,pyramid=5:1,flow=2048:4";
+    QualityLevel full = {1, VARTIP_QUALITY_ALL, VARTIP_QUALITY_ALL};
+    QualityLevel half = {2, VARTIP_QUALITY_ALL, 2};
+    QualityLevel cheapest = {4, 1, 1};
+    VARTIP_CHECK(ApplyQualityLevel(filters, full) == filters);
+    VARTIP_CHECK(ApplyQualityLevel(filters, half) == "gray,size=320x180,pyramid=2:1,flow=2048:2");
+    VARTIP_CHECK(ApplyQualityLevel(filters, cheapest) == "gray");
+    VARTIP_CHECK(ApplyQualityLevel("gray,flow", half) == "gray,flow=1024:2");
+    VARTIP_CHECK(ApplyQualityLevel("", half) == "");
+}
+
+// Frames from the synthetic source with a work time that follows the pixels converted: 40 ms at full resolution
+// against a 33 ms target. The governor has to step down to half resolution and stay there, trying full resolution
+// less and less often as it keeps not fitting
+static void TestGovernorWithSyntheticFrames(void) {
+    const double fixedMs = 4.0;
+    const double fullConversionMs = 36.0;
+    const uint32_t frameCount = 3000;
+    QualityGovernor governor(33.0);
+    SyntheticFrameSource source(FRAME_WIDTH, FRAME_HEIGHT);
+    std::vector<uint32_t> frame(FRAME_STRIDE * FRAME_HEIGHT);
+
+    uint32_t framesAtHalf = 0;
+    uint32_t lastHalfStretch = 0;
+    uint32_t halfStretch = 0;
+    for (uint32_t i = 0; i < frameCount; i++) {
+        const QualityLevel& level = governor.GetLevel();
+        source.SetConversionStep(level.conversionStep);
+        source.NextFrame(frame.data(), FRAME_STRIDE);
+
+        uint32_t step = level.conversionStep;
+        double converted = static_cast<double>((FRAME_WIDTH + step - 1) / step * ((FRAME_HEIGHT + step - 1) / step)) /
+                           (FRAME_WIDTH * FRAME_HEIGHT);
+        governor.AddFrame(fixedMs + fullConversionMs * converted);
+
+        if (governor.GetLevelIndex() == 1) {
+            framesAtHalf++;
+            halfStretch++;
+        } else if (halfStretch > 0) {
+            lastHalfStretch = halfStretch;
+            halfStretch = 0;
+        }
+    }
+
+    QualityGovernorStats stats = governor.GetStats();
+    VARTIP_CHECK(stats.frameCount == frameCount);
+    VARTIP_CHECK(source.GetFrameCount() == frameCount);
+    // Half resolution fits, it never goes lower
+    VARTIP_CHECK(stats.lowestLevel == 1);
+    VARTIP_CHECK(stats.stepDownCount >= 2);
+    VARTIP_CHECK(stats.bounceCount >= 1);
+    VARTIP_CHECK(stats.stepDownCount == stats.stepUpCount + (governor.GetLevelIndex() == 1 ? 1 : 0));
+    VARTIP_CHECK(framesAtHalf > frameCount * 8 / 10);
+    // The backoff grows, the later stays at half resolution are longer than the first wait of 90 frames
+    VARTIP_CHECK(lastHalfStretch > VARTIP_GOVERNOR_UP_FRAMES);
+}
+
+int main() {
+    TestSubsampledFrames();
+    TestApplyQualityLevel();
+    TestGovernorWithSyntheticFrames();
+    return VARTIP_TEST_RESULT();
+}
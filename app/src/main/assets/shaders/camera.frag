@@ -2,8 +2,19 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 layout (binding = 0) uniform sampler2D tex;
+// 256x1 curve applied to every channel when useLut is set, ex) histogram equalization
+layout (binding = 1) uniform sampler2D lut;
+layout (push_constant) uniform Display {
+   int useLut;
+};
 layout (location = 0) in vec2 texcoord;
 layout (location = 0) out vec4 uFragColor;
 void main() {
-   uFragColor = texture(tex, texcoord);
+   vec4 color = texture(tex, texcoord);
+   if (useLut != 0) {
+      ivec3 index = ivec3(clamp(color.rgb * 255.0 + 0.5, 0.0, 255.0));
+      color.rgb = vec3(texelFetch(lut, ivec2(index.r, 0), 0).r, texelFetch(lut, ivec2(index.g, 0), 0).r,
+                       texelFetch(lut, ivec2(index.b, 0), 0).r);
+   }
+   uFragColor = color;
 }
@@ -0,0 +1,9 @@
+#version 450
+// Coverage of the glyph from the font atlas, bars sample a solid texel
+layout (binding = 0) uniform sampler2D font;
+layout (location = 0) in vec2 texcoord;
+layout (location = 1) in vec4 quadColor;
+layout (location = 0) out vec4 uFragColor;
+void main() {
+   uFragColor = vec4(quadColor.rgb, quadColor.a * texture(font, texcoord).r);
+}
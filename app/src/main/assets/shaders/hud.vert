@@ -0,0 +1,21 @@
+#version 450
+// One instance per glyph or bar of the HUD, the 6 vertices of its quad come from the vertex index
+layout (location = 0) in vec4 rect;  // x, y, width, height in pixels from the top left corner
+layout (location = 1) in vec4 uvRect;
+layout (location = 2) in vec4 color;
+layout (push_constant) uniform Hud {
+   vec2 viewportSize;
+};
+layout (location = 0) out vec2 texcoord;
+layout (location = 1) out vec4 quadColor;
+
+const vec2 corners[6] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0), vec2(0.0, 1.0), vec2(1.0, 0.0),
+                               vec2(1.0, 1.0));
+
+void main() {
+   vec2 corner = corners[gl_VertexIndex];
+   texcoord = mix(uvRect.xy, uvRect.zw, corner);
+   quadColor = color;
+   vec2 pixel = rect.xy + rect.zw * corner;
+   gl_Position = vec4(pixel / viewportSize * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -1,17 +1,110 @@
 #include <android/log.h>
 #include <android_native_app_glue.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include "CpuProfiler.h"
+#include "EventLoop.h"
 #include "VulkanMain.h"
 
+// Looper ident of the camera's frame event, the app glue uses the ones below LOOPER_ID_USER
+#define VARTIP_LOOPER_ID_FRAME LOOPER_ID_USER
+// Looper ident of the headless run being done
+#define VARTIP_LOOPER_ID_HEADLESS (LOOPER_ID_USER + 1)
+
+// What the render thread did while a window was shown, logged when it goes away
+struct MainLoopStats {
+    double startMs;
+    double startCpuMs;
+    double drawCpuMs;  // thread CPU time in VulkanDrawFrame, the rest went to the loop itself
+    uint64_t wakeups;
+    uint64_t frames;
+    double wakeToRenderTotalMs;  // from the camera posting a frame to drawing it
+    double wakeToRenderMaxMs;
+};
+
+EventLoop* mainLoop;
+// The registered one, nullptr without a window
+FrameEvent* frameEvent;
+MainLoopStats loopStats;
+
+// The headless run owns the Vulkan state on its own thread until it posts done, a window shown meanwhile is only set
+// up after
+struct HeadlessRunInfo {
+    std::thread thread;
+    FrameEvent* done;  // nullptr when no run is going on
+    bool windowPending;
+};
+HeadlessRunInfo headlessRun;
+
+static double GetThreadCpuMs(void) {
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+// Draws whenever the camera posts a frame from now on
+static void StartFrameEvents(void) {
+    frameEvent = GetCameraFrameEvent();
+    if (frameEvent != nullptr && !mainLoop->AddFd(frameEvent->GetFd(), VARTIP_LOOPER_ID_FRAME)) {
+        LOGE("Failed to add the camera frame event to the looper");
+        frameEvent = nullptr;
+    }
+    memset(&loopStats, 0, sizeof(loopStats));
+    loopStats.startMs = GetTimeMs();
+    loopStats.startCpuMs = GetThreadCpuMs();
+}
+
+// Before the camera goes, its event with it
+static void StopFrameEvents(void) {
+    if (frameEvent != nullptr) {
+        mainLoop->RemoveFd(frameEvent->GetFd());
+        frameEvent = nullptr;
+    }
+    double wallMs = GetTimeMs() - loopStats.startMs;
+    if (loopStats.frames == 0 || wallMs <= 0.0) {
+        return;
+    }
+    double idleCpuMs = GetThreadCpuMs() - loopStats.startCpuMs - loopStats.drawCpuMs;
+    LOGI("Main loop: %llu frames, %llu wakeups in %.1f s, %.2f%% CPU outside drawing, wake to render %.3f ms mean, "
+         "%.3f ms max",
+         (unsigned long long)loopStats.frames, (unsigned long long)loopStats.wakeups, wallMs / 1000.0,
+         idleCpuMs * 100.0 / wallMs, loopStats.wakeToRenderTotalMs / loopStats.frames, loopStats.wakeToRenderMaxMs);
+}
+
+// postNs is when the camera posted the oldest frame not drawn yet, VulkanDrawFrame draws the latest
+static void DrawCameraFrame(int64_t postNs) {
+    double wakeToRenderMs = (CpuProfilerNowNs() - postNs) / 1000000.0;
+    double cpuStart = GetThreadCpuMs();
+    if (VulkanDrawFrame()) {
+        loopStats.frames++;
+        loopStats.wakeToRenderTotalMs += wakeToRenderMs;
+        loopStats.wakeToRenderMaxMs = std::max(loopStats.wakeToRenderMaxMs, wakeToRenderMs);
+    }
+    loopStats.drawCpuMs += GetThreadCpuMs() - cpuStart;
+}
+
 // Process the next main command.
 void handle_cmd(android_app* app, int32_t cmd) {
     switch (cmd) {
         case APP_CMD_INIT_WINDOW:
+            if (headlessRun.done != nullptr) {
+                headlessRun.windowPending = true;
+                break;
+            }
             // The window is being shown, get it ready.
+            // Camera is opened in parallel to the Vulkan setup
             InitVulkanContext(app);
-            InitCamera();
+            StartFrameEvents();
             break;
         case APP_CMD_TERM_WINDOW:
+            if (headlessRun.done != nullptr) {
+                headlessRun.windowPending = false;
+                break;
+            }
             // The window is being hidden or closed, clean it up.
+            StopFrameEvents();
             DeleteVulkanContext();
             break;
         default:
@@ -19,23 +112,76 @@ void handle_cmd(android_app* app, int32_t cmd) {
     }
 }
 
+// Headless benchmark, see RunHeadlessIfRequested. It runs next to the main loop so the app glue's commands are still
+// handled while it goes on
+static void StartHeadlessRun(android_app* app) {
+    char value[32];
+    if (GetDebugOption(VARTIP_HEADLESS_ENV, VARTIP_HEADLESS_PROPERTY, value, sizeof(value)) == false) {
+        return;
+    }
+    headlessRun.done = new FrameEvent();
+    if (!mainLoop->AddFd(headlessRun.done->GetFd(), VARTIP_LOOPER_ID_HEADLESS)) {
+        LOGE("Failed to add the headless event to the looper, not running headless");
+        delete headlessRun.done;
+        headlessRun.done = nullptr;
+        return;
+    }
+    AssetSource assets{.assetManager = app->activity->assetManager};
+    std::string dataDirectory = app->activity->internalDataPath;
+    FrameEvent* done = headlessRun.done;
+    headlessRun.thread = std::thread([assets, dataDirectory, done]() {
+        VARTIP_CPU_THREAD_NAME("headless");
+        if (!RunHeadlessIfRequested(assets, dataDirectory.c_str())) {
+            LOGE("Headless run failed");
+        }
+        done->Post();
+    });
+}
+
+// Hands the Vulkan state back, to the window if one was shown meanwhile
+static void FinishHeadlessRun(android_app* app) {
+    headlessRun.thread.join();
+    mainLoop->RemoveFd(headlessRun.done->GetFd());
+    delete headlessRun.done;
+    headlessRun.done = nullptr;
+    if (headlessRun.windowPending) {
+        headlessRun.windowPending = false;
+        InitVulkanContext(app);
+        StartFrameEvents();
+    }
+}
+
 void android_main(struct android_app* app) {
+    VARTIP_CPU_THREAD_NAME("render");
     // Set the callback to process system events
     app->onAppCmd = handle_cmd;
 
-    // Used to poll the events in the main loop
-    int events;
-    android_poll_source* source;
-
-    // Main loop
+    // Main loop, sleeps until the app glue has a command or input, the camera has a frame or the headless run is done
+    EventLoop loop;
+    mainLoop = &loop;
+    StartHeadlessRun(app);
     do {
-        if (ALooper_pollAll(IsVulkanReady() ? 1 : 0, nullptr, &events, (void**)&source) >= 0) {
-            if (source != NULL) source->process(app, source);
-        }
-
-        // render if vulkan is ready
-        if (IsVulkanReady() == true) {
-            VulkanDrawFrame(app);
+        void* data;
+        int ident = loop.Wait(-1, &data);
+        loopStats.wakeups++;
+        if (ident == VARTIP_LOOPER_ID_FRAME) {
+            // Frames posted while the last one was drawn are taken at once, only the latest is drawn
+            int64_t postNs;
+            if (frameEvent != nullptr && frameEvent->Take(&postNs) > 0 && IsVulkanReady()) {
+                DrawCameraFrame(postNs);
+            }
+        } else if (ident == VARTIP_LOOPER_ID_HEADLESS) {
+            if (headlessRun.done != nullptr && headlessRun.done->Take(nullptr) > 0) {
+                FinishHeadlessRun(app);
+            }
+        } else if (data != nullptr) {
+            android_poll_source* source = static_cast<android_poll_source*>(data);
+            source->process(app, source);
         }
     } while (app->destroyRequested == 0);
+    if (headlessRun.done != nullptr) {
+        headlessRun.windowPending = false;
+        FinishHeadlessRun(app);
+    }
+    mainLoop = nullptr;
 }
@@ -0,0 +1,134 @@
+#include "CameraStreamPlanner.h"
+#include <algorithm>
+
+// Frame rates computed from nanosecond durations are a hair off the nominal ones, 33333333 ns is 30.0000003 FPS
+#define VARTIP_FPS_TOLERANCE 0.01
+
+// Duration of format at width x height in a table of (format, width, height, ns) entries, 0 if it has none
+static int64_t FindDuration(const std::vector<int64_t>& table, int32_t format, int32_t width, int32_t height) {
+    for (size_t i = 0; i + 3 < table.size(); i += 4) {
+        if (table[i] == format && table[i + 1] == width && table[i + 2] == height) {
+            return table[i + 3];
+        }
+    }
+    return 0;
+}
+
+// The AIMAGE_FORMAT_*s whose stall durations hold up the next frames, JPEG and the RAW ones. Others, ex) YUV, never
+// stall and devices listing a stall for them anyway are ignored
+static bool IsStallingFormat(int32_t format) {
+    switch (format) {
+        case 0x100:  // AIMAGE_FORMAT_JPEG
+        case 0x20:   // AIMAGE_FORMAT_RAW16
+        case 0x24:   // AIMAGE_FORMAT_RAW_PRIVATE
+        case 0x25:   // AIMAGE_FORMAT_RAW10
+        case 0x26:   // AIMAGE_FORMAT_RAW12
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Whether plan a is a better stream than b, both found
+static bool IsBetterStream(const CameraStreamPlan& a, const CameraStreamPlan& b, int32_t targetFps) {
+    if (a.sameRatio != b.sameRatio) {
+        return a.sameRatio;
+    }
+    bool aReaches = a.maxFps + VARTIP_FPS_TOLERANCE >= targetFps;
+    bool bReaches = b.maxFps + VARTIP_FPS_TOLERANCE >= targetFps;
+    if (aReaches != bReaches) {
+        return aReaches;
+    }
+    if (a.pixelsPerSecond != b.pixelsPerSecond) {
+        return a.pixelsPerSecond > b.pixelsPerSecond;
+    }
+    return a.maxFps > b.maxFps;
+}
+
+// Of the (min, max) ranges up to maxFps, the lowest max reaching targetFps, else the highest max, with the higher min
+// on a tie. fixedOnly only looks at ranges with min == max
+static bool PickFpsRange(const std::vector<int32_t>& ranges, double maxFps, int32_t targetFps, bool fixedOnly,
+                         int32_t* range) {
+    bool found = false;
+    bool foundReaches = false;
+    for (size_t i = 0; i + 1 < ranges.size(); i += 2) {
+        int32_t fpsMin = ranges[i];
+        int32_t fpsMax = ranges[i + 1];
+        if (fpsMax <= 0 || fpsMax > maxFps + VARTIP_FPS_TOLERANCE || (fixedOnly && fpsMin != fpsMax)) {
+            continue;
+        }
+        bool reaches = fpsMax >= targetFps;
+        bool better;
+        if (!found || reaches != foundReaches) {
+            better = !found || reaches;
+        } else if (fpsMax != range[1]) {
+            better = reaches ? fpsMax < range[1] : fpsMax > range[1];
+        } else {
+            better = fpsMin > range[0];
+        }
+        if (better) {
+            range[0] = fpsMin;
+            range[1] = fpsMax;
+            found = true;
+            foundReaches = reaches;
+        }
+    }
+    return found;
+}
+
+CameraStreamPlan PlanCameraStream(const CameraStreamTables& tables, const CameraStreamRequest& request) {
+    CameraStreamPlan best{};
+    const std::vector<int32_t>& configs = tables.streamConfigurations;
+    for (size_t i = 0; i + 3 < configs.size(); i += 4) {
+        int32_t format = configs[i];
+        int32_t width = configs[i + 1];
+        int32_t height = configs[i + 2];
+        bool input = configs[i + 3] != 0;
+        if (input || format != request.format || width <= 0 || height <= 0) {
+            continue;
+        }
+        int64_t pixels = static_cast<int64_t>(width) * height;
+        if (pixels > request.pixelBudget) {
+            continue;
+        }
+
+        // Every output has to list its min frame duration, one that doesn't is taken to reach the target. Stalls of
+        // stalling formats add to the frame time of every frame the stream is part of
+        int64_t frameNs = FindDuration(tables.minFrameDurations, format, width, height);
+        if (IsStallingFormat(format)) {
+            frameNs += FindDuration(tables.stallDurations, format, width, height);
+        }
+        CameraStreamPlan candidate{};
+        candidate.found = true;
+        candidate.width = width;
+        candidate.height = height;
+        candidate.sameRatio =
+            static_cast<int64_t>(width) * request.height == static_cast<int64_t>(height) * request.width;
+        candidate.frameDurationNs = frameNs;
+        candidate.maxFps = frameNs > 0 ? 1e9 / frameNs : request.targetFps;
+        candidate.pixelsPerSecond = pixels * std::min<double>(candidate.maxFps, request.targetFps);
+        if (!best.found || IsBetterStream(candidate, best, request.targetFps)) {
+            best = candidate;
+        }
+    }
+    if (!best.found) {
+        return best;
+    }
+
+    // Ranges going over what the size can do would be cut short by the sensor anyway
+    int32_t range[2];
+    if (PickFpsRange(tables.fpsRanges, best.maxFps, request.targetFps, false, range)) {
+        best.fpsMin = range[0];
+        best.fpsMax = range[1];
+    }
+    if (PickFpsRange(tables.fpsRanges, best.maxFps, request.targetFps, true, range)) {
+        best.fixedFps = range[1];
+    }
+
+    double runFps = std::min<double>(best.maxFps, request.targetFps);
+    if (best.fpsMax > 0) {
+        runFps = std::min<double>(runFps, best.fpsMax);
+    }
+    best.pixelsPerSecond = static_cast<double>(best.width) * best.height * runFps;
+    return best;
+}
@@ -0,0 +1,46 @@
+#ifndef VARTIP_CAMERASTREAMPLANNER_H_
+#define VARTIP_CAMERASTREAMPLANNER_H_
+
+#include <stdint.h>
+#include <vector>
+
+// Camera characteristics the plan is made from, laid out like the metadata entries they are copied from so the tables
+// recorded from a device can be planned anywhere
+struct CameraStreamTables {
+    std::vector<int32_t> streamConfigurations;  // ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS: format, w, h, input
+    std::vector<int64_t> minFrameDurations;     // ACAMERA_SCALER_AVAILABLE_MIN_FRAME_DURATIONS: format, w, h, ns
+    std::vector<int64_t> stallDurations;        // ACAMERA_SCALER_AVAILABLE_STALL_DURATIONS: format, w, h, ns
+    std::vector<int32_t> fpsRanges;             // ACAMERA_CONTROL_AE_AVAILABLE_TARGET_FPS_RANGES: min, max
+};
+
+struct CameraStreamRequest {
+    int32_t format;       // AIMAGE_FORMAT_* of the output
+    int32_t width;        // aspect ratio wanted, in the sensor's landscape orientation
+    int32_t height;
+    int64_t pixelBudget;  // largest width * height accepted
+    int32_t targetFps;
+};
+
+struct CameraStreamPlan {
+    bool found;  // false when no output of the format fits the budget
+    int32_t width;
+    int32_t height;
+    bool sameRatio;
+    int64_t frameDurationNs;  // min frame plus, for JPEG and RAW, stall duration, 0 when the camera lists neither
+    double maxFps;            // what the size can be streamed at, from frameDurationNs
+    int32_t fpsMin;           // AE target FPS range to request, both 0 when the camera lists none the size can reach
+    int32_t fpsMax;
+    int32_t fixedFps;         // of the listed ranges with min == max picked the same way, 0 if there is none
+    double pixelsPerSecond;   // width * height at the frame rate the plan runs at
+};
+
+/**
+ * Picks the output size and AE target FPS range streaming the most pixels per second within the pixel budget at up to
+ * targetFps. Sizes of the requested aspect ratio come first, then the ones reaching targetFps, then the most pixels
+ * per second. Of the FPS ranges the size can sustain, the one with the lowest maximum still reaching targetFps wins,
+ * the steadier one with the higher minimum on a tie, and the same goes for the fixed ranges. Only reads tables, so it
+ * can be checked on a host
+ */
+CameraStreamPlan PlanCameraStream(const CameraStreamTables& tables, const CameraStreamRequest& request);
+
+#endif  // VARTIP_CAMERASTREAMPLANNER_H_
@@ -0,0 +1,143 @@
+#include "CaptureProfile.h"
+#include <string.h>
+#include <algorithm>
+#ifdef __ANDROID__
+#include <camera/NdkCameraMetadataTags.h>
+#else
+// What the profiles use of NdkCameraMetadataTags.h, same values, so their requests can be checked on a host
+#define ACAMERA_CONTROL_AE_TARGET_FPS_RANGE 0x10005
+#define ACAMERA_EDGE_MODE 0x30000
+#define ACAMERA_NOISE_REDUCTION_MODE 0xA0000
+#define ACAMERA_EDGE_MODE_OFF 0
+#define ACAMERA_EDGE_MODE_FAST 1
+#define ACAMERA_NOISE_REDUCTION_MODE_OFF 0
+#define ACAMERA_NOISE_REDUCTION_MODE_FAST 1
+#endif
+
+// quality is what the camera always streamed with. lowlatency drops the processing that adds pipeline depth and holds
+// the frame rate with a fixed AE target range so AE never stretches the exposure past the frame time
+static const CaptureProfile kCaptureProfiles[] = {
+    {
+        .name = "quality",
+        .captureTemplate = CAPTURE_TEMPLATE_RECORD,
+        .fixedFps = false,
+        .noiseReduction = {VARTIP_CAPTURE_MODE_TEMPLATE, VARTIP_CAPTURE_MODE_TEMPLATE},
+        .edge = {VARTIP_CAPTURE_MODE_TEMPLATE, VARTIP_CAPTURE_MODE_TEMPLATE},
+    },
+    {
+        .name = "preview",
+        .captureTemplate = CAPTURE_TEMPLATE_PREVIEW,
+        .fixedFps = false,
+        .noiseReduction = {ACAMERA_NOISE_REDUCTION_MODE_FAST, VARTIP_CAPTURE_MODE_TEMPLATE},
+        .edge = {ACAMERA_EDGE_MODE_FAST, VARTIP_CAPTURE_MODE_TEMPLATE},
+    },
+    {
+        .name = "lowlatency",
+        .captureTemplate = CAPTURE_TEMPLATE_PREVIEW,
+        .fixedFps = true,
+        .noiseReduction = {ACAMERA_NOISE_REDUCTION_MODE_OFF, ACAMERA_NOISE_REDUCTION_MODE_FAST},
+        .edge = {ACAMERA_EDGE_MODE_OFF, ACAMERA_EDGE_MODE_FAST},
+    },
+};
+#define VARTIP_CAPTURE_PROFILE_COUNT (sizeof(kCaptureProfiles) / sizeof(kCaptureProfiles[0]))
+
+uint32_t GetCaptureProfileCount(void) { return VARTIP_CAPTURE_PROFILE_COUNT; }
+
+const CaptureProfile& GetCaptureProfile(uint32_t index) { return kCaptureProfiles[index]; }
+
+const CaptureProfile* FindCaptureProfile(const char* name) {
+    for (uint32_t i = 0; i < VARTIP_CAPTURE_PROFILE_COUNT; i++) {
+        if (strcmp(kCaptureProfiles[i].name, name) == 0) {
+            return &kCaptureProfiles[i];
+        }
+    }
+    return nullptr;
+}
+
+// First of the preferred modes the camera lists, VARTIP_CAPTURE_MODE_TEMPLATE if none of them
+static int32_t PickMode(const int32_t preferred[2], const std::vector<uint8_t>& available) {
+    for (uint32_t i = 0; i < 2; i++) {
+        if (preferred[i] != VARTIP_CAPTURE_MODE_TEMPLATE &&
+            std::find(available.begin(), available.end(), preferred[i]) != available.end()) {
+            return preferred[i];
+        }
+    }
+    return VARTIP_CAPTURE_MODE_TEMPLATE;
+}
+
+bool WriteCaptureRequest(const CaptureProfile& profile, const CameraStreamPlan& plan,
+                         const CaptureCapabilities& capabilities, CaptureRequestWriter* writer) {
+    if (!writer->CreateRequest(profile.captureTemplate)) {
+        return false;
+    }
+
+    // Only listed ranges can be requested, without one the template picks
+    int32_t fpsRange[2] = {plan.fpsMin, plan.fpsMax};
+    if (profile.fixedFps && plan.fixedFps > 0) {
+        fpsRange[0] = plan.fixedFps;
+        fpsRange[1] = plan.fixedFps;
+    }
+    if (fpsRange[1] > 0 && !writer->SetEntry(ACAMERA_CONTROL_AE_TARGET_FPS_RANGE, 2, fpsRange)) {
+        return false;
+    }
+
+    int32_t noiseReduction = PickMode(profile.noiseReduction, capabilities.noiseReductionModes);
+    if (noiseReduction != VARTIP_CAPTURE_MODE_TEMPLATE) {
+        uint8_t mode = static_cast<uint8_t>(noiseReduction);
+        if (!writer->SetEntry(ACAMERA_NOISE_REDUCTION_MODE, 1, &mode)) {
+            return false;
+        }
+    }
+    int32_t edge = PickMode(profile.edge, capabilities.edgeModes);
+    if (edge != VARTIP_CAPTURE_MODE_TEMPLATE) {
+        uint8_t mode = static_cast<uint8_t>(edge);
+        if (!writer->SetEntry(ACAMERA_EDGE_MODE, 1, &mode)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RecordingRequestWriter::CreateRequest(CaptureTemplate captureTemplate) {
+    m_requestCount++;
+    m_template = captureTemplate;
+    m_entries.clear();
+    return true;
+}
+
+template <typename T>
+bool RecordingRequestWriter::Record(uint32_t tag, uint32_t count, const T* data) {
+    if (m_requestCount == 0) {
+        return false;
+    }
+    Entry entry = {.tag = tag, .values = std::vector<int64_t>(data, data + count)};
+    for (uint32_t i = 0; i < m_entries.size(); i++) {
+        if (m_entries[i].tag == tag) {
+            m_entries[i] = entry;
+            return true;
+        }
+    }
+    m_entries.push_back(entry);
+    return true;
+}
+
+bool RecordingRequestWriter::SetEntry(uint32_t tag, uint32_t count, const uint8_t* data) {
+    return Record(tag, count, data);
+}
+
+bool RecordingRequestWriter::SetEntry(uint32_t tag, uint32_t count, const int32_t* data) {
+    return Record(tag, count, data);
+}
+
+bool RecordingRequestWriter::SetEntry(uint32_t tag, uint32_t count, const int64_t* data) {
+    return Record(tag, count, data);
+}
+
+const std::vector<int64_t>* RecordingRequestWriter::FindEntry(uint32_t tag) {
+    for (uint32_t i = 0; i < m_entries.size(); i++) {
+        if (m_entries[i].tag == tag) {
+            return &m_entries[i].values;
+        }
+    }
+    return nullptr;
+}
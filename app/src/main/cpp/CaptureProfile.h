@@ -0,0 +1,97 @@
+#ifndef VARTIP_CAPTUREPROFILE_H_
+#define VARTIP_CAPTUREPROFILE_H_
+
+#include <stdint.h>
+#include <vector>
+#include "CameraStreamPlanner.h"
+
+// Capture profile the camera streams with, by name, ex) adb shell setprop debug.vartip.capture.profile lowlatency
+#define VARTIP_CAPTURE_PROFILE_ENV "VARTIP_CAPTURE_PROFILE"
+#define VARTIP_CAPTURE_PROFILE_PROPERTY "debug.vartip.capture.profile"
+#define VARTIP_CAPTURE_PROFILE_DEFAULT "quality"
+
+// Mode of a profile that leaves the entry to the capture template
+#define VARTIP_CAPTURE_MODE_TEMPLATE -1
+
+// The capture request templates a profile can start from
+enum CaptureTemplate {
+    CAPTURE_TEMPLATE_PREVIEW = 0,  // shortest ISP pipeline, for what is shown right away
+    CAPTURE_TEMPLATE_RECORD = 1,   // steady frame rate and post-processing quality
+};
+
+// What a capture request is made of, beyond the stream it targets
+struct CaptureProfile {
+    const char* name;
+    CaptureTemplate captureTemplate;
+    bool fixedFps;              // AE target range with min == max when the camera lists one, else the planned range
+    int32_t noiseReduction[2];  // ACAMERA_NOISE_REDUCTION_MODE_*, preferred first, the first the camera lists is set
+    int32_t edge[2];            // ACAMERA_EDGE_MODE_*, the same way
+};
+
+// What the camera lists of the modes a profile sets
+struct CaptureCapabilities {
+    std::vector<uint8_t> noiseReductionModes;  // ACAMERA_NOISE_REDUCTION_AVAILABLE_NOISE_REDUCTION_MODES
+    std::vector<uint8_t> edgeModes;            // ACAMERA_EDGE_AVAILABLE_EDGE_MODES
+};
+
+// Where a capture request is built, the camera's on a device and a recording stand-in to check the requests a profile
+// makes without one
+class CaptureRequestWriter {
+   public:
+    virtual ~CaptureRequestWriter() {}
+
+    // Starts a new request from the template, entries are set on the latest one
+    virtual bool CreateRequest(CaptureTemplate captureTemplate) = 0;
+
+    virtual bool SetEntry(uint32_t tag, uint32_t count, const uint8_t* data) = 0;
+    virtual bool SetEntry(uint32_t tag, uint32_t count, const int32_t* data) = 0;
+    virtual bool SetEntry(uint32_t tag, uint32_t count, const int64_t* data) = 0;
+};
+
+// Keeps what was written to the latest request so it can be checked
+class RecordingRequestWriter : public CaptureRequestWriter {
+   public:
+    RecordingRequestWriter() : m_requestCount(0), m_template(CAPTURE_TEMPLATE_PREVIEW) {}
+
+    bool CreateRequest(CaptureTemplate captureTemplate);
+    bool SetEntry(uint32_t tag, uint32_t count, const uint8_t* data);
+    bool SetEntry(uint32_t tag, uint32_t count, const int32_t* data);
+    bool SetEntry(uint32_t tag, uint32_t count, const int64_t* data);
+
+    uint32_t GetRequestCount(void) { return m_requestCount; }
+    CaptureTemplate GetTemplate(void) { return m_template; }
+    uint32_t GetEntryCount(void) { return static_cast<uint32_t>(m_entries.size()); }
+
+    // @return the values of tag widened to 64 bits, nullptr if it wasn't set
+    const std::vector<int64_t>* FindEntry(uint32_t tag);
+
+   private:
+    struct Entry {
+        uint32_t tag;
+        std::vector<int64_t> values;
+    };
+
+    template <typename T>
+    bool Record(uint32_t tag, uint32_t count, const T* data);
+
+    uint32_t m_requestCount;
+    CaptureTemplate m_template;
+    std::vector<Entry> m_entries;
+};
+
+uint32_t GetCaptureProfileCount(void);
+const CaptureProfile& GetCaptureProfile(uint32_t index);
+
+// @return nullptr if there is no profile called name
+const CaptureProfile* FindCaptureProfile(const char* name);
+
+/**
+ * Writes the request of profile for the planned stream: the template, the AE target FPS range and the noise reduction
+ * and edge modes. Entries the camera can't take are left out, so are ones the profile leaves to the template. AE stays
+ * on, so the frame rate is held by the range alone
+ * @return false if the writer failed
+ */
+bool WriteCaptureRequest(const CaptureProfile& profile, const CameraStreamPlan& plan,
+                         const CaptureCapabilities& capabilities, CaptureRequestWriter* writer);
+
+#endif  // VARTIP_CAPTUREPROFILE_H_
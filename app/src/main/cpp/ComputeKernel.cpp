@@ -0,0 +1,218 @@
+#include "ComputeKernel.h"
+#include <cassert>
+#include "CreateShaderModule.h"
+#include "Util.h"
+
+void CreateComputePipeline(VkDevice device, VkShaderModule shaderModule, const std::vector<VkDescriptorType>& bindings,
+                           uint32_t pushConstantSize, const VkSpecializationInfo* specialization,
+                           VkPipelineCache pipelineCache, ComputePipeline* pipeline) {
+    pipeline->bindings = bindings;
+    pipeline->pushConstantSize = pushConstantSize;
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings(bindings.size());
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        layoutBindings[i] = {
+            .binding = i,
+            .descriptorType = bindings[i],
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = nullptr,
+        };
+    }
+
+    const VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .bindingCount = static_cast<uint32_t>(layoutBindings.size()),
+        .pBindings = layoutBindings.data(),
+    };
+    CALL_VK(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &pipeline->setLayout));
+
+    VkPushConstantRange pushConstantRange{
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = pushConstantSize,
+    };
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .setLayoutCount = 1,
+        .pSetLayouts = &pipeline->setLayout,
+        .pushConstantRangeCount = pushConstantSize > 0 ? 1u : 0u,
+        .pPushConstantRanges = &pushConstantRange,
+    };
+    CALL_VK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipeline->layout));
+
+    VkComputePipelineCreateInfo pipelineCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .stage =
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shaderModule,
+                .pName = "main",
+                .pSpecializationInfo = specialization,
+            },
+        .layout = pipeline->layout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = 0,
+    };
+    CALL_VK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline->pipeline));
+}
+
+void DestroyComputePipeline(VkDevice device, ComputePipeline* pipeline) {
+    vkDestroyPipeline(device, pipeline->pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipeline->layout, nullptr);
+    vkDestroyDescriptorSetLayout(device, pipeline->setLayout, nullptr);
+    pipeline->pipeline = VK_NULL_HANDLE;
+    pipeline->layout = VK_NULL_HANDLE;
+    pipeline->setLayout = VK_NULL_HANDLE;
+}
+
+ComputeKernel::ComputeKernel(const AssetSource& assets, VkDevice device, const char* shaderPath,
+                             const std::vector<VkDescriptorType>& bindings, uint32_t pushConstantSize,
+                             const VkSpecializationInfo* specialization)
+    : m_device(device), m_ownsPipeline(true) {
+    VkShaderModule shaderModule = LoadSPIRVShader(assets, shaderPath, device);
+    CreateComputePipeline(device, shaderModule, bindings, pushConstantSize, specialization, VK_NULL_HANDLE,
+                          &m_pipeline);
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+    CreateDescriptorPool();
+}
+
+ComputeKernel::ComputeKernel(VkDevice device, const ComputePipeline* pipeline)
+    : m_device(device), m_pipeline(*pipeline), m_ownsPipeline(false) {
+    CreateDescriptorPool();
+}
+
+ComputeKernel::~ComputeKernel() {
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    if (m_ownsPipeline) {
+        DestroyComputePipeline(m_device, &m_pipeline);
+    }
+}
+
+void ComputeKernel::CreateDescriptorPool(void) {
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (uint32_t i = 0; i < m_pipeline.bindings.size(); i++) {
+        bool counted = false;
+        for (uint32_t j = 0; j < poolSizes.size() && !counted; j++) {
+            if (poolSizes[j].type == m_pipeline.bindings[i]) {
+                poolSizes[j].descriptorCount += VARTIP_KERNEL_MAX_SETS;
+                counted = true;
+            }
+        }
+        if (!counted) {
+            poolSizes.push_back({.type = m_pipeline.bindings[i], .descriptorCount = VARTIP_KERNEL_MAX_SETS});
+        }
+    }
+
+    const VkDescriptorPoolCreateInfo poolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .maxSets = VARTIP_KERNEL_MAX_SETS,
+        .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+        .pPoolSizes = poolSizes.data(),
+    };
+    CALL_VK(vkCreateDescriptorPool(m_device, &poolCreateInfo, nullptr, &m_descriptorPool));
+}
+
+VkDescriptorSet ComputeKernel::AllocateSet(void) {
+    VkDescriptorSetAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .descriptorPool = m_descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &m_pipeline.setLayout,
+    };
+    VkDescriptorSet set;
+    CALL_VK(vkAllocateDescriptorSets(m_device, &allocInfo, &set));
+    return set;
+}
+
+// Graph images always stay in the general layout
+void ComputeKernel::UpdateSampledImage(VkDescriptorSet set, uint32_t binding, VkSampler sampler, VkImageView view) {
+    VkDescriptorImageInfo imageInfo{
+        .sampler = sampler,
+        .imageView = view,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+    };
+    VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = nullptr,
+        .dstSet = set,
+        .dstBinding = binding,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &imageInfo,
+        .pBufferInfo = nullptr,
+        .pTexelBufferView = nullptr,
+    };
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
+
+void ComputeKernel::UpdateStorageImage(VkDescriptorSet set, uint32_t binding, VkImageView view) {
+    VkDescriptorImageInfo imageInfo{
+        .sampler = VK_NULL_HANDLE,
+        .imageView = view,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+    };
+    VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = nullptr,
+        .dstSet = set,
+        .dstBinding = binding,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        .pImageInfo = &imageInfo,
+        .pBufferInfo = nullptr,
+        .pTexelBufferView = nullptr,
+    };
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
+
+void ComputeKernel::UpdateStorageBuffer(VkDescriptorSet set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset,
+                                        VkDeviceSize range) {
+    VkDescriptorBufferInfo bufferInfo{
+        .buffer = buffer,
+        .offset = offset,
+        .range = range,
+    };
+    VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = nullptr,
+        .dstSet = set,
+        .dstBinding = binding,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pImageInfo = nullptr,
+        .pBufferInfo = &bufferInfo,
+        .pTexelBufferView = nullptr,
+    };
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
+
+void ComputeKernel::Dispatch(VkCommandBuffer cmdBuffer, VkDescriptorSet set, const void* pushConstants,
+                             uint32_t width, uint32_t height) {
+    DispatchGroups(cmdBuffer, set, pushConstants, (width + VARTIP_KERNEL_GROUP_SIZE - 1) / VARTIP_KERNEL_GROUP_SIZE,
+                   (height + VARTIP_KERNEL_GROUP_SIZE - 1) / VARTIP_KERNEL_GROUP_SIZE);
+}
+
+void ComputeKernel::DispatchGroups(VkCommandBuffer cmdBuffer, VkDescriptorSet set, const void* pushConstants,
+                                   uint32_t groupCountX, uint32_t groupCountY) {
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline.pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline.layout, 0, 1, &set, 0, nullptr);
+    if (m_pipeline.pushConstantSize > 0) {
+        ASSERT(pushConstants != nullptr, "Kernel expects %u bytes of push constants", m_pipeline.pushConstantSize);
+        vkCmdPushConstants(cmdBuffer, m_pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, m_pipeline.pushConstantSize,
+                           pushConstants);
+    }
+    vkCmdDispatch(cmdBuffer, groupCountX, groupCountY, 1);
+}
@@ -0,0 +1,79 @@
+#ifndef VARTIP_COMPUTEKERNEL_H_
+#define VARTIP_COMPUTEKERNEL_H_
+
+#include <vulkan_wrapper.h>
+#include <vector>
+#include "CreateShaderModule.h"
+
+// Work group size every filter shader is written for, local_size_x/y in the .comp files have to match
+#define VARTIP_KERNEL_GROUP_SIZE 8
+
+// Descriptor sets a kernel can hand out, one per pass using it is the usual case
+#define VARTIP_KERNEL_MAX_SETS 8
+
+// What a compute kernel needs that does not depend on the resources bound to it: the descriptor set layout (binding i
+// is bindings[i]), pipeline layout and pipeline. Kernels of the same shader and specialization can share one
+struct ComputePipeline {
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout layout;
+    VkPipeline pipeline;
+    std::vector<VkDescriptorType> bindings;
+    uint32_t pushConstantSize;
+};
+
+/**
+ * @param shaderModule stays owned by the caller, it can be destroyed once this returns
+ * @param specialization specialization constants of the pipeline, nullptr if none
+ * @param pipelineCache VK_NULL_HANDLE if none
+ */
+void CreateComputePipeline(VkDevice device, VkShaderModule shaderModule, const std::vector<VkDescriptorType>& bindings,
+                           uint32_t pushConstantSize, const VkSpecializationInfo* specialization,
+                           VkPipelineCache pipelineCache, ComputePipeline* pipeline);
+
+void DestroyComputePipeline(VkDevice device, ComputePipeline* pipeline);
+
+// A compute pipeline with a small descriptor pool the passes using it allocate their sets from
+class ComputeKernel {
+   public:
+    /**
+     * @param shaderPath SPIR-V asset, ex) "shaders/luma.comp.spv"
+     * @param pushConstantSize bytes of push constants, 0 if the shader has none
+     * @param specialization specialization constants of the pipeline, nullptr if none
+     */
+    explicit ComputeKernel(const AssetSource& assets, VkDevice device, const char* shaderPath,
+                           const std::vector<VkDescriptorType>& bindings, uint32_t pushConstantSize = 0,
+                           const VkSpecializationInfo* specialization = nullptr);
+
+    // Kernel on a pipeline owned by someone else, which has to outlive it
+    explicit ComputeKernel(VkDevice device, const ComputePipeline* pipeline);
+
+    ~ComputeKernel();
+
+    VkDescriptorSet AllocateSet(void);
+
+    void UpdateSampledImage(VkDescriptorSet set, uint32_t binding, VkSampler sampler, VkImageView view);
+    void UpdateStorageImage(VkDescriptorSet set, uint32_t binding, VkImageView view);
+    void UpdateStorageBuffer(VkDescriptorSet set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0,
+                             VkDeviceSize range = VK_WHOLE_SIZE);
+
+    // Binds the pipeline and set, pushes the constants and dispatches enough groups to cover width x height
+    void Dispatch(VkCommandBuffer cmdBuffer, VkDescriptorSet set, const void* pushConstants, uint32_t width,
+                  uint32_t height);
+
+    // Same for shaders with another group size than VARTIP_KERNEL_GROUP_SIZE
+    void DispatchGroups(VkCommandBuffer cmdBuffer, VkDescriptorSet set, const void* pushConstants, uint32_t groupCountX,
+                        uint32_t groupCountY);
+
+    VkPipelineLayout GetLayout(void) { return m_pipeline.layout; }
+    VkPipeline GetPipeline(void) { return m_pipeline.pipeline; }
+
+   private:
+    void CreateDescriptorPool(void);
+
+    VkDevice m_device;
+    ComputePipeline m_pipeline;
+    bool m_ownsPipeline;
+    VkDescriptorPool m_descriptorPool;
+};
+
+#endif  // VARTIP_COMPUTEKERNEL_H_
@@ -0,0 +1,115 @@
+#include "CpuProfiler.h"
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Util.h"
+
+struct CpuZone {
+    const char* name;
+    int64_t startNs;
+    int64_t endNs;
+};
+
+// Single producer ring, its thread writes a zone and then publishes it by bumping written. A flush reading it from
+// another thread takes the published zones and drops the ones the producer lapped while it copied
+struct CpuZoneRing {
+    std::atomic<uint64_t> written;
+    uint32_t tid;
+    char name[32];
+    CpuZone zones[VARTIP_CPU_PROFILER_RING_SIZE];
+};
+
+// Rings of every thread that recorded, they are kept after their thread exits so its zones still get flushed
+static std::mutex ringMutex;
+static std::vector<CpuZoneRing*> rings;
+static thread_local CpuZoneRing* threadRing = nullptr;
+
+static CpuZoneRing* GetThreadRing() {
+    if (threadRing == nullptr) {
+        CpuZoneRing* ring = new CpuZoneRing();
+        ring->written.store(0, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(ringMutex);
+        ring->tid = static_cast<uint32_t>(rings.size()) + 1;
+        snprintf(ring->name, sizeof(ring->name), "thread %u", ring->tid);
+        rings.push_back(ring);
+        threadRing = ring;
+    }
+    return threadRing;
+}
+
+void CpuProfilerSetThreadName(const char* name) {
+    CpuZoneRing* ring = GetThreadRing();
+    std::lock_guard<std::mutex> lock(ringMutex);
+    strncpy(ring->name, name, sizeof(ring->name) - 1);
+    ring->name[sizeof(ring->name) - 1] = '\0';
+}
+
+void CpuProfilerRecord(const char* name, int64_t startNs, int64_t endNs) {
+    CpuZoneRing* ring = GetThreadRing();
+    uint64_t index = ring->written.load(std::memory_order_relaxed);
+    CpuZone& zone = ring->zones[index & (VARTIP_CPU_PROFILER_RING_SIZE - 1)];
+    zone.name = name;
+    zone.startNs = startNs;
+    zone.endNs = endNs;
+    ring->written.store(index + 1, std::memory_order_release);
+}
+
+uint32_t CpuProfilerWriteTraceEvents(FILE* file, uint32_t pid) {
+    std::vector<CpuZoneRing*> snapshot;
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(ringMutex);
+        snapshot = rings;
+        for (uint32_t i = 0; i < rings.size(); i++) {
+            names.push_back(rings[i]->name);
+        }
+    }
+
+    uint32_t written = 0;
+    std::vector<CpuZone> zones;
+    for (uint32_t i = 0; i < snapshot.size(); i++) {
+        CpuZoneRing* ring = snapshot[i];
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                pid, ring->tid, names[i].c_str());
+
+        uint64_t end = ring->written.load(std::memory_order_acquire);
+        uint64_t begin = end > VARTIP_CPU_PROFILER_RING_SIZE ? end - VARTIP_CPU_PROFILER_RING_SIZE : 0;
+        zones.resize(end - begin);
+        for (uint64_t z = begin; z < end; z++) {
+            zones[z - begin] = ring->zones[z & (VARTIP_CPU_PROFILER_RING_SIZE - 1)];
+        }
+        // Whatever the producer wrote meanwhile overwrote the oldest of them, and it may be halfway through the slot
+        // of index after, which is also the one of after - RING_SIZE. The fence keeps the copies above from moving past
+        // the reload
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = ring->written.load(std::memory_order_acquire);
+        uint64_t valid = after + 1 > VARTIP_CPU_PROFILER_RING_SIZE ? after + 1 - VARTIP_CPU_PROFILER_RING_SIZE : 0;
+        for (uint64_t z = std::max(begin, valid); z < end; z++) {
+            const CpuZone& zone = zones[z - begin];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", zone.name,
+                    pid, ring->tid, zone.startNs / 1000.0, (zone.endNs - zone.startNs) / 1000.0);
+            written++;
+        }
+    }
+    return written;
+}
+
+bool CpuProfilerWriteChromeTrace(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        LOGE("Could not open trace file %s", path);
+        return false;
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CPU zones\"}}");
+    uint32_t zoneCount = CpuProfilerWriteTraceEvents(file, 1);
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    LOGI("Wrote %u CPU zones to %s", zoneCount, path);
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef VARTIP_CPUPROFILER_H_
+#define VARTIP_CPUPROFILER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+
+// Zones are compiled in unless VARTIP_CPU_PROFILER is 0, which release builds (NDEBUG) default to so the macros below
+// leave nothing behind
+#ifndef VARTIP_CPU_PROFILER
+#ifdef NDEBUG
+#define VARTIP_CPU_PROFILER 0
+#else
+#define VARTIP_CPU_PROFILER 1
+#endif
+#endif
+
+// Zones each thread keeps, the oldest are overwritten. Has to be a power of 2
+#define VARTIP_CPU_PROFILER_RING_SIZE 4096
+
+// Name of the calling thread in the trace, "thread <n>" until set
+void CpuProfilerSetThreadName(const char* name);
+
+// Records a zone on the calling thread's ring. Lock free, the ring is only written by its thread. name is only
+// pointed to so it has to be a string literal
+void CpuProfilerRecord(const char* name, int64_t startNs, int64_t endNs);
+
+// Chrome trace events of the zones the rings hold, each written as ",\n{...}" so they can follow other events of a
+// trace. Threads are tids of pid. Safe while other threads keep recording, zones overwritten during the flush are
+// skipped
+// @return zones written
+uint32_t CpuProfilerWriteTraceEvents(FILE* file, uint32_t pid);
+
+// The same as a trace file of its own, open in chrome://tracing or ui.perfetto.dev
+bool CpuProfilerWriteChromeTrace(const char* path);
+
+// Steady clock, the same timeline as GetTimeMs
+static inline int64_t CpuProfilerNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Zone from construction to the end of the enclosing scope
+class CpuZoneScope {
+   public:
+    explicit CpuZoneScope(const char* name) : m_name(name), m_startNs(CpuProfilerNowNs()) {}
+
+    ~CpuZoneScope() { CpuProfilerRecord(m_name, m_startNs, CpuProfilerNowNs()); }
+
+   private:
+    const char* m_name;
+    int64_t m_startNs;
+};
+
+#define VARTIP_CPU_ZONE_CONCAT_(a, b) a##b
+#define VARTIP_CPU_ZONE_CONCAT(a, b) VARTIP_CPU_ZONE_CONCAT_(a, b)
+
+#if (VARTIP_CPU_PROFILER)
+// Times the rest of the enclosing scope, ex) VARTIP_CPU_ZONE("texture copy");
+#define VARTIP_CPU_ZONE(name) CpuZoneScope VARTIP_CPU_ZONE_CONCAT(cpuZone, __LINE__)(name)
+#define VARTIP_CPU_THREAD_NAME(name) CpuProfilerSetThreadName(name)
+#else
+#define VARTIP_CPU_ZONE(name) ((void)0)
+#define VARTIP_CPU_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif  // VARTIP_CPUPROFILER_H_
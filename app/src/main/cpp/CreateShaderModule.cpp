@@ -1,28 +1,160 @@
 #include "CreateShaderModule.h"
-#include <android/log.h>
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#ifndef __ANDROID__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "Util.h"
 
-VkShaderModule LoadSPIRVShader(android_app* appInfo, const char* filePath, VkDevice vkDevice) {
+#ifdef __ANDROID__
+bool OpenSPIRVAsset(const AssetSource& assets, const char* filePath, SpirvAsset* spirv) {
     // Shaders need to compiled prior
-    AAsset* asset = AAssetManager_open(appInfo->activity->assetManager, filePath, AASSET_MODE_BUFFER);
-    ASSERT(asset != nullptr, "Make sure you have ran the build_shader.py script prior to compiling!");
-    size_t shaderSize = AAsset_getLength(asset);
-    assert(shaderSize > 0);
+    spirv->asset = AAssetManager_open(assets.assetManager, filePath, AASSET_MODE_BUFFER);
+    if (spirv->asset == nullptr) {
+        return false;
+    }
+    spirv->size = AAsset_getLength(spirv->asset);
+    assert(spirv->size > 0);
 
-    char* shaderCode = new char[shaderSize];
-    AAsset_read(asset, shaderCode, shaderSize);
-    AAsset_close(asset);
-    assert(shaderCode != nullptr);
+    // Stored assets map the APK, pCode only needs the 4 byte alignment zipalign gives them
+    const void* buffer = AAsset_getBuffer(spirv->asset);
+    if (buffer != nullptr && reinterpret_cast<uintptr_t>(buffer) % sizeof(uint32_t) == 0) {
+        spirv->code = static_cast<const uint32_t*>(buffer);
+        return true;
+    }
+    spirv->copy.resize((spirv->size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+    if (buffer != nullptr) {
+        memcpy(spirv->copy.data(), buffer, spirv->size);
+    } else {
+        AAsset_seek(spirv->asset, 0, SEEK_SET);
+        AAsset_read(spirv->asset, spirv->copy.data(), spirv->size);
+    }
+    spirv->code = spirv->copy.data();
+    return true;
+}
+
+void CloseSPIRVAsset(SpirvAsset* spirv) {
+    AAsset_close(spirv->asset);
+    spirv->asset = nullptr;
+    spirv->code = nullptr;
+    spirv->copy.clear();
+}
+#else
+// Read in place like the APK's stored assets, a mapping starts on a page so pCode is aligned
+bool OpenSPIRVAsset(const AssetSource& assets, const char* filePath, SpirvAsset* spirv) {
+    std::string path = assets.directory + "/" + filePath;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat fileStat;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+        mapping = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // The mapping keeps the file, the descriptor isn't needed any more
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        LOGE("Could not map %s", path.c_str());
+        return false;
+    }
+    spirv->mapping = mapping;
+    spirv->mappingSize = static_cast<size_t>(fileStat.st_size);
+    spirv->size = spirv->mappingSize;
+    spirv->code = static_cast<const uint32_t*>(mapping);
+    return true;
+}
+
+void CloseSPIRVAsset(SpirvAsset* spirv) {
+    munmap(spirv->mapping, spirv->mappingSize);
+    spirv->mapping = nullptr;
+    spirv->mappingSize = 0;
+    spirv->code = nullptr;
+}
+#endif
 
+static VkShaderModule CreateShaderModule(VkDevice vkDevice, const SpirvAsset& spirv) {
     VkShaderModuleCreateInfo shaderModuleCreateInfo{};
     shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shaderModuleCreateInfo.codeSize = shaderSize;
-    shaderModuleCreateInfo.pCode = (uint32_t*)shaderCode;
+    shaderModuleCreateInfo.codeSize = spirv.size;
+    shaderModuleCreateInfo.pCode = spirv.code;
 
     VkShaderModule shaderModule;
     CALL_VK(vkCreateShaderModule(vkDevice, &shaderModuleCreateInfo, nullptr, &shaderModule));
+    return shaderModule;
+}
+
+VkShaderModule LoadSPIRVShader(const AssetSource& assets, const char* filePath, VkDevice vkDevice) {
+    SpirvAsset spirv;
+    bool opened = OpenSPIRVAsset(assets, filePath, &spirv);
+    ASSERT(opened, "Make sure you have ran the build_shader.py script prior to compiling!");
+    VkShaderModule shaderModule = CreateShaderModule(vkDevice, spirv);
+    CloseSPIRVAsset(&spirv);
+    return shaderModule;
+}
+
+ShaderModuleCache::ShaderModuleCache(const AssetSource& assets, VkDevice device)
+    : m_assets(assets), m_device(device), m_stats() {}
+
+ShaderModuleCache::~ShaderModuleCache() {
+    // Paths sharing a module share its entry in m_contents, which has each module once
+    for (std::map<std::pair<uint64_t, size_t>, VkShaderModule>::iterator it = m_contents.begin();
+         it != m_contents.end(); ++it) {
+        vkDestroyShaderModule(m_device, it->second, nullptr);
+    }
+}
+
+VkShaderModule ShaderModuleCache::GetModule(const char* filePath) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double loadStart = GetTimeMs();
+    m_stats.requestCount++;
+    std::map<std::string, VkShaderModule>::iterator path = m_paths.find(filePath);
+    if (path != m_paths.end()) {
+        m_stats.loadMs += GetTimeMs() - loadStart;
+        return path->second;
+    }
 
-    delete[] shaderCode;
+    SpirvAsset spirv;
+    if (!OpenSPIRVAsset(m_assets, filePath, &spirv)) {
+        LOGE("Shader %s is missing, make sure you have ran the build_shader.py script prior to compiling!", filePath);
+        return VK_NULL_HANDLE;
+    }
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(spirv.code);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < spirv.size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    std::pair<uint64_t, size_t> content = std::make_pair(hash, spirv.size);
+    std::map<std::pair<uint64_t, size_t>, VkShaderModule>::iterator same = m_contents.find(content);
+    VkShaderModule shaderModule;
+    if (same != m_contents.end()) {
+        shaderModule = same->second;
+        m_stats.sameContentCount++;
+    } else {
+        shaderModule = CreateShaderModule(m_device, spirv);
+        m_contents[content] = shaderModule;
+        m_stats.moduleCount++;
+        m_stats.spirvBytes += spirv.size;
+    }
+    m_stats.copiedCount += spirv.copy.empty() ? 0 : 1;
+    CloseSPIRVAsset(&spirv);
+    m_paths[filePath] = shaderModule;
+    m_stats.loadMs += GetTimeMs() - loadStart;
     return shaderModule;
 }
+
+ShaderModuleStats ShaderModuleCache::GetStats(void) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void ShaderModuleCache::LogStats(void) {
+    ShaderModuleStats stats = GetStats();
+    LOGI("Shader modules: %u from %llu KB of SPIR-V for %u requests in %.2f ms, %u shared by content, %u copied",
+         stats.moduleCount, (unsigned long long)(stats.spirvBytes / 1024), stats.requestCount, stats.loadMs,
+         stats.sameContentCount, stats.copiedCount);
+}
@@ -1,9 +1,78 @@
 #ifndef VARTIP_CREATESHADERMODULE_H_
 #define VARTIP_CREATESHADERMODULE_H_
 
-#include <android_native_app_glue.h>
 #include <vulkan_wrapper.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#ifdef __ANDROID__
+#include <android/asset_manager.h>
+#endif
 
-VkShaderModule LoadSPIRVShader(android_app* appInfo, const char* filePath, VkDevice vkDevice);
+// Where the SPIR-V assets are read from, the APK on Android. Elsewhere it is a directory the asset paths are relative
+// to, the one build_shaders.py writes shaders/ into, ex) app/build/generated/assets/shaders
+struct AssetSource {
+#ifdef __ANDROID__
+    AAssetManager* assetManager;
+#else
+    std::string directory;
+#endif
+};
+
+// SPIR-V of an asset. Uncompressed assets are read in place from their memory mapped buffer, compressed or misaligned
+// ones are copied into copy. Files off Android are memory mapped, copy stays empty
+struct SpirvAsset {
+#ifdef __ANDROID__
+    AAsset* asset;
+#else
+    void* mapping;
+    size_t mappingSize;
+#endif
+    const uint32_t* code;
+    size_t size;  // bytes
+    std::vector<uint32_t> copy;
+};
+
+bool OpenSPIRVAsset(const AssetSource& assets, const char* filePath, SpirvAsset* spirv);
+
+void CloseSPIRVAsset(SpirvAsset* spirv);
+
+// Module the caller destroys
+VkShaderModule LoadSPIRVShader(const AssetSource& assets, const char* filePath, VkDevice vkDevice);
+
+struct ShaderModuleStats {
+    uint32_t moduleCount;       // modules created
+    uint32_t requestCount;      // modules asked for
+    uint32_t sameContentCount;  // assets whose SPIR-V was already loaded under another name
+    uint32_t copiedCount;       // assets that could not be read in place
+    uint64_t spirvBytes;        // SPIR-V the modules were created from
+    double loadMs;              // opening, hashing and creating, the hits included
+};
+
+// Shader modules of the assets, created once and shared by every pipeline using them. Modules are found by path, and
+// by a hash of their SPIR-V so identical shaders under different names share one too. Thread safe, the graphics
+// pipeline is created on another thread than the filter kernels
+class ShaderModuleCache {
+   public:
+    explicit ShaderModuleCache(const AssetSource& assets, VkDevice device);
+
+    ~ShaderModuleCache();
+
+    // The module lives as long as the cache, VK_NULL_HANDLE if the asset is missing
+    VkShaderModule GetModule(const char* filePath);
+
+    ShaderModuleStats GetStats(void);
+    void LogStats(void);
+
+   private:
+    AssetSource m_assets;
+    VkDevice m_device;
+    std::mutex m_mutex;
+    std::map<std::string, VkShaderModule> m_paths;
+    std::map<std::pair<uint64_t, size_t>, VkShaderModule> m_contents;  // FNV-1a hash and size of the SPIR-V
+    ShaderModuleStats m_stats;
+};
 
 #endif  // VARTIP_CREATESHADERMODULE_H_
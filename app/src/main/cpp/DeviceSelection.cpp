@@ -0,0 +1,172 @@
+#include "DeviceSelection.h"
+#include <stdlib.h>
+#include <string.h>
+#include "Util.h"
+
+static bool HasDeviceExtensions(VkPhysicalDevice gpuDevice, const std::vector<const char*>& requiredExtensions) {
+    uint32_t extensionCount = 0;
+    CALL_VK(vkEnumerateDeviceExtensionProperties(gpuDevice, nullptr, &extensionCount, nullptr));
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    CALL_VK(vkEnumerateDeviceExtensionProperties(gpuDevice, nullptr, &extensionCount, extensions.data()));
+
+    for (uint32_t i = 0; i < requiredExtensions.size(); i++) {
+        bool found = false;
+        for (uint32_t j = 0; j < extensionCount && !found; j++) {
+            found = (strcmp(requiredExtensions[i], extensions[j].extensionName) == 0);
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Graphics family has to present as well since everything is drawn and presented from one queue. Dedicated compute is
+// a family with compute but no graphics, dedicated transfer has neither of them
+static bool FindQueueFamilies(VkPhysicalDevice gpuDevice, VkSurfaceKHR surface, QueueFamilySelection* queueFamilies) {
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(gpuDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(gpuDevice, &queueFamilyCount, queueFamilyProperties.data());
+
+    bool foundGraphics = false;
+    queueFamilies->hasDedicatedCompute = false;
+    queueFamilies->hasDedicatedTransfer = false;
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+        VkQueueFlags flags = queueFamilyProperties[i].queueFlags;
+        if (queueFamilyProperties[i].queueCount == 0) {
+            continue;
+        }
+
+        if (!foundGraphics && (flags & VK_QUEUE_GRAPHICS_BIT)) {
+            VkBool32 presentSupport = VK_TRUE;
+            if (surface != VK_NULL_HANDLE) {
+                CALL_VK(vkGetPhysicalDeviceSurfaceSupportKHR(gpuDevice, i, surface, &presentSupport));
+            }
+            if (presentSupport == VK_TRUE) {
+                queueFamilies->graphics = i;
+                foundGraphics = true;
+            }
+        } else if (!queueFamilies->hasDedicatedCompute && (flags & VK_QUEUE_COMPUTE_BIT) &&
+                   !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            queueFamilies->compute = i;
+            queueFamilies->hasDedicatedCompute = true;
+        } else if (!queueFamilies->hasDedicatedTransfer && (flags & VK_QUEUE_TRANSFER_BIT) &&
+                   !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            queueFamilies->transfer = i;
+            queueFamilies->hasDedicatedTransfer = true;
+        }
+    }
+
+    if (!foundGraphics) {
+        return false;
+    }
+    if (!queueFamilies->hasDedicatedCompute) {
+        queueFamilies->compute = queueFamilies->graphics;
+    }
+    if (!queueFamilies->hasDedicatedTransfer) {
+        queueFamilies->transfer = queueFamilies->graphics;
+    }
+    return true;
+}
+
+// Higher is better, -1 if the device can't be used at all
+static int64_t ScorePhysicalDevice(VkPhysicalDevice gpuDevice, VkSurfaceKHR surface,
+                                   const std::vector<const char*>& requiredExtensions,
+                                   QueueFamilySelection* queueFamilies) {
+    if (!HasDeviceExtensions(gpuDevice, requiredExtensions) || !FindQueueFamilies(gpuDevice, surface, queueFamilies)) {
+        return -1;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(gpuDevice, &properties);
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(gpuDevice, &memoryProperties);
+
+    int64_t score = 0;
+    switch (properties.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            score += 10000;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            score += 5000;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            score += 2000;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            score += 500;
+            break;
+        default:
+            break;
+    }
+
+    // 1 point per 64 MB of the largest device local heap
+    VkDeviceSize largestHeap = 0;
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        if ((memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) &&
+            memoryProperties.memoryHeaps[i].size > largestHeap) {
+            largestHeap = memoryProperties.memoryHeaps[i].size;
+        }
+    }
+    score += static_cast<int64_t>(largestHeap / (64 * 1024 * 1024));
+
+    // The camera upload runs on it instead of the graphics queue
+    if (queueFamilies->hasDedicatedTransfer) score += 100;
+    return score;
+}
+
+bool SelectPhysicalDevice(VkInstance instance, VkSurfaceKHR surface, const std::vector<const char*>& requiredExtensions,
+                          VkPhysicalDevice* gpuDevice, QueueFamilySelection* queueFamilies) {
+    uint32_t gpuCount = 0;
+    CALL_VK(vkEnumeratePhysicalDevices(instance, &gpuCount, nullptr));
+    std::vector<VkPhysicalDevice> gpus(gpuCount);
+    CALL_VK(vkEnumeratePhysicalDevices(instance, &gpuCount, gpus.data()));
+
+    char overrideValue[128];
+    bool hasOverride = GetDebugOption(VARTIP_DEVICE_OVERRIDE_ENV, VARTIP_DEVICE_OVERRIDE_PROPERTY, overrideValue,
+                                      sizeof(overrideValue));
+    char* overrideEnd = nullptr;
+    long overrideIndex = hasOverride ? strtol(overrideValue, &overrideEnd, 10) : -1;
+    bool overrideIsIndex = hasOverride && overrideEnd != overrideValue && *overrideEnd == '\0';
+
+    int64_t bestScore = -1;
+    int32_t bestIndex = -1;
+    for (uint32_t i = 0; i < gpuCount; i++) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(gpus[i], &properties);
+
+        QueueFamilySelection families{};
+        int64_t score = ScorePhysicalDevice(gpus[i], surface, requiredExtensions, &families);
+        LOGI("GPU[%u] %s type %d score %lld, queue families graphics %u compute %u transfer %u", i,
+             properties.deviceName, properties.deviceType, (long long)score, families.graphics, families.compute,
+             families.transfer);
+        if (score < 0) {
+            continue;
+        }
+
+        if (hasOverride) {
+            bool matches = overrideIsIndex ? (overrideIndex == static_cast<long>(i))
+                                           : (strstr(properties.deviceName, overrideValue) != nullptr);
+            if (matches) {
+                bestIndex = i;
+                *queueFamilies = families;
+                LOGI("GPU[%u] forced by %s=%s", i, VARTIP_DEVICE_OVERRIDE_ENV, overrideValue);
+                break;
+            }
+        } else if (score > bestScore) {
+            bestScore = score;
+            bestIndex = i;
+            *queueFamilies = families;
+        }
+    }
+
+    if (bestIndex < 0) {
+        if (hasOverride) {
+            LOGE("No usable GPU matches %s=%s", VARTIP_DEVICE_OVERRIDE_ENV, overrideValue);
+        }
+        return false;
+    }
+    *gpuDevice = gpus[bestIndex];
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef VARTIP_DEVICESELECTION_H_
+#define VARTIP_DEVICESELECTION_H_
+
+#include <vulkan_wrapper.h>
+#include <vector>
+
+// Environment variable (or debug.vartip.device property on Android) forcing the physical device, either its index in
+// vkEnumeratePhysicalDevices order or a substring of its name, ex) VARTIP_DEVICE=llvmpipe to benchmark on lavapipe
+#define VARTIP_DEVICE_OVERRIDE_ENV "VARTIP_DEVICE"
+#define VARTIP_DEVICE_OVERRIDE_PROPERTY "debug.vartip.device"
+
+// Queue families picked for a physical device. When the device has no dedicated compute or transfer family the
+// index is the same as the graphics one. A dedicated transfer family gets the camera upload, the compute family is
+// only logged and doesn't count in the device score
+struct QueueFamilySelection {
+    uint32_t graphics;  // graphics and, if there is a surface, present
+    uint32_t compute;   // async compute family without graphics
+    uint32_t transfer;  // transfer only family, usually a DMA engine
+    bool hasDedicatedCompute;
+    bool hasDedicatedTransfer;
+};
+
+/**
+ * Scores every physical device and returns the best one usable for rendering
+ * @param surface to check present support against, VK_NULL_HANDLE when rendering offscreen
+ * @param requiredExtensions device extensions the device must expose
+ * @return false if no device is usable
+ */
+bool SelectPhysicalDevice(VkInstance instance, VkSurfaceKHR surface, const std::vector<const char*>& requiredExtensions,
+                          VkPhysicalDevice* gpuDevice, QueueFamilySelection* queueFamilies);
+
+#endif  // VARTIP_DEVICESELECTION_H_
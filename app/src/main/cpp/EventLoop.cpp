@@ -0,0 +1,87 @@
+#include "EventLoop.h"
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "CpuProfiler.h"
+#include "Util.h"
+#ifndef __ANDROID__
+#include <sys/epoll.h>
+#endif
+
+#ifdef __ANDROID__
+EventLoop::EventLoop() {
+    // NativeActivity's thread already has the looper the app glue added its fds to
+    m_looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
+    ALooper_acquire(m_looper);
+}
+
+EventLoop::~EventLoop() { ALooper_release(m_looper); }
+
+bool EventLoop::AddFd(int fd, int ident) {
+    return ALooper_addFd(m_looper, fd, ident, ALOOPER_EVENT_INPUT, nullptr, nullptr) == 1;
+}
+
+void EventLoop::RemoveFd(int fd) { ALooper_removeFd(m_looper, fd); }
+
+int EventLoop::Wait(int timeoutMs, void** data) {
+    int events;
+    *data = nullptr;
+    int ident = ALooper_pollOnce(timeoutMs, nullptr, &events, data);
+    return (ident >= 0) ? ident : VARTIP_EVENT_NONE;
+}
+#else
+EventLoop::EventLoop() {
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    ASSERT(m_epollFd >= 0, "Failed to create the epoll set (errno %d)", errno);
+}
+
+EventLoop::~EventLoop() { close(m_epollFd); }
+
+bool EventLoop::AddFd(int fd, int ident) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = static_cast<uint64_t>(ident);
+    return epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+void EventLoop::RemoveFd(int fd) { epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr); }
+
+int EventLoop::Wait(int timeoutMs, void** data) {
+    epoll_event event;
+    *data = nullptr;
+    int count;
+    do {
+        count = epoll_wait(m_epollFd, &event, 1, timeoutMs);
+    } while (count < 0 && errno == EINTR);
+    return (count > 0) ? static_cast<int>(event.data.u64) : VARTIP_EVENT_NONE;
+}
+#endif
+
+FrameEvent::FrameEvent() : m_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), m_firstPostNs(0) {
+    ASSERT(m_fd >= 0, "Failed to create the frame eventfd (errno %d)", errno);
+}
+
+FrameEvent::~FrameEvent() { close(m_fd); }
+
+void FrameEvent::Post(void) {
+    // The time goes first, whoever wakes up for the write finds it set
+    int64_t none = 0;
+    m_firstPostNs.compare_exchange_strong(none, CpuProfilerNowNs());
+    uint64_t one = 1;
+    ssize_t written = write(m_fd, &one, sizeof(one));
+    (void)written;
+}
+
+uint64_t FrameEvent::Take(int64_t* postNs) {
+    uint64_t count = 0;
+    if (read(m_fd, &count, sizeof(count)) != sizeof(count)) {
+        return 0;
+    }
+    // A post landing between the read and here leaves its event pending without a time, the next take then counts
+    // from when it was taken instead
+    int64_t firstNs = m_firstPostNs.exchange(0);
+    if (postNs != nullptr) {
+        *postNs = (firstNs != 0) ? firstNs : CpuProfilerNowNs();
+    }
+    return count;
+}
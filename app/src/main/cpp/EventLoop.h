@@ -0,0 +1,67 @@
+#ifndef VARTIP_EVENTLOOP_H_
+#define VARTIP_EVENTLOOP_H_
+
+#include <stdint.h>
+#include <atomic>
+#ifdef __ANDROID__
+#include <android/looper.h>
+#endif
+
+// Returned by EventLoop::Wait when it returns without any fd readable, a timeout or a wake up
+#define VARTIP_EVENT_NONE -1
+
+// Sleeps the calling thread until one of its fds is readable. On Android it is the thread's ALooper, so the fds the
+// app glue added to it are waited on by the same call and come back with their own idents. Elsewhere it is an epoll
+// set, for running the loop on a host
+class EventLoop {
+   public:
+    EventLoop();
+
+    ~EventLoop();
+
+    // ident comes back from Wait when fd is readable, it has to be positive and above the app glue's LOOPER_ID_USER
+    bool AddFd(int fd, int ident);
+
+    void RemoveFd(int fd);
+
+    /**
+     * Waits up to timeoutMs, forever if it is -1, for one of the fds to be readable
+     * @param data the app glue's android_poll_source for its own idents, else nullptr
+     * @return ident of that fd or VARTIP_EVENT_NONE
+     */
+    int Wait(int timeoutMs, void** data);
+
+   private:
+#ifdef __ANDROID__
+    ALooper* m_looper;
+#else
+    int m_epollFd;
+#endif
+};
+
+// An eventfd counting events posted from any thread until the thread waiting on it takes them, remembering when the
+// first one not taken yet was posted so the wait to handle it can be measured
+class FrameEvent {
+   public:
+    FrameEvent();
+
+    ~FrameEvent();
+
+    int GetFd(void) { return m_fd; }
+
+    // Any thread, wakes the loop the fd was added to
+    void Post(void);
+
+    /**
+     * Takes the pending events, the fd is not readable again until the next Post
+     * @param postNs steady clock time of the oldest event taken, CpuProfilerNowNs's timeline, may be nullptr
+     * @return events taken, 0 if there were none
+     */
+    uint64_t Take(int64_t* postNs);
+
+   private:
+    int m_fd;
+    std::atomic<int64_t> m_firstPostNs;  // 0 when nothing is pending
+};
+
+#endif  // VARTIP_EVENTLOOP_H_
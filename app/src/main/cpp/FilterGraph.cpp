@@ -0,0 +1,491 @@
+#include "FilterGraph.h"
+#include <algorithm>
+#include <cassert>
+#include "Util.h"
+
+// The planner's masks are recorded as they are
+static_assert(VARTIP_GRAPH_STAGE_FRAGMENT_SHADER == VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, "Stage bits differ");
+static_assert(VARTIP_GRAPH_STAGE_COMPUTE_SHADER == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, "Stage bits differ");
+static_assert(VARTIP_GRAPH_STAGE_TRANSFER == VK_PIPELINE_STAGE_TRANSFER_BIT, "Stage bits differ");
+static_assert(VARTIP_GRAPH_ACCESS_SHADER_READ == VK_ACCESS_SHADER_READ_BIT, "Access bits differ");
+static_assert(VARTIP_GRAPH_ACCESS_SHADER_WRITE == VK_ACCESS_SHADER_WRITE_BIT, "Access bits differ");
+static_assert(VARTIP_GRAPH_ACCESS_TRANSFER_READ == VK_ACCESS_TRANSFER_READ_BIT, "Access bits differ");
+static_assert(VARTIP_GRAPH_ACCESS_TRANSFER_WRITE == VK_ACCESS_TRANSFER_WRITE_BIT, "Access bits differ");
+
+FilterGraph::FilterGraph(VkDevice device, MemoryAllocator* allocator)
+    : m_device(device), m_allocator(allocator), m_compiled(false), m_cleared(false) {
+    memset(&m_transientMemory, 0, sizeof(m_transientMemory));
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_outputBarrier = {};
+
+    VkSamplerCreateInfo samplerCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = nullptr,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .maxAnisotropy = 1,
+        .compareOp = VK_COMPARE_OP_NEVER,
+        .minLod = 0.0f,
+        .maxLod = 0.0f,
+        .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK,
+        .unnormalizedCoordinates = VK_FALSE,
+    };
+    CALL_VK(vkCreateSampler(m_device, &samplerCreateInfo, nullptr, &m_linearSampler));
+    samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+    CALL_VK(vkCreateSampler(m_device, &samplerCreateInfo, nullptr, &m_nearestSampler));
+}
+
+FilterGraph::~FilterGraph() {
+    for (uint32_t i = 0; i < m_kernels.size(); i++) {
+        delete m_kernels[i];
+    }
+    for (uint32_t i = 0; i < m_resources.size(); i++) {
+        Resource& resource = m_resources[i];
+        if (resource.imported) {
+            continue;
+        }
+        if (resource.buffer != VK_NULL_HANDLE) {
+            m_allocator->DestroyBuffer(resource.buffer, &resource.bufferMemory);
+        }
+        if (resource.view != VK_NULL_HANDLE) {
+            vkDestroyImageView(m_device, resource.view, nullptr);
+        }
+        for (uint32_t level = 0; level < resource.levelViews.size(); level++) {
+            vkDestroyImageView(m_device, resource.levelViews[level], nullptr);
+        }
+        if (resource.image != VK_NULL_HANDLE && resource.persistent) {
+            m_allocator->DestroyImage(resource.image, &resource.imageMemory);
+        } else if (resource.image != VK_NULL_HANDLE) {
+            vkDestroyImage(m_device, resource.image, nullptr);
+        }
+    }
+    if (m_transientMemory.memory != VK_NULL_HANDLE) {
+        m_allocator->Free(&m_transientMemory);
+    }
+    vkDestroySampler(m_device, m_linearSampler, nullptr);
+    vkDestroySampler(m_device, m_nearestSampler, nullptr);
+}
+
+GraphResource FilterGraph::ImportImage(const char* name, VkImage image, VkImageView view, VkFormat format,
+                                       uint32_t width, uint32_t height, VkPipelineStageFlags writeStage,
+                                       VkAccessFlags writeAccess) {
+    ASSERT(!m_compiled, "Images have to be declared before Compile");
+    Resource resource = {};
+    resource.name = name;
+    resource.imported = true;
+    resource.image = image;
+    resource.view = view;
+    resource.format = format;
+    resource.width = width;
+    resource.height = height;
+    resource.mipLevels = 1;
+    resource.importStage = writeStage;
+    resource.importAccess = writeAccess;
+    resource.firstPass = -1;
+    resource.lastPass = -1;
+    m_resources.push_back(resource);
+    return static_cast<GraphResource>(m_resources.size() - 1);
+}
+
+GraphResource FilterGraph::CreateTransientImage(const char* name, VkFormat format, uint32_t width, uint32_t height,
+                                                VkImageUsageFlags extraUsage, uint32_t mipLevels) {
+    ASSERT(!m_compiled, "Images have to be declared before Compile");
+    Resource resource = {};
+    resource.name = name;
+    resource.imported = false;
+    resource.image = VK_NULL_HANDLE;
+    resource.view = VK_NULL_HANDLE;
+    resource.format = format;
+    resource.width = width;
+    resource.height = height;
+    resource.mipLevels = mipLevels;
+    resource.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | extraUsage;
+    resource.firstPass = -1;
+    resource.lastPass = -1;
+    m_resources.push_back(resource);
+    return static_cast<GraphResource>(m_resources.size() - 1);
+}
+
+GraphResource FilterGraph::CreatePersistentImage(const char* name, VkFormat format, uint32_t width, uint32_t height,
+                                                 VkImageUsageFlags extraUsage, uint32_t mipLevels) {
+    GraphResource resource = CreateTransientImage(name, format, width, height, extraUsage, mipLevels);
+    m_resources[resource].persistent = true;
+    // Destination of the clear
+    m_resources[resource].usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    return resource;
+}
+
+GraphResource FilterGraph::CreateBuffer(const char* name, VkDeviceSize size) {
+    ASSERT(!m_compiled, "Buffers have to be declared before Compile");
+    Resource resource = {};
+    resource.name = name;
+    resource.imported = false;
+    resource.isBuffer = true;
+    resource.buffer = VK_NULL_HANDLE;
+    resource.bufferSize = size;
+    resource.firstPass = -1;
+    resource.lastPass = -1;
+    m_resources.push_back(resource);
+    return static_cast<GraphResource>(m_resources.size() - 1);
+}
+
+void FilterGraph::AddImageUsage(GraphResource resource, VkImageUsageFlags usage) {
+    ASSERT(!m_compiled, "Usage has to be added before Compile");
+    m_resources[resource].usage |= usage;
+}
+
+void FilterGraph::MarkOutput(GraphResource resource, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    m_resources[resource].output = true;
+    m_resources[resource].outputStage = dstStage;
+    m_resources[resource].outputAccess = dstAccess;
+    if (dstStage & VK_PIPELINE_STAGE_TRANSFER_BIT) {
+        m_resources[resource].usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+}
+
+void FilterGraph::AddPass(const char* name, const std::vector<GraphResource>& reads,
+                          const std::vector<GraphResource>& writes, GraphSetupFn setup, GraphRecordFn record,
+                          VkPipelineStageFlags stage) {
+    ASSERT(!m_compiled, "Passes have to be added before Compile");
+    m_passes.push_back({
+        .name = name,
+        .reads = reads,
+        .writes = writes,
+        .setup = setup,
+        .record = record,
+        .stage = stage,
+    });
+}
+
+ComputeKernel* FilterGraph::AddKernel(ComputeKernel* kernel) {
+    m_kernels.push_back(kernel);
+    return kernel;
+}
+
+void FilterGraph::CreateViews(Resource* resource) {
+    VkImageViewCreateInfo viewCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = nullptr,
+        .image = resource->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = resource->format,
+        .components =
+            {
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+            },
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, resource->mipLevels, 0, 1},
+        .flags = 0,
+    };
+    CALL_VK(vkCreateImageView(m_device, &viewCreateInfo, nullptr, &resource->view));
+
+    // Storage images can only be bound one level at a time
+    if (resource->mipLevels > 1) {
+        resource->levelViews.resize(resource->mipLevels);
+        for (uint32_t level = 0; level < resource->mipLevels; level++) {
+            viewCreateInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+            CALL_VK(vkCreateImageView(m_device, &viewCreateInfo, nullptr, &resource->levelViews[level]));
+        }
+    }
+}
+
+// Images whose lifetimes don't overlap share memory, see PlaceAliasedImages
+bool FilterGraph::AllocateTransientImages(void) {
+    std::vector<uint32_t> transients;
+    for (uint32_t i = 0; i < m_resources.size(); i++) {
+        Resource& resource = m_resources[i];
+        if (resource.imported || resource.persistent || resource.isBuffer || resource.firstPass < 0) {
+            continue;
+        }
+        VkImageCreateInfo imageCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = resource.format,
+            .extent = {resource.width, resource.height, 1},
+            .mipLevels = resource.mipLevels,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = resource.usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .flags = 0,
+        };
+        CALL_VK(vkCreateImage(m_device, &imageCreateInfo, nullptr, &resource.image));
+        vkGetImageMemoryRequirements(m_device, resource.image, &resource.requirements);
+        transients.push_back(i);
+    }
+    m_stats.transientImageCount = static_cast<uint32_t>(transients.size());
+    if (transients.empty()) {
+        return true;
+    }
+
+    std::vector<GraphMemoryRequest> requests(transients.size());
+    VkMemoryRequirements total = {.size = 0, .alignment = 1, .memoryTypeBits = ~0u};
+    for (uint32_t i = 0; i < transients.size(); i++) {
+        const Resource& resource = m_resources[transients[i]];
+        requests[i] = {
+            .size = resource.requirements.size,
+            .alignment = resource.requirements.alignment,
+            .firstPass = resource.firstPass,
+            .lastPass = resource.lastPass,
+        };
+        total.alignment = std::max(total.alignment, resource.requirements.alignment);
+        total.memoryTypeBits &= resource.requirements.memoryTypeBits;
+        m_stats.transientBytes += resource.requirements.size;
+    }
+    std::vector<uint64_t> offsets;
+    total.size = PlaceAliasedImages(requests, &offsets);
+    for (uint32_t i = 0; i < transients.size(); i++) {
+        m_resources[transients[i]].memoryOffset = offsets[i];
+    }
+    m_stats.aliasedBytes = total.size;
+
+    if (total.memoryTypeBits == 0 ||
+        !m_allocator->Allocate(total, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_ALLOCATION_KIND_OPTIMAL,
+                               &m_transientMemory)) {
+        LOGE("Failed to allocate %llu bytes for the filter graph images", (unsigned long long)total.size);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < transients.size(); i++) {
+        Resource& resource = m_resources[transients[i]];
+        CALL_VK(vkBindImageMemory(m_device, resource.image, m_transientMemory.memory,
+                                  m_transientMemory.offset + resource.memoryOffset));
+
+        CreateViews(&resource);
+    }
+    return true;
+}
+
+bool FilterGraph::AllocatePersistentImages(void) {
+    for (uint32_t i = 0; i < m_resources.size(); i++) {
+        Resource& resource = m_resources[i];
+        if (!resource.persistent || resource.firstPass < 0) {
+            continue;
+        }
+        VkImageCreateInfo imageCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = resource.format,
+            .extent = {resource.width, resource.height, 1},
+            .mipLevels = resource.mipLevels,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = resource.usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .flags = 0,
+        };
+        if (!m_allocator->CreateImage(&imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &resource.image,
+                                      &resource.imageMemory)) {
+            LOGE("Failed to allocate the filter graph image %s", resource.name.c_str());
+            return false;
+        }
+        CreateViews(&resource);
+        m_stats.persistentImageCount++;
+    }
+    return true;
+}
+
+bool FilterGraph::AllocateBuffers(void) {
+    for (uint32_t i = 0; i < m_resources.size(); i++) {
+        Resource& resource = m_resources[i];
+        if (!resource.isBuffer || resource.firstPass < 0) {
+            continue;
+        }
+        VkBufferCreateInfo bufferCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .size = resource.bufferSize,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .flags = 0,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr,
+        };
+        if (!m_allocator->CreateBuffer(&bufferCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &resource.buffer,
+                                       &resource.bufferMemory)) {
+            LOGE("Failed to allocate the filter graph buffer %s", resource.name.c_str());
+            return false;
+        }
+        m_stats.bufferCount++;
+    }
+    return true;
+}
+
+FilterGraph::BarrierBatch FilterGraph::MakeBarrierBatch(const GraphPlanBarrier& planned) {
+    BarrierBatch batch = {
+        .srcStage = planned.srcStage,
+        .dstStage = planned.dstStage,
+        .srcAccess = planned.srcAccess,
+        .dstAccess = planned.dstAccess,
+    };
+    // Transient images only, discarding the content of their previous frame or of what aliased their memory
+    for (uint32_t i = 0; i < planned.discards.size(); i++) {
+        batch.imageBarriers.push_back({
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = planned.discardSrcAccess,
+            .dstAccessMask = planned.discardDstAccess,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = m_resources[planned.discards[i]].image,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1},
+        });
+    }
+    return batch;
+}
+
+bool FilterGraph::Compile(void) {
+    ASSERT(!m_compiled, "Filter graph is already compiled");
+    std::vector<GraphPlanResource> planResources(m_resources.size());
+    for (uint32_t i = 0; i < m_resources.size(); i++) {
+        const Resource& resource = m_resources[i];
+        planResources[i] = {
+            .name = resource.name.c_str(),
+            .imported = resource.imported,
+            .persistent = resource.persistent,
+            .isBuffer = resource.isBuffer,
+            .importStage = resource.importStage,
+            .importAccess = resource.importAccess,
+            .output = resource.output,
+            .outputStage = resource.outputStage,
+            .outputAccess = resource.outputAccess,
+        };
+    }
+    std::vector<GraphPlanPass> planPasses(m_passes.size());
+    for (uint32_t p = 0; p < m_passes.size(); p++) {
+        planPasses[p] = {
+            .name = m_passes[p].name,
+            .reads = m_passes[p].reads,
+            .writes = m_passes[p].writes,
+            .stage = m_passes[p].stage,
+        };
+    }
+    FilterGraphPlan plan = PlanFilterGraph(planResources, planPasses);
+    if (!plan.acyclic) {
+        return false;
+    }
+    m_order = plan.order;
+    m_stats.passCount = static_cast<uint32_t>(m_order.size());
+    m_stats.culledPassCount = plan.culledPassCount;
+    m_stats.barrierCount = plan.barrierCount;
+    for (uint32_t i = 0; i < m_resources.size(); i++) {
+        m_resources[i].firstPass = plan.firstPass[i];
+        m_resources[i].lastPass = plan.lastPass[i];
+    }
+
+    if (!AllocateTransientImages() || !AllocatePersistentImages() || !AllocateBuffers()) {
+        return false;
+    }
+    // The discards need the images
+    m_barriers.resize(m_order.size());
+    for (uint32_t o = 0; o < m_order.size(); o++) {
+        m_barriers[o] = MakeBarrierBatch(plan.barriers[o]);
+    }
+    m_outputBarrier = MakeBarrierBatch(plan.outputBarrier);
+    m_compiled = true;
+
+    for (uint32_t o = 0; o < m_order.size(); o++) {
+        if (m_passes[m_order[o]].setup) {
+            m_passes[m_order[o]].setup(this);
+        }
+    }
+    return true;
+}
+
+void FilterGraph::RecordBarrier(VkCommandBuffer cmdBuffer, const BarrierBatch& batch) {
+    if (batch.srcStage == 0) {
+        return;
+    }
+    VkMemoryBarrier memoryBarrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = batch.srcAccess,
+        .dstAccessMask = batch.dstAccess,
+    };
+    bool needsMemoryBarrier = (batch.srcAccess != 0 || batch.dstAccess != 0);
+    vkCmdPipelineBarrier(cmdBuffer, batch.srcStage, batch.dstStage, 0, needsMemoryBarrier ? 1 : 0, &memoryBarrier,
+                         0, nullptr, static_cast<uint32_t>(batch.imageBarriers.size()), batch.imageBarriers.data());
+}
+
+// Zeros in everything that carries over between frames. The planned barriers already wait for transfer writes from
+// the previous frame, which covers the clears too
+void FilterGraph::RecordClears(VkCommandBuffer cmdBuffer) {
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    for (uint32_t i = 0; i < m_resources.size(); i++) {
+        if (m_resources[i].persistent && m_resources[i].image != VK_NULL_HANDLE) {
+            imageBarriers.push_back({
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = 0,
+                .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = m_resources[i].image,
+                .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1},
+            });
+        }
+    }
+    if (!imageBarriers.empty()) {
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                             nullptr, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+    }
+
+    VkClearColorValue zeros = {};
+    VkImageSubresourceRange allLevels = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+    for (uint32_t i = 0; i < m_resources.size(); i++) {
+        const Resource& resource = m_resources[i];
+        if (resource.persistent && resource.image != VK_NULL_HANDLE) {
+            vkCmdClearColorImage(cmdBuffer, resource.image, VK_IMAGE_LAYOUT_GENERAL, &zeros, 1, &allLevels);
+        } else if (resource.isBuffer && resource.buffer != VK_NULL_HANDLE) {
+            vkCmdFillBuffer(cmdBuffer, resource.buffer, 0, VK_WHOLE_SIZE, 0);
+        }
+    }
+}
+
+void FilterGraph::Execute(VkCommandBuffer cmdBuffer, GpuProfiler* profiler, uint32_t slot) {
+    ASSERT(m_compiled, "Filter graph has to be compiled before it is executed");
+    if (!m_cleared) {
+        RecordClears(cmdBuffer);
+        m_cleared = true;
+    }
+    for (uint32_t o = 0; o < m_order.size(); o++) {
+        const Pass& pass = m_passes[m_order[o]];
+        RecordBarrier(cmdBuffer, m_barriers[o]);
+        uint32_t scope = profiler->BeginScope(cmdBuffer, slot, pass.name);
+        pass.record(cmdBuffer);
+        profiler->EndScope(cmdBuffer, slot, scope);
+    }
+    RecordBarrier(cmdBuffer, m_outputBarrier);
+}
+
+void FilterGraph::LogStats(void) {
+    LOGI("Filter graph: %u passes (%u culled), %u transient images %llu KB aliased into %llu KB, %u persistent "
+         "images, %u buffers, %u barriers",
+         m_stats.passCount, m_stats.culledPassCount, m_stats.transientImageCount,
+         (unsigned long long)(m_stats.transientBytes / 1024), (unsigned long long)(m_stats.aliasedBytes / 1024),
+         m_stats.persistentImageCount, m_stats.bufferCount, m_stats.barrierCount);
+    for (uint32_t o = 0; o < m_order.size(); o++) {
+        LOGI("  %u: %s", o, m_passes[m_order[o]].name);
+    }
+}
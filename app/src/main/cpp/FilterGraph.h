@@ -0,0 +1,193 @@
+#ifndef VARTIP_FILTERGRAPH_H_
+#define VARTIP_FILTERGRAPH_H_
+
+#include <vulkan_wrapper.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "ComputeKernel.h"
+#include "FilterGraphPlanner.h"
+#include "GpuProfiler.h"
+#include "MemoryAllocator.h"
+
+// Called once after Compile when every image has its view, usually to write the pass's descriptor sets
+typedef std::function<void(class FilterGraph* graph)> GraphSetupFn;
+// Records the pass into the frame's command buffer, barriers are already taken care of
+typedef std::function<void(VkCommandBuffer cmdBuffer)> GraphRecordFn;
+
+struct FilterGraphStats {
+    uint32_t passCount;
+    uint32_t culledPassCount;  // passes nothing marked as output depends on
+    uint32_t transientImageCount;
+    uint32_t persistentImageCount;
+    uint32_t bufferCount;
+    VkDeviceSize transientBytes;  // what the transient images would take without aliasing
+    VkDeviceSize aliasedBytes;    // what they actually take
+    uint32_t barrierCount;        // vkCmdPipelineBarrier calls per Execute
+};
+
+// Small frame graph for the compute filters. Passes declare the images they read and write, Compile orders them by
+// their dependencies, drops the ones no output depends on, places the transient images in one allocation where images
+// whose lifetimes don't overlap share memory, and plans the barriers. Execute then records the passes with a single
+// batched barrier in front of each pass that needs one. Buffers and persistent images are tracked the same way but are
+// never aliased, their content carries over from one frame to the next and starts out as zeros.
+// Every image the graph touches stays in VK_IMAGE_LAYOUT_GENERAL, the only layout transitions are the first write of a
+// transient image each frame which discards whatever the memory held before, and the clear of the persistent images
+// by the first Execute. The ordering, culling, aliasing and barriers are planned by FilterGraphPlanner, this class only
+// turns the plan into Vulkan objects and commands.
+class FilterGraph {
+   public:
+    explicit FilterGraph(VkDevice device, MemoryAllocator* allocator);
+
+    ~FilterGraph();
+
+    /**
+     * Image produced outside of the graph, it has to be in the general layout
+     * @param writeStage stage and access of its last write, the graph makes it visible before the first pass reading it
+     */
+    GraphResource ImportImage(const char* name, VkImage image, VkImageView view, VkFormat format, uint32_t width,
+                              uint32_t height, VkPipelineStageFlags writeStage, VkAccessFlags writeAccess);
+
+    /**
+     * Image only living within a frame, its content is undefined until a pass writes it
+     * @param mipLevels levels of a mip chain, each one also gets its own view, see GetLevelView
+     */
+    GraphResource CreateTransientImage(const char* name, VkFormat format, uint32_t width, uint32_t height,
+                                       VkImageUsageFlags extraUsage = 0, uint32_t mipLevels = 1);
+
+    /**
+     * Image with its own memory whose content carries over from one frame to the next, ex) the previous frame for
+     * temporal filters. It is cleared to zeros by the first Execute. Passes writing it are never culled since the next
+     * frame may read what they wrote
+     */
+    GraphResource CreatePersistentImage(const char* name, VkFormat format, uint32_t width, uint32_t height,
+                                        VkImageUsageFlags extraUsage = 0, uint32_t mipLevels = 1);
+
+    // More usage for a transient image, ex) a pass blitting from it. Imported images need it from their creator
+    void AddImageUsage(GraphResource resource, VkImageUsageFlags usage);
+
+    // Device local storage buffer owned by the graph, it can also be a transfer source and destination. Like persistent
+    // images, its content carries over between frames and is cleared to zeros by the first Execute
+    GraphResource CreateBuffer(const char* name, VkDeviceSize size);
+
+    // Resource read after the graph, ex) by the display, it is made visible to dstStage at the end of Execute. A
+    // transfer dstStage also makes a transient image usable as a copy source
+    void MarkOutput(GraphResource resource, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+    /**
+     * @param name also the GPU profiler scope, which only keeps the pointer so it has to be a string literal to
+     *             outlive the graph when it is rebuilt
+     * @param stage VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT for dispatches or VK_PIPELINE_STAGE_TRANSFER_BIT for
+     *              copies and blits, decides the stages and accesses of the barriers around the pass
+     */
+    void AddPass(const char* name, const std::vector<GraphResource>& reads, const std::vector<GraphResource>& writes,
+                 GraphSetupFn setup, GraphRecordFn record,
+                 VkPipelineStageFlags stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    // The graph owns the kernel from now on and deletes it with itself
+    ComputeKernel* AddKernel(ComputeKernel* kernel);
+
+    // @return false if the passes have a cyclic dependency or the transient images could not be allocated
+    bool Compile(void);
+
+    // Records every pass, each one in its own GPU profiler scope
+    void Execute(VkCommandBuffer cmdBuffer, GpuProfiler* profiler, uint32_t slot);
+
+    VkImage GetImage(GraphResource resource) { return m_resources[resource].image; }
+    VkImageView GetImageView(GraphResource resource) { return m_resources[resource].view; }
+    // View of a single mip level, level 0 of an image without mips is the image view
+    VkImageView GetLevelView(GraphResource resource, uint32_t level) {
+        const Resource& image = m_resources[resource];
+        return image.mipLevels > 1 ? image.levelViews[level] : image.view;
+    }
+    uint32_t GetMipLevels(GraphResource resource) { return m_resources[resource].mipLevels; }
+    VkFormat GetFormat(GraphResource resource) { return m_resources[resource].format; }
+    VkExtent2D GetExtent(GraphResource resource) {
+        return {m_resources[resource].width, m_resources[resource].height};
+    }
+    VkBuffer GetBuffer(GraphResource resource) { return m_resources[resource].buffer; }
+    VkDeviceSize GetBufferSize(GraphResource resource) { return m_resources[resource].bufferSize; }
+
+    // Clamp to edge samplers for the passes to read images with
+    VkSampler GetSampler(VkFilter filter) { return filter == VK_FILTER_LINEAR ? m_linearSampler : m_nearestSampler; }
+
+    FilterGraphStats GetStats(void) { return m_stats; }
+    void LogStats(void);
+
+   private:
+    struct Resource {
+        std::string name;
+        bool imported;
+        bool persistent;
+        VkImage image;
+        VkImageView view;
+        VkFormat format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipLevels;
+        std::vector<VkImageView> levelViews;  // only with more than one level
+        VkImageUsageFlags usage;
+        VkPipelineStageFlags importStage;
+        VkAccessFlags importAccess;
+        bool output;
+        VkPipelineStageFlags outputStage;
+        VkAccessFlags outputAccess;
+        // lifetime in compiled pass order, placement inside the transient memory
+        int32_t firstPass;
+        int32_t lastPass;
+        VkMemoryRequirements requirements;
+        VkDeviceSize memoryOffset;
+        MemoryAllocation imageMemory;  // persistent images only
+        // buffers only
+        bool isBuffer;
+        VkBuffer buffer;
+        VkDeviceSize bufferSize;
+        MemoryAllocation bufferMemory;
+    };
+
+    struct Pass {
+        const char* name;
+        std::vector<GraphResource> reads;
+        std::vector<GraphResource> writes;
+        GraphSetupFn setup;
+        GraphRecordFn record;
+        VkPipelineStageFlags stage;
+    };
+
+    // Everything one vkCmdPipelineBarrier needs, a global memory barrier plus the layout transitions
+    struct BarrierBatch {
+        VkPipelineStageFlags srcStage;
+        VkPipelineStageFlags dstStage;
+        VkAccessFlags srcAccess;
+        VkAccessFlags dstAccess;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+    };
+
+    void CreateViews(Resource* resource);
+    bool AllocateTransientImages(void);
+    bool AllocatePersistentImages(void);
+    bool AllocateBuffers(void);
+    BarrierBatch MakeBarrierBatch(const GraphPlanBarrier& planned);
+    void RecordBarrier(VkCommandBuffer cmdBuffer, const BarrierBatch& batch);
+    void RecordClears(VkCommandBuffer cmdBuffer);
+
+    VkDevice m_device;
+    MemoryAllocator* m_allocator;
+    VkSampler m_linearSampler;
+    VkSampler m_nearestSampler;
+
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<ComputeKernel*> m_kernels;
+
+    // Compiled state
+    bool m_compiled;
+    std::vector<uint32_t> m_order;
+    std::vector<BarrierBatch> m_barriers;  // one in front of each pass in m_order
+    BarrierBatch m_outputBarrier;
+    bool m_cleared;  // the persistent images and buffers were cleared by an earlier Execute
+    MemoryAllocation m_transientMemory;
+    FilterGraphStats m_stats;
+};
+
+#endif  // VARTIP_FILTERGRAPH_H_
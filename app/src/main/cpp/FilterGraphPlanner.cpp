@@ -0,0 +1,284 @@
+#include "FilterGraphPlanner.h"
+#include <algorithm>
+#include "Util.h"
+
+// Whoever used an image in the previous frame (or the previous owner of aliased memory) may still be running when a
+// transient image is first written
+static const uint32_t kPreviousUseStages =
+    VARTIP_GRAPH_STAGE_COMPUTE_SHADER | VARTIP_GRAPH_STAGE_TRANSFER | VARTIP_GRAPH_STAGE_FRAGMENT_SHADER;
+static const uint32_t kPreviousUseWrites = VARTIP_GRAPH_ACCESS_SHADER_WRITE | VARTIP_GRAPH_ACCESS_TRANSFER_WRITE;
+
+static uint32_t ReadAccess(uint32_t stage) {
+    return stage == VARTIP_GRAPH_STAGE_TRANSFER ? VARTIP_GRAPH_ACCESS_TRANSFER_READ : VARTIP_GRAPH_ACCESS_SHADER_READ;
+}
+
+static uint32_t WriteAccess(uint32_t stage) {
+    return stage == VARTIP_GRAPH_STAGE_TRANSFER ? VARTIP_GRAPH_ACCESS_TRANSFER_WRITE
+                                                : VARTIP_GRAPH_ACCESS_SHADER_WRITE;
+}
+
+// A pass depends on every other pass writing what it reads, passes writing the same resource keep the order they
+// were added in, and so does a pass writing what an earlier added pass reads. For buffers and persistent images only
+// the writers added before a reader count, a writer added after it updates the content for the next frame, ex) the
+// previous frame of a temporal filter. Ready passes are taken in the order they were added so the result is stable
+static bool SortPasses(const std::vector<GraphPlanResource>& resources, const std::vector<GraphPlanPass>& passes,
+                       std::vector<uint32_t>* order) {
+    uint32_t passCount = static_cast<uint32_t>(passes.size());
+    std::vector<std::vector<uint32_t>> writers(resources.size());
+    std::vector<std::vector<uint32_t>> readers(resources.size());
+    for (uint32_t p = 0; p < passCount; p++) {
+        for (uint32_t i = 0; i < passes[p].writes.size(); i++) {
+            writers[passes[p].writes[i]].push_back(p);
+        }
+        for (uint32_t i = 0; i < passes[p].reads.size(); i++) {
+            readers[passes[p].reads[i]].push_back(p);
+        }
+    }
+
+    std::vector<bool> dependsOn(passCount * passCount, false);
+    for (uint32_t p = 0; p < passCount; p++) {
+        for (uint32_t i = 0; i < passes[p].reads.size(); i++) {
+            const GraphPlanResource& resource = resources[passes[p].reads[i]];
+            bool carriesOver = resource.isBuffer || resource.persistent;
+            const std::vector<uint32_t>& resourceWriters = writers[passes[p].reads[i]];
+            for (uint32_t j = 0; j < resourceWriters.size() && (!carriesOver || resourceWriters[j] < p); j++) {
+                if (resourceWriters[j] != p) dependsOn[p * passCount + resourceWriters[j]] = true;
+            }
+        }
+        for (uint32_t i = 0; i < passes[p].writes.size(); i++) {
+            const std::vector<uint32_t>& resourceWriters = writers[passes[p].writes[i]];
+            for (uint32_t j = 0; j < resourceWriters.size() && resourceWriters[j] < p; j++) {
+                dependsOn[p * passCount + resourceWriters[j]] = true;
+            }
+            const std::vector<uint32_t>& resourceReaders = readers[passes[p].writes[i]];
+            for (uint32_t j = 0; j < resourceReaders.size() && resourceReaders[j] < p; j++) {
+                dependsOn[p * passCount + resourceReaders[j]] = true;
+            }
+        }
+    }
+
+    std::vector<uint32_t> pendingCount(passCount, 0);
+    for (uint32_t p = 0; p < passCount; p++) {
+        for (uint32_t q = 0; q < passCount; q++) {
+            if (dependsOn[p * passCount + q]) pendingCount[p]++;
+        }
+    }
+
+    std::vector<bool> scheduled(passCount, false);
+    order->clear();
+    while (order->size() < passCount) {
+        uint32_t next = passCount;
+        for (uint32_t p = 0; p < passCount && next == passCount; p++) {
+            if (!scheduled[p] && pendingCount[p] == 0) next = p;
+        }
+        if (next == passCount) {
+            LOGE("Filter graph has a dependency cycle");
+            return false;
+        }
+        scheduled[next] = true;
+        order->push_back(next);
+        for (uint32_t p = 0; p < passCount; p++) {
+            if (dependsOn[p * passCount + next]) pendingCount[p]--;
+        }
+    }
+    return true;
+}
+
+// Keeps only the passes an output depends on, walking backwards from the outputs. Passes writing buffers and
+// persistent images are kept too, the next frame may read what they wrote
+static void CullPasses(const std::vector<GraphPlanResource>& resources, const std::vector<GraphPlanPass>& passes,
+                       const std::vector<uint32_t>& sorted, std::vector<uint32_t>* order) {
+    std::vector<bool> needed(resources.size(), false);
+    for (uint32_t i = 0; i < resources.size(); i++) {
+        needed[i] = resources[i].output || resources[i].persistent;
+    }
+    std::vector<bool> keep(passes.size(), false);
+    for (int32_t o = static_cast<int32_t>(sorted.size()) - 1; o >= 0; o--) {
+        const GraphPlanPass& pass = passes[sorted[o]];
+        for (uint32_t i = 0; i < pass.writes.size() && !keep[sorted[o]]; i++) {
+            keep[sorted[o]] = needed[pass.writes[i]];
+        }
+        if (keep[sorted[o]]) {
+            for (uint32_t i = 0; i < pass.reads.size(); i++) {
+                needed[pass.reads[i]] = true;
+            }
+        }
+    }
+    order->clear();
+    for (uint32_t o = 0; o < sorted.size(); o++) {
+        if (keep[sorted[o]]) order->push_back(sorted[o]);
+    }
+}
+
+// Walks the compiled order keeping, per resource, its last write and which stages already see it. Reads of a write
+// not visible yet and writes after reads or writes (the previous frame counts) add to the pass's batch. Buffers and
+// persistent images start out as if the previous frame, or the clear of the first one, had both written and read
+// them
+static void PlanBarriers(const std::vector<GraphPlanResource>& resources, const std::vector<GraphPlanPass>& passes,
+                         FilterGraphPlan* plan) {
+    struct AccessState {
+        bool initialized;
+        uint32_t writeStage;
+        uint32_t writeAccess;
+        uint32_t readStages;
+        uint32_t visibleStages;
+    };
+    std::vector<AccessState> states(resources.size());
+    for (uint32_t i = 0; i < resources.size(); i++) {
+        if (resources[i].isBuffer || resources[i].persistent) {
+            states[i] = {
+                .initialized = true,
+                .writeStage = kPreviousUseStages,
+                .writeAccess = kPreviousUseWrites,
+                .readStages = kPreviousUseStages,
+                .visibleStages = 0,
+            };
+            continue;
+        }
+        states[i] = {
+            .initialized = resources[i].imported,
+            .writeStage = resources[i].importStage,
+            .writeAccess = resources[i].importAccess,
+            .readStages = 0,
+            .visibleStages = 0,
+        };
+    }
+
+    plan->barriers.assign(plan->order.size(), GraphPlanBarrier());
+    for (uint32_t o = 0; o < plan->order.size(); o++) {
+        const GraphPlanPass& pass = passes[plan->order[o]];
+        GraphPlanBarrier& batch = plan->barriers[o];
+
+        for (uint32_t i = 0; i < pass.reads.size(); i++) {
+            AccessState& state = states[pass.reads[i]];
+            if (!state.initialized) {
+                LOGW("Pass %s reads %s before anything writes it", pass.name, resources[pass.reads[i]].name);
+            }
+            if (state.writeStage != 0 && !(state.visibleStages & pass.stage)) {
+                batch.srcStage |= state.writeStage;
+                batch.srcAccess |= state.writeAccess;
+                batch.dstStage |= pass.stage;
+                batch.dstAccess |= ReadAccess(pass.stage);
+                state.visibleStages |= pass.stage;
+            }
+            state.readStages |= pass.stage;
+        }
+
+        for (uint32_t i = 0; i < pass.writes.size(); i++) {
+            AccessState& state = states[pass.writes[i]];
+            if (!state.initialized) {
+                // The first write of a transient image discards whatever the memory held
+                batch.discards.push_back(pass.writes[i]);
+                batch.discardSrcAccess = kPreviousUseWrites;
+                batch.discardDstAccess = WriteAccess(pass.stage);
+                batch.srcStage |= kPreviousUseStages;
+                batch.dstStage |= pass.stage;
+                state.initialized = true;
+            } else if (state.writeStage != 0 || state.readStages != 0) {
+                // Write after write needs the memory dependency, write after read only the execution one
+                batch.srcStage |= state.writeStage | state.readStages;
+                batch.srcAccess |= state.writeAccess;
+                batch.dstStage |= pass.stage;
+                batch.dstAccess |= WriteAccess(pass.stage);
+            }
+            state.writeStage = pass.stage;
+            state.writeAccess = WriteAccess(pass.stage);
+            state.readStages = 0;
+            state.visibleStages = 0;
+        }
+
+        if (batch.srcStage != 0) {
+            plan->barrierCount++;
+        }
+    }
+
+    plan->outputBarrier = GraphPlanBarrier();
+    for (uint32_t i = 0; i < resources.size(); i++) {
+        if (resources[i].output && states[i].writeStage != 0) {
+            plan->outputBarrier.srcStage |= states[i].writeStage;
+            plan->outputBarrier.srcAccess |= states[i].writeAccess;
+            plan->outputBarrier.dstStage |= resources[i].outputStage;
+            plan->outputBarrier.dstAccess |= resources[i].outputAccess;
+        }
+    }
+    if (plan->outputBarrier.srcStage != 0) {
+        plan->barrierCount++;
+    }
+}
+
+FilterGraphPlan PlanFilterGraph(const std::vector<GraphPlanResource>& resources,
+                                const std::vector<GraphPlanPass>& passes) {
+    FilterGraphPlan plan = {};
+    std::vector<uint32_t> sorted;
+    plan.acyclic = SortPasses(resources, passes, &sorted);
+    if (!plan.acyclic) {
+        return plan;
+    }
+    CullPasses(resources, passes, sorted, &plan.order);
+    plan.culledPassCount = static_cast<uint32_t>(passes.size() - plan.order.size());
+
+    // Lifetimes, outputs stay alive until the end of the graph
+    plan.firstPass.assign(resources.size(), -1);
+    plan.lastPass.assign(resources.size(), -1);
+    for (uint32_t o = 0; o < plan.order.size(); o++) {
+        const GraphPlanPass& pass = passes[plan.order[o]];
+        for (uint32_t k = 0; k < 2; k++) {
+            const std::vector<GraphResource>& used = (k == 0) ? pass.reads : pass.writes;
+            for (uint32_t i = 0; i < used.size(); i++) {
+                if (plan.firstPass[used[i]] < 0) plan.firstPass[used[i]] = o;
+                plan.lastPass[used[i]] = o;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < resources.size(); i++) {
+        if (resources[i].output && plan.firstPass[i] >= 0) {
+            plan.lastPass[i] = static_cast<int32_t>(plan.order.size());
+        }
+    }
+
+    PlanBarriers(resources, passes, &plan);
+    return plan;
+}
+
+uint64_t PlaceAliasedImages(const std::vector<GraphMemoryRequest>& images, std::vector<uint64_t>* offsets) {
+    std::vector<uint32_t> placement(images.size());
+    for (uint32_t i = 0; i < images.size(); i++) {
+        placement[i] = i;
+    }
+    // Stable so images of the same size are placed in the order they were declared
+    std::stable_sort(placement.begin(), placement.end(),
+                     [&images](uint32_t a, uint32_t b) { return images[a].size > images[b].size; });
+
+    uint64_t total = 0;
+    offsets->assign(images.size(), 0);
+    for (uint32_t i = 0; i < placement.size(); i++) {
+        const GraphMemoryRequest& image = images[placement[i]];
+
+        // Candidates are the start of the memory and the end of every placed image, lowest fitting one wins
+        uint64_t bestOffset = ~0ull;
+        for (uint32_t c = 0; c <= i; c++) {
+            uint64_t candidate = 0;
+            if (c < i) {
+                candidate = (*offsets)[placement[c]] + images[placement[c]].size;
+            }
+            candidate = (candidate + image.alignment - 1) / image.alignment * image.alignment;
+            if (candidate >= bestOffset) {
+                continue;
+            }
+
+            bool fits = true;
+            for (uint32_t j = 0; j < i && fits; j++) {
+                const GraphMemoryRequest& placed = images[placement[j]];
+                uint64_t placedOffset = (*offsets)[placement[j]];
+                bool aliveTogether = placed.firstPass <= image.lastPass && image.firstPass <= placed.lastPass;
+                bool overlaps = candidate < placedOffset + placed.size && placedOffset < candidate + image.size;
+                fits = !(aliveTogether && overlaps);
+            }
+            if (fits) bestOffset = candidate;
+        }
+
+        (*offsets)[placement[i]] = bestOffset;
+        total = std::max(total, bestOffset + image.size);
+    }
+    return total;
+}
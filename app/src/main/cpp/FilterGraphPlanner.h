@@ -0,0 +1,86 @@
+#ifndef VARTIP_FILTERGRAPHPLANNER_H_
+#define VARTIP_FILTERGRAPHPLANNER_H_
+
+#include <stdint.h>
+#include <vector>
+
+// Handle of an image or buffer declared to the graph
+typedef uint32_t GraphResource;
+#define VARTIP_GRAPH_NO_RESOURCE 0xFFFFFFFFu
+
+// The pipeline stage and access bits the planner uses, same values as the Vulkan ones so FilterGraph records the
+// planned masks as they are
+#define VARTIP_GRAPH_STAGE_FRAGMENT_SHADER 0x00000080u  // VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+#define VARTIP_GRAPH_STAGE_COMPUTE_SHADER 0x00000800u   // VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+#define VARTIP_GRAPH_STAGE_TRANSFER 0x00001000u         // VK_PIPELINE_STAGE_TRANSFER_BIT
+#define VARTIP_GRAPH_ACCESS_SHADER_READ 0x00000020u     // VK_ACCESS_SHADER_READ_BIT
+#define VARTIP_GRAPH_ACCESS_SHADER_WRITE 0x00000040u    // VK_ACCESS_SHADER_WRITE_BIT
+#define VARTIP_GRAPH_ACCESS_TRANSFER_READ 0x00000800u   // VK_ACCESS_TRANSFER_READ_BIT
+#define VARTIP_GRAPH_ACCESS_TRANSFER_WRITE 0x00001000u  // VK_ACCESS_TRANSFER_WRITE_BIT
+
+// What the planner needs to know of a resource, transient images are the ones neither imported, persistent nor buffers
+struct GraphPlanResource {
+    const char* name;
+    bool imported;
+    bool persistent;
+    bool isBuffer;
+    uint32_t importStage;  // stage and access of the last write of an imported image
+    uint32_t importAccess;
+    bool output;
+    uint32_t outputStage;  // what reads an output after the graph
+    uint32_t outputAccess;
+};
+
+struct GraphPlanPass {
+    const char* name;
+    std::vector<GraphResource> reads;
+    std::vector<GraphResource> writes;
+    uint32_t stage;  // VARTIP_GRAPH_STAGE_COMPUTE_SHADER or VARTIP_GRAPH_STAGE_TRANSFER
+};
+
+// One vkCmdPipelineBarrier, a global memory barrier plus the transient images moving out of the undefined layout
+struct GraphPlanBarrier {
+    uint32_t srcStage;  // 0 when there is nothing to wait for
+    uint32_t dstStage;
+    uint32_t srcAccess;
+    uint32_t dstAccess;
+    std::vector<GraphResource> discards;
+    uint32_t discardSrcAccess;  // access masks of the discards' image barriers
+    uint32_t discardDstAccess;
+};
+
+struct FilterGraphPlan {
+    bool acyclic;                    // false when the passes have a dependency cycle, nothing else is planned then
+    std::vector<uint32_t> order;     // passes kept, in the order they run
+    uint32_t culledPassCount;        // passes nothing marked as output depends on
+    std::vector<int32_t> firstPass;  // per resource, position in order of its first use, -1 if it is never used
+    std::vector<int32_t> lastPass;   // of its last use, order.size() for outputs which outlive the graph
+    std::vector<GraphPlanBarrier> barriers;  // one in front of each pass in order
+    GraphPlanBarrier outputBarrier;
+    uint32_t barrierCount;  // batches with something to wait for, outputBarrier included
+};
+
+/**
+ * Orders the passes by their dependencies, drops the ones no output depends on, and plans the barriers between the
+ * ones left. Only reads the declarations, so a graph can be checked on a host without a device. See FilterGraph for
+ * the rules
+ */
+FilterGraphPlan PlanFilterGraph(const std::vector<GraphPlanResource>& resources,
+                                const std::vector<GraphPlanPass>& passes);
+
+struct GraphMemoryRequest {
+    uint64_t size;
+    uint64_t alignment;
+    int32_t firstPass;  // lifetime from FilterGraphPlan
+    int32_t lastPass;
+};
+
+/**
+ * Places images in one allocation, images whose lifetimes don't overlap may share memory. Largest images are placed
+ * first, each at the lowest offset where it doesn't overlap an already placed image alive at the same time
+ * @param offsets where each image goes, in the order of images
+ * @return size of the allocation
+ */
+uint64_t PlaceAliasedImages(const std::vector<GraphMemoryRequest>& images, std::vector<uint64_t>* offsets);
+
+#endif  // VARTIP_FILTERGRAPHPLANNER_H_
@@ -0,0 +1,402 @@
+#include "FilterReference.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+void ComputeGaussianWeights(float sigma, uint32_t radius, float* weights) {
+    float sum = 0.0f;
+    for (uint32_t i = 0; i <= radius; i++) {
+        weights[i] = expf(-0.5f * (i * i) / (sigma * sigma));
+        sum += (i == 0) ? weights[i] : 2.0f * weights[i];
+    }
+    for (uint32_t i = 0; i <= radius; i++) {
+        weights[i] /= sum;
+    }
+}
+
+void LumaReference(const uint32_t* pixels, int32_t stride, int32_t width, int32_t height, float* luma) {
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            // Bytes in memory order are what the R8G8B8A8 texture sees as r, g and b
+            const uint8_t* rgba = reinterpret_cast<const uint8_t*>(&pixels[y * stride + x]);
+            luma[y * width + x] = (rgba[0] * 0.299f + rgba[1] * 0.587f + rgba[2] * 0.114f) / 255.0f;
+        }
+    }
+}
+
+void DownsampleReference(const float* src, int32_t width, int32_t height, float* dst) {
+    int32_t dstWidth = width / 2;
+    int32_t dstHeight = height / 2;
+    for (int32_t y = 0; y < dstHeight; y++) {
+        for (int32_t x = 0; x < dstWidth; x++) {
+            const float* block = src + (y * 2) * width + x * 2;
+            dst[y * dstWidth + x] = (block[0] + block[1] + block[width] + block[width + 1]) * 0.25f;
+        }
+    }
+}
+
+void LumaHistogramReference(const uint32_t* pixels, int32_t stride, int32_t width, int32_t height, uint32_t* bins) {
+    memset(bins, 0, 256 * sizeof(uint32_t));
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const uint8_t* rgba = reinterpret_cast<const uint8_t*>(&pixels[y * stride + x]);
+            float luma = (rgba[0] * 0.299f + rgba[1] * 0.587f + rgba[2] * 0.114f) / 255.0f;
+            float bin = luma * 255.0f + 0.5f;
+            bins[static_cast<uint32_t>(bin < 0.0f ? 0.0f : (bin > 255.0f ? 255.0f : bin))]++;
+        }
+    }
+}
+
+static inline int32_t Clamp(int32_t value, int32_t low, int32_t high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+void GaussianBlurReference(const float* src, float* dst, int32_t width, int32_t height, float sigma,
+                           uint32_t radius) {
+    std::vector<float> weights(radius + 1);
+    ComputeGaussianWeights(sigma, radius, weights.data());
+    std::vector<float> horizontal(width * height);
+    int32_t r = static_cast<int32_t>(radius);
+
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            float sum = src[y * width + x] * weights[0];
+            for (int32_t i = 1; i <= r; i++) {
+                sum += (src[y * width + Clamp(x - i, 0, width - 1)] + src[y * width + Clamp(x + i, 0, width - 1)]) *
+                       weights[i];
+            }
+            horizontal[y * width + x] = sum;
+        }
+    }
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            float sum = horizontal[y * width + x] * weights[0];
+            for (int32_t i = 1; i <= r; i++) {
+                sum += (horizontal[Clamp(y - i, 0, height - 1) * width + x] +
+                        horizontal[Clamp(y + i, 0, height - 1) * width + x]) *
+                       weights[i];
+            }
+            dst[y * width + x] = sum;
+        }
+    }
+}
+
+void SobelReference(const float* luma, int32_t width, int32_t height, float* magnitude, uint8_t* sector) {
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            float p[3][3];
+            for (int32_t j = 0; j < 3; j++) {
+                for (int32_t i = 0; i < 3; i++) {
+                    p[j][i] = luma[Clamp(y + j - 1, 0, height - 1) * width + Clamp(x + i - 1, 0, width - 1)];
+                }
+            }
+            float gx = (p[0][2] + 2.0f * p[1][2] + p[2][2]) - (p[0][0] + 2.0f * p[1][0] + p[2][0]);
+            float gy = (p[2][0] + 2.0f * p[2][1] + p[2][2]) - (p[0][0] + 2.0f * p[0][1] + p[0][2]);
+            magnitude[y * width + x] = sqrtf(gx * gx + gy * gy);
+
+            // tan(22.5 degrees), same comparisons as shaders/sobel.comp so both round the same way
+            float ax = fabsf(gx);
+            float ay = fabsf(gy);
+            if (ay <= ax * 0.41421356f) {
+                sector[y * width + x] = 0;
+            } else if (ax <= ay * 0.41421356f) {
+                sector[y * width + x] = 2;
+            } else {
+                sector[y * width + x] = (gx * gy > 0.0f) ? 1 : 3;
+            }
+        }
+    }
+}
+
+void CannyReference(const float* luma, int32_t width, int32_t height, float low, float high, uint8_t* edges) {
+    static const int32_t kOffsets[4][2] = {{1, 0}, {1, 1}, {0, 1}, {1, -1}};
+    std::vector<float> magnitude(width * height);
+    std::vector<uint8_t> sector(width * height);
+    SobelReference(luma, width, height, magnitude.data(), sector.data());
+
+    // 0 suppressed, 1 weak, 2 strong
+    std::vector<uint8_t> state(width * height);
+    std::vector<int32_t> stack;
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const int32_t* offset = kOffsets[sector[y * width + x]];
+            float m = magnitude[y * width + x];
+            float forward =
+                magnitude[Clamp(y + offset[1], 0, height - 1) * width + Clamp(x + offset[0], 0, width - 1)];
+            float backward =
+                magnitude[Clamp(y - offset[1], 0, height - 1) * width + Clamp(x - offset[0], 0, width - 1)];
+            uint8_t value = 0;
+            if (m > forward && m >= backward) {
+                value = (m >= high) ? 2 : (m >= low ? 1 : 0);
+            }
+            state[y * width + x] = value;
+            if (value == 2) stack.push_back(y * width + x);
+        }
+    }
+
+    // Grow the strong pixels into the 8-connected weak ones
+    while (!stack.empty()) {
+        int32_t index = stack.back();
+        stack.pop_back();
+        int32_t x = index % width;
+        int32_t y = index / width;
+        for (int32_t j = -1; j <= 1; j++) {
+            for (int32_t i = -1; i <= 1; i++) {
+                if (x + i < 0 || x + i >= width || y + j < 0 || y + j >= height) continue;
+                int32_t neighbour = (y + j) * width + x + i;
+                if (state[neighbour] == 1) {
+                    state[neighbour] = 2;
+                    stack.push_back(neighbour);
+                }
+            }
+        }
+    }
+    for (int32_t i = 0; i < width * height; i++) {
+        edges[i] = (state[i] == 2) ? 1 : 0;
+    }
+}
+
+// Bilinear sample clamped to the edge, pixel centers on integer coordinates
+static float SampleLinear(const float* image, int32_t width, int32_t height, float x, float y) {
+    float baseX = floorf(x);
+    float baseY = floorf(y);
+    float fx = x - baseX;
+    float fy = y - baseY;
+    int32_t x0 = Clamp(static_cast<int32_t>(baseX), 0, width - 1);
+    int32_t x1 = Clamp(static_cast<int32_t>(baseX) + 1, 0, width - 1);
+    int32_t y0 = Clamp(static_cast<int32_t>(baseY), 0, height - 1);
+    int32_t y1 = Clamp(static_cast<int32_t>(baseY) + 1, 0, height - 1);
+    float top = image[y0 * width + x0] + (image[y0 * width + x1] - image[y0 * width + x0]) * fx;
+    float bottom = image[y1 * width + x0] + (image[y1 * width + x1] - image[y1 * width + x0]) * fx;
+    return top + (bottom - top) * fy;
+}
+
+void LucasKanadeReference(const float* previous, const float* current, int32_t width, int32_t height, uint32_t levels,
+                          uint32_t iterations, float minEigenvalue, uint32_t count, const float* points,
+                          float* tracked, uint8_t* found) {
+    const int32_t kWindow = 8;
+    std::vector<std::vector<float>> previousLevels(levels);
+    std::vector<std::vector<float>> currentLevels(levels);
+    previousLevels[0].assign(previous, previous + width * height);
+    currentLevels[0].assign(current, current + width * height);
+    for (uint32_t level = 1; level < levels; level++) {
+        int32_t levelWidth = width >> (level - 1);
+        int32_t levelHeight = height >> (level - 1);
+        previousLevels[level].resize((levelWidth / 2) * (levelHeight / 2));
+        currentLevels[level].resize((levelWidth / 2) * (levelHeight / 2));
+        DownsampleReference(previousLevels[level - 1].data(), levelWidth, levelHeight, previousLevels[level].data());
+        DownsampleReference(currentLevels[level - 1].data(), levelWidth, levelHeight, currentLevels[level].data());
+    }
+
+    float window[kWindow * kWindow][3];
+    for (uint32_t p = 0; p < count; p++) {
+        float guessX = 0.0f;
+        float guessY = 0.0f;
+        bool lost = false;
+        for (int32_t level = static_cast<int32_t>(levels) - 1; level >= 0; level--) {
+            const float* prev = previousLevels[level].data();
+            const float* curr = currentLevels[level].data();
+            int32_t levelWidth = width >> level;
+            int32_t levelHeight = height >> level;
+            float scale = 1.0f / static_cast<float>(1 << level);
+            float gxx = 0.0f;
+            float gxy = 0.0f;
+            float gyy = 0.0f;
+            for (int32_t i = 0; i < kWindow * kWindow; i++) {
+                float x = points[p * 2] * scale + (i % kWindow) - 3.5f;
+                float y = points[p * 2 + 1] * scale + (i / kWindow) - 3.5f;
+                float ix = (SampleLinear(prev, levelWidth, levelHeight, x + 1.0f, y) -
+                            SampleLinear(prev, levelWidth, levelHeight, x - 1.0f, y)) * 0.5f;
+                float iy = (SampleLinear(prev, levelWidth, levelHeight, x, y + 1.0f) -
+                            SampleLinear(prev, levelWidth, levelHeight, x, y - 1.0f)) * 0.5f;
+                window[i][0] = SampleLinear(prev, levelWidth, levelHeight, x, y);
+                window[i][1] = ix;
+                window[i][2] = iy;
+                gxx += ix * ix;
+                gxy += ix * iy;
+                gyy += iy * iy;
+            }
+            float det = gxx * gyy - gxy * gxy;
+            float minEigen = (gxx + gyy - sqrtf((gxx - gyy) * (gxx - gyy) + 4.0f * gxy * gxy)) * (0.5f / 64.0f);
+            if (minEigen < minEigenvalue || det <= 0.0f) {
+                lost = true;
+                break;
+            }
+
+            float vx = 0.0f;
+            float vy = 0.0f;
+            for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+                float bx = 0.0f;
+                float by = 0.0f;
+                for (int32_t i = 0; i < kWindow * kWindow; i++) {
+                    float x = points[p * 2] * scale + (i % kWindow) - 3.5f + guessX + vx;
+                    float y = points[p * 2 + 1] * scale + (i / kWindow) - 3.5f + guessY + vy;
+                    float diff = window[i][0] - SampleLinear(curr, levelWidth, levelHeight, x, y);
+                    bx += diff * window[i][1];
+                    by += diff * window[i][2];
+                }
+                float stepX = (gyy * bx - gxy * by) / det;
+                float stepY = (gxx * by - gxy * bx) / det;
+                vx += stepX;
+                vy += stepY;
+                if (stepX * stepX + stepY * stepY < 1e-4f) break;
+            }
+            guessX = (level > 0) ? 2.0f * (guessX + vx) : guessX + vx;
+            guessY = (level > 0) ? 2.0f * (guessY + vy) : guessY + vy;
+        }
+
+        tracked[p * 2] = points[p * 2] + guessX;
+        tracked[p * 2 + 1] = points[p * 2 + 1] + guessY;
+        found[p] = !lost && tracked[p * 2] >= 0.0f && tracked[p * 2 + 1] >= 0.0f && tracked[p * 2] <= width - 1 &&
+                   tracked[p * 2 + 1] <= height - 1;
+    }
+}
+
+static const int32_t kFastCircle[16][2] = {{0, -3}, {1, -3}, {2, -2}, {3, -1},  {3, 0},   {3, 1},   {2, 2},   {1, 3},
+                                           {0, 3},  {-1, 3}, {-2, 2}, {-3, 1},  {-3, 0},  {-3, -1}, {-2, -2}, {-1, -3}};
+
+static bool HasArc(uint32_t mask) {
+    uint32_t ring = mask | (mask << 16);
+    uint32_t run = ring;
+    for (int32_t k = 1; k < 9; k++) {
+        run &= ring >> k;
+    }
+    return (run & 0xFFFFu) != 0;
+}
+
+uint32_t FastCornersReference(const float* luma, int32_t width, int32_t height, float threshold, uint32_t perTile,
+                              uint32_t capacity, float* corners) {
+    std::vector<float> score(width * height, 0.0f);
+    for (int32_t y = 3; y < height - 3; y++) {
+        for (int32_t x = 3; x < width - 3; x++) {
+            float center = luma[y * width + x];
+            uint32_t brighter = 0;
+            uint32_t darker = 0;
+            float brighterSum = 0.0f;
+            float darkerSum = 0.0f;
+            for (int32_t i = 0; i < 16; i++) {
+                float value = luma[(y + kFastCircle[i][1]) * width + x + kFastCircle[i][0]];
+                if (value > center + threshold) {
+                    brighter |= 1u << i;
+                    brighterSum += value - center - threshold;
+                } else if (value < center - threshold) {
+                    darker |= 1u << i;
+                    darkerSum += center - threshold - value;
+                }
+            }
+            float s = HasArc(brighter) ? brighterSum : 0.0f;
+            if (HasArc(darker)) s = std::max(s, darkerSum);
+            score[y * width + x] = s;
+        }
+    }
+
+    uint32_t count = 0;
+    std::vector<std::pair<float, int32_t>> tile;
+    for (int32_t ty = 0; ty < height; ty += VARTIP_FAST_TILE_SIZE) {
+        for (int32_t tx = 0; tx < width; tx += VARTIP_FAST_TILE_SIZE) {
+            tile.clear();
+            for (int32_t y = ty; y < std::min(ty + VARTIP_FAST_TILE_SIZE, height); y++) {
+                for (int32_t x = tx; x < std::min(tx + VARTIP_FAST_TILE_SIZE, width); x++) {
+                    float s = score[y * width + x];
+                    bool corner = s > 0.0f;
+                    for (int32_t j = -1; j <= 1 && corner; j++) {
+                        for (int32_t i = -1; i <= 1; i++) {
+                            int32_t nx = x + i;
+                            int32_t ny = y + j;
+                            if ((i == 0 && j == 0) || nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+                            float other = score[ny * width + nx];
+                            bool earlier = j < 0 || (j == 0 && i < 0);
+                            if (earlier ? other >= s : other > s) corner = false;
+                        }
+                    }
+                    // Negated score so the sort puts the strongest first and ties in raster order like the shader
+                    if (corner) tile.push_back(std::make_pair(-s, (y - ty) * VARTIP_FAST_TILE_SIZE + x - tx));
+                }
+            }
+            std::sort(tile.begin(), tile.end());
+            for (size_t k = 0; k < tile.size() && k < perTile && count < capacity; k++, count++) {
+                corners[count * 3] = static_cast<float>(tx + tile[k].second % VARTIP_FAST_TILE_SIZE);
+                corners[count * 3 + 1] = static_cast<float>(ty + tile[k].second / VARTIP_FAST_TILE_SIZE);
+                corners[count * 3 + 2] = -tile[k].first;
+            }
+        }
+    }
+    return count;
+}
+
+void IntegralImageReference(const float* luma, int32_t width, int32_t height, uint32_t* sums, uint32_t* squares) {
+    for (int32_t y = 0; y < height; y++) {
+        uint32_t rowSum = 0;
+        uint32_t rowSquares = 0;
+        for (int32_t x = 0; x < width; x++) {
+            float clamped = std::min(std::max(luma[y * width + x], 0.0f), 1.0f);
+            uint32_t value = static_cast<uint32_t>(clamped * 255.0f + 0.5f);
+            rowSum += value;
+            rowSquares += value * value;
+            sums[y * width + x] = rowSum + (y > 0 ? sums[(y - 1) * width + x] : 0);
+            if (squares != nullptr) squares[y * width + x] = rowSquares + (y > 0 ? squares[(y - 1) * width + x] : 0);
+        }
+    }
+}
+
+// Sum over the box from (x0, y0) exclusive to (x1, y1) inclusive, -1 is the edge before the image
+static uint32_t BoxSum(const uint32_t* integral, int32_t width, int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+    uint32_t sum = integral[y1 * width + x1];
+    if (x0 >= 0) sum -= integral[y1 * width + x0];
+    if (y0 >= 0) sum -= integral[y0 * width + x1];
+    if (x0 >= 0 && y0 >= 0) sum += integral[y0 * width + x0];
+    return sum;
+}
+
+void BoxFilterReference(const uint32_t* sums, const uint32_t* squares, int32_t width, int32_t height, int32_t radius,
+                        bool stddev, float* output) {
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            int32_t x0 = std::max(x - radius - 1, -1);
+            int32_t y0 = std::max(y - radius - 1, -1);
+            int32_t x1 = std::min(x + radius, width - 1);
+            int32_t y1 = std::min(y + radius, height - 1);
+            float area = static_cast<float>((x1 - x0) * (y1 - y0));
+            float mean = BoxSum(sums, width, x0, y0, x1, y1) / area;
+            float value = mean / 255.0f;
+            if (stddev) {
+                float variance = BoxSum(squares, width, x0, y0, x1, y1) / area - mean * mean;
+                value = sqrtf(std::max(variance, 0.0f)) / 255.0f;
+            }
+            output[y * width + x] = value;
+        }
+    }
+}
+
+void BackgroundModelReference(const float* luma, int32_t width, int32_t height, float rate, float threshold,
+                              float minVariance, float warmupFrames, float* model, uint8_t* mask) {
+    const float kForegroundScale = 0.1f;
+    for (int32_t p = 0; p < width * height; p++) {
+        float* pixel = model + p * 3;
+        float diff = luma[p] - pixel[0];
+        float variance = std::max(pixel[1], minVariance);
+        bool motion = pixel[2] >= warmupFrames && diff * diff > threshold * threshold * variance;
+
+        float alpha = std::max(1.0f / (pixel[2] + 1.0f), rate) * (motion ? kForegroundScale : 1.0f);
+        pixel[0] += alpha * diff;
+        pixel[1] = (1.0f - alpha) * (pixel[1] + alpha * diff * diff);
+        pixel[2] = std::min(pixel[2] + 1.0f, warmupFrames);
+        mask[p] = motion ? 1 : 0;
+    }
+}
+
+void MorphologyReference(const uint8_t* src, int32_t width, int32_t height, int32_t radius, bool dilate,
+                         uint8_t* dst) {
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            uint8_t value = dilate ? 0 : 1;
+            for (int32_t j = std::max(y - radius, 0); j <= std::min(y + radius, height - 1); j++) {
+                for (int32_t i = std::max(x - radius, 0); i <= std::min(x + radius, width - 1); i++) {
+                    value = dilate ? std::max(value, src[j * width + i]) : std::min(value, src[j * width + i]);
+                }
+            }
+            dst[y * width + x] = value;
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef VARTIP_FILTERREFERENCE_H_
+#define VARTIP_FILTERREFERENCE_H_
+
+#include <stdint.h>
+
+// CPU versions of the compute filters, slow and straightforward, to check the GPU output against. Images are row
+// major floats, borders are clamped to the edge like the samplers of the filter graph
+
+// Largest radius the blur shader has push constants for
+#define VARTIP_BLUR_MAX_RADIUS 31
+
+/**
+ * Normalized one sided Gaussian weights, weights[0] is the center tap and weights[i] the tap at distance i on both
+ * sides
+ * @param weights radius + 1 values
+ */
+void ComputeGaussianWeights(float sigma, uint32_t radius, float* weights);
+
+// Luma of RGBA8 pixels the way the luma shader computes it, stride in pixels
+void LumaReference(const uint32_t* pixels, int32_t stride, int32_t width, int32_t height, float* luma);
+
+// Separable Gaussian blur, horizontal then vertical
+void GaussianBlurReference(const float* src, float* dst, int32_t width, int32_t height, float sigma,
+                           uint32_t radius);
+
+// Next pyramid level of the compute fallback, the mean of each 2x2 block. dst is width / 2 x height / 2, an odd last
+// row or column is dropped
+void DownsampleReference(const float* src, int32_t width, int32_t height, float* dst);
+
+// 256 bin histogram of the luma of RGBA8 pixels, binned like shaders/histogram.comp
+void LumaHistogramReference(const uint32_t* pixels, int32_t stride, int32_t width, int32_t height, uint32_t* bins);
+
+/**
+ * 3x3 Sobel gradient
+ * @param sector direction of the gradient rounded to 45 degrees: 0 horizontal, 1 diagonal down right, 2 vertical,
+ *               3 diagonal up right
+ */
+void SobelReference(const float* luma, int32_t width, int32_t height, float* magnitude, uint8_t* sector);
+
+// Canny edges from luma: non-maximum suppression, the low and high magnitude thresholds and full hysteresis. edges is
+// 1 on an edge and 0 elsewhere
+void CannyReference(const float* luma, int32_t width, int32_t height, float low, float high, uint8_t* edges);
+
+/**
+ * Pyramidal Lucas-Kanade the way shaders/flow.comp tracks points: levels built with DownsampleReference, an 8x8
+ * window centered on the point, bilinear samples with pixel centers on integer coordinates
+ * @param points, tracked count x, y pairs, where the points are in previous and where they were found in current
+ * @param found 0 where a point is lost: flat window or out of the image
+ */
+void LucasKanadeReference(const float* previous, const float* current, int32_t width, int32_t height, uint32_t levels,
+                          uint32_t iterations, float minEigenvalue, uint32_t count, const float* points,
+                          float* tracked, uint8_t* found);
+
+// Side of the tiles the FAST corners are capped per, one work group of shaders/fast_nms.comp
+#define VARTIP_FAST_TILE_SIZE 16
+
+/**
+ * FAST-9 corners the way shaders/fast.comp and fast_nms.comp find them: score, 3x3 non-maximum suppression and the
+ * perTile strongest corners of each tile
+ * @param corners x, y and score of each corner, tile by tile, at least capacity of them
+ * @return corners found, at most capacity
+ */
+uint32_t FastCornersReference(const float* luma, int32_t width, int32_t height, float threshold, uint32_t perTile,
+                              uint32_t capacity, float* corners);
+
+/**
+ * Integral image of luma quantized to 0-255 like shaders/integral_rows.comp, sums and squares wrap around 2^32 the
+ * same way
+ * @param squares integral of the squared luma, nullptr to skip it
+ */
+void IntegralImageReference(const float* luma, int32_t width, int32_t height, uint32_t* sums, uint32_t* squares);
+
+// Box mean or standard deviation from the integral images like shaders/box_filter.comp, from 0 to 1
+void BoxFilterReference(const uint32_t* sums, const uint32_t* squares, int32_t width, int32_t height, int32_t radius,
+                        bool stddev, float* output);
+
+/**
+ * One frame of the background model of shaders/background.comp
+ * @param model mean, variance and frames seen of each pixel, zeros before the first frame
+ * @param mask 1 where there is motion, 0 elsewhere
+ */
+void BackgroundModelReference(const float* luma, int32_t width, int32_t height, float rate, float threshold,
+                              float minVariance, float warmupFrames, float* model, uint8_t* mask);
+
+// Erosion or dilation of a 0/1 mask with a (2 * radius + 1) square like shaders/morphology.comp
+void MorphologyReference(const uint8_t* src, int32_t width, int32_t height, int32_t radius, bool dilate, uint8_t* dst);
+
+#endif  // VARTIP_FILTERREFERENCE_H_
@@ -0,0 +1,1090 @@
+#include "Filters.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include "FilterReference.h"
+#include "Util.h"
+
+static const std::vector<VkDescriptorType> kSampledToStorage = {
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+};
+
+// Kernel of a stage owned by the graph, its pipeline comes from the variant cache when there is one so stages using
+// the same shader and constants share it
+static ComputeKernel* CreateKernel(FilterContext* context, const char* shaderPath,
+                                   const std::vector<VkDescriptorType>& bindings, uint32_t pushConstantSize = 0,
+                                   const KernelSpecialization& specialization = KernelSpecialization()) {
+    if (context->kernelVariants != nullptr) {
+        const ComputePipeline* pipeline =
+            context->kernelVariants->GetVariant(shaderPath, bindings, pushConstantSize, specialization);
+        return context->graph->AddKernel(new ComputeKernel(context->device, pipeline));
+    }
+    VkSpecializationInfo info = specialization.GetInfo();
+    return context->graph->AddKernel(new ComputeKernel(*context->assets, context->device, shaderPath, bindings,
+                                                       pushConstantSize, specialization.IsEmpty() ? nullptr : &info));
+}
+
+// One dispatch over the output reading input through a sampler, the shape of most filter passes
+static void AddSampledToStoragePass(FilterContext* context, const char* name, ComputeKernel* kernel,
+                                    GraphResource input, GraphResource output) {
+    FilterGraph* graph = context->graph;
+    std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        name, {input}, {output},
+        [kernel, set, input, output](FilterGraph* graph) {
+            *set = kernel->AllocateSet();
+            kernel->UpdateSampledImage(*set, 0, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(input));
+            kernel->UpdateStorageImage(*set, 1, graph->GetImageView(output));
+        },
+        [kernel, set, graph, output](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(output);
+            kernel->Dispatch(cmdBuffer, *set, nullptr, extent.width, extent.height);
+        });
+}
+
+GraphResource AddLumaStage(FilterContext* context, GraphResource input) {
+    FilterGraph* graph = context->graph;
+    ComputeKernel* kernel = CreateKernel(context, "shaders/luma.comp.spv", kSampledToStorage);
+    VkExtent2D extent = graph->GetExtent(input);
+    GraphResource luma = graph->CreateTransientImage("luma", VK_FORMAT_R32_SFLOAT, extent.width, extent.height);
+    AddSampledToStoragePass(context, "luma", kernel, input, luma);
+    return luma;
+}
+
+// Group size of the shaders working on a shared memory tile (blur, hysteresis and histogram), wider than the other
+// kernels so the apron is a smaller share of the loads
+#define VARTIP_TILE_GROUP_SIZE 16
+
+GraphResource AddGaussianBlurStage(FilterContext* context, GraphResource input, float sigma, uint32_t radius) {
+    FilterGraph* graph = context->graph;
+    if (radius == 0) radius = static_cast<uint32_t>(ceilf(3.0f * sigma));
+    if (radius < 1) radius = 1;
+    if (radius > VARTIP_BLUR_MAX_RADIUS) radius = VARTIP_BLUR_MAX_RADIUS;
+
+    // The weights are the push constants, the radius sizes the shared tile so it has to be a specialization constant
+    std::shared_ptr<std::vector<float>> weights =
+        std::make_shared<std::vector<float>>(VARTIP_BLUR_MAX_RADIUS + 1, 0.0f);
+    ComputeGaussianWeights(sigma, radius, weights->data());
+
+    VkExtent2D extent = graph->GetExtent(input);
+    GraphResource images[3] = {
+        input,
+        graph->CreateTransientImage("blur h", VK_FORMAT_R32_SFLOAT, extent.width, extent.height),
+        graph->CreateTransientImage("blur", VK_FORMAT_R32_SFLOAT, extent.width, extent.height),
+    };
+    for (uint32_t vertical = 0; vertical < 2; vertical++) {
+        ComputeKernel* kernel = CreateKernel(context, "shaders/blur.comp.spv", kSampledToStorage,
+                                             (VARTIP_BLUR_MAX_RADIUS + 1) * sizeof(float),
+                                             KernelSpecialization().Set(0, radius).Set(1, vertical));
+
+        GraphResource source = images[vertical];
+        GraphResource output = images[vertical + 1];
+        std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+        graph->AddPass(
+            vertical ? "blur v" : "blur h", {source}, {output},
+            [kernel, set, source, output](FilterGraph* graph) {
+                *set = kernel->AllocateSet();
+                kernel->UpdateSampledImage(*set, 0, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(source));
+                kernel->UpdateStorageImage(*set, 1, graph->GetImageView(output));
+            },
+            [kernel, set, weights, graph, output](VkCommandBuffer cmdBuffer) {
+                VkExtent2D extent = graph->GetExtent(output);
+                kernel->DispatchGroups(cmdBuffer, *set, weights->data(),
+                                       (extent.width + VARTIP_TILE_GROUP_SIZE - 1) / VARTIP_TILE_GROUP_SIZE,
+                                       (extent.height + VARTIP_TILE_GROUP_SIZE - 1) / VARTIP_TILE_GROUP_SIZE);
+            });
+    }
+    return images[2];
+}
+
+struct CannyThresholds {
+    float low;
+    float high;
+};
+
+GraphResource AddCannyStage(FilterContext* context, GraphResource input, float low, float high) {
+    FilterGraph* graph = context->graph;
+    VkExtent2D extent = graph->GetExtent(input);
+
+    ComputeKernel* sobel = CreateKernel(context, "shaders/sobel.comp.spv", kSampledToStorage);
+    GraphResource gradient =
+        graph->CreateTransientImage("gradient", VK_FORMAT_R32G32B32A32_SFLOAT, extent.width, extent.height);
+    AddSampledToStoragePass(context, "sobel", sobel, input, gradient);
+
+    ComputeKernel* nms = CreateKernel(context, "shaders/nms.comp.spv", kSampledToStorage, sizeof(CannyThresholds));
+    GraphResource edges = graph->CreateTransientImage("edges", VK_FORMAT_R32_SFLOAT, extent.width, extent.height);
+    CannyThresholds thresholds{.low = low, .high = high};
+    std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "nms", {gradient}, {edges},
+        [nms, set, gradient, edges](FilterGraph* graph) {
+            *set = nms->AllocateSet();
+            nms->UpdateSampledImage(*set, 0, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(gradient));
+            nms->UpdateStorageImage(*set, 1, graph->GetImageView(edges));
+        },
+        [nms, set, thresholds, graph, edges](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(edges);
+            nms->Dispatch(cmdBuffer, *set, &thresholds, extent.width, extent.height);
+        });
+
+    // Every round ping-pongs into a new transient image, aliasing keeps only two of them in memory
+    ComputeKernel* hysteresis = CreateKernel(context, "shaders/hysteresis.comp.spv", kSampledToStorage);
+    for (uint32_t i = 0; i < VARTIP_HYSTERESIS_PASSES; i++) {
+        GraphResource grown =
+            graph->CreateTransientImage("hysteresis", VK_FORMAT_R32_SFLOAT, extent.width, extent.height);
+        std::shared_ptr<VkDescriptorSet> roundSet = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+        graph->AddPass(
+            "hysteresis", {edges}, {grown},
+            [hysteresis, roundSet, edges, grown](FilterGraph* graph) {
+                *roundSet = hysteresis->AllocateSet();
+                hysteresis->UpdateSampledImage(*roundSet, 0, graph->GetSampler(VK_FILTER_NEAREST),
+                                               graph->GetImageView(edges));
+                hysteresis->UpdateStorageImage(*roundSet, 1, graph->GetImageView(grown));
+            },
+            [hysteresis, roundSet, graph, grown](VkCommandBuffer cmdBuffer) {
+                VkExtent2D extent = graph->GetExtent(grown);
+                hysteresis->DispatchGroups(cmdBuffer, *roundSet, nullptr,
+                                           (extent.width + VARTIP_TILE_GROUP_SIZE - 1) / VARTIP_TILE_GROUP_SIZE,
+                                           (extent.height + VARTIP_TILE_GROUP_SIZE - 1) / VARTIP_TILE_GROUP_SIZE);
+            });
+        edges = grown;
+    }
+    return edges;
+}
+
+GraphResource AddEdgeOverlayStage(FilterContext* context, GraphResource color, GraphResource edges) {
+    FilterGraph* graph = context->graph;
+    ComputeKernel* kernel = CreateKernel(context, "shaders/edge_overlay.comp.spv",
+                                         {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE});
+    VkExtent2D extent = graph->GetExtent(color);
+    GraphResource output =
+        graph->CreateTransientImage("edge overlay", VK_FORMAT_R8G8B8A8_UNORM, extent.width, extent.height);
+    std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "edge overlay", {color, edges}, {output},
+        [kernel, set, color, edges, output](FilterGraph* graph) {
+            *set = kernel->AllocateSet();
+            kernel->UpdateSampledImage(*set, 0, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(color));
+            kernel->UpdateSampledImage(*set, 1, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(edges));
+            kernel->UpdateStorageImage(*set, 2, graph->GetImageView(output));
+        },
+        [kernel, set, graph, output](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(output);
+            kernel->Dispatch(cmdBuffer, *set, nullptr, extent.width, extent.height);
+        });
+    return output;
+}
+
+GraphResource AddHistogramStage(FilterContext* context, GraphResource input) {
+    FilterGraph* graph = context->graph;
+    GraphResource histogram = graph->CreateBuffer("histogram", VARTIP_HISTOGRAM_BINS * sizeof(uint32_t));
+    graph->AddPass(
+        "histogram clear", {}, {histogram}, nullptr,
+        [graph, histogram](VkCommandBuffer cmdBuffer) {
+            vkCmdFillBuffer(cmdBuffer, graph->GetBuffer(histogram), 0, VK_WHOLE_SIZE, 0);
+        },
+        VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    // The atomics read the bins too
+    ComputeKernel* kernel =
+        CreateKernel(context, "shaders/histogram.comp.spv",
+                     {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER});
+    std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "histogram", {input, histogram}, {histogram},
+        [kernel, set, input, histogram](FilterGraph* graph) {
+            *set = kernel->AllocateSet();
+            kernel->UpdateSampledImage(*set, 0, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(input));
+            kernel->UpdateStorageBuffer(*set, 1, graph->GetBuffer(histogram));
+        },
+        [kernel, set, graph, input](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(input);
+            kernel->DispatchGroups(cmdBuffer, *set, nullptr,
+                                   (extent.width + VARTIP_TILE_GROUP_SIZE - 1) / VARTIP_TILE_GROUP_SIZE,
+                                   (extent.height + VARTIP_TILE_GROUP_SIZE - 1) / VARTIP_TILE_GROUP_SIZE);
+        });
+    return histogram;
+}
+
+struct HistogramLutParameters {
+    uint32_t mode;
+    float clip;
+};
+
+GraphResource AddHistogramLutStage(FilterContext* context, GraphResource histogram, HistogramLutMode mode,
+                                   float clip) {
+    FilterGraph* graph = context->graph;
+    ComputeKernel* kernel = CreateKernel(context, "shaders/histogram_lut.comp.spv",
+                                         {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE},
+                                         sizeof(HistogramLutParameters));
+    GraphResource lut = graph->CreateTransientImage("histogram lut", VK_FORMAT_R32_SFLOAT, VARTIP_HISTOGRAM_BINS, 1);
+    HistogramLutParameters parameters{.mode = static_cast<uint32_t>(mode), .clip = clip};
+    std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "histogram lut", {histogram}, {lut},
+        [kernel, set, histogram, lut](FilterGraph* graph) {
+            *set = kernel->AllocateSet();
+            kernel->UpdateStorageBuffer(*set, 0, graph->GetBuffer(histogram));
+            kernel->UpdateStorageImage(*set, 1, graph->GetImageView(lut));
+        },
+        [kernel, set, parameters](VkCommandBuffer cmdBuffer) {
+            kernel->DispatchGroups(cmdBuffer, *set, &parameters, 1, 1);
+        });
+    return lut;
+}
+
+void AnalyzeLumaHistogram(const uint32_t* bins, LumaHistogramStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    uint64_t weighted = 0;
+    for (uint32_t i = 0; i < VARTIP_HISTOGRAM_BINS; i++) {
+        stats->pixelCount += bins[i];
+        weighted += static_cast<uint64_t>(bins[i]) * i;
+    }
+    if (stats->pixelCount == 0) {
+        return;
+    }
+    stats->mean = static_cast<float>(weighted) / stats->pixelCount / (VARTIP_HISTOGRAM_BINS - 1);
+    stats->underexposed = static_cast<float>(bins[0]) / stats->pixelCount;
+    stats->overexposed = static_cast<float>(bins[VARTIP_HISTOGRAM_BINS - 1]) / stats->pixelCount;
+
+    uint32_t count = 0;
+    bool lowFound = false;
+    for (uint32_t i = 0; i < VARTIP_HISTOGRAM_BINS; i++) {
+        count += bins[i];
+        if (!lowFound && count * 20ull >= stats->pixelCount) {
+            stats->lowPercentile = i;
+            lowFound = true;
+        }
+        if (count * 20ull >= stats->pixelCount * 19ull) {
+            stats->highPercentile = i;
+            break;
+        }
+    }
+}
+
+static bool SupportsLinearBlit(FilterContext* context, VkFormat format) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(context->gpuDevice, format, &properties);
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & needed) == needed;
+}
+
+// Far corner of a mip level, levels round down and stop at 1 pixel
+static VkOffset3D LevelCorner(VkExtent2D extent, uint32_t level) {
+    return {std::max(1, static_cast<int32_t>(extent.width >> level)),
+            std::max(1, static_cast<int32_t>(extent.height >> level)), 1};
+}
+
+GraphResource AddPyramidStage(FilterContext* context, GraphResource input, uint32_t levels) {
+    FilterGraph* graph = context->graph;
+    VkExtent2D extent = graph->GetExtent(input);
+    VkFormat format = graph->GetFormat(input);
+    uint32_t maxLevels = 1;
+    while ((std::min(extent.width, extent.height) >> maxLevels) > 0) maxLevels++;
+    levels = std::max(1u, std::min(levels, maxLevels));
+
+    if (SupportsLinearBlit(context, format)) {
+        LOGI("Pyramid of %u levels by linear blits, format %d", levels, format);
+        graph->AddImageUsage(input, VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+        GraphResource pyramid = graph->CreateTransientImage(
+            "pyramid", format, extent.width, extent.height,
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, levels);
+        graph->AddPass(
+            "pyramid", {input}, {pyramid}, nullptr,
+            [graph, input, pyramid, levels](VkCommandBuffer cmdBuffer) {
+                VkExtent2D extent = graph->GetExtent(pyramid);
+                VkImageCopy copy{
+                    .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                    .srcOffset = {0, 0, 0},
+                    .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                    .dstOffset = {0, 0, 0},
+                    .extent = {extent.width, extent.height, 1},
+                };
+                vkCmdCopyImage(cmdBuffer, graph->GetImage(input), VK_IMAGE_LAYOUT_GENERAL, graph->GetImage(pyramid),
+                               VK_IMAGE_LAYOUT_GENERAL, 1, &copy);
+
+                // Every level is read by the blit of the next one once it is written
+                VkMemoryBarrier levelBarrier{
+                    .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                    .pNext = nullptr,
+                    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+                };
+                for (uint32_t level = 1; level < levels; level++) {
+                    VkImageBlit blit{
+                        .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1},
+                        .srcOffsets = {{0, 0, 0}, LevelCorner(extent, level - 1)},
+                        .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+                        .dstOffsets = {{0, 0, 0}, LevelCorner(extent, level)},
+                    };
+                    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                         1, &levelBarrier, 0, nullptr, 0, nullptr);
+                    vkCmdBlitImage(cmdBuffer, graph->GetImage(pyramid), VK_IMAGE_LAYOUT_GENERAL,
+                                   graph->GetImage(pyramid), VK_IMAGE_LAYOUT_GENERAL, 1, &blit, VK_FILTER_LINEAR);
+                }
+            },
+            VK_PIPELINE_STAGE_TRANSFER_BIT);
+        return pyramid;
+    }
+
+    if (format != VK_FORMAT_R32_SFLOAT) {
+        LOGE("No pyramid for format %d, it can't be blitted with linear filtering", format);
+        return VARTIP_GRAPH_NO_RESOURCE;
+    }
+    // One descriptor set per level
+    levels = std::min(levels, static_cast<uint32_t>(VARTIP_KERNEL_MAX_SETS));
+    LOGI("Pyramid of %u levels by compute, format %d has no linear blits", levels, format);
+    ComputeKernel* kernel = CreateKernel(context, "shaders/downsample.comp.spv", kSampledToStorage, sizeof(int32_t));
+    GraphResource pyramid = graph->CreateTransientImage("pyramid", format, extent.width, extent.height, 0, levels);
+    std::shared_ptr<std::vector<VkDescriptorSet>> sets = std::make_shared<std::vector<VkDescriptorSet>>(levels);
+    graph->AddPass(
+        "pyramid", {input}, {pyramid},
+        [kernel, sets, input, pyramid, levels](FilterGraph* graph) {
+            for (uint32_t level = 0; level < levels; level++) {
+                VkImageView source = (level > 0) ? graph->GetLevelView(pyramid, level - 1) : graph->GetImageView(input);
+                (*sets)[level] = kernel->AllocateSet();
+                kernel->UpdateSampledImage((*sets)[level], 0, graph->GetSampler(VK_FILTER_NEAREST), source);
+                kernel->UpdateStorageImage((*sets)[level], 1, graph->GetLevelView(pyramid, level));
+            }
+        },
+        [kernel, sets, graph, pyramid, levels](VkCommandBuffer cmdBuffer) {
+            VkMemoryBarrier levelBarrier{
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            };
+            VkExtent2D extent = graph->GetExtent(pyramid);
+            for (uint32_t level = 0; level < levels; level++) {
+                int32_t step = (level > 0) ? 2 : 1;
+                if (level > 0) {
+                    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &levelBarrier, 0, nullptr, 0,
+                                         nullptr);
+                }
+                kernel->Dispatch(cmdBuffer, (*sets)[level], &step, std::max(1u, extent.width >> level),
+                                 std::max(1u, extent.height >> level));
+            }
+        });
+    return pyramid;
+}
+
+GraphResource AddPyramidLevelStage(FilterContext* context, GraphResource pyramid, uint32_t level) {
+    FilterGraph* graph = context->graph;
+    level = std::min(level, graph->GetMipLevels(pyramid) - 1);
+    VkExtent2D extent = graph->GetExtent(pyramid);
+    uint32_t width = std::max(1u, extent.width >> level);
+    uint32_t height = std::max(1u, extent.height >> level);
+
+    if (graph->GetFormat(pyramid) == VK_FORMAT_R8G8B8A8_UNORM) {
+        GraphResource output = graph->CreateTransientImage("pyramid level", VK_FORMAT_R8G8B8A8_UNORM, width, height,
+                                                           VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+        graph->AddPass(
+            "pyramid level", {pyramid}, {output}, nullptr,
+            [graph, pyramid, output, level](VkCommandBuffer cmdBuffer) {
+                VkExtent2D extent = graph->GetExtent(output);
+                VkImageCopy region{
+                    .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+                    .srcOffset = {0, 0, 0},
+                    .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                    .dstOffset = {0, 0, 0},
+                    .extent = {extent.width, extent.height, 1},
+                };
+                vkCmdCopyImage(cmdBuffer, graph->GetImage(pyramid), VK_IMAGE_LAYOUT_GENERAL, graph->GetImage(output),
+                               VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+            },
+            VK_PIPELINE_STAGE_TRANSFER_BIT);
+        return output;
+    }
+
+    ComputeKernel* kernel = CreateKernel(context, "shaders/visualize.comp.spv", kSampledToStorage);
+    GraphResource output = graph->CreateTransientImage("pyramid level", VK_FORMAT_R8G8B8A8_UNORM, width, height);
+    std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "pyramid level", {pyramid}, {output},
+        [kernel, set, pyramid, output, level](FilterGraph* graph) {
+            *set = kernel->AllocateSet();
+            kernel->UpdateSampledImage(*set, 0, graph->GetSampler(VK_FILTER_NEAREST),
+                                       graph->GetLevelView(pyramid, level));
+            kernel->UpdateStorageImage(*set, 1, graph->GetImageView(output));
+        },
+        [kernel, set, graph, output](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(output);
+            kernel->Dispatch(cmdBuffer, *set, nullptr, extent.width, extent.height);
+        });
+    return output;
+}
+
+struct FlowParameters {
+    uint32_t pointCount;
+    uint32_t gridColumns;
+    int32_t levels;
+    int32_t iterations;
+    float minEigenvalue;
+};
+
+GraphResource AddOpticalFlowStage(FilterContext* context, GraphResource luma, uint32_t pointCount, uint32_t levels) {
+    FilterGraph* graph = context->graph;
+    pointCount = std::max(1u, std::min(pointCount, static_cast<uint32_t>(VARTIP_FLOW_MAX_POINTS)));
+    GraphResource pyramid = AddPyramidStage(context, luma, levels);
+    if (pyramid == VARTIP_GRAPH_NO_RESOURCE) {
+        return VARTIP_GRAPH_NO_RESOURCE;
+    }
+    levels = graph->GetMipLevels(pyramid);
+    VkExtent2D extent = graph->GetExtent(pyramid);
+    GraphResource previous = graph->CreatePersistentImage("previous pyramid", graph->GetFormat(pyramid), extent.width,
+                                                          extent.height, 0, levels);
+    GraphResource points = graph->CreateBuffer("flow points", pointCount * sizeof(FlowPoint));
+
+    // Grid cells about as wide as they are high
+    uint32_t gridColumns = static_cast<uint32_t>(sqrtf(static_cast<float>(pointCount) * extent.width / extent.height));
+    gridColumns = std::max(1u, std::min(gridColumns, pointCount));
+    std::shared_ptr<FlowParameters> parameters = std::make_shared<FlowParameters>();
+    *parameters = {
+        .pointCount = pointCount,
+        .gridColumns = gridColumns,
+        .levels = static_cast<int32_t>(levels),
+        .iterations = VARTIP_FLOW_ITERATIONS,
+        .minEigenvalue = VARTIP_FLOW_MIN_EIGENVALUE,
+    };
+    ComputeKernel* kernel = CreateKernel(context, "shaders/flow.comp.spv",
+                                         {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+                                         sizeof(FlowParameters));
+    std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "flow", {previous, pyramid, points}, {points},
+        [kernel, set, previous, pyramid, points](FilterGraph* graph) {
+            *set = kernel->AllocateSet();
+            kernel->UpdateSampledImage(*set, 0, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(previous));
+            kernel->UpdateSampledImage(*set, 1, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(pyramid));
+            kernel->UpdateStorageBuffer(*set, 2, graph->GetBuffer(points));
+        },
+        [kernel, set, parameters](VkCommandBuffer cmdBuffer) {
+            // One work group per point
+            kernel->DispatchGroups(cmdBuffer, *set, parameters.get(), parameters->pointCount, 1);
+        });
+
+    // This frame's pyramid is the next frame's previous one, added after the flow pass so it runs after it
+    graph->AddImageUsage(pyramid, VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    graph->AddPass(
+        "flow history", {pyramid}, {previous}, nullptr,
+        [graph, pyramid, previous, levels](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(pyramid);
+            std::vector<VkImageCopy> regions(levels);
+            for (uint32_t level = 0; level < levels; level++) {
+                regions[level] = {
+                    .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+                    .srcOffset = {0, 0, 0},
+                    .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+                    .dstOffset = {0, 0, 0},
+                    .extent = {std::max(1u, extent.width >> level), std::max(1u, extent.height >> level), 1},
+                };
+            }
+            vkCmdCopyImage(cmdBuffer, graph->GetImage(pyramid), VK_IMAGE_LAYOUT_GENERAL, graph->GetImage(previous),
+                           VK_IMAGE_LAYOUT_GENERAL, levels, regions.data());
+        },
+        VK_PIPELINE_STAGE_TRANSFER_BIT);
+    return points;
+}
+
+GraphResource AddFlowOverlayStage(FilterContext* context, GraphResource color, GraphResource points) {
+    FilterGraph* graph = context->graph;
+    // Identity swizzle, a copy of the color image the points are drawn over
+    PointwiseOp copy;
+    ParsePointwiseOp("swizzle", "rgba", &copy);
+    GraphResource output = AddPointwiseStage(context, color, {copy});
+
+    uint32_t pointCount = static_cast<uint32_t>(graph->GetBufferSize(points) / sizeof(FlowPoint));
+    ComputeKernel* kernel =
+        CreateKernel(context, "shaders/flow_overlay.comp.spv",
+                     {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE}, sizeof(uint32_t));
+    std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "flow overlay", {points}, {output},
+        [kernel, set, points, output](FilterGraph* graph) {
+            *set = kernel->AllocateSet();
+            kernel->UpdateStorageBuffer(*set, 0, graph->GetBuffer(points));
+            kernel->UpdateStorageImage(*set, 1, graph->GetImageView(output));
+        },
+        [kernel, set, pointCount](VkCommandBuffer cmdBuffer) {
+            kernel->DispatchGroups(cmdBuffer, *set, &pointCount, (pointCount + 63) / 64, 1);
+        });
+    return output;
+}
+
+struct FastParameters {
+    uint32_t capacity;
+    uint32_t perTile;
+};
+
+GraphResource AddFastStage(FilterContext* context, GraphResource luma, float threshold, uint32_t perTile) {
+    FilterGraph* graph = context->graph;
+    VkExtent2D extent = graph->GetExtent(luma);
+    ComputeKernel* fast = CreateKernel(context, "shaders/fast.comp.spv", kSampledToStorage, sizeof(float));
+    GraphResource score = graph->CreateTransientImage("fast score", VK_FORMAT_R32_SFLOAT, extent.width, extent.height);
+    std::shared_ptr<VkDescriptorSet> scoreSet = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "fast score", {luma}, {score},
+        [fast, scoreSet, luma, score](FilterGraph* graph) {
+            *scoreSet = fast->AllocateSet();
+            fast->UpdateSampledImage(*scoreSet, 0, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(luma));
+            fast->UpdateStorageImage(*scoreSet, 1, graph->GetImageView(score));
+        },
+        [fast, scoreSet, threshold, graph, score](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(score);
+            fast->Dispatch(cmdBuffer, *scoreSet, &threshold, extent.width, extent.height);
+        });
+
+    GraphResource keypoints = graph->CreateBuffer(
+        "keypoints", sizeof(KeypointHeader) + VARTIP_FAST_MAX_KEYPOINTS * sizeof(Keypoint));
+    graph->AddPass(
+        "fast clear", {}, {keypoints}, nullptr,
+        [graph, keypoints](VkCommandBuffer cmdBuffer) {
+            vkCmdFillBuffer(cmdBuffer, graph->GetBuffer(keypoints), 0, sizeof(KeypointHeader), 0);
+        },
+        VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    // One group per tile, each one bumps the count once for all of the tile's corners. The pass reads the buffer too
+    // since the count it adds to comes from the clear
+    ComputeKernel* nms = CreateKernel(context, "shaders/fast_nms.comp.spv",
+                                      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+                                      sizeof(FastParameters));
+    const uint32_t tilePixels = VARTIP_FAST_TILE_SIZE * VARTIP_FAST_TILE_SIZE;
+    FastParameters parameters{
+        .capacity = VARTIP_FAST_MAX_KEYPOINTS,
+        .perTile = std::max(1u, std::min(perTile, tilePixels)),
+    };
+    std::shared_ptr<VkDescriptorSet> nmsSet = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "fast nms", {score, keypoints}, {keypoints},
+        [nms, nmsSet, score, keypoints](FilterGraph* graph) {
+            *nmsSet = nms->AllocateSet();
+            nms->UpdateSampledImage(*nmsSet, 0, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(score));
+            nms->UpdateStorageBuffer(*nmsSet, 1, graph->GetBuffer(keypoints));
+        },
+        [nms, nmsSet, parameters, graph, score](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(score);
+            nms->DispatchGroups(cmdBuffer, *nmsSet, &parameters,
+                                (extent.width + VARTIP_FAST_TILE_SIZE - 1) / VARTIP_FAST_TILE_SIZE,
+                                (extent.height + VARTIP_FAST_TILE_SIZE - 1) / VARTIP_FAST_TILE_SIZE);
+        });
+    return keypoints;
+}
+
+GraphResource AddKeypointOverlayStage(FilterContext* context, GraphResource color, GraphResource keypoints) {
+    FilterGraph* graph = context->graph;
+    // Identity swizzle, a copy of the color image the corners are drawn over
+    PointwiseOp copy;
+    ParsePointwiseOp("swizzle", "rgba", &copy);
+    GraphResource output = AddPointwiseStage(context, color, {copy});
+
+    // As many invocations as the buffer holds, the ones past the count return right away
+    ComputeKernel* kernel = CreateKernel(context, "shaders/keypoint_overlay.comp.spv",
+                                         {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE});
+    std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "keypoint overlay", {keypoints}, {output},
+        [kernel, set, keypoints, output](FilterGraph* graph) {
+            *set = kernel->AllocateSet();
+            kernel->UpdateStorageBuffer(*set, 0, graph->GetBuffer(keypoints));
+            kernel->UpdateStorageImage(*set, 1, graph->GetImageView(output));
+        },
+        [kernel, set](VkCommandBuffer cmdBuffer) {
+            kernel->DispatchGroups(cmdBuffer, *set, nullptr, VARTIP_FAST_MAX_KEYPOINTS / 64, 1);
+        });
+    return output;
+}
+
+IntegralImages AddIntegralImageStage(FilterContext* context, GraphResource luma, bool squared) {
+    FilterGraph* graph = context->graph;
+    VkExtent2D extent = graph->GetExtent(luma);
+    KernelSpecialization specialization;
+    specialization.Set(0, squared ? 1u : 0u);
+    ComputeKernel* rows = CreateKernel(
+        context, "shaders/integral_rows.comp.spv",
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE},
+        0, specialization);
+    ComputeKernel* columns = CreateKernel(context, "shaders/integral_columns.comp.spv",
+                                          {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                           VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                           VK_DESCRIPTOR_TYPE_STORAGE_IMAGE},
+                                          0, specialization);
+
+    // Without squares their bindings get the sums images, the shaders never touch them then
+    GraphResource sumRows =
+        graph->CreateTransientImage("integral rows", VK_FORMAT_R32_UINT, extent.width, extent.height);
+    IntegralImages integral{
+        .sums = graph->CreateTransientImage("integral", VK_FORMAT_R32_UINT, extent.width, extent.height),
+        .squares = VARTIP_GRAPH_NO_RESOURCE,
+    };
+    GraphResource squareRows = sumRows;
+    GraphResource squares = integral.sums;
+    std::vector<GraphResource> rowWrites = {sumRows};
+    std::vector<GraphResource> columnWrites = {integral.sums};
+    if (squared) {
+        squareRows =
+            graph->CreateTransientImage("integral square rows", VK_FORMAT_R32_UINT, extent.width, extent.height);
+        integral.squares = squares =
+            graph->CreateTransientImage("integral squares", VK_FORMAT_R32_UINT, extent.width, extent.height);
+        rowWrites.push_back(squareRows);
+        columnWrites.push_back(squares);
+    }
+
+    // 16 rows per group for the row scan, 16 columns per group for the column scan
+    std::shared_ptr<VkDescriptorSet> rowSet = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "integral rows", {luma}, rowWrites,
+        [rows, rowSet, luma, sumRows, squareRows](FilterGraph* graph) {
+            *rowSet = rows->AllocateSet();
+            rows->UpdateSampledImage(*rowSet, 0, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(luma));
+            rows->UpdateStorageImage(*rowSet, 1, graph->GetImageView(sumRows));
+            rows->UpdateStorageImage(*rowSet, 2, graph->GetImageView(squareRows));
+        },
+        [rows, rowSet, graph, sumRows](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(sumRows);
+            rows->DispatchGroups(cmdBuffer, *rowSet, nullptr, 1,
+                                 (extent.height + VARTIP_TILE_GROUP_SIZE - 1) / VARTIP_TILE_GROUP_SIZE);
+        });
+    std::shared_ptr<VkDescriptorSet> columnSet = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "integral columns", rowWrites, columnWrites,
+        [columns, columnSet, sumRows, squareRows, integral, squares](FilterGraph* graph) {
+            VkSampler sampler = graph->GetSampler(VK_FILTER_NEAREST);
+            *columnSet = columns->AllocateSet();
+            columns->UpdateSampledImage(*columnSet, 0, sampler, graph->GetImageView(sumRows));
+            columns->UpdateSampledImage(*columnSet, 1, sampler, graph->GetImageView(squareRows));
+            columns->UpdateStorageImage(*columnSet, 2, graph->GetImageView(integral.sums));
+            columns->UpdateStorageImage(*columnSet, 3, graph->GetImageView(squares));
+        },
+        [columns, columnSet, graph, sumRows](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(sumRows);
+            columns->DispatchGroups(cmdBuffer, *columnSet, nullptr,
+                                    (extent.width + VARTIP_TILE_GROUP_SIZE - 1) / VARTIP_TILE_GROUP_SIZE, 1);
+        });
+    return integral;
+}
+
+GraphResource AddBoxFilterStage(FilterContext* context, const IntegralImages& integral, uint32_t radius, bool stddev) {
+    FilterGraph* graph = context->graph;
+    if (stddev && integral.squares == VARTIP_GRAPH_NO_RESOURCE) {
+        LOGE("The box standard deviation needs the squared integral image");
+        return VARTIP_GRAPH_NO_RESOURCE;
+    }
+    int32_t boxRadius = static_cast<int32_t>(std::max(1u, std::min(radius, VARTIP_BOX_MAX_RADIUS)));
+    ComputeKernel* kernel = CreateKernel(context, "shaders/box_filter.comp.spv",
+                                         {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE},
+                                         sizeof(int32_t), KernelSpecialization().Set(0, stddev ? 1u : 0u));
+
+    VkExtent2D extent = graph->GetExtent(integral.sums);
+    GraphResource output = graph->CreateTransientImage(stddev ? "box stddev" : "box mean", VK_FORMAT_R32_SFLOAT,
+                                                       extent.width, extent.height);
+    GraphResource sums = integral.sums;
+    GraphResource squares = stddev ? integral.squares : integral.sums;
+    std::vector<GraphResource> reads = {sums};
+    if (stddev) reads.push_back(squares);
+    std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "box filter", reads, {output},
+        [kernel, set, sums, squares, output](FilterGraph* graph) {
+            VkSampler sampler = graph->GetSampler(VK_FILTER_NEAREST);
+            *set = kernel->AllocateSet();
+            kernel->UpdateSampledImage(*set, 0, sampler, graph->GetImageView(sums));
+            kernel->UpdateSampledImage(*set, 1, sampler, graph->GetImageView(squares));
+            kernel->UpdateStorageImage(*set, 2, graph->GetImageView(output));
+        },
+        [kernel, set, boxRadius, graph, output](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(output);
+            kernel->Dispatch(cmdBuffer, *set, &boxRadius, extent.width, extent.height);
+        });
+    return output;
+}
+
+GraphResource AddResizeStage(FilterContext* context, GraphResource input, uint32_t width, uint32_t height) {
+    FilterGraph* graph = context->graph;
+    VkFormat format = graph->GetFormat(input);
+    VkFilter filter = SupportsLinearBlit(context, format) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+    graph->AddImageUsage(input, VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    GraphResource output =
+        graph->CreateTransientImage("resized", format, width, height, VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    graph->AddPass(
+        "resize", {input}, {output}, nullptr,
+        [graph, input, output, filter](VkCommandBuffer cmdBuffer) {
+            VkExtent2D from = graph->GetExtent(input);
+            VkExtent2D to = graph->GetExtent(output);
+            VkImageBlit blit{
+                .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                .srcOffsets = {{0, 0, 0}, LevelCorner(from, 0)},
+                .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                .dstOffsets = {{0, 0, 0}, LevelCorner(to, 0)},
+            };
+            vkCmdBlitImage(cmdBuffer, graph->GetImage(input), VK_IMAGE_LAYOUT_GENERAL, graph->GetImage(output),
+                           VK_IMAGE_LAYOUT_GENERAL, 1, &blit, filter);
+        },
+        VK_PIPELINE_STAGE_TRANSFER_BIT);
+    return output;
+}
+
+GraphResource AddMorphologyStage(FilterContext* context, GraphResource mask, MorphologyOp op, uint32_t radius) {
+    if (op == MORPHOLOGY_OPEN || op == MORPHOLOGY_CLOSE) {
+        bool open = (op == MORPHOLOGY_OPEN);
+        GraphResource first = AddMorphologyStage(context, mask, open ? MORPHOLOGY_ERODE : MORPHOLOGY_DILATE, radius);
+        return AddMorphologyStage(context, first, open ? MORPHOLOGY_DILATE : MORPHOLOGY_ERODE, radius);
+    }
+
+    // The radius bounds the loops, as a specialization constant they unroll
+    FilterGraph* graph = context->graph;
+    KernelSpecialization specialization;
+    specialization.Set(0, op == MORPHOLOGY_DILATE ? 1u : 0u);
+    specialization.Set(1, std::max(1u, std::min(radius, VARTIP_MORPHOLOGY_MAX_RADIUS)));
+    ComputeKernel* kernel = CreateKernel(context, "shaders/morphology.comp.spv", kSampledToStorage, 0, specialization);
+    VkExtent2D extent = graph->GetExtent(mask);
+    const char* name = (op == MORPHOLOGY_DILATE) ? "dilate" : "erode";
+    GraphResource output = graph->CreateTransientImage(name, VK_FORMAT_R32_SFLOAT, extent.width, extent.height);
+    AddSampledToStoragePass(context, name, kernel, mask, output);
+    return output;
+}
+
+struct BackgroundParameters {
+    float rate;
+    float threshold;
+    float minVariance;
+    float warmupFrames;
+};
+
+GraphResource AddMotionStage(FilterContext* context, GraphResource luma, float rate, float threshold,
+                             uint32_t radius) {
+    FilterGraph* graph = context->graph;
+    VkExtent2D extent = graph->GetExtent(luma);
+    ComputeKernel* kernel = CreateKernel(
+        context, "shaders/background.comp.spv",
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE},
+        sizeof(BackgroundParameters));
+    // Mean, variance and frames seen, RGBA since two channel float storage images are optional in Vulkan 1.0
+    GraphResource model = graph->CreatePersistentImage("background", VK_FORMAT_R32G32B32A32_SFLOAT, extent.width,
+                                                       extent.height);
+    GraphResource mask = graph->CreateTransientImage("motion", VK_FORMAT_R32_SFLOAT, extent.width, extent.height);
+    BackgroundParameters parameters{
+        .rate = rate,
+        .threshold = threshold,
+        .minVariance = VARTIP_MOTION_MIN_VARIANCE,
+        .warmupFrames = VARTIP_MOTION_WARMUP_FRAMES,
+    };
+    std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "background", {luma, model}, {model, mask},
+        [kernel, set, luma, model, mask](FilterGraph* graph) {
+            *set = kernel->AllocateSet();
+            kernel->UpdateSampledImage(*set, 0, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(luma));
+            kernel->UpdateStorageImage(*set, 1, graph->GetImageView(model));
+            kernel->UpdateStorageImage(*set, 2, graph->GetImageView(mask));
+        },
+        [kernel, set, parameters, graph, mask](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(mask);
+            kernel->Dispatch(cmdBuffer, *set, &parameters, extent.width, extent.height);
+        });
+
+    if (radius == 0) {
+        return mask;
+    }
+    mask = AddMorphologyStage(context, mask, MORPHOLOGY_OPEN, radius);
+    return AddMorphologyStage(context, mask, MORPHOLOGY_CLOSE, radius);
+}
+
+GraphResource AddMotionOverlayStage(FilterContext* context, GraphResource color, GraphResource mask) {
+    FilterGraph* graph = context->graph;
+    ComputeKernel* kernel = CreateKernel(context, "shaders/motion_overlay.comp.spv",
+                                         {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE});
+    VkExtent2D extent = graph->GetExtent(color);
+    GraphResource output =
+        graph->CreateTransientImage("motion overlay", VK_FORMAT_R8G8B8A8_UNORM, extent.width, extent.height);
+    std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        "motion overlay", {color, mask}, {output},
+        [kernel, set, color, mask, output](FilterGraph* graph) {
+            *set = kernel->AllocateSet();
+            kernel->UpdateSampledImage(*set, 0, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(color));
+            kernel->UpdateSampledImage(*set, 1, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(mask));
+            kernel->UpdateStorageImage(*set, 2, graph->GetImageView(output));
+        },
+        [kernel, set, graph, output](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(output);
+            kernel->Dispatch(cmdBuffer, *set, nullptr, extent.width, extent.height);
+        });
+    return output;
+}
+
+GraphResource AddVisualizeStage(FilterContext* context, GraphResource input) {
+    FilterGraph* graph = context->graph;
+    ComputeKernel* kernel = CreateKernel(context, "shaders/visualize.comp.spv", kSampledToStorage);
+    VkExtent2D extent = graph->GetExtent(input);
+    GraphResource output =
+        graph->CreateTransientImage("visualize", VK_FORMAT_R8G8B8A8_UNORM, extent.width, extent.height);
+    AddSampledToStoragePass(context, "visualize", kernel, input, output);
+    return output;
+}
+
+bool ParsePointwiseOp(const std::string& name, const std::string& value, PointwiseOp* op) {
+    memset(op, 0, sizeof(*op));
+    op->slotCount = 1;
+    float number = value.empty() ? 0.0f : strtof(value.c_str(), nullptr);
+
+    if (name == "sepia" || name == "invert") {
+        static const float kSepia[3][4] = {
+            {0.393f, 0.769f, 0.189f, 0.0f},
+            {0.349f, 0.686f, 0.168f, 0.0f},
+            {0.272f, 0.534f, 0.131f, 0.0f},
+        };
+        static const float kInvert[3][4] = {
+            {-1.0f, 0.0f, 0.0f, 1.0f},
+            {0.0f, -1.0f, 0.0f, 1.0f},
+            {0.0f, 0.0f, -1.0f, 1.0f},
+        };
+        op->type = POINTWISE_COLOR_MATRIX;
+        op->slotCount = 3;
+        memcpy(op->params, name == "sepia" ? kSepia : kInvert, sizeof(op->params));
+    } else if (name == "gamma") {
+        op->type = POINTWISE_GAMMA;
+        op->params[0][0] = value.empty() ? 2.2f : number;
+    } else if (name == "contrast" || name == "brightness") {
+        op->type = POINTWISE_CONTRAST;
+        op->params[0][0] = (name == "contrast") ? number : 1.0f;
+        op->params[0][1] = 0.5f;
+        op->params[0][2] = (name == "brightness") ? number : 0.0f;
+    } else if (name == "threshold") {
+        op->type = POINTWISE_THRESHOLD;
+        op->params[0][0] = value.empty() ? 0.5f : number;
+    } else if (name == "swizzle") {
+        static const char kChannels[] = "rgba";
+        op->type = POINTWISE_SWIZZLE;
+        for (uint32_t i = 0; i < 4; i++) {
+            const char* channel = (i < value.size()) ? strchr(kChannels, value[i]) : nullptr;
+            op->params[0][i] = (channel != nullptr && *channel != '\0') ? static_cast<float>(channel - kChannels) : i;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Pass names of a single operation by PointwiseOpType, so the profiler times unfused chains per operation
+static const char* const kPointwisePassNames[] = {
+    "pointwise",          "pointwise color matrix", "pointwise gamma",
+    "pointwise contrast", "pointwise threshold",    "pointwise swizzle",
+};
+
+GraphResource AddPointwiseStage(FilterContext* context, GraphResource input, const std::vector<PointwiseOp>& ops) {
+    ASSERT(!ops.empty() && ops.size() <= VARTIP_POINTWISE_MAX_OPS, "%u pointwise ops in one pass",
+           static_cast<uint32_t>(ops.size()));
+    FilterGraph* graph = context->graph;
+
+    // Specialization constants 0-7 are the operations, 8-15 their first parameter slot, unused ones stay 0
+    KernelSpecialization specialization;
+    std::shared_ptr<std::vector<float>> params =
+        std::make_shared<std::vector<float>>(VARTIP_POINTWISE_PARAM_SLOTS * 4, 0.0f);
+    uint32_t slot = 0;
+    for (uint32_t i = 0; i < ops.size(); i++) {
+        ASSERT(slot + ops[i].slotCount <= VARTIP_POINTWISE_PARAM_SLOTS, "Pointwise parameters don't fit");
+        specialization.Set(i, ops[i].type);
+        specialization.Set(VARTIP_POINTWISE_MAX_OPS + i, slot);
+        memcpy(&(*params)[slot * 4], ops[i].params, ops[i].slotCount * 4 * sizeof(float));
+        slot += ops[i].slotCount;
+    }
+    ComputeKernel* kernel = CreateKernel(context, "shaders/pointwise.comp.spv", kSampledToStorage,
+                                         VARTIP_POINTWISE_PARAM_SLOTS * 4 * sizeof(float), specialization);
+
+    VkExtent2D extent = graph->GetExtent(input);
+    GraphResource output =
+        graph->CreateTransientImage("pointwise", VK_FORMAT_R8G8B8A8_UNORM, extent.width, extent.height);
+    std::shared_ptr<VkDescriptorSet> set = std::make_shared<VkDescriptorSet>(VK_NULL_HANDLE);
+    graph->AddPass(
+        ops.size() > 1 ? "pointwise fused" : kPointwisePassNames[ops[0].type], {input}, {output},
+        [kernel, set, input, output](FilterGraph* graph) {
+            *set = kernel->AllocateSet();
+            kernel->UpdateSampledImage(*set, 0, graph->GetSampler(VK_FILTER_NEAREST), graph->GetImageView(input));
+            kernel->UpdateStorageImage(*set, 1, graph->GetImageView(output));
+        },
+        [kernel, set, params, graph, output](VkCommandBuffer cmdBuffer) {
+            VkExtent2D extent = graph->GetExtent(output);
+            kernel->Dispatch(cmdBuffer, *set, params->data(), extent.width, extent.height);
+        });
+    return output;
+}
+
+// Pointwise filters work on the color image so they come before the ones working on luma. Consecutive ones are
+// collected and become a single pass when fusing
+FilterChainOutputs BuildFilterChain(FilterContext* context, GraphResource camera, const char* filterList) {
+    FilterChainOutputs outputs = {
+        .image = VARTIP_GRAPH_NO_RESOURCE,
+        .lut = VARTIP_GRAPH_NO_RESOURCE,
+        .histogram = VARTIP_GRAPH_NO_RESOURCE,
+        .flowPoints = VARTIP_GRAPH_NO_RESOURCE,
+        .keypoints = VARTIP_GRAPH_NO_RESOURCE,
+    };
+    GraphResource color = camera;
+    GraphResource luma = VARTIP_GRAPH_NO_RESOURCE;
+    GraphResource edges = VARTIP_GRAPH_NO_RESOURCE;
+    bool overlayEdges = false;
+    GraphResource pyramidLevel = VARTIP_GRAPH_NO_RESOURCE;
+    GraphResource motion = VARTIP_GRAPH_NO_RESOURCE;
+    bool overlayMotion = false;
+    std::vector<PointwiseOp> pending;
+    uint32_t pendingSlots = 0;
+
+    std::string list = filterList;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) end = list.size();
+        std::string name = list.substr(start, end - start);
+        start = end + 1;
+        if (name.empty()) {
+            continue;
+        }
+        std::string value;
+        size_t equals = name.find('=');
+        if (equals != std::string::npos) {
+            value = name.substr(equals + 1);
+            name = name.substr(0, equals);
+        }
+
+        PointwiseOp op;
+        if (ParsePointwiseOp(name, value, &op)) {
+            if (luma != VARTIP_GRAPH_NO_RESOURCE) {
+                LOGW("%s works on color, it has to come before the luma filters", name.c_str());
+                continue;
+            }
+            bool full = pending.size() == VARTIP_POINTWISE_MAX_OPS ||
+                        pendingSlots + op.slotCount > VARTIP_POINTWISE_PARAM_SLOTS;
+            if (!pending.empty() && (full || !context->fusePointwise)) {
+                color = AddPointwiseStage(context, color, pending);
+                pending.clear();
+                pendingSlots = 0;
+            }
+            pending.push_back(op);
+            pendingSlots += op.slotCount;
+            continue;
+        }
+
+        if (!pending.empty()) {
+            color = AddPointwiseStage(context, color, pending);
+            pending.clear();
+            pendingSlots = 0;
+        }
+        if (name == "gray") {
+            if (luma == VARTIP_GRAPH_NO_RESOURCE) luma = AddLumaStage(context, color);
+        } else if (name == "pyramid") {
+            // pyramid=levels:shown, of luma when a luma filter came before, of the color image otherwise
+            uint32_t levels = value.empty() ? 4 : strtoul(value.c_str(), nullptr, 10);
+            size_t colon = value.find(':');
+            uint32_t shown = (colon != std::string::npos) ? strtoul(value.c_str() + colon + 1, nullptr, 10) : 1;
+            GraphResource pyramid = AddPyramidStage(context, luma != VARTIP_GRAPH_NO_RESOURCE ? luma : color, levels);
+            if (pyramid != VARTIP_GRAPH_NO_RESOURCE) {
+                pyramidLevel = AddPyramidLevelStage(context, pyramid, shown);
+            }
+        } else if (name == "flow") {
+            // flow=points:levels, tracked on luma and drawn over the color image
+            uint32_t pointCount = value.empty() ? 1024 : strtoul(value.c_str(), nullptr, 10);
+            size_t colon = value.find(':');
+            uint32_t levels = (colon != std::string::npos) ? strtoul(value.c_str() + colon + 1, nullptr, 10) : 4;
+            if (luma == VARTIP_GRAPH_NO_RESOURCE) luma = AddLumaStage(context, color);
+            outputs.flowPoints = AddOpticalFlowStage(context, luma, pointCount, levels);
+        } else if (name == "fast") {
+            // fast=threshold:perTile, corners of luma drawn over the color image
+            float threshold = value.empty() ? 0.08f : strtof(value.c_str(), nullptr);
+            size_t colon = value.find(':');
+            uint32_t perTile = (colon != std::string::npos) ? strtoul(value.c_str() + colon + 1, nullptr, 10) : 8;
+            if (luma == VARTIP_GRAPH_NO_RESOURCE) luma = AddLumaStage(context, color);
+            outputs.keypoints = AddFastStage(context, luma, threshold, perTile);
+        } else if (name == "motion" || name == "foreground") {
+            // motion=rate:threshold:radius tints the moving pixels of the color image, foreground shows only the mask
+            float rate = value.empty() ? 0.05f : strtof(value.c_str(), nullptr);
+            size_t colon = value.find(':');
+            float threshold = (colon != std::string::npos) ? strtof(value.c_str() + colon + 1, nullptr) : 3.0f;
+            size_t second = (colon != std::string::npos) ? value.find(':', colon + 1) : std::string::npos;
+            uint32_t radius = (second != std::string::npos) ? strtoul(value.c_str() + second + 1, nullptr, 10) : 1;
+            if (!(rate > 0.0f && rate <= 1.0f)) {
+                LOGW("%s needs a rate in (0, 1], got %s", name.c_str(), value.c_str());
+                continue;
+            }
+            if (luma == VARTIP_GRAPH_NO_RESOURCE) luma = AddLumaStage(context, color);
+            motion = AddMotionStage(context, luma, rate, threshold, radius);
+            overlayMotion = (name == "motion");
+        } else if (name == "box" || name == "stddev") {
+            // box=radius shows the box mean of luma, stddev=radius its standard deviation, both from the integral image
+            uint32_t radius = value.empty() ? 8 : strtoul(value.c_str(), nullptr, 10);
+            if (luma == VARTIP_GRAPH_NO_RESOURCE) luma = AddLumaStage(context, color);
+            IntegralImages integral = AddIntegralImageStage(context, luma, name == "stddev");
+            luma = AddBoxFilterStage(context, integral, radius, name == "stddev");
+        } else if (name == "size") {
+            // size=WxH resizes the color image, the filters after it work at that size
+            uint32_t width = strtoul(value.c_str(), nullptr, 10);
+            size_t x = value.find('x');
+            uint32_t height = (x != std::string::npos) ? strtoul(value.c_str() + x + 1, nullptr, 10) : 0;
+            if (width == 0 || height == 0) {
+                LOGW("size needs WxH, got %s", value.c_str());
+                continue;
+            }
+            if (luma != VARTIP_GRAPH_NO_RESOURCE) {
+                LOGW("size works on color, it has to come before the luma filters");
+                continue;
+            }
+            color = AddResizeStage(context, color, width, height);
+        } else if (name == "equalize" || name == "autocontrast") {
+            // Applied by the display to whatever it shows, the histogram is of the color image at this point
+            if (outputs.histogram == VARTIP_GRAPH_NO_RESOURCE) outputs.histogram = AddHistogramStage(context, color);
+            float clip = value.empty() ? 0.01f : strtof(value.c_str(), nullptr);
+            outputs.lut = AddHistogramLutStage(
+                context, outputs.histogram, name == "equalize" ? HISTOGRAM_LUT_EQUALIZE : HISTOGRAM_LUT_AUTO_CONTRAST,
+                clip);
+        } else if (name == "canny" || name == "edges") {
+            // canny=low:high draws the edges over the color image, edges=low:high shows only the edges
+            float low = value.empty() ? 0.1f : strtof(value.c_str(), nullptr);
+            size_t colon = value.find(':');
+            float high = (colon != std::string::npos) ? strtof(value.c_str() + colon + 1, nullptr) : 3.0f * low;
+            if (luma == VARTIP_GRAPH_NO_RESOURCE) luma = AddLumaStage(context, color);
+            edges = AddCannyStage(context, luma, low, high);
+            overlayEdges = (name == "canny");
+        } else if (name == "blur") {
+            // blur=sigma or blur=sigma:radius
+            float sigma = value.empty() ? 1.0f : strtof(value.c_str(), nullptr);
+            size_t colon = value.find(':');
+            uint32_t radius = (colon != std::string::npos) ? strtoul(value.c_str() + colon + 1, nullptr, 10) : 0;
+            if (!(sigma > 0.0f)) {
+                LOGW("blur needs a positive sigma, got %s", value.c_str());
+                continue;
+            }
+            if (luma == VARTIP_GRAPH_NO_RESOURCE) luma = AddLumaStage(context, color);
+            luma = AddGaussianBlurStage(context, luma, sigma, radius);
+        } else {
+            LOGW("Unknown filter %s", name.c_str());
+        }
+    }
+    if (!pending.empty()) {
+        color = AddPointwiseStage(context, color, pending);
+    }
+
+    if (pyramidLevel != VARTIP_GRAPH_NO_RESOURCE) {
+        outputs.image = pyramidLevel;
+    } else if (outputs.flowPoints != VARTIP_GRAPH_NO_RESOURCE) {
+        outputs.image = AddFlowOverlayStage(context, color, outputs.flowPoints);
+    } else if (outputs.keypoints != VARTIP_GRAPH_NO_RESOURCE) {
+        outputs.image = AddKeypointOverlayStage(context, color, outputs.keypoints);
+    } else if (motion != VARTIP_GRAPH_NO_RESOURCE) {
+        outputs.image =
+            overlayMotion ? AddMotionOverlayStage(context, color, motion) : AddVisualizeStage(context, motion);
+    } else if (edges != VARTIP_GRAPH_NO_RESOURCE) {
+        outputs.image = overlayEdges ? AddEdgeOverlayStage(context, color, edges) : AddVisualizeStage(context, edges);
+    } else if (luma != VARTIP_GRAPH_NO_RESOURCE) {
+        outputs.image = AddVisualizeStage(context, luma);
+    } else if (color != camera) {
+        outputs.image = color;
+    }
+    return outputs;
+}
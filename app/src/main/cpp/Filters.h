@@ -0,0 +1,258 @@
+#ifndef VARTIP_FILTERS_H_
+#define VARTIP_FILTERS_H_
+
+#include <string>
+#include <vector>
+#include "FilterGraph.h"
+#include "KernelVariantCache.h"
+
+// Comma separated filters to run on the camera frames, in that order, ex) adb shell setprop debug.vartip.filters gray
+#define VARTIP_FILTERS_ENV "VARTIP_FILTERS"
+#define VARTIP_FILTERS_PROPERTY "debug.vartip.filters"
+
+// Set to 0 to run every pointwise filter as its own pass, to compare against the fused pass
+#define VARTIP_FUSE_ENV "VARTIP_FUSE"
+#define VARTIP_FUSE_PROPERTY "debug.vartip.fuse"
+
+// What the filter stages need to create their kernels and declare their passes
+struct FilterContext {
+    const AssetSource* assets;
+    VkPhysicalDevice gpuDevice;  // for the format features
+    VkDevice device;
+    FilterGraph* graph;
+    KernelVariantCache* kernelVariants;  // nullptr gives every kernel a pipeline of its own
+    bool fusePointwise;                  // consecutive pointwise filters become one pass
+};
+
+// Per pixel operations on the color image, values are the operation codes of shaders/pointwise.comp
+enum PointwiseOpType {
+    POINTWISE_NONE = 0,
+    POINTWISE_COLOR_MATRIX = 1,  // 3 slots, one matrix row and offset each
+    POINTWISE_GAMMA = 2,         // x: gamma
+    POINTWISE_CONTRAST = 3,      // x: contrast, y: pivot, z: brightness
+    POINTWISE_THRESHOLD = 4,     // x: luma threshold, the output is black or white
+    POINTWISE_SWIZZLE = 5,       // xyzw: source channel index of each output channel
+};
+
+// A fused pass holds this many operations, and their parameters in this many vec4 push constant slots (128 bytes,
+// the minimum maxPushConstantsSize)
+#define VARTIP_POINTWISE_MAX_OPS 8
+#define VARTIP_POINTWISE_PARAM_SLOTS 8
+
+struct PointwiseOp {
+    PointwiseOpType type;
+    uint32_t slotCount;
+    float params[3][4];
+};
+
+/**
+ * Pointwise filter from its name in the filter list: colormatrix presets sepia and invert, gamma=g, contrast=c,
+ * brightness=b, threshold=t and swizzle=bgra
+ * @return false if name isn't a pointwise filter
+ */
+bool ParsePointwiseOp(const std::string& name, const std::string& value, PointwiseOp* op);
+
+// All the ops in one pass over the color image, the result is RGBA8
+GraphResource AddPointwiseStage(FilterContext* context, GraphResource input, const std::vector<PointwiseOp>& ops);
+
+// Camera RGBA to a R32_SFLOAT luma image, the input of every other filter
+GraphResource AddLumaStage(FilterContext* context, GraphResource input);
+
+/**
+ * Separable Gaussian blur of a single channel image, a horizontal and a vertical pass reading through shared memory
+ * @param radius taps on each side, 0 picks ceil(3 * sigma), clamped to 1..VARTIP_BLUR_MAX_RADIUS
+ */
+GraphResource AddGaussianBlurStage(FilterContext* context, GraphResource input, float sigma, uint32_t radius = 0);
+
+// Rounds of shaders/hysteresis.comp, each one carries the edges at least one 16 pixel tile further
+#define VARTIP_HYSTERESIS_PASSES 4
+
+/**
+ * Canny edges of a luma image: Sobel gradient, non-maximum suppression with the double threshold and hysteresis
+ * @param low, high gradient magnitude thresholds, luma goes from 0 to 1 and the Sobel kernels sum to 4
+ * @return R32_SFLOAT image, 1 on the edges and 0 or 0.5 elsewhere
+ */
+GraphResource AddCannyStage(FilterContext* context, GraphResource input, float low, float high);
+
+// Color image with the edges of AddCannyStage drawn over it, RGBA8
+GraphResource AddEdgeOverlayStage(FilterContext* context, GraphResource color, GraphResource edges);
+
+// Bins of the luma histogram, shaders/histogram.comp and histogram_lut.comp are written for 256
+#define VARTIP_HISTOGRAM_BINS 256
+
+enum HistogramLutMode {
+    HISTOGRAM_LUT_EQUALIZE = 0,
+    HISTOGRAM_LUT_AUTO_CONTRAST = 1,
+};
+
+// Buffer of VARTIP_HISTOGRAM_BINS uint counts of the luma of an RGBA image, cleared and rebuilt every frame
+GraphResource AddHistogramStage(FilterContext* context, GraphResource input);
+
+/**
+ * Curve from the CDF of a histogram, a 256x1 R32_SFLOAT image the display applies to every channel
+ * @param clip auto contrast only, fraction of the pixels allowed to clip on each side
+ */
+GraphResource AddHistogramLutStage(FilterContext* context, GraphResource histogram, HistogramLutMode mode,
+                                   float clip);
+
+// Exposure analytics of a luma histogram
+struct LumaHistogramStats {
+    uint32_t pixelCount;
+    float mean;               // 0 to 1
+    uint32_t lowPercentile;   // bin of the 5th percentile
+    uint32_t highPercentile;  // bin of the 95th percentile
+    float underexposed;       // fraction of the pixels in the first bin
+    float overexposed;        // fraction of the pixels in the last bin
+};
+
+void AnalyzeLumaHistogram(const uint32_t* bins, LumaHistogramStats* stats);
+
+/**
+ * Mip chain of input in one image, level 0 is a copy of input and every level is half the one above. Blits with linear
+ * filtering when the format supports it, otherwise a 2x2 average compute kernel for R32_SFLOAT images
+ * @param levels clamped to what the size allows
+ * @return image with GetMipLevels levels, each one has its own view for the stages downstream, see GetLevelView
+ */
+GraphResource AddPyramidStage(FilterContext* context, GraphResource input, uint32_t levels);
+
+// One level of a pyramid as an RGBA8 image of that level's size, to display it
+GraphResource AddPyramidLevelStage(FilterContext* context, GraphResource pyramid, uint32_t level);
+
+// Points AddOpticalFlowStage can track, and the side of the window each one is matched over (one 8x8 work group)
+#define VARTIP_FLOW_MAX_POINTS 4096
+#define VARTIP_FLOW_WINDOW 8
+// Lucas-Kanade iterations per level, and the smallest eigenvalue of the gradient matrix (per pixel of the window) a
+// point needs to be trackable
+#define VARTIP_FLOW_ITERATIONS 8
+#define VARTIP_FLOW_MIN_EIGENVALUE 1e-4f
+
+enum FlowPointStatus {
+    FLOW_POINT_NONE = 0,     // never placed, the point buffer starts out cleared
+    FLOW_POINT_SEEDED = 1,   // placed on its grid cell this frame, tracked from the next one
+    FLOW_POINT_TRACKED = 2,  // found in this frame, motion is how far it moved since the previous one
+    FLOW_POINT_LOST = 3,     // not trackable (flat window or left the image), placed again next frame
+};
+
+// One point of the buffer shaders/flow.comp updates in place, std430 layout
+struct FlowPoint {
+    float x, y;
+    float dx, dy;
+    uint32_t status;  // FlowPointStatus
+    float error;      // mean absolute luma difference over the window once tracked
+};
+
+/**
+ * Sparse pyramidal Lucas-Kanade optical flow on a luma image. Points start out on a grid, each frame they are tracked
+ * from the previous frame's pyramid to this one's, and the lost ones are placed back on their grid cell
+ * @param pointCount up to VARTIP_FLOW_MAX_POINTS
+ * @param levels pyramid levels the search starts from, the coarsest one is tracked first
+ * @return buffer of pointCount FlowPoint that persists across frames
+ */
+GraphResource AddOpticalFlowStage(FilterContext* context, GraphResource luma, uint32_t pointCount, uint32_t levels);
+
+// Copy of the color image with every flow point and its motion drawn on it, RGBA8
+GraphResource AddFlowOverlayStage(FilterContext* context, GraphResource color, GraphResource points);
+
+// Corners AddFastStage can hand out per frame, the ones found past it are dropped
+#define VARTIP_FAST_MAX_KEYPOINTS 8192
+
+// Keypoint buffer layout of shaders/fast_nms.comp: this header, then the keypoints
+struct KeypointHeader {
+    uint32_t count;  // corners found, can be larger than the buffer holds so min with VARTIP_FAST_MAX_KEYPOINTS
+    uint32_t reserved[3];
+};
+
+struct Keypoint {
+    float x, y;
+    float score;  // sum of how far the brighter or darker arc pixels are past the threshold
+    uint32_t reserved;
+};
+
+/**
+ * FAST-9 corners of a luma image with a 3x3 non-maximum suppression of their score, appended to a buffer through an
+ * atomic counter so only the corners leave the GPU, never a score map
+ * @param threshold luma difference to the center the arc pixels need, luma goes from 0 to 1
+ * @param perTile corners kept in each VARTIP_FAST_TILE_SIZE square tile, the strongest ones, so they spread over the
+ *                image instead of piling up on the most textured part
+ * @return buffer of a KeypointHeader and VARTIP_FAST_MAX_KEYPOINTS Keypoint, rebuilt every frame
+ */
+GraphResource AddFastStage(FilterContext* context, GraphResource luma, float threshold, uint32_t perTile);
+
+// Copy of the color image with the corners of AddFastStage circled, RGBA8
+GraphResource AddKeypointOverlayStage(FilterContext* context, GraphResource color, GraphResource keypoints);
+
+// Images of AddIntegralImageStage, squares is VARTIP_GRAPH_NO_RESOURCE unless asked for
+struct IntegralImages {
+    GraphResource sums;
+    GraphResource squares;
+};
+
+/**
+ * Integral image (summed-area table) of a luma image quantized to 0-255, a scan along the rows then one down the
+ * columns. Each pixel holds the sum of the pixels above and left of it, itself included, so a box of any size sums in
+ * four fetches. R32_UINT, the sums fit up to 4K and the squares wrap around 2^32, which differences of them undo for
+ * boxes of up to 66051 pixels, see VARTIP_BOX_MAX_RADIUS
+ * @param squared also the integral of the squared luma, for variances
+ */
+IntegralImages AddIntegralImageStage(FilterContext* context, GraphResource luma, bool squared);
+
+// Largest radius whose (2r+1)^2 box of squared luma still sums below 2^32
+#define VARTIP_BOX_MAX_RADIUS 127u
+
+/**
+ * Mean or standard deviation of the luma over the (2 * radius + 1) square box around each pixel, from its integral
+ * images so the cost doesn't depend on the radius. The box is cut to the image at the border
+ * @param radius clamped to 1..VARTIP_BOX_MAX_RADIUS
+ * @return R32_SFLOAT image from 0 to 1
+ */
+GraphResource AddBoxFilterStage(FilterContext* context, const IntegralImages& integral, uint32_t radius, bool stddev);
+
+// Color image resized with a linear blit, nearest when the format has no linear blits
+GraphResource AddResizeStage(FilterContext* context, GraphResource input, uint32_t width, uint32_t height);
+
+enum MorphologyOp {
+    MORPHOLOGY_ERODE = 0,
+    MORPHOLOGY_DILATE = 1,
+    MORPHOLOGY_OPEN = 2,   // erode then dilate, removes specks
+    MORPHOLOGY_CLOSE = 3,  // dilate then erode, fills holes
+};
+
+// Morphology of a 0/1 R32_SFLOAT mask with a (2 * radius + 1) square, radius from 1 to VARTIP_MORPHOLOGY_MAX_RADIUS
+#define VARTIP_MORPHOLOGY_MAX_RADIUS 7u
+GraphResource AddMorphologyStage(FilterContext* context, GraphResource mask, MorphologyOp op, uint32_t radius);
+
+// Frames the background model averages evenly before it flags motion, and the variance it never goes below so the
+// noise of flat areas isn't motion, luma goes from 0 to 1
+#define VARTIP_MOTION_WARMUP_FRAMES 16
+#define VARTIP_MOTION_MIN_VARIANCE 1e-4f
+
+/**
+ * Motion mask of luma against a running background model, mean and variance per pixel in a persistent image so the
+ * model stays on the GPU from one frame to the next. The mask is opened then closed to clean it up
+ * @param rate weight of the new frame in the model once warmed up
+ * @param threshold distance to the mean in standard deviations a pixel needs to be in motion
+ * @param radius of the morphology, 0 skips the clean up
+ * @return R32_SFLOAT image, 1 where there is motion and 0 elsewhere
+ */
+GraphResource AddMotionStage(FilterContext* context, GraphResource luma, float rate, float threshold,
+                             uint32_t radius);
+
+// Color image with the motion mask tinted red over it, RGBA8
+GraphResource AddMotionOverlayStage(FilterContext* context, GraphResource color, GraphResource mask);
+
+// Single channel image to RGBA8 for the display
+GraphResource AddVisualizeStage(FilterContext* context, GraphResource input);
+
+// What the display and the CPU read from the graph, VARTIP_GRAPH_NO_RESOURCE for what the filters don't produce
+struct FilterChainOutputs {
+    GraphResource image;       // RGBA8 image the display samples instead of the camera
+    GraphResource lut;         // curve the display applies, see AddHistogramLutStage
+    GraphResource histogram;   // luma histogram for the CPU to read back
+    GraphResource flowPoints;  // tracked points for the CPU to read back, see AddOpticalFlowStage
+    GraphResource keypoints;   // corners for the CPU to read back, see AddFastStage
+};
+
+// Declare the stages named in filterList on top of the camera image, unknown names are skipped with a warning
+FilterChainOutputs BuildFilterChain(FilterContext* context, GraphResource camera, const char* filterList);
+
+#endif  // VARTIP_FILTERS_H_
@@ -0,0 +1,327 @@
+#include "GpuProfiler.h"
+#include <stdio.h>
+#include <string.h>
+#include <cassert>
+#include <string>
+#include "CpuProfiler.h"
+#include "Util.h"
+
+GpuProfiler::GpuProfiler(VkPhysicalDevice gpuDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t slotCount)
+    : m_device(device),
+      m_queryPool(VK_NULL_HANDLE),
+      m_timestampPeriodNs(1.0),
+      m_timestampMask(~0ull),
+      m_currentSlot(0),
+      m_frameNumber(0),
+      m_completedFrames(0),
+      m_droppedFrames(0),
+      m_nameCount(0),
+      m_summaryFrames(0) {
+    m_slots.resize(slotCount);
+    for (uint32_t i = 0; i < slotCount; i++) {
+        m_slots[i].pending = false;
+        m_slots[i].frame.gpuScopeCount = 0;
+    }
+    m_history.reserve(VARTIP_GPU_PROFILER_HISTORY);
+    memset(&m_currentFrame, 0, sizeof(m_currentFrame));
+    memset(m_cpuSummary, 0, sizeof(m_cpuSummary));
+    memset(m_gpuSummary, 0, sizeof(m_gpuSummary));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(gpuDevice, &properties);
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(gpuDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(gpuDevice, &queueFamilyCount, queueFamilyProperties.data());
+
+    uint32_t validBits = queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+    if (validBits == 0 || properties.limits.timestampPeriod == 0.0f) {
+        LOGW("Timestamps are not supported on queue family %u, GPU times won't be available", queueFamilyIndex);
+        return;
+    }
+    m_timestampPeriodNs = properties.limits.timestampPeriod;
+    m_timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = slotCount * VARTIP_GPU_PROFILER_MAX_SCOPES * 2,
+        .pipelineStatistics = 0,
+    };
+    CALL_VK(vkCreateQueryPool(m_device, &queryPoolCreateInfo, nullptr, &m_queryPool));
+}
+
+GpuProfiler::~GpuProfiler() {
+    if (m_queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(m_device, m_queryPool, nullptr);
+    }
+}
+
+void GpuProfiler::BeginCommands(VkCommandBuffer cmdBuffer, uint32_t slot) {
+    SlotInfo& slotInfo = m_slots[slot];
+    if (slotInfo.pending) {
+        // Not collected after its fence wait, whatever is not available now is lost with the reset below
+        if (!CollectSlot(slot)) {
+            slotInfo.pending = false;
+            m_droppedFrames++;
+        }
+    }
+    slotInfo.frame.gpuScopeCount = 0;
+    if (m_queryPool == VK_NULL_HANDLE) {
+        return;
+    }
+    vkCmdResetQueryPool(cmdBuffer, m_queryPool, slot * VARTIP_GPU_PROFILER_MAX_SCOPES * 2,
+                        VARTIP_GPU_PROFILER_MAX_SCOPES * 2);
+}
+
+uint32_t GpuProfiler::BeginScope(VkCommandBuffer cmdBuffer, uint32_t slot, const char* name) {
+    FrameProfile& frame = m_slots[slot].frame;
+    ASSERT(frame.gpuScopeCount < VARTIP_GPU_PROFILER_MAX_SCOPES, "Too many GPU scopes (%s)", name);
+    uint32_t scope = frame.gpuScopeCount++;
+    frame.gpuScopes[scope] = {name, GetNameIndex(name), 0.0, 0.0};
+    if (m_queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool,
+                            (slot * VARTIP_GPU_PROFILER_MAX_SCOPES + scope) * 2);
+    }
+    return scope;
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer cmdBuffer, uint32_t slot, uint32_t scope) {
+    if (m_queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool,
+                            (slot * VARTIP_GPU_PROFILER_MAX_SCOPES + scope) * 2 + 1);
+    }
+}
+
+void GpuProfiler::BeginFrame(void) {
+    m_currentFrame.frameNumber = m_frameNumber++;
+    m_currentFrame.cpuStartMs = GetTimeMs();
+    m_currentFrame.submitMs = m_currentFrame.cpuStartMs;
+    m_currentFrame.gpuMs = 0.0;
+    m_currentFrame.cpuScopeCount = 0;
+    m_currentFrame.gpuScopeCount = 0;
+}
+
+void GpuProfiler::AddCpuScope(const char* name, double startMs, double durationMs) {
+    if (m_currentFrame.cpuScopeCount >= VARTIP_GPU_PROFILER_MAX_SCOPES) {
+        return;
+    }
+    m_currentFrame.cpuScopes[m_currentFrame.cpuScopeCount++] = {name, GetNameIndex(name), startMs, durationMs};
+}
+
+// Names are string literals, the same one is nearly always the same pointer so that is checked before the content
+uint32_t GpuProfiler::GetNameIndex(const char* name) {
+    for (uint32_t i = 0; i < m_nameCount; i++) {
+        if (m_names[i] == name) {
+            return i;
+        }
+    }
+    for (uint32_t i = 0; i < m_nameCount; i++) {
+        if (strcmp(m_names[i], name) == 0) {
+            return i;
+        }
+    }
+    if (m_nameCount == VARTIP_GPU_PROFILER_MAX_NAMES) {
+        return VARTIP_GPU_PROFILER_MAX_NAMES;
+    }
+    m_names[m_nameCount] = name;
+    return m_nameCount++;
+}
+
+void GpuProfiler::SubmitFrame(uint32_t slot) {
+    m_currentSlot = slot;
+    m_currentFrame.submitMs = GetTimeMs();
+}
+
+// The GPU scopes were recorded into the slot's frame already, the CPU side of the frame joins them
+void GpuProfiler::EndFrame(void) {
+    SlotInfo& slotInfo = m_slots[m_currentSlot];
+    FrameProfile& frame = slotInfo.frame;
+    frame.frameNumber = m_currentFrame.frameNumber;
+    frame.cpuStartMs = m_currentFrame.cpuStartMs;
+    frame.submitMs = m_currentFrame.submitMs;
+    frame.gpuMs = 0.0;
+    frame.cpuScopeCount = m_currentFrame.cpuScopeCount;
+    memcpy(frame.cpuScopes, m_currentFrame.cpuScopes, frame.cpuScopeCount * sizeof(ProfileScope));
+    slotInfo.pending = true;
+}
+
+bool GpuProfiler::CollectSlot(uint32_t slot) {
+    SlotInfo& slotInfo = m_slots[slot];
+    if (!slotInfo.pending) {
+        return true;
+    }
+
+    FrameProfile& frame = slotInfo.frame;
+    if (m_queryPool == VK_NULL_HANDLE) {
+        frame.gpuScopeCount = 0;
+    } else if (frame.gpuScopeCount > 0) {
+        uint64_t timestamps[VARTIP_GPU_PROFILER_MAX_SCOPES * 2];
+        VkResult result = vkGetQueryPoolResults(m_device, m_queryPool, slot * VARTIP_GPU_PROFILER_MAX_SCOPES * 2,
+                                                frame.gpuScopeCount * 2, sizeof(timestamps), timestamps,
+                                                sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result == VK_NOT_READY) {
+            return false;
+        }
+        CALL_VK(result);
+
+        uint64_t firstTimestamp = timestamps[0] & m_timestampMask;
+        uint64_t lastTimestamp = timestamps[1] & m_timestampMask;
+        for (uint32_t i = 1; i < frame.gpuScopeCount; i++) {
+            uint64_t begin = timestamps[i * 2] & m_timestampMask;
+            uint64_t end = timestamps[i * 2 + 1] & m_timestampMask;
+            if (begin < firstTimestamp) firstTimestamp = begin;
+            if (end > lastTimestamp) lastTimestamp = end;
+        }
+        for (uint32_t i = 0; i < frame.gpuScopeCount; i++) {
+            uint64_t begin = timestamps[i * 2] & m_timestampMask;
+            uint64_t end = timestamps[i * 2 + 1] & m_timestampMask;
+            frame.gpuScopes[i].startMs = frame.submitMs + (begin - firstTimestamp) * m_timestampPeriodNs / 1e6;
+            frame.gpuScopes[i].durationMs = (end - begin) * m_timestampPeriodNs / 1e6;
+        }
+        frame.gpuMs = (lastTimestamp - firstTimestamp) * m_timestampPeriodNs / 1e6;
+    }
+
+    slotInfo.pending = false;
+    CompleteFrame(frame);
+    return true;
+}
+
+void GpuProfiler::CollectResults(void) {
+    for (;;) {
+        uint32_t oldest = static_cast<uint32_t>(m_slots.size());
+        for (uint32_t slot = 0; slot < m_slots.size(); slot++) {
+            if (m_slots[slot].pending &&
+                (oldest == m_slots.size() || m_slots[slot].frame.frameNumber < m_slots[oldest].frame.frameNumber)) {
+                oldest = slot;
+            }
+        }
+        if (oldest == m_slots.size() || !CollectSlot(oldest)) {
+            return;
+        }
+    }
+}
+
+void GpuProfiler::CompleteFrame(const FrameProfile& frame) {
+    if (m_history.size() < VARTIP_GPU_PROFILER_HISTORY) {
+        m_history.push_back(frame);
+    } else {
+        m_history[m_completedFrames % VARTIP_GPU_PROFILER_HISTORY] = frame;
+    }
+    m_completedFrames++;
+
+    for (uint32_t i = 0; i < frame.cpuScopeCount; i++) {
+        if (frame.cpuScopes[i].nameIndex < VARTIP_GPU_PROFILER_MAX_NAMES) {
+            ScopeSummary& summary = m_cpuSummary[frame.cpuScopes[i].nameIndex];
+            summary.totalMs += frame.cpuScopes[i].durationMs;
+            summary.count++;
+        }
+    }
+    for (uint32_t i = 0; i < frame.gpuScopeCount; i++) {
+        if (frame.gpuScopes[i].nameIndex < VARTIP_GPU_PROFILER_MAX_NAMES) {
+            ScopeSummary& summary = m_gpuSummary[frame.gpuScopes[i].nameIndex];
+            summary.totalMs += frame.gpuScopes[i].durationMs;
+            summary.count++;
+        }
+    }
+
+    if (++m_summaryFrames >= VARTIP_GPU_PROFILER_SUMMARY_FRAMES) {
+        LogSummary();
+    }
+}
+
+const FrameProfile* GpuProfiler::GetLatestFrame(void) {
+    if (m_completedFrames == 0) {
+        return nullptr;
+    }
+    return &m_history[(m_completedFrames - 1) % VARTIP_GPU_PROFILER_HISTORY];
+}
+
+void GpuProfiler::LogSummary(void) {
+    std::string line;
+    char entry[96];
+    for (uint32_t i = 0; i < m_nameCount; i++) {
+        if (m_cpuSummary[i].count > 0) {
+            snprintf(entry, sizeof(entry), " %s %.3f", m_names[i], m_cpuSummary[i].totalMs / m_cpuSummary[i].count);
+            line += entry;
+        }
+    }
+    line += " | GPU";
+    for (uint32_t i = 0; i < m_nameCount; i++) {
+        if (m_gpuSummary[i].count > 0) {
+            snprintf(entry, sizeof(entry), " %s %.3f", m_names[i], m_gpuSummary[i].totalMs / m_gpuSummary[i].count);
+            line += entry;
+        }
+    }
+    LOGI("Profile over %u frames (ms), CPU%s, dropped %llu", m_summaryFrames, line.c_str(),
+         (unsigned long long)m_droppedFrames);
+
+    memset(m_cpuSummary, 0, sizeof(m_cpuSummary));
+    memset(m_gpuSummary, 0, sizeof(m_gpuSummary));
+    m_summaryFrames = 0;
+}
+
+double GpuProfiler::GetAverageGpuMs(const char* name, uint64_t sinceFrame) {
+    double totalMs = 0.0;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < m_history.size(); i++) {
+        const FrameProfile& frame = m_history[i];
+        if (frame.frameNumber < sinceFrame) continue;
+        for (uint32_t j = 0; j < frame.gpuScopeCount; j++) {
+            if (strcmp(frame.gpuScopes[j].name, name) == 0) {
+                totalMs += frame.gpuScopes[j].durationMs;
+                count++;
+            }
+        }
+    }
+    return count > 0 ? totalMs / count : 0.0;
+}
+
+double GpuProfiler::GetAverageFrameGpuMs(uint64_t sinceFrame) {
+    double totalMs = 0.0;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < m_history.size(); i++) {
+        const FrameProfile& frame = m_history[i];
+        if (frame.frameNumber >= sinceFrame && frame.gpuScopeCount > 0) {
+            totalMs += frame.gpuMs;
+            count++;
+        }
+    }
+    return count > 0 ? totalMs / count : 0.0;
+}
+
+bool GpuProfiler::WriteChromeTrace(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        LOGE("Could not open trace file %s", path);
+        return false;
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}},\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Frames\"}},\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"CPU zones\"}}");
+    for (uint32_t i = 0; i < m_history.size(); i++) {
+        const FrameProfile& frame = m_history[i];
+        for (uint32_t j = 0; j < frame.cpuScopeCount; j++) {
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                    frame.cpuScopes[j].name, frame.cpuScopes[j].startMs * 1000.0,
+                    frame.cpuScopes[j].durationMs * 1000.0);
+        }
+        for (uint32_t j = 0; j < frame.gpuScopeCount; j++) {
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f}",
+                    frame.gpuScopes[j].name, frame.gpuScopes[j].startMs * 1000.0,
+                    frame.gpuScopes[j].durationMs * 1000.0);
+        }
+    }
+    // Zones of every thread on the same steady clock timeline, under the frames
+    uint32_t zoneCount = CpuProfilerWriteTraceEvents(file, 2);
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    LOGI("Wrote %u frames and %u CPU zones of trace to %s", static_cast<uint32_t>(m_history.size()), zoneCount, path);
+    return true;
+}
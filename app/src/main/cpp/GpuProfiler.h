@@ -0,0 +1,133 @@
+#ifndef VARTIP_GPUPROFILER_H_
+#define VARTIP_GPUPROFILER_H_
+
+#include <vulkan_wrapper.h>
+#include <vector>
+
+// Timestamp scopes a command buffer can hold
+#define VARTIP_GPU_PROFILER_MAX_SCOPES 32
+// Frames kept for the trace dump
+#define VARTIP_GPU_PROFILER_HISTORY 512
+// Frames averaged in the rolling summary
+#define VARTIP_GPU_PROFILER_SUMMARY_FRAMES 120
+// Distinct scope names summarized, CPU and GPU ones together
+#define VARTIP_GPU_PROFILER_MAX_NAMES 96
+
+// Trace file is written on teardown when set, ex) adb shell setprop debug.vartip.trace 1
+#define VARTIP_TRACE_ENV "VARTIP_TRACE"
+#define VARTIP_TRACE_PROPERTY "debug.vartip.trace"
+
+struct ProfileScope {
+    const char* name;    // only the pointer is kept, it has to outlive the profiler
+    uint32_t nameIndex;  // of name in the profiler's name table, VARTIP_GPU_PROFILER_MAX_NAMES when it was full
+    double startMs;      // GetTimeMs() timeline, GPU scopes are aligned to the submit time
+    double durationMs;
+};
+
+// Everything measured about one frame, the GPU part completes a few frames after the CPU part
+struct FrameProfile {
+    uint64_t frameNumber;
+    double cpuStartMs;
+    double submitMs;
+    double gpuMs;  // from the first GPU timestamp of the frame to the last one, 0 without timestamps
+    uint32_t cpuScopeCount;
+    ProfileScope cpuScopes[VARTIP_GPU_PROFILER_MAX_SCOPES];
+    uint32_t gpuScopeCount;
+    ProfileScope gpuScopes[VARTIP_GPU_PROFILER_MAX_SCOPES];
+};
+
+// Per pass GPU timing with timestamp queries. Every command buffer slot owns a range of a query pool which it resets
+// at its start. A slot's results are read by CollectSlot once its fence signaled, before it records again, and are
+// merged with the CPU scopes of the same frame into a FrameProfile
+class GpuProfiler {
+   public:
+    explicit GpuProfiler(VkPhysicalDevice gpuDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t slotCount);
+
+    ~GpuProfiler();
+
+    // Timestamps are optional for graphics queues, everything is a no-op without them
+    bool IsSupported() { return m_queryPool != VK_NULL_HANDLE; }
+
+    /**
+     * Recording side, BeginCommands has to be recorded outside of a render pass, scopes can be anywhere. The scope
+     * names go to the slot's frame, they stay with its timestamps until they are collected
+     * @return scope index to end, scopes of a slot are ended in any order
+     */
+    void BeginCommands(VkCommandBuffer cmdBuffer, uint32_t slot);
+    uint32_t BeginScope(VkCommandBuffer cmdBuffer, uint32_t slot, const char* name);
+    void EndScope(VkCommandBuffer cmdBuffer, uint32_t slot, uint32_t scope);
+
+    // Frame side, CPU scopes go to the frame being built between BeginFrame and EndFrame, SubmitFrame tells which
+    // slot's queries belong to it
+    void BeginFrame(void);
+    void AddCpuScope(const char* name, double startMs, double durationMs);
+    void SubmitFrame(uint32_t slot);
+    void EndFrame(void);
+
+    /**
+     * Reads back the slot's last frame, called once the fence it was submitted with signaled and before the slot
+     * records again. Never waits on the GPU
+     * @return false if its queries were not available yet
+     */
+    bool CollectSlot(uint32_t slot);
+
+    // Collects every submitted slot, oldest frame first, once the GPU is idle
+    void CollectResults(void);
+
+    // Average time per scope over the last VARTIP_GPU_PROFILER_SUMMARY_FRAMES completed frames
+    void LogSummary(void);
+
+    // Chrome trace-event JSON of the kept history, open in chrome://tracing or ui.perfetto.dev
+    bool WriteChromeTrace(const char* path);
+
+    // Average duration of the GPU scopes called name in the kept frames numbered sinceFrame or later, 0 if none
+    double GetAverageGpuMs(const char* name, uint64_t sinceFrame);
+
+    // Average FrameProfile::gpuMs of the kept frames numbered sinceFrame or later that have GPU times, 0 if none
+    double GetAverageFrameGpuMs(uint64_t sinceFrame);
+
+    // Most recently completed frame, nullptr before the first one. Overwritten as more frames complete
+    const FrameProfile* GetLatestFrame(void);
+
+    uint64_t GetCompletedFrameCount() { return m_completedFrames; }
+    // Frames whose GPU times were lost, their slot recorded again before they were collected
+    uint64_t GetDroppedFrameCount() { return m_droppedFrames; }
+    uint64_t GetFrameNumber() { return m_frameNumber; }
+
+   private:
+    struct SlotInfo {
+        bool pending;        // submitted and not collected yet
+        FrameProfile frame;  // GPU scopes are named while recording, timed when collected
+    };
+
+    struct ScopeSummary {
+        double totalMs;
+        uint32_t count;
+    };
+
+    // Index of name in m_names, added if it is new
+    uint32_t GetNameIndex(const char* name);
+    void CompleteFrame(const FrameProfile& frame);
+
+    VkDevice m_device;
+    VkQueryPool m_queryPool;
+    double m_timestampPeriodNs;
+    uint64_t m_timestampMask;
+
+    std::vector<SlotInfo> m_slots;
+    FrameProfile m_currentFrame;
+    uint32_t m_currentSlot;
+    uint64_t m_frameNumber;
+    uint64_t m_completedFrames;
+    uint64_t m_droppedFrames;
+
+    std::vector<FrameProfile> m_history;  // ring of VARTIP_GPU_PROFILER_HISTORY
+    // Summaries are indexed by the scopes' nameIndex so adding a frame to them doesn't look anything up
+    const char* m_names[VARTIP_GPU_PROFILER_MAX_NAMES];
+    uint32_t m_nameCount;
+    ScopeSummary m_cpuSummary[VARTIP_GPU_PROFILER_MAX_NAMES];
+    ScopeSummary m_gpuSummary[VARTIP_GPU_PROFILER_MAX_NAMES];
+    uint32_t m_summaryFrames;
+};
+
+#endif  // VARTIP_GPUPROFILER_H_
@@ -1,6 +1,7 @@
 #include "ImageReader.h"
 #include <stdlib.h>
 #include <string>
+#include "CpuProfiler.h"
 #include "Util.h"
 
 // Max buffers in this ImageReader.
@@ -16,7 +17,12 @@ void OnImageCallback(void* ctx, AImageReader* reader) { reinterpret_cast<ImageRe
 
 // TODO m_imageHeight and m_imageWidth are not used at
 ImageReader::ImageReader(ImageFormat* res, enum AIMAGE_FORMATS format)
-    : m_pReader(nullptr), m_presentRotation(0), m_imageHeight(res->height), m_imageWidth(res->width), m_bufferCount(0) {
+    : m_pReader(nullptr),
+      m_presentRotation(0),
+      m_conversionStep(1),
+      m_imageHeight(res->height),
+      m_imageWidth(res->width),
+      m_bufferCount(0) {
     media_status_t status = AImageReader_new(res->width, res->height, format, MAX_BUF_COUNT, &m_pReader);
     ASSERT(m_pReader && status == AMEDIA_OK, "Failed to create AImageReader");
 
@@ -45,6 +51,7 @@ void ImageReader::ImageCallback(AImageReader* reader) {
     if (m_bufferCount < MAX_BUF_COUNT) {
         m_bufferCount++;
     }
+    m_frameEvent.Post();
     //  int32_t format;
     //  media_status_t status = AImageReader_getFormat(reader, &format);
     //  ASSERT(status == AMEDIA_OK, "Failed to get the media format");
@@ -178,6 +185,7 @@ static inline uint32_t YUV2RGB(int nY, int nU, int nV) {
  *            it will be deleted via {@link AImage_delete}
  */
 bool ImageReader::DisplayImage(uint32_t* buf, AImage* image) {
+    VARTIP_CPU_ZONE("DisplayImage");
     if (image == nullptr) {
         LOGE("AIamge is soooo null boi");
         return false;
@@ -193,6 +201,12 @@ bool ImageReader::DisplayImage(uint32_t* buf, AImage* image) {
     AImage_getNumberOfPlanes(image, &srcPlanes);
     ASSERT(srcPlanes == 3, "Is not 3 planes");
 
+    if (m_conversionStep > 1) {
+        PresentImageSubsampled(buf, image);
+        AImage_delete(image);
+        return true;
+    }
+
     switch (m_presentRotation) {
         case 0:
             PresentImage(buf, image);
@@ -364,4 +378,58 @@ void ImageReader::PresentImage270(uint32_t* buf, AImage* image) {
     }
 }
 
+// Where PresentImage, PresentImage90, PresentImage180 and PresentImage270 write the pixel (x, y) of a width x height
+// image, with rows stride pixels apart. They all use the source width as the stride
+static inline int32_t PresentIndex(int32_t rotation, int32_t x, int32_t y, int32_t width, int32_t height,
+                                   int32_t stride) {
+    switch (rotation) {
+        case 90:
+            return (height - 1 - y) + x * stride;
+        case 180:
+            return (height - 1 - y) * stride + width - 1 - x;
+        case 270:
+            return y + (width - 1 - x) * stride;
+        default:
+            return y * stride + x;
+    }
+}
+
+// Converting YUV to RGB at a fraction of the resolution, in any of the rotations
+// The top left pixel of every m_conversionStep block becomes one pixel of an image m_conversionStep times smaller each
+// way, written with the same row stride as the full resolution one
+void ImageReader::PresentImageSubsampled(uint32_t* buf, AImage* image) {
+    AImageCropRect srcRect;
+    AImage_getCropRect(image, &srcRect);
+
+    AImage_getPlaneRowStride(image, 0, &m_yStride);
+    AImage_getPlaneRowStride(image, 1, &m_uvStride);
+    m_pyPixel = m_pImageBuffer;
+    AImage_getPlaneData(image, 0, &m_pyPixel, &m_yLen);
+    m_pvPixel = m_pImageBuffer + m_yLen;
+    AImage_getPlaneData(image, 1, &m_pvPixel, &m_vLen);
+    m_puPixel = m_pImageBuffer + m_yLen + m_vLen;
+    AImage_getPlaneData(image, 2, &m_puPixel, &m_uLen);
+    AImage_getPlanePixelStride(image, 1, &m_uvPixelStride);
+
+    int32_t height = srcRect.bottom - srcRect.top;
+    int32_t width = srcRect.right - srcRect.left;
+    int32_t step = m_conversionStep;
+    int32_t outWidth = (width + step - 1) / step;
+    int32_t outHeight = (height + step - 1) / step;
+
+    for (int32_t y = 0, outY = 0; y < height; y += step, outY++) {
+        const uint8_t* pY = m_pyPixel + m_yStride * (y + srcRect.top) + srcRect.left;
+
+        int32_t uv_row_start = m_uvStride * ((y + srcRect.top) >> 1);
+        const uint8_t* pU = m_puPixel + uv_row_start + (srcRect.left >> 1);
+        const uint8_t* pV = m_pvPixel + uv_row_start + (srcRect.left >> 1);
+
+        for (int32_t x = 0, outX = 0; x < width; x += step, outX++) {
+            const int32_t uv_offset = (x >> 1) * m_uvPixelStride;
+            buf[PresentIndex(m_presentRotation, outX, outY, outWidth, outHeight, width)] =
+                YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
+        }
+    }
+}
+
 void ImageReader::SetPresentRotation(int32_t angle) { m_presentRotation = angle; }
@@ -1,6 +1,8 @@
 #ifndef VARTIP_IMAGEREADER_H_
 #define VARTIP_IMAGEREADER_H_
 #include <media/NdkImageReader.h>
+#include <atomic>
+#include "EventLoop.h"
 #include "Util.h"
 
 class ImageReader {
@@ -62,20 +64,32 @@ class ImageReader {
      */
     void SetPresentRotation(int32_t angle);
 
-    uint8_t GetBufferCount() { return m_bufferCount; }
-    void DecBufferCount() { m_bufferCount--; }
+    /**
+     * Convert only one pixel of every step x step block, 1 converts every pixel. The image comes out step times
+     * smaller each way in the top left of the buffer, its rows as far apart as at full resolution. Trades resolution
+     * for conversion and upload time
+     */
+    void SetConversionStep(int32_t step) { m_conversionStep = step; }
+
+    // Posted from the image callback for every frame the camera delivers
+    FrameEvent* GetFrameEvent() { return &m_frameEvent; }
+
+    // Images that arrived since the last call, GetLatestImage takes all of them at once so the count starts over
+    uint32_t TakeBufferCount() { return m_bufferCount.exchange(0); }
     // void SetImageVk(_vkCallback onImageVk) { m_onImageVk = onImageVk; }
 
    private:
     //_vkCallback m_onImageVk;
 
     int32_t m_presentRotation;
+    int32_t m_conversionStep;
     AImageReader* m_pReader;
 
     void PresentImage(uint32_t* buf, AImage* image);
     void PresentImage90(uint32_t* buf, AImage* image);
     void PresentImage180(uint32_t* buf, AImage* image);
     void PresentImage270(uint32_t* buf, AImage* image);
+    void PresentImageSubsampled(uint32_t* buf, AImage* image);
 
     void WriteFile(AImage* image);
 
@@ -89,7 +103,8 @@ class ImageReader {
     int32_t m_yLen, m_uLen, m_vLen;
     int32_t m_uvPixelStride;
 
-    uint8_t m_bufferCount;
+    std::atomic<uint32_t> m_bufferCount;  // written by the image callback's thread
+    FrameEvent m_frameEvent;
 };
 
 #endif  // VARTIP_IMAGEREADER_H_
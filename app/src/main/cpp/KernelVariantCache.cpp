@@ -0,0 +1,118 @@
+#include "KernelVariantCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "Util.h"
+
+KernelSpecialization& KernelSpecialization::Set(uint32_t constantId, uint32_t value) {
+    for (uint32_t i = 0; i < m_entries.size(); i++) {
+        if (m_entries[i].constantID == constantId) {
+            m_data[i] = value;
+            return *this;
+        }
+    }
+    m_entries.push_back({
+        .constantID = constantId,
+        .offset = static_cast<uint32_t>(m_data.size() * sizeof(uint32_t)),
+        .size = sizeof(uint32_t),
+    });
+    m_data.push_back(value);
+    return *this;
+}
+
+KernelSpecialization& KernelSpecialization::SetFloat(uint32_t constantId, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return Set(constantId, bits);
+}
+
+VkSpecializationInfo KernelSpecialization::GetInfo(void) const {
+    return {
+        .mapEntryCount = static_cast<uint32_t>(m_entries.size()),
+        .pMapEntries = m_entries.data(),
+        .dataSize = m_data.size() * sizeof(uint32_t),
+        .pData = m_data.data(),
+    };
+}
+
+std::string KernelSpecialization::GetKey(void) const {
+    std::vector<std::pair<uint32_t, uint32_t>> constants(m_entries.size());
+    for (uint32_t i = 0; i < m_entries.size(); i++) {
+        constants[i] = std::make_pair(m_entries[i].constantID, m_data[i]);
+    }
+    std::sort(constants.begin(), constants.end());
+    std::string key;
+    char constant[32];
+    for (uint32_t i = 0; i < constants.size(); i++) {
+        snprintf(constant, sizeof(constant), "%s%u=%u", i > 0 ? " " : "", constants[i].first, constants[i].second);
+        key += constant;
+    }
+    return key;
+}
+
+KernelVariantCache::KernelVariantCache(ShaderModuleCache* modules, VkDevice device)
+    : m_modules(modules), m_device(device), m_stats() {
+    VkPipelineCacheCreateInfo cacheCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .initialDataSize = 0,
+        .pInitialData = nullptr,
+    };
+    CALL_VK(vkCreatePipelineCache(m_device, &cacheCreateInfo, nullptr, &m_pipelineCache));
+}
+
+KernelVariantCache::~KernelVariantCache() {
+    for (std::map<std::string, ComputePipeline*>::iterator it = m_variants.begin(); it != m_variants.end(); ++it) {
+        DestroyComputePipeline(m_device, it->second);
+        delete it->second;
+    }
+    vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+}
+
+const ComputePipeline* KernelVariantCache::GetVariant(const char* shaderPath,
+                                                      const std::vector<VkDescriptorType>& bindings,
+                                                      uint32_t pushConstantSize,
+                                                      const KernelSpecialization& specialization) {
+    m_stats.requestCount++;
+
+    // The interface is part of the key, a shader can only share its pipeline with kernels binding the same way
+    std::string key = shaderPath;
+    char interface[32];
+    snprintf(interface, sizeof(interface), " push %u bindings", pushConstantSize);
+    key += interface;
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        snprintf(interface, sizeof(interface), " %d", bindings[i]);
+        key += interface;
+    }
+    key += " [" + specialization.GetKey() + "]";
+    std::map<std::string, ComputePipeline*>::iterator it = m_variants.find(key);
+    if (it != m_variants.end()) {
+        return it->second;
+    }
+
+    double createStart = GetTimeMs();
+    VkShaderModule shaderModule = m_modules->GetModule(shaderPath);
+    ASSERT(shaderModule != VK_NULL_HANDLE, "No shader module for %s", shaderPath);
+    ComputePipeline* pipeline = new ComputePipeline();
+    VkSpecializationInfo info = specialization.GetInfo();
+    CreateComputePipeline(m_device, shaderModule, bindings, pushConstantSize,
+                          specialization.IsEmpty() ? nullptr : &info, m_pipelineCache, pipeline);
+    double createMs = GetTimeMs() - createStart;
+    m_variants[key] = pipeline;
+
+    m_stats.variantCount++;
+    m_stats.createMs += createMs;
+    if (createMs > m_stats.slowestMs) {
+        m_stats.slowestMs = createMs;
+        m_stats.slowestShader = shaderPath;
+    }
+    LOGI("Kernel variant %s [%s] created in %.2f ms", shaderPath, specialization.GetKey().c_str(), createMs);
+    return pipeline;
+}
+
+void KernelVariantCache::LogStats(void) {
+    LOGI("Kernel variants: %u created in %.1f ms for %u kernels, slowest %s in %.2f ms", m_stats.variantCount,
+         m_stats.createMs, m_stats.requestCount, m_stats.variantCount > 0 ? m_stats.slowestShader.c_str() : "none",
+         m_stats.slowestMs);
+}
@@ -0,0 +1,67 @@
+#ifndef VARTIP_KERNELVARIANTCACHE_H_
+#define VARTIP_KERNELVARIANTCACHE_H_
+
+#include <vulkan_wrapper.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "ComputeKernel.h"
+#include "CreateShaderModule.h"
+
+// Specialization constants picking a variant of a shader, each of them 32 bits like the uint, int, bool and float
+// constants of the shaders
+class KernelSpecialization {
+   public:
+    // Setting a constant again replaces its value
+    KernelSpecialization& Set(uint32_t constantId, uint32_t value);
+    KernelSpecialization& SetFloat(uint32_t constantId, float value);
+
+    bool IsEmpty(void) const { return m_entries.empty(); }
+
+    // Points into this object, valid until it changes
+    VkSpecializationInfo GetInfo(void) const;
+
+    // Constant ids and values sorted by id, two specializations with the same key build the same pipeline
+    std::string GetKey(void) const;
+
+   private:
+    std::vector<VkSpecializationMapEntry> m_entries;
+    std::vector<uint32_t> m_data;
+};
+
+struct KernelVariantStats {
+    uint32_t variantCount;  // pipelines created
+    uint32_t requestCount;  // variants asked for, all but variantCount of them shared an existing pipeline
+    double createMs;        // creating the pipelines, shader loading included
+    double slowestMs;
+    std::string slowestShader;
+};
+
+// Compute pipelines of every shader and specialization the filters asked for, keyed by the shader, its interface and
+// the constant values. Stages asking for the same variant share its pipeline, and the cache outlives the filter graphs
+// so rebuilding the filters only creates the variants it has not seen yet. Constants bounding loops let the compiler
+// unroll them and drop the branches on them, which is why filters specialize instead of pushing those values.
+// Pipelines are created through a VkPipelineCache so the driver can reuse what variants of a shader have in common
+class KernelVariantCache {
+   public:
+    // The shader modules come from modules, which has to outlive the cache
+    explicit KernelVariantCache(ShaderModuleCache* modules, VkDevice device);
+
+    ~KernelVariantCache();
+
+    // Creates the variant the first time it is asked for, the pipeline lives as long as the cache
+    const ComputePipeline* GetVariant(const char* shaderPath, const std::vector<VkDescriptorType>& bindings,
+                                      uint32_t pushConstantSize, const KernelSpecialization& specialization);
+
+    KernelVariantStats GetStats(void) { return m_stats; }
+    void LogStats(void);
+
+   private:
+    ShaderModuleCache* m_modules;
+    VkDevice m_device;
+    VkPipelineCache m_pipelineCache;
+    std::map<std::string, ComputePipeline*> m_variants;
+    KernelVariantStats m_stats;
+};
+
+#endif  // VARTIP_KERNELVARIANTCACHE_H_
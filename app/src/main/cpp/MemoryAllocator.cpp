@@ -0,0 +1,311 @@
+#include "MemoryAllocator.h"
+#include <cassert>
+#include "Util.h"
+
+static inline VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+MemoryAllocator::MemoryAllocator(VkPhysicalDevice gpuDevice, VkDevice device, VkDeviceSize blockSize)
+    : m_device(device), m_blockSize(blockSize), m_deviceAllocationCount(0) {
+    vkGetPhysicalDeviceMemoryProperties(gpuDevice, &m_memoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(gpuDevice, &properties);
+    m_bufferImageGranularity = properties.limits.bufferImageGranularity;
+    m_maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+}
+
+MemoryAllocator::~MemoryAllocator() {
+    for (uint32_t i = 0; i < m_blocks.size(); i++) {
+        if (m_blocks[i].memory == VK_NULL_HANDLE) {
+            continue;
+        }
+        if (m_blocks[i].allocationCount != 0) {
+            LOGW("Memory block %u freed with %u live allocations", i, m_blocks[i].allocationCount);
+        }
+        if (m_blocks[i].mappedData != nullptr) {
+            vkUnmapMemory(m_device, m_blocks[i].memory);
+        }
+        vkFreeMemory(m_device, m_blocks[i].memory, nullptr);
+    }
+    m_blocks.clear();
+}
+
+// Memory type is an index into the array of 32 entries; or the bit index for the memory type (each BIT of an 32 bit
+// integer is a type)
+bool MemoryAllocator::FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t* typeIndex) {
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) == 0) {
+            continue;
+        }
+        if ((m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            *typeIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MemoryAllocator::AllocateBlock(uint32_t typeIndex, VkDeviceSize size, bool dedicated, uint32_t* blockIndex) {
+    if (m_deviceAllocationCount >= m_maxAllocationCount) {
+        LOGE("maxMemoryAllocationCount (%u) reached", m_maxAllocationCount);
+        return false;
+    }
+
+    VkMemoryAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .allocationSize = size,
+        .memoryTypeIndex = typeIndex,
+    };
+    MemoryBlock block{};
+    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+        LOGE("Failed to allocate a %llu byte block of memory type %u", (unsigned long long)size, typeIndex);
+        return false;
+    }
+    m_deviceAllocationCount++;
+
+    block.size = size;
+    block.memoryTypeIndex = typeIndex;
+    block.allocationCount = 0;
+    block.dedicated = dedicated;
+    block.mappedData = nullptr;
+    block.freeRanges.push_back({0, size});
+
+    // Only one mapping per VkDeviceMemory is allowed so map the whole block once
+    if (m_memoryProperties.memoryTypes[typeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        void* data;
+        CALL_VK(vkMapMemory(m_device, block.memory, 0, VK_WHOLE_SIZE, 0, &data));
+        block.mappedData = static_cast<uint8_t*>(data);
+    }
+
+    // Reuse the slot of a released block so block indices stay stable
+    for (uint32_t i = 0; i < m_blocks.size(); i++) {
+        if (m_blocks[i].memory == VK_NULL_HANDLE) {
+            m_blocks[i] = block;
+            *blockIndex = i;
+            return true;
+        }
+    }
+    m_blocks.push_back(block);
+    *blockIndex = static_cast<uint32_t>(m_blocks.size() - 1);
+    return true;
+}
+
+// The slot stays in m_blocks so the indices of the other blocks don't move
+void MemoryAllocator::ReleaseBlock(uint32_t blockIndex) {
+    MemoryBlock& block = m_blocks[blockIndex];
+    if (block.mappedData != nullptr) {
+        vkUnmapMemory(m_device, block.memory);
+    }
+    vkFreeMemory(m_device, block.memory, nullptr);
+    m_deviceAllocationCount--;
+    block.memory = VK_NULL_HANDLE;
+    block.mappedData = nullptr;
+    block.freeRanges.clear();
+}
+
+// First fit, the aligned start can leave a padding range in front which stays in the free list
+bool MemoryAllocator::AllocateFromBlock(uint32_t blockIndex, VkDeviceSize size, VkDeviceSize alignment,
+                                        MemoryAllocation* allocation) {
+    MemoryBlock& block = m_blocks[blockIndex];
+    for (uint32_t i = 0; i < block.freeRanges.size(); i++) {
+        FreeRange range = block.freeRanges[i];
+        VkDeviceSize offset = AlignUp(range.offset, alignment);
+        VkDeviceSize padding = offset - range.offset;
+        if (padding + size > range.size) {
+            continue;
+        }
+
+        VkDeviceSize tail = range.size - padding - size;
+        block.freeRanges.erase(block.freeRanges.begin() + i);
+        if (tail > 0) {
+            block.freeRanges.insert(block.freeRanges.begin() + i, {offset + size, tail});
+        }
+        if (padding > 0) {
+            block.freeRanges.insert(block.freeRanges.begin() + i, {range.offset, padding});
+        }
+        block.allocationCount++;
+
+        allocation->memory = block.memory;
+        allocation->offset = offset;
+        allocation->size = size;
+        allocation->memoryTypeIndex = block.memoryTypeIndex;
+        allocation->blockIndex = blockIndex;
+        allocation->mappedData = (block.mappedData != nullptr) ? block.mappedData + offset : nullptr;
+        return true;
+    }
+    return false;
+}
+
+bool MemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                               MemoryAllocationKind kind, MemoryAllocation* allocation) {
+    uint32_t typeIndex;
+    if (FindMemoryType(requirements.memoryTypeBits, properties, &typeIndex) == false) {
+        LOGE("No memory type for type bits 0x%x with properties 0x%x", requirements.memoryTypeBits, properties);
+        return false;
+    }
+
+    // Optimal images get whole bufferImageGranularity pages so they never share one with a linear resource
+    VkDeviceSize alignment = requirements.alignment;
+    VkDeviceSize size = requirements.size;
+    if (kind == MEMORY_ALLOCATION_KIND_OPTIMAL && m_bufferImageGranularity > 1) {
+        alignment = AlignUp(alignment, m_bufferImageGranularity);
+        size = AlignUp(size, m_bufferImageGranularity);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (size > m_blockSize / 2) {
+        uint32_t blockIndex;
+        if (AllocateBlock(typeIndex, size, true, &blockIndex) == false) {
+            return false;
+        }
+        return AllocateFromBlock(blockIndex, size, alignment, allocation);
+    }
+
+    for (uint32_t i = 0; i < m_blocks.size(); i++) {
+        if (m_blocks[i].memory == VK_NULL_HANDLE || m_blocks[i].dedicated ||
+            m_blocks[i].memoryTypeIndex != typeIndex) {
+            continue;
+        }
+        if (AllocateFromBlock(i, size, alignment, allocation)) {
+            return true;
+        }
+    }
+
+    uint32_t blockIndex;
+    if (AllocateBlock(typeIndex, m_blockSize, false, &blockIndex) == false) {
+        return false;
+    }
+    return AllocateFromBlock(blockIndex, size, alignment, allocation);
+}
+
+void MemoryAllocator::Free(MemoryAllocation* allocation) {
+    if (allocation->memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    assert(allocation->blockIndex < m_blocks.size());
+    MemoryBlock& block = m_blocks[allocation->blockIndex];
+    assert(block.memory == allocation->memory);
+    block.allocationCount--;
+
+    if (block.dedicated) {
+        ReleaseBlock(allocation->blockIndex);
+    } else {
+        // Insert back in offset order and merge with the neighbours
+        FreeRange range = {allocation->offset, allocation->size};
+        uint32_t i = 0;
+        while (i < block.freeRanges.size() && block.freeRanges[i].offset < range.offset) {
+            i++;
+        }
+        block.freeRanges.insert(block.freeRanges.begin() + i, range);
+        if (i + 1 < block.freeRanges.size() &&
+            block.freeRanges[i].offset + block.freeRanges[i].size == block.freeRanges[i + 1].offset) {
+            block.freeRanges[i].size += block.freeRanges[i + 1].size;
+            block.freeRanges.erase(block.freeRanges.begin() + i + 1);
+        }
+        if (i > 0 && block.freeRanges[i - 1].offset + block.freeRanges[i - 1].size == block.freeRanges[i].offset) {
+            block.freeRanges[i - 1].size += block.freeRanges[i].size;
+            block.freeRanges.erase(block.freeRanges.begin() + i);
+        }
+
+        // Keep one empty block around so a rebuild doesn't reallocate right away, anything more goes back to the
+        // driver or a graph that shrinks would hold on to its peak forever. The latest one is kept, it is the memory
+        // type most likely to be asked for again
+        if (block.allocationCount == 0) {
+            for (uint32_t j = 0; j < m_blocks.size(); j++) {
+                if (j != allocation->blockIndex && m_blocks[j].memory != VK_NULL_HANDLE && !m_blocks[j].dedicated &&
+                    m_blocks[j].allocationCount == 0) {
+                    ReleaseBlock(j);
+                }
+            }
+        }
+    }
+
+    allocation->memory = VK_NULL_HANDLE;
+    allocation->mappedData = nullptr;
+}
+
+bool MemoryAllocator::CreateBuffer(const VkBufferCreateInfo* createInfo, VkMemoryPropertyFlags properties,
+                                   VkBuffer* buffer, MemoryAllocation* allocation) {
+    CALL_VK(vkCreateBuffer(m_device, createInfo, nullptr, buffer));
+
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements(m_device, *buffer, &memReqs);
+    if (Allocate(memReqs, properties, MEMORY_ALLOCATION_KIND_LINEAR, allocation) == false) {
+        vkDestroyBuffer(m_device, *buffer, nullptr);
+        *buffer = VK_NULL_HANDLE;
+        return false;
+    }
+    CALL_VK(vkBindBufferMemory(m_device, *buffer, allocation->memory, allocation->offset));
+    return true;
+}
+
+bool MemoryAllocator::CreateImage(const VkImageCreateInfo* createInfo, VkMemoryPropertyFlags properties,
+                                  VkImage* image, MemoryAllocation* allocation) {
+    CALL_VK(vkCreateImage(m_device, createInfo, nullptr, image));
+
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements(m_device, *image, &memReqs);
+    MemoryAllocationKind kind = (createInfo->tiling == VK_IMAGE_TILING_OPTIMAL) ? MEMORY_ALLOCATION_KIND_OPTIMAL
+                                                                                : MEMORY_ALLOCATION_KIND_LINEAR;
+    if (Allocate(memReqs, properties, kind, allocation) == false) {
+        vkDestroyImage(m_device, *image, nullptr);
+        *image = VK_NULL_HANDLE;
+        return false;
+    }
+    CALL_VK(vkBindImageMemory(m_device, *image, allocation->memory, allocation->offset));
+    return true;
+}
+
+void MemoryAllocator::DestroyBuffer(VkBuffer buffer, MemoryAllocation* allocation) {
+    if (buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(m_device, buffer, nullptr);
+    }
+    Free(allocation);
+}
+
+void MemoryAllocator::DestroyImage(VkImage image, MemoryAllocation* allocation) {
+    if (image != VK_NULL_HANDLE) {
+        vkDestroyImage(m_device, image, nullptr);
+    }
+    Free(allocation);
+}
+
+MemoryAllocatorStats MemoryAllocator::GetStats(void) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MemoryAllocatorStats stats{};
+    for (uint32_t i = 0; i < m_blocks.size(); i++) {
+        const MemoryBlock& block = m_blocks[i];
+        if (block.memory == VK_NULL_HANDLE) {
+            continue;
+        }
+        stats.blockCount++;
+        stats.allocationCount += block.allocationCount;
+
+        VkDeviceSize blockFree = 0;
+        for (uint32_t j = 0; j < block.freeRanges.size(); j++) {
+            blockFree += block.freeRanges[j].size;
+            if (block.freeRanges[j].size > stats.largestFreeRange) {
+                stats.largestFreeRange = block.freeRanges[j].size;
+            }
+        }
+        stats.freeBytes += blockFree;
+        stats.usedBytes += block.size - blockFree;
+    }
+    stats.fragmentation =
+        (stats.freeBytes > 0) ? 1.0f - (float)stats.largestFreeRange / (float)stats.freeBytes : 0.0f;
+    return stats;
+}
+
+void MemoryAllocator::LogStats(void) {
+    MemoryAllocatorStats stats = GetStats();
+    LOGI("Memory: %u blocks, %u allocations, %llu KB used, %llu KB free, fragmentation %.2f", stats.blockCount,
+         stats.allocationCount, (unsigned long long)(stats.usedBytes / 1024),
+         (unsigned long long)(stats.freeBytes / 1024), stats.fragmentation);
+}
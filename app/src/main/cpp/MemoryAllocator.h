@@ -0,0 +1,110 @@
+#ifndef VARTIP_MEMORYALLOCATOR_H_
+#define VARTIP_MEMORYALLOCATOR_H_
+
+#include <vulkan_wrapper.h>
+#include <mutex>
+#include <vector>
+
+// Default size of a device memory block, resources bigger than half of it get a dedicated block
+#define VARTIP_MEMORY_BLOCK_SIZE (16 * 1024 * 1024)
+
+// Resources are either linear (buffers, linear tiled images) or optimal tiled images. The two kinds can't share a
+// bufferImageGranularity page so the allocator needs to know which one it is placing
+enum MemoryAllocationKind {
+    MEMORY_ALLOCATION_KIND_LINEAR = 0,
+    MEMORY_ALLOCATION_KIND_OPTIMAL = 1,
+};
+
+// Sub range of a memory block handed out by the allocator
+struct MemoryAllocation {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t memoryTypeIndex;
+    uint32_t blockIndex;
+    void* mappedData;  // already offset, nullptr if the memory type is not host visible
+};
+
+struct MemoryAllocatorStats {
+    uint32_t blockCount;
+    uint32_t allocationCount;
+    VkDeviceSize usedBytes;
+    VkDeviceSize freeBytes;
+    VkDeviceSize largestFreeRange;
+    // 0 when all the free space is one contiguous range, towards 1 when it is scattered in small ranges
+    float fragmentation;
+};
+
+// Block sub-allocator, memory is allocated in large blocks per memory type and resources are placed inside them
+// with a first fit over an offset sorted free list. Host visible blocks are mapped once for their whole lifetime,
+// blocks left empty are freed except for one spare
+class MemoryAllocator {
+   public:
+    explicit MemoryAllocator(VkPhysicalDevice gpuDevice, VkDevice device,
+                             VkDeviceSize blockSize = VARTIP_MEMORY_BLOCK_SIZE);
+
+    ~MemoryAllocator();
+
+    /**
+     * Find the first memory type allowed by typeBits which has all the requested properties
+     * @return false if no memory type matches
+     */
+    bool FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t* typeIndex);
+
+    VkMemoryPropertyFlags GetMemoryProperties(uint32_t typeIndex) {
+        return m_memoryProperties.memoryTypes[typeIndex].propertyFlags;
+    }
+
+    bool Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                  MemoryAllocationKind kind, MemoryAllocation* allocation);
+
+    void Free(MemoryAllocation* allocation);
+
+    /**
+     * Create the buffer/image, allocate memory for it and bind it
+     * @return false if no memory could be found for it, nothing is left created in that case
+     */
+    bool CreateBuffer(const VkBufferCreateInfo* createInfo, VkMemoryPropertyFlags properties, VkBuffer* buffer,
+                      MemoryAllocation* allocation);
+    bool CreateImage(const VkImageCreateInfo* createInfo, VkMemoryPropertyFlags properties, VkImage* image,
+                     MemoryAllocation* allocation);
+
+    void DestroyBuffer(VkBuffer buffer, MemoryAllocation* allocation);
+    void DestroyImage(VkImage image, MemoryAllocation* allocation);
+
+    MemoryAllocatorStats GetStats(void);
+    void LogStats(void);
+
+   private:
+    struct FreeRange {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    struct MemoryBlock {
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+        uint32_t memoryTypeIndex;
+        uint32_t allocationCount;
+        bool dedicated;
+        uint8_t* mappedData;
+        std::vector<FreeRange> freeRanges;  // sorted by offset, neighbours are always merged
+    };
+
+    bool AllocateBlock(uint32_t typeIndex, VkDeviceSize size, bool dedicated, uint32_t* blockIndex);
+    void ReleaseBlock(uint32_t blockIndex);
+    bool AllocateFromBlock(uint32_t blockIndex, VkDeviceSize size, VkDeviceSize alignment,
+                           MemoryAllocation* allocation);
+
+    VkDevice m_device;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties;
+    VkDeviceSize m_blockSize;
+    VkDeviceSize m_bufferImageGranularity;
+    uint32_t m_maxAllocationCount;
+    uint32_t m_deviceAllocationCount;
+
+    std::vector<MemoryBlock> m_blocks;
+    std::mutex m_mutex;
+};
+
+#endif  // VARTIP_MEMORYALLOCATOR_H_
@@ -1,4 +1,57 @@
 #include "NativeCamera.h"
+#include <stdlib.h>
+#include <vector>
+
+// Copies a metadata entry into a table, leaving it empty when the camera does not list it
+static void CopyEntry(const ACameraMetadata* metadata, uint32_t tag, std::vector<int32_t>* table) {
+    ACameraMetadata_const_entry entry;
+    if (ACameraMetadata_getConstEntry(metadata, tag, &entry) == ACAMERA_OK) {
+        table->assign(entry.data.i32, entry.data.i32 + entry.count);
+    }
+}
+
+static void CopyEntry(const ACameraMetadata* metadata, uint32_t tag, std::vector<int64_t>* table) {
+    ACameraMetadata_const_entry entry;
+    if (ACameraMetadata_getConstEntry(metadata, tag, &entry) == ACAMERA_OK) {
+        table->assign(entry.data.i64, entry.data.i64 + entry.count);
+    }
+}
+
+static void CopyEntry(const ACameraMetadata* metadata, uint32_t tag, std::vector<uint8_t>* table) {
+    ACameraMetadata_const_entry entry;
+    if (ACameraMetadata_getConstEntry(metadata, tag, &entry) == ACAMERA_OK) {
+        table->assign(entry.data.u8, entry.data.u8 + entry.count);
+    }
+}
+
+// Builds capture requests of the camera device
+class NdkCaptureRequestWriter : public CaptureRequestWriter {
+   public:
+    explicit NdkCaptureRequestWriter(ACameraDevice* device) : m_device(device), m_request(nullptr) {}
+
+    bool CreateRequest(CaptureTemplate captureTemplate) {
+        ACameraDevice_request_template templateId =
+            (captureTemplate == CAPTURE_TEMPLATE_PREVIEW) ? TEMPLATE_PREVIEW : TEMPLATE_RECORD;
+        return ACameraDevice_createCaptureRequest(m_device, templateId, &m_request) == ACAMERA_OK;
+    }
+    bool SetEntry(uint32_t tag, uint32_t count, const uint8_t* data) {
+        return ACaptureRequest_setEntry_u8(m_request, tag, count, data) == ACAMERA_OK;
+    }
+    bool SetEntry(uint32_t tag, uint32_t count, const int32_t* data) {
+        return ACaptureRequest_setEntry_i32(m_request, tag, count, data) == ACAMERA_OK;
+    }
+    bool SetEntry(uint32_t tag, uint32_t count, const int64_t* data) {
+        return ACaptureRequest_setEntry_i64(m_request, tag, count, data) == ACAMERA_OK;
+    }
+
+    // The caller frees it
+    ACaptureRequest* GetRequest(void) { return m_request; }
+
+   private:
+    ACameraDevice* m_device;
+    ACaptureRequest* m_request;
+};
+
 
 NativeCamera::NativeCamera() {
     ACameraMetadata* cameraMetadata = nullptr;
@@ -18,6 +71,25 @@ NativeCamera::NativeCamera() {
 
     cameraStatus = ACameraManager_getCameraCharacteristics(m_camera_manager, m_selected_camera_id, &cameraMetadata);
     ASSERT(cameraStatus == ACAMERA_OK, "Failed to get camera meta data of ID: %s", m_selected_camera_id);
+    CopyEntry(cameraMetadata, ACAMERA_NOISE_REDUCTION_AVAILABLE_NOISE_REDUCTION_MODES,
+              &m_capabilities.noiseReductionModes);
+    CopyEntry(cameraMetadata, ACAMERA_EDGE_AVAILABLE_EDGE_MODES, &m_capabilities.edgeModes);
+    ACameraMetadata_const_entry entry;
+    m_timestamp_realtime =
+        ACameraMetadata_getConstEntry(cameraMetadata, ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE, &entry) == ACAMERA_OK &&
+        entry.data.u8[0] == ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME;
+    ACameraMetadata_free(cameraMetadata);
+
+    char value[PROP_VALUE_MAX];
+    m_capture_profile = FindCaptureProfile(VARTIP_CAPTURE_PROFILE_DEFAULT);
+    if (GetDebugOption(VARTIP_CAPTURE_PROFILE_ENV, VARTIP_CAPTURE_PROFILE_PROPERTY, value, sizeof(value))) {
+        const CaptureProfile* profile = FindCaptureProfile(value);
+        if (profile != nullptr) {
+            m_capture_profile = profile;
+        } else {
+            LOGW("No capture profile %s, using %s", value, m_capture_profile->name);
+        }
+    }
 
     m_device_state_callbacks.onDisconnected = CameraDeviceOnDisconnected;
     m_device_state_callbacks.onError = CameraDeviceOnError;
@@ -65,77 +137,89 @@ bool NativeCamera::MatchCaptureSizeRequest(ImageFormat* resView, int32_t width,
         disp.Flip();
     }
 
+    char value[PROP_VALUE_MAX];
+    int32_t targetFps = VARTIP_CAMERA_DEFAULT_FPS;
+    if (GetDebugOption(VARTIP_CAMERA_FPS_ENV, VARTIP_CAMERA_FPS_PROPERTY, value, sizeof(value)) && atoi(value) > 0) {
+        targetFps = atoi(value);
+    }
+
     ACameraMetadata* metadata;
     ACameraManager_getCameraCharacteristics(m_camera_manager, m_selected_camera_id, &metadata);
-    ACameraMetadata_const_entry entry;
-    ACameraMetadata_getConstEntry(metadata, ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS, &entry);
-    // format of the data: format, width, height, input?, type int32
-    bool foundIt = false;
-    // max resolution for current gen phones
-    DisplayDimension foundRes(1000, 1000);
-
-    for (int i = 0; i < entry.count; ++i) {
-        int32_t input = entry.data.i32[i * 4 + 3];
-        int32_t format = entry.data.i32[i * 4 + 0];
-
-        if (input != 0) {
-            continue;
-        }
-
-        if (format == AIMAGE_FORMAT_YUV_420_888) {
-            LOGI("--H: %d -- W: %d -- ratio %f", entry.data.i32[i * 4 + 1], entry.data.i32[i * 4 + 2],
-                 (double)entry.data.i32[i * 4 + 1] / (double)entry.data.i32[i * 4 + 2]);
-
-            DisplayDimension res(entry.data.i32[i * 4 + 1], entry.data.i32[i * 4 + 2]);
-            if (!disp.IsSameRatio(res)) continue;
-            if (format == AIMAGE_FORMAT_YUV_420_888 && foundRes > res) {
-                foundIt = true;
-                foundRes = res;
-            }
-        }
-    }
+    CameraStreamTables tables;
+    CopyEntry(metadata, ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS, &tables.streamConfigurations);
+    CopyEntry(metadata, ACAMERA_SCALER_AVAILABLE_MIN_FRAME_DURATIONS, &tables.minFrameDurations);
+    CopyEntry(metadata, ACAMERA_SCALER_AVAILABLE_STALL_DURATIONS, &tables.stallDurations);
+    CopyEntry(metadata, ACAMERA_CONTROL_AE_AVAILABLE_TARGET_FPS_RANGES, &tables.fpsRanges);
+    ACameraMetadata_free(metadata);
+
+    // The camera image is copied into a texture of the requested size, so the request is also the pixel budget
+    CameraStreamRequest request = {
+        .format = AIMAGE_FORMAT_YUV_420_888,
+        .width = disp.GetWidth(),
+        .height = disp.GetHeight(),
+        .pixelBudget = static_cast<int64_t>(width) * height,
+        .targetFps = targetFps,
+    };
+    CameraStreamPlan plan = PlanCameraStream(tables, request);
+    bool foundIt = plan.found && plan.sameRatio;
 
     if (foundIt) {
-        resView->width = foundRes.OrgWidth();
-        resView->height = foundRes.OrgHeight();
+        resView->width = plan.width;
+        resView->height = plan.height;
+        m_stream_plan = plan;
+        LOGI("Camera stream %dx%d, up to %.1f FPS, AE target range [%d, %d] (fixed %d), %.1f MP/s at %d FPS",
+             plan.width, plan.height, plan.maxFps, plan.fpsMin, plan.fpsMax, plan.fixedFps,
+             plan.pixelsPerSecond / 1e6, targetFps);
     } else {
         if (disp.IsPortrait()) {
-            resView->width = 480;
-            resView->height = 720;
+            resView->width = backup_width;
+            resView->height = backup_height;
         } else {
-            resView->width = 720;
-            resView->height = 480;
+            resView->width = backup_height;
+            resView->height = backup_width;
         }
+        LOGW("No %dx%d ratio camera stream within %dx%d, falling back to %dx%d", disp.GetWidth(), disp.GetHeight(),
+             width, height, resView->width, resView->height);
     }
     resView->format = AIMAGE_FORMAT_YUV_420_888;
-    LOGI("--- W -- H -- %d -- %d", resView->width, resView->height);
     return foundIt;
 }
 
 bool NativeCamera::CreateCaptureSession(ANativeWindow* window) {
-    camera_status_t cameraStatus = ACAMERA_OK;
-
     ACaptureSessionOutputContainer_create(&m_capture_session_output_container);
     ANativeWindow_acquire(window);
     ACaptureSessionOutput_create(window, &m_session_output);
     ACaptureSessionOutputContainer_add(m_capture_session_output_container, m_session_output);
     ACameraOutputTarget_create(window, &m_camera_output_target);
 
-    // TEMPLATE_RECORD because rather have post-processing quality for more
-    // accureate CV algo
-    // Frame rate should be good since all image buffers are being done from
-    // native side
-    cameraStatus = ACameraDevice_createCaptureRequest(m_camera_device, TEMPLATE_RECORD, &m_capture_request);
-    ASSERT(cameraStatus == ACAMERA_OK, "Failed to create preview capture request (id: %s)", m_selected_camera_id);
-
-    ACaptureRequest_addTarget(m_capture_request, m_camera_output_target);
-
     m_capture_session_state_callbacks.onReady = CaptureSessionOnReady;
     m_capture_session_state_callbacks.onActive = CaptureSessionOnActive;
     ACameraDevice_createCaptureSession(m_camera_device, m_capture_session_output_container,
                                        &m_capture_session_state_callbacks, &m_capture_session);
 
-    ACameraCaptureSession_setRepeatingRequest(m_capture_session, nullptr, 1, &m_capture_request, nullptr);
+    return SetCaptureProfile(*m_capture_profile);
+}
+
+bool NativeCamera::SetCaptureProfile(const CaptureProfile& profile) {
+    NdkCaptureRequestWriter writer(m_camera_device);
+    bool written = WriteCaptureRequest(profile, m_stream_plan, m_capabilities, &writer);
+    if (!written) {
+        LOGE("Failed to create the %s capture request (id: %s)", profile.name, m_selected_camera_id);
+        if (writer.GetRequest() != nullptr) {
+            ACaptureRequest_free(writer.GetRequest());
+        }
+        return false;
+    }
 
+    // The new request replaces the old one once the frames in flight are done, the session stays
+    if (m_capture_request != nullptr) {
+        ACameraCaptureSession_stopRepeating(m_capture_session);
+        ACaptureRequest_free(m_capture_request);
+    }
+    m_capture_request = writer.GetRequest();
+    m_capture_profile = &profile;
+    ACaptureRequest_addTarget(m_capture_request, m_camera_output_target);
+    ACameraCaptureSession_setRepeatingRequest(m_capture_session, nullptr, 1, &m_capture_request, nullptr);
+    LOGI("Capture profile %s", profile.name);
     return true;
-}
\ No newline at end of file
+}
@@ -5,8 +5,15 @@
 #include <camera/NdkCameraDevice.h>
 #include <camera/NdkCameraManager.h>
 #include <media/NdkImageReader.h>
+#include "CameraStreamPlanner.h"
+#include "CaptureProfile.h"
 #include "Util.h"
 
+// Frame rate the camera stream is planned for, ex) adb shell setprop debug.vartip.camera.fps 60
+#define VARTIP_CAMERA_FPS_ENV "VARTIP_CAMERA_FPS"
+#define VARTIP_CAMERA_FPS_PROPERTY "debug.vartip.camera.fps"
+#define VARTIP_CAMERA_DEFAULT_FPS 30
+
 // TODO - reasonable actions with callbacks
 // Camera Callbacks
 static void CameraDeviceOnDisconnected(void* context, ACameraDevice* device) {
@@ -30,15 +37,23 @@ class NativeCamera {
 
     bool MatchCaptureSizeRequest(ImageFormat* resView, int32_t width, int32_t height);
 
+    // Streams with the capture profile of VARTIP_CAPTURE_PROFILE_ENV, quality if it isn't set
     bool CreateCaptureSession(ANativeWindow* window);
 
+    // Switches the repeating request of the session to profile
+    bool SetCaptureProfile(const CaptureProfile& profile);
+    const CaptureProfile& GetCaptureProfile() { return *m_capture_profile; }
+
+    // Whether image timestamps are on the CLOCK_BOOTTIME timebase, else they only compare with each other
+    bool IsTimestampRealtime() { return m_timestamp_realtime; }
+
     int32_t GetCameraCount() { return m_camera_id_list->numCameras; }
     uint32_t GetOrientation() { return m_camera_orientation; };
 
    private:
     // Camera variables
     ACameraDevice* m_camera_device;
-    ACaptureRequest* m_capture_request;
+    ACaptureRequest* m_capture_request = nullptr;
     ACameraOutputTarget* m_camera_output_target;
     ACaptureSessionOutput* m_session_output;
     ACaptureSessionOutputContainer* m_capture_session_output_container;
@@ -55,6 +70,11 @@ class NativeCamera {
 
     int32_t backup_width = 480;
     int32_t backup_height = 720;
+    // Nothing found leaves the FPS range to the capture template
+    CameraStreamPlan m_stream_plan{};
+    CaptureCapabilities m_capabilities;
+    const CaptureProfile* m_capture_profile;
+    bool m_timestamp_realtime;
 };
 
 #endif  // VARTIP_NATIVECAMERA_H_
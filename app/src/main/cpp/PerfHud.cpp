@@ -0,0 +1,618 @@
+#include "PerfHud.h"
+#include <ctype.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "Util.h"
+
+// 3x5 pixel font, one octal digit per row from the top, its bits are the pixels from the left. The last glyph is a
+// solid block the bars sample
+static const char kFontChars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.:/%-+()=_#";
+static const uint16_t kFontGlyphs[] = {
+    075557, 026227, 071747, 071717, 055711, 074717, 074757, 071122, 075757, 075717,  // 0-9
+    025755, 065656, 034443, 065556, 074647, 074644, 034553, 055755, 072227, 011152,  // A-J
+    055655, 044447, 057755, 065555, 025552, 065644, 025563, 065655, 034216, 072222,  // K-T
+    055557, 055552, 055775, 055255, 055222, 071247,                                  // U-Z
+    000002, 002020, 011244, 051245, 000700, 002720, 012221, 042224, 007070, 000007,  // .:/%-+()=_
+    077777,
+};
+#define VARTIP_HUD_GLYPH_COUNT (sizeof(kFontGlyphs) / sizeof(kFontGlyphs[0]))
+#define VARTIP_HUD_SOLID_GLYPH (VARTIP_HUD_GLYPH_COUNT - 1)
+// Atlas cells are a column wider than the glyphs so neighbours never bleed into each other
+#define VARTIP_HUD_CELL_WIDTH 4
+#define VARTIP_HUD_GLYPH_WIDTH 3
+#define VARTIP_HUD_GLYPH_HEIGHT 5
+
+static inline uint32_t HudColor(uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+PerfHud::PerfHud(VkDevice device, MemoryAllocator* allocator, ShaderModuleCache* modules, VkRenderPass renderPass,
+                 uint32_t slotCount)
+    : m_device(device),
+      m_allocator(allocator),
+      m_atlasUploaded(false),
+      m_slots(slotCount),
+      m_extent({0, 0}),
+      m_scale(1.0f),
+      m_quads(nullptr),
+      m_quadCount(0),
+      m_frameMs(VARTIP_HUD_GRAPH_FRAMES, 0.0),
+      m_lastFrameStartMs(0.0),
+      m_lastProfileFrame(UINT64_MAX),
+      m_windowGpuMs(0.0),
+      m_windowFrames(0),
+      m_stats() {
+    static_assert(sizeof(kFontChars) - 1 == VARTIP_HUD_GLYPH_COUNT, "Every font character needs a glyph");
+    memset(m_glyphs, -1, sizeof(m_glyphs));
+    for (uint32_t i = 0; i < VARTIP_HUD_GLYPH_COUNT; i++) {
+        m_glyphs[static_cast<uint8_t>(kFontChars[i])] = static_cast<int8_t>(i);
+    }
+
+    CreateFontAtlas();
+    CreatePipeline(modules, renderPass);
+
+    // Written by the CPU every frame and read once by the GPU, host coherent so nothing has to be flushed
+    for (uint32_t i = 0; i < slotCount; i++) {
+        VkBufferCreateInfo createInfo{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .size = VARTIP_HUD_MAX_QUADS * sizeof(HudQuad),
+            .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr,
+        };
+        bool allocated = m_allocator->CreateBuffer(
+            &createInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &m_slots[i].buffer, &m_slots[i].memory);
+        ASSERT(allocated, "Failed to allocate the HUD quads");
+        m_slots[i].quadCount = 0;
+    }
+}
+
+PerfHud::~PerfHud() {
+    for (uint32_t i = 0; i < m_slots.size(); i++) {
+        m_allocator->DestroyBuffer(m_slots[i].buffer, &m_slots[i].memory);
+    }
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_setLayout, nullptr);
+    vkDestroySampler(m_device, m_sampler, nullptr);
+    vkDestroyImageView(m_device, m_atlasView, nullptr);
+    m_allocator->DestroyImage(m_atlas, &m_atlasMemory);
+    m_allocator->DestroyBuffer(m_atlasStaging, &m_atlasStagingMemory);
+}
+
+void PerfHud::CreateFontAtlas(void) {
+    // One row of R8 cells, 255 where a glyph has a pixel
+    m_atlasWidth = VARTIP_HUD_GLYPH_COUNT * VARTIP_HUD_CELL_WIDTH;
+    VkBufferCreateInfo stagingCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .size = m_atlasWidth * VARTIP_HUD_GLYPH_HEIGHT,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+    };
+    bool allocated = m_allocator->CreateBuffer(
+        &stagingCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &m_atlasStaging, &m_atlasStagingMemory);
+    ASSERT(allocated, "Failed to allocate the HUD font staging buffer");
+
+    uint8_t* texels = static_cast<uint8_t*>(m_atlasStagingMemory.mappedData);
+    memset(texels, 0, m_atlasWidth * VARTIP_HUD_GLYPH_HEIGHT);
+    for (uint32_t glyph = 0; glyph < VARTIP_HUD_GLYPH_COUNT; glyph++) {
+        for (uint32_t y = 0; y < VARTIP_HUD_GLYPH_HEIGHT; y++) {
+            uint32_t row = (kFontGlyphs[glyph] >> ((VARTIP_HUD_GLYPH_HEIGHT - 1 - y) * 3)) & 7;
+            for (uint32_t x = 0; x < VARTIP_HUD_GLYPH_WIDTH; x++) {
+                if (row & (4 >> x)) {
+                    texels[y * m_atlasWidth + glyph * VARTIP_HUD_CELL_WIDTH + x] = 255;
+                }
+            }
+        }
+    }
+
+    VkImageCreateInfo imageCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8_UNORM,
+        .extent = {m_atlasWidth, VARTIP_HUD_GLYPH_HEIGHT, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    allocated = m_allocator->CreateImage(&imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_atlas,
+                                         &m_atlasMemory);
+    ASSERT(allocated, "Failed to allocate the HUD font atlas");
+
+    VkImageViewCreateInfo viewCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .image = m_atlas,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R8_UNORM,
+        .components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B,
+                       VK_COMPONENT_SWIZZLE_A},
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    CALL_VK(vkCreateImageView(m_device, &viewCreateInfo, nullptr, &m_atlasView));
+
+    // Glyphs are drawn at whole multiples of their size, nearest keeps their pixels sharp
+    VkSamplerCreateInfo samplerCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_NEVER,
+        .minLod = 0.0f,
+        .maxLod = 0.0f,
+        .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+        .unnormalizedCoordinates = VK_FALSE,
+    };
+    CALL_VK(vkCreateSampler(m_device, &samplerCreateInfo, nullptr, &m_sampler));
+}
+
+void PerfHud::CreatePipeline(ShaderModuleCache* modules, VkRenderPass renderPass) {
+    VkDescriptorSetLayoutBinding fontBinding{
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .pImmutableSamplers = nullptr,
+    };
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .bindingCount = 1,
+        .pBindings = &fontBinding,
+    };
+    CALL_VK(vkCreateDescriptorSetLayout(m_device, &setLayoutCreateInfo, nullptr, &m_setLayout));
+
+    // viewportSize of shaders/hud.vert
+    VkPushConstantRange pushConstantRange{
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = 2 * sizeof(float),
+    };
+    VkPipelineLayoutCreateInfo layoutCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .setLayoutCount = 1,
+        .pSetLayouts = &m_setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
+    };
+    CALL_VK(vkCreatePipelineLayout(m_device, &layoutCreateInfo, nullptr, &m_layout));
+
+    VkDescriptorPoolSize poolSize{
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+    };
+    VkDescriptorPoolCreateInfo poolCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize,
+    };
+    CALL_VK(vkCreateDescriptorPool(m_device, &poolCreateInfo, nullptr, &m_descriptorPool));
+    VkDescriptorSetAllocateInfo allocateInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .descriptorPool = m_descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &m_setLayout,
+    };
+    CALL_VK(vkAllocateDescriptorSets(m_device, &allocateInfo, &m_descriptorSet));
+    // The atlas is in this layout by the time the first draw samples it
+    VkDescriptorImageInfo imageInfo{
+        .sampler = m_sampler,
+        .imageView = m_atlasView,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = nullptr,
+        .dstSet = m_descriptorSet,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &imageInfo,
+        .pBufferInfo = nullptr,
+        .pTexelBufferView = nullptr,
+    };
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+
+    VkPipelineShaderStageCreateInfo shaderStages[2]{
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = modules->GetModule("shaders/hud.vert.spv"),
+            .pName = "main",
+            .pSpecializationInfo = nullptr,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = modules->GetModule("shaders/hud.frag.spv"),
+            .pName = "main",
+            .pSpecializationInfo = nullptr,
+        }};
+
+    // One quad per instance, the corners come from the vertex index so only the instances are read
+    VkVertexInputBindingDescription instanceBinding{
+        .binding = 0,
+        .stride = sizeof(HudQuad),
+        .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+    };
+    VkVertexInputAttributeDescription instanceAttributes[3]{
+        {
+            .location = 0,
+            .binding = 0,
+            .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+            .offset = offsetof(HudQuad, x),
+        },
+        {
+            .location = 1,
+            .binding = 0,
+            .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+            .offset = offsetof(HudQuad, u0),
+        },
+        {
+            .location = 2,
+            .binding = 0,
+            .format = VK_FORMAT_R8G8B8A8_UNORM,
+            .offset = offsetof(HudQuad, color),
+        },
+    };
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &instanceBinding,
+        .vertexAttributeDescriptionCount = 3,
+        .pVertexAttributeDescriptions = instanceAttributes,
+    };
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .primitiveRestartEnable = VK_FALSE,
+    };
+
+    // Drawn in the same render pass as the camera quad, with its viewport and scissor
+    VkPipelineViewportStateCreateInfo viewportInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .viewportCount = 1,
+        .pViewports = nullptr,
+        .scissorCount = 1,
+        .pScissors = nullptr,
+    };
+    VkDynamicState dynamicStates[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+    };
+    VkPipelineDynamicStateCreateInfo dynamicInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates,
+    };
+    VkPipelineRasterizationStateCreateInfo rasterInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE,
+        .lineWidth = 1,
+    };
+    VkSampleMask sampleMask = ~0u;
+    VkPipelineMultisampleStateCreateInfo multisampleInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        .sampleShadingEnable = VK_FALSE,
+        .minSampleShading = 0,
+        .pSampleMask = &sampleMask,
+        .alphaToCoverageEnable = VK_FALSE,
+        .alphaToOneEnable = VK_FALSE,
+    };
+
+    // Blended over the camera image by the glyph coverage times the quad alpha
+    VkPipelineColorBlendAttachmentState attachmentState{
+        .blendEnable = VK_TRUE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .alphaBlendOp = VK_BLEND_OP_ADD,
+        .colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+    VkPipelineColorBlendStateCreateInfo colorBlendInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .logicOpEnable = VK_FALSE,
+        .logicOp = VK_LOGIC_OP_COPY,
+        .attachmentCount = 1,
+        .pAttachments = &attachmentState,
+    };
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .stageCount = 2,
+        .pStages = shaderStages,
+        .pVertexInputState = &vertexInputInfo,
+        .pInputAssemblyState = &inputAssemblyInfo,
+        .pTessellationState = nullptr,
+        .pViewportState = &viewportInfo,
+        .pRasterizationState = &rasterInfo,
+        .pMultisampleState = &multisampleInfo,
+        .pDepthStencilState = nullptr,
+        .pColorBlendState = &colorBlendInfo,
+        .pDynamicState = &dynamicInfo,
+        .layout = m_layout,
+        .renderPass = renderPass,
+        .subpass = 0,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = 0,
+    };
+    CALL_VK(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &m_pipeline));
+}
+
+void PerfHud::AddQuad(float x, float y, float width, float height, float u0, float v0, float u1, float v1,
+                      uint32_t color) {
+    if (m_quadCount >= VARTIP_HUD_MAX_QUADS) {
+        return;
+    }
+    // Written in order straight to the mapped buffer, which is likely uncached
+    m_quads[m_quadCount++] = {x, y, width, height, u0, v0, u1, v1, color};
+}
+
+void PerfHud::AddRect(float x, float y, float width, float height, uint32_t color) {
+    // Every texel around the center of the solid glyph is covered
+    float u = (VARTIP_HUD_SOLID_GLYPH * VARTIP_HUD_CELL_WIDTH + 1.5f) / m_atlasWidth;
+    AddQuad(x, y, width, height, u, 0.5f, u, 0.5f, color);
+}
+
+float PerfHud::AddText(float x, float y, uint32_t color, const char* text) {
+    for (const char* c = text; *c != '\0'; c++, x += VARTIP_HUD_CELL_WIDTH * m_scale) {
+        uint8_t character = static_cast<uint8_t>(toupper(static_cast<uint8_t>(*c)));
+        if (character >= sizeof(m_glyphs) || m_glyphs[character] < 0) {
+            continue;
+        }
+        float u0 = static_cast<float>(m_glyphs[character] * VARTIP_HUD_CELL_WIDTH) / m_atlasWidth;
+        float u1 = u0 + static_cast<float>(VARTIP_HUD_GLYPH_WIDTH) / m_atlasWidth;
+        AddQuad(x, y, VARTIP_HUD_GLYPH_WIDTH * m_scale, VARTIP_HUD_GLYPH_HEIGHT * m_scale, u0, 0.0f, u1, 1.0f,
+                color);
+    }
+    return x;
+}
+
+void PerfHud::TrackFrameTime(double frameMs) {
+    uint32_t filled = static_cast<uint32_t>(std::min<uint64_t>(m_stats.frameCount, VARTIP_HUD_GRAPH_FRAMES));
+    if (filled > 0) {
+        double totalMs = 0.0;
+        for (uint32_t i = 0; i < filled; i++) {
+            totalMs += m_frameMs[i];
+        }
+        if (frameMs > totalMs / filled * VARTIP_HUD_DROP_FACTOR) {
+            m_stats.droppedFrames++;
+        }
+    }
+    m_frameMs[m_stats.frameCount % VARTIP_HUD_GRAPH_FRAMES] = frameMs;
+    m_stats.frameCount++;
+}
+
+void PerfHud::TrackHudCost(const FrameProfile& profile) {
+    for (uint32_t i = 0; i < profile.gpuScopeCount; i++) {
+        if (strcmp(profile.gpuScopes[i].name, VARTIP_HUD_SCOPE) != 0) {
+            continue;
+        }
+        m_windowGpuMs += profile.gpuScopes[i].durationMs;
+        if (++m_windowFrames < VARTIP_HUD_GRAPH_FRAMES) {
+            return;
+        }
+
+        m_stats.gpuMs = m_windowGpuMs / m_windowFrames;
+        m_stats.worstGpuMs = std::max(m_stats.worstGpuMs, m_stats.gpuMs);
+        if (m_stats.gpuMs > VARTIP_HUD_BUDGET_MS) {
+            if (m_stats.windowsOverBudget++ == 0) {
+                LOGW("HUD took %.3f ms of GPU time per frame, over its %.1f ms budget", m_stats.gpuMs,
+                     VARTIP_HUD_BUDGET_MS);
+            }
+        }
+        m_windowGpuMs = 0.0;
+        m_windowFrames = 0;
+        return;
+    }
+}
+
+void PerfHud::Update(uint32_t slot, double frameStartMs, const FrameProfile* profile, uint64_t lostProfiles,
+                     VkExtent2D extent) {
+    if (m_lastFrameStartMs > 0.0) {
+        TrackFrameTime(frameStartMs - m_lastFrameStartMs);
+    }
+    m_lastFrameStartMs = frameStartMs;
+    if (profile != nullptr && profile->frameNumber != m_lastProfileFrame) {
+        m_lastProfileFrame = profile->frameNumber;
+        TrackHudCost(*profile);
+    }
+
+    // Font pixels stay whole output pixels, about 240 of them across the screen
+    m_extent = extent;
+    m_scale = static_cast<float>(std::max(2u, std::min(extent.width, extent.height) / 240));
+    m_quads = static_cast<HudQuad*>(m_slots[slot].memory.mappedData);
+    m_quadCount = 0;
+
+    float advance = VARTIP_HUD_CELL_WIDTH * m_scale;
+    float lineHeight = (VARTIP_HUD_GLYPH_HEIGHT + 2) * m_scale;
+    float left = 2 * advance;
+    float y = 2 * advance;
+    // Sized once everything else is placed, it is the first quad so it is drawn below them
+    AddRect(0, 0, 0, 0, HudColor(0, 0, 0, 160));
+
+    uint32_t filled = static_cast<uint32_t>(std::min<uint64_t>(m_stats.frameCount, VARTIP_HUD_GRAPH_FRAMES));
+    double totalMs = 0.0;
+    for (uint32_t i = 0; i < filled; i++) {
+        totalMs += m_frameMs[i];
+    }
+    double averageMs = filled > 0 ? totalMs / filled : 0.0;
+    uint32_t white = HudColor(255, 255, 255, 255);
+    uint32_t grey = HudColor(160, 160, 160, 255);
+    uint32_t green = HudColor(64, 208, 64, 255);
+    uint32_t red = HudColor(240, 64, 64, 255);
+    char line[64];
+    snprintf(line, sizeof(line), "FPS %.1f  FRAME %.2f MS", averageMs > 0.0 ? 1000.0 / averageMs : 0.0, averageMs);
+    AddText(left, y, white, line);
+    y += lineHeight;
+    snprintf(line, sizeof(line), "DROPPED %llu  LOST %llu", (unsigned long long)m_stats.droppedFrames,
+             (unsigned long long)lostProfiles);
+    AddText(left, y, m_stats.droppedFrames > 0 ? red : white, line);
+    y += lineHeight;
+
+    // Frame times from the oldest on the left, scaled to twice the target with a line at the target
+    float graphHeight = 16 * m_scale;
+    float graphBottom = y + graphHeight;
+    for (uint32_t i = 0; i < filled; i++) {
+        uint64_t frame = m_stats.frameCount - filled + i;
+        double frameMs = m_frameMs[frame % VARTIP_HUD_GRAPH_FRAMES];
+        float height = graphHeight * static_cast<float>(std::min(frameMs / (2.0 * VARTIP_HUD_TARGET_MS), 1.0));
+        AddRect(left + i * m_scale, graphBottom - height, m_scale, height,
+                frameMs > VARTIP_HUD_TARGET_MS * VARTIP_HUD_DROP_FACTOR ? red : green);
+    }
+    AddRect(left, y + graphHeight / 2, VARTIP_HUD_GRAPH_FRAMES * m_scale, std::max(1.0f, m_scale / 2),
+            HudColor(255, 208, 64, 160));
+    y = graphBottom + lineHeight / 2;
+
+    // CPU stages on the left, GPU passes on the right, of the latest frame the profiler completed
+    float gpuLeft = left + 20 * advance;
+    float bottom = y;
+    if (profile != nullptr) {
+        AddText(left, y, grey, "CPU MS");
+        AddText(gpuLeft, y, grey, "GPU MS");
+        float cpuY = y + lineHeight;
+        for (uint32_t i = 0; i < profile->cpuScopeCount; i++, cpuY += lineHeight) {
+            snprintf(line, sizeof(line), "%-12.12s%7.3f", profile->cpuScopes[i].name, profile->cpuScopes[i].durationMs);
+            AddText(left, cpuY, white, line);
+        }
+        float gpuY = y + lineHeight;
+        for (uint32_t i = 0; i < profile->gpuScopeCount; i++, gpuY += lineHeight) {
+            snprintf(line, sizeof(line), "%-12.12s%7.3f", profile->gpuScopes[i].name, profile->gpuScopes[i].durationMs);
+            bool hudOverBudget = strcmp(profile->gpuScopes[i].name, VARTIP_HUD_SCOPE) == 0 &&
+                                 profile->gpuScopes[i].durationMs > VARTIP_HUD_BUDGET_MS;
+            AddText(gpuLeft, gpuY, hudOverBudget ? red : white, line);
+        }
+        bottom = std::max(cpuY, gpuY);
+    }
+
+    float right = std::max(left + VARTIP_HUD_GRAPH_FRAMES * m_scale, gpuLeft + 19 * advance);
+    m_quads[0].width = right + advance;
+    m_quads[0].height = bottom + advance;
+    m_slots[slot].quadCount = m_quadCount;
+    m_stats.quadCount = m_quadCount;
+}
+
+void PerfHud::RecordUpload(VkCommandBuffer cmdBuffer) {
+    if (m_atlasUploaded) {
+        return;
+    }
+    m_atlasUploaded = true;
+
+    VkImageMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = m_atlas,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &barrier);
+    VkBufferImageCopy copyRegion{
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .imageOffset = {0, 0, 0},
+        .imageExtent = {m_atlasWidth, VARTIP_HUD_GLYPH_HEIGHT, 1},
+    };
+    vkCmdCopyBufferToImage(cmdBuffer, m_atlasStaging, m_atlas, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+                         nullptr, 0, nullptr, 1, &barrier);
+}
+
+void PerfHud::RecordDraw(VkCommandBuffer cmdBuffer, uint32_t slot) {
+    if (m_slots[slot].quadCount == 0) {
+        return;
+    }
+    float viewportSize[2] = {static_cast<float>(m_extent.width), static_cast<float>(m_extent.height)};
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_layout, 0, 1, &m_descriptorSet, 0, nullptr);
+    vkCmdPushConstants(cmdBuffer, m_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(viewportSize), viewportSize);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &m_slots[slot].buffer, &offset);
+    vkCmdDraw(cmdBuffer, 6, m_slots[slot].quadCount, 0, 0);
+}
+
+void PerfHud::LogStats(void) {
+    LOGI("HUD: %llu frames, %llu dropped, %u quads, GPU %.3f ms/frame (worst %.3f ms), %u windows over the %.1f ms "
+         "budget",
+         (unsigned long long)m_stats.frameCount, (unsigned long long)m_stats.droppedFrames, m_stats.quadCount,
+         m_stats.gpuMs, m_stats.worstGpuMs, m_stats.windowsOverBudget, VARTIP_HUD_BUDGET_MS);
+}
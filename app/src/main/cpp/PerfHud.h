@@ -0,0 +1,124 @@
+#ifndef VARTIP_PERFHUD_H_
+#define VARTIP_PERFHUD_H_
+
+#include <vulkan_wrapper.h>
+#include <vector>
+#include "CreateShaderModule.h"
+#include "GpuProfiler.h"
+#include "MemoryAllocator.h"
+
+// HUD drawn over the camera image when set, ex) adb shell setprop debug.vartip.hud 1
+#define VARTIP_HUD_ENV "VARTIP_HUD"
+#define VARTIP_HUD_PROPERTY "debug.vartip.hud"
+
+// Quads one frame of the HUD can draw, glyphs and bars past it are left out
+#define VARTIP_HUD_MAX_QUADS 2048
+// Frames in the frame time graph, also the window the HUD's own cost is averaged over
+#define VARTIP_HUD_GRAPH_FRAMES 120
+// The graph is scaled to twice this, bars over VARTIP_HUD_DROP_FACTOR times it are drawn as dropped
+#define VARTIP_HUD_TARGET_MS (1000.0 / 60.0)
+// A frame taking this many times the average frame time of the graph counts as dropped
+#define VARTIP_HUD_DROP_FACTOR 1.5
+// GPU time the HUD may take per frame
+#define VARTIP_HUD_BUDGET_MS 0.2
+// Profiler scopes timing the HUD, on the CPU building its quads and on the GPU drawing them
+#define VARTIP_HUD_SCOPE "hud"
+
+// One glyph or bar, an instance of the HUD quad
+struct HudQuad {
+    float x, y, width, height;  // pixels from the top left corner
+    float u0, v0, u1, v1;       // font atlas rect
+    uint32_t color;             // RGBA8, red in the low byte
+};
+
+struct PerfHudStats {
+    uint64_t frameCount;
+    uint64_t droppedFrames;  // frames over VARTIP_HUD_DROP_FACTOR times the average of the graph
+    uint32_t quadCount;      // of the last frame
+    double gpuMs;            // average GPU time of the HUD over the last complete window
+    double worstGpuMs;       // worst window average
+    uint32_t windowsOverBudget;
+};
+
+// Performance overlay drawn by the GPU after the camera quad: FPS, a graph of the frame times, the CPU and GPU time of
+// each profiled stage and the dropped frames. Text comes from a 3x5 pixel font atlas, every glyph and bar is an
+// instance of one quad read from a vertex buffer of the frame slot, so the HUD is a single draw. What it costs the GPU
+// is timed by a profiler scope of its own and checked against VARTIP_HUD_BUDGET_MS
+class PerfHud {
+   public:
+    // The pipeline draws in subpass 0 of renderPass, shaders come from modules
+    explicit PerfHud(VkDevice device, MemoryAllocator* allocator, ShaderModuleCache* modules, VkRenderPass renderPass,
+                     uint32_t slotCount);
+
+    ~PerfHud();
+
+    /**
+     * Writes the quads of the frame recorded into slot, the GPU has to be done with the last frame of the slot
+     * @param frameStartMs GetTimeMs() at the start of the frame, frame times are the intervals between them
+     * @param profile latest completed frame of the profiler, nullptr until there is one
+     * @param lostProfiles frames the profiler lost the GPU times of
+     */
+    void Update(uint32_t slot, double frameStartMs, const FrameProfile* profile, uint64_t lostProfiles,
+                VkExtent2D extent);
+
+    // Copies the font atlas in the first time it is called, has to be recorded outside of the render pass
+    void RecordUpload(VkCommandBuffer cmdBuffer);
+
+    // Draws what Update wrote for slot inside the render pass, the viewport and scissor are left as they are
+    void RecordDraw(VkCommandBuffer cmdBuffer, uint32_t slot);
+
+    PerfHudStats GetStats(void) { return m_stats; }
+    void LogStats(void);
+
+   private:
+    struct Slot {
+        VkBuffer buffer;
+        MemoryAllocation memory;
+        uint32_t quadCount;
+    };
+
+    void CreateFontAtlas(void);
+    void CreatePipeline(ShaderModuleCache* modules, VkRenderPass renderPass);
+
+    void AddQuad(float x, float y, float width, float height, float u0, float v0, float u1, float v1, uint32_t color);
+    void AddRect(float x, float y, float width, float height, uint32_t color);
+    // @return x after the last character
+    float AddText(float x, float y, uint32_t color, const char* text);
+
+    void TrackFrameTime(double frameMs);
+    void TrackHudCost(const FrameProfile& profile);
+
+    VkDevice m_device;
+    MemoryAllocator* m_allocator;
+
+    int8_t m_glyphs[128];  // atlas cell of each character, -1 if the font has none
+    uint32_t m_atlasWidth;
+    VkImage m_atlas;
+    MemoryAllocation m_atlasMemory;
+    VkImageView m_atlasView;
+    VkSampler m_sampler;
+    VkBuffer m_atlasStaging;
+    MemoryAllocation m_atlasStagingMemory;
+    bool m_atlasUploaded;
+
+    VkDescriptorSetLayout m_setLayout;
+    VkDescriptorPool m_descriptorPool;
+    VkDescriptorSet m_descriptorSet;
+    VkPipelineLayout m_layout;
+    VkPipeline m_pipeline;
+
+    std::vector<Slot> m_slots;
+    VkExtent2D m_extent;
+    float m_scale;     // pixels per font pixel
+    HudQuad* m_quads;  // mapped vertex buffer being written
+    uint32_t m_quadCount;
+
+    std::vector<double> m_frameMs;  // ring of VARTIP_HUD_GRAPH_FRAMES
+    double m_lastFrameStartMs;
+    uint64_t m_lastProfileFrame;
+    double m_windowGpuMs;
+    uint32_t m_windowFrames;
+    PerfHudStats m_stats;
+};
+
+#endif  // VARTIP_PERFHUD_H_
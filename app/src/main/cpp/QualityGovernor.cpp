@@ -0,0 +1,157 @@
+#include "QualityGovernor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "Util.h"
+
+// Cheapest first to go: conversion resolution, then pyramid depth, then the filters at the end of the list
+static const QualityLevel kQualityLevels[] = {
+    {1, VARTIP_QUALITY_ALL, VARTIP_QUALITY_ALL},
+    {2, VARTIP_QUALITY_ALL, VARTIP_QUALITY_ALL},
+    {2, VARTIP_QUALITY_ALL, 2},
+    {4, VARTIP_QUALITY_ALL, 2},
+    {4, 2, 2},
+    {4, 1, 1},
+};
+#define VARTIP_QUALITY_LEVEL_COUNT (sizeof(kQualityLevels) / sizeof(kQualityLevels[0]))
+
+QualityGovernor::QualityGovernor(double targetMs)
+    : m_targetMs(targetMs),
+      m_level(0),
+      m_smoothedMs(0.0),
+      m_settleFrames(0),
+      m_overFrames(0),
+      m_underFrames(0),
+      m_backoff(1),
+      m_lastStepUpFrame(0),
+      m_stats() {}
+
+const QualityLevel& QualityGovernor::GetLevel(void) { return kQualityLevels[m_level]; }
+
+uint32_t QualityGovernor::GetLevelCount(void) { return VARTIP_QUALITY_LEVEL_COUNT; }
+
+void QualityGovernor::SetLevel(uint32_t level) {
+    LOGI("Quality level %u -> %u, frames %.2f ms against %.2f ms", m_level, level, m_smoothedMs, m_targetMs);
+    m_level = level;
+    m_stats.lowestLevel = std::max(m_stats.lowestLevel, level);
+    m_smoothedMs = 0.0;
+    m_settleFrames = VARTIP_GOVERNOR_SETTLE_FRAMES;
+    m_overFrames = 0;
+    m_underFrames = 0;
+}
+
+bool QualityGovernor::AddFrame(double workMs) {
+    m_stats.frameCount++;
+    if (m_settleFrames > 0) {
+        m_settleFrames--;
+        return false;
+    }
+    m_smoothedMs = (m_smoothedMs == 0.0) ? workMs
+                                         : m_smoothedMs + (workMs - m_smoothedMs) * VARTIP_GOVERNOR_SMOOTHING;
+
+    // Anything between the two thresholds is fine as it is and starts both counts over
+    if (m_smoothedMs > m_targetMs) {
+        m_overFrames++;
+        m_underFrames = 0;
+    } else if (m_smoothedMs < m_targetMs * VARTIP_GOVERNOR_UP_RATIO) {
+        m_underFrames++;
+        m_overFrames = 0;
+    } else {
+        m_overFrames = 0;
+        m_underFrames = 0;
+    }
+
+    if (m_overFrames >= VARTIP_GOVERNOR_DOWN_FRAMES && m_level + 1 < VARTIP_QUALITY_LEVEL_COUNT) {
+        // Back down soon after going up means the level above does not fit, wait longer before trying it again.
+        // Staying for a while means the load changed, the next step up can be tried at the usual pace
+        if (m_stats.stepUpCount > 0 && m_stats.frameCount - m_lastStepUpFrame < VARTIP_GOVERNOR_BOUNCE_FRAMES) {
+            m_backoff = std::min<uint32_t>(m_backoff * 2, VARTIP_GOVERNOR_MAX_BACKOFF);
+            m_stats.bounceCount++;
+        } else {
+            m_backoff = 1;
+        }
+        m_stats.stepDownCount++;
+        SetLevel(m_level + 1);
+        return true;
+    }
+    if (m_underFrames >= VARTIP_GOVERNOR_UP_FRAMES * m_backoff && m_level > 0) {
+        m_stats.stepUpCount++;
+        m_lastStepUpFrame = m_stats.frameCount;
+        SetLevel(m_level - 1);
+        return true;
+    }
+    return false;
+}
+
+void QualityGovernor::LogStats(void) {
+    LOGI("Quality governor: %llu frames against %.2f ms, level %u of %u (lowest %u), %u down, %u up, %u bounces",
+         (unsigned long long)m_stats.frameCount, m_targetMs, m_level, GetLevelCount() - 1,
+         m_stats.lowestLevel, m_stats.stepDownCount, m_stats.stepUpCount, m_stats.bounceCount);
+}
+
+// Caps the levels field of a "levels:other" or "other:levels" filter value, filling in the default when it is missing
+static std::string CapLevels(const std::string& value, bool levelsFirst, uint32_t defaultLevels, uint32_t maxLevels) {
+    size_t colon = value.find(':');
+    std::string levelsField;
+    std::string other;
+    if (levelsFirst) {
+        levelsField = value.substr(0, colon);
+        other = (colon != std::string::npos) ? value.substr(colon) : "";
+    } else {
+        levelsField = (colon != std::string::npos) ? value.substr(colon + 1) : "";
+        other = value.substr(0, colon);
+    }
+    uint32_t levels = levelsField.empty() ? defaultLevels : strtoul(levelsField.c_str(), nullptr, 10);
+    char capped[16];
+    snprintf(capped, sizeof(capped), "%u", std::min(levels, maxLevels));
+    return levelsFirst ? capped + other : other + ":" + capped;
+}
+
+std::string ApplyQualityLevel(const char* filterList, const QualityLevel& level) {
+    std::vector<std::string> filters;
+    std::string list = filterList;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) end = list.size();
+        std::string filter = list.substr(start, end - start);
+        start = end + 1;
+        if (!filter.empty()) {
+            filters.push_back(filter);
+        }
+    }
+    if (filters.size() > level.maxStages) {
+        filters.resize(level.maxStages);
+    }
+    if (filters.empty()) {
+        return "";
+    }
+
+    // Defaults the same as BuildFilterChain's
+    char size[32];
+    for (uint32_t i = 0; i < filters.size(); i++) {
+        size_t equals = filters[i].find('=');
+        std::string name = filters[i].substr(0, equals);
+        std::string value = (equals != std::string::npos) ? filters[i].substr(equals + 1) : "";
+        if (name == "pyramid" && level.maxPyramidLevels != VARTIP_QUALITY_ALL) {
+            filters[i] = name + "=" + CapLevels(value, true, 4, level.maxPyramidLevels);
+        } else if (name == "flow" && level.maxPyramidLevels != VARTIP_QUALITY_ALL) {
+            filters[i] = name + "=" + CapLevels(value.empty() ? "1024" : value, false, 4, level.maxPyramidLevels);
+        } else if (name == "size" && level.conversionStep > 1) {
+            // Given for the full resolution, scaled down with the camera image
+            uint32_t sizeWidth = strtoul(value.c_str(), nullptr, 10);
+            size_t x = value.find('x');
+            uint32_t sizeHeight = (x != std::string::npos) ? strtoul(value.c_str() + x + 1, nullptr, 10) : 0;
+            snprintf(size, sizeof(size), "size=%ux%u", std::max(1u, sizeWidth / level.conversionStep),
+                     std::max(1u, sizeHeight / level.conversionStep));
+            filters[i] = size;
+        }
+    }
+
+    std::string result;
+    for (uint32_t i = 0; i < filters.size(); i++) {
+        result += (i > 0 ? "," : "") + filters[i];
+    }
+    return result;
+}
@@ -0,0 +1,91 @@
+#ifndef VARTIP_QUALITYGOVERNOR_H_
+#define VARTIP_QUALITYGOVERNOR_H_
+
+#include <stdint.h>
+#include <string>
+
+// Target frame time in ms the governor keeps the frame work under, ex) adb shell setprop debug.vartip.governor 33
+#define VARTIP_GOVERNOR_ENV "VARTIP_GOVERNOR"
+#define VARTIP_GOVERNOR_PROPERTY "debug.vartip.governor"
+
+// Busy work in ms the headless benchmark adds to every frame at full conversion resolution, less at lower ones like a
+// real conversion, to try the governor on a host, ex) VARTIP_CPU_LOAD=40
+#define VARTIP_CPU_LOAD_ENV "VARTIP_CPU_LOAD"
+#define VARTIP_CPU_LOAD_PROPERTY "debug.vartip.cpuload"
+
+// Weight of the latest frame in the smoothed frame time
+#define VARTIP_GOVERNOR_SMOOTHING 0.1
+// Frames the smoothed time has to stay over the target before stepping down
+#define VARTIP_GOVERNOR_DOWN_FRAMES 15
+// Frames it has to stay under VARTIP_GOVERNOR_UP_RATIO of the target before stepping up, times the backoff
+#define VARTIP_GOVERNOR_UP_FRAMES 90
+#define VARTIP_GOVERNOR_UP_RATIO 0.7
+// Frames ignored after a change, they still carry the work of the old level and the rebuild
+#define VARTIP_GOVERNOR_SETTLE_FRAMES 10
+// Stepping back down within this many frames of a step up doubles the frames the next step up waits, up to the
+// maximum backoff, so the governor does not keep bouncing between two levels
+#define VARTIP_GOVERNOR_BOUNCE_FRAMES 240
+#define VARTIP_GOVERNOR_MAX_BACKOFF 8
+
+// Stage and pyramid limits of a level that keep everything
+#define VARTIP_QUALITY_ALL UINT32_MAX
+
+// What a quality level does to the frame work
+struct QualityLevel {
+    uint32_t conversionStep;    // 1 converts every camera pixel, 2 half and 4 a quarter of the resolution each way
+    uint32_t maxStages;         // filters kept from the start of the filter list
+    uint32_t maxPyramidLevels;  // of the pyramid and flow filters
+};
+
+struct QualityGovernorStats {
+    uint64_t frameCount;
+    uint32_t stepDownCount;
+    uint32_t stepUpCount;
+    uint32_t bounceCount;  // step downs right after a step up
+    uint32_t lowestLevel;  // highest level index reached, the lowest quality
+};
+
+// Steps the frame work down when the frames take longer than the target and back up once they have been well under
+// it for a while, from full quality at level 0 to the cheapest at GetLevelCount() - 1. Frames are smoothed and the
+// two directions have their own thresholds and delays so noise or a single slow frame never changes the level.
+// Only looks at frame times so it runs anywhere, applying a level is left to the caller
+class QualityGovernor {
+   public:
+    explicit QualityGovernor(double targetMs);
+
+    /**
+     * Takes the time the last frame's work took, waiting for the next camera frame excluded
+     * @return true when the level changed, the new one applies from the next frame
+     */
+    bool AddFrame(double workMs);
+
+    uint32_t GetLevelIndex(void) { return m_level; }
+    const QualityLevel& GetLevel(void);
+    uint32_t GetLevelCount(void);
+    double GetTargetMs(void) { return m_targetMs; }
+    double GetSmoothedMs(void) { return m_smoothedMs; }
+
+    QualityGovernorStats GetStats(void) { return m_stats; }
+    void LogStats(void);
+
+   private:
+    void SetLevel(uint32_t level);
+
+    double m_targetMs;
+    uint32_t m_level;
+    double m_smoothedMs;  // 0 until the first frame after a change
+    uint32_t m_settleFrames;
+    uint32_t m_overFrames;
+    uint32_t m_underFrames;
+    uint32_t m_backoff;
+    uint64_t m_lastStepUpFrame;
+    QualityGovernorStats m_stats;
+};
+
+/**
+ * The filter list with level applied: filters past maxStages are dropped, pyramid and flow levels are capped and sizes
+ * are divided by the conversion step. The camera image the filters start from is already at the converted size
+ */
+std::string ApplyQualityLevel(const char* filterList, const QualityLevel& level);
+
+#endif  // VARTIP_QUALITYGOVERNOR_H_
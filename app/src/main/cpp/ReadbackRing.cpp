@@ -0,0 +1,202 @@
+#include "ReadbackRing.h"
+#include <algorithm>
+#include "Util.h"
+
+static inline VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+ReadbackRing::ReadbackRing(VkPhysicalDevice gpuDevice, VkDevice device, MemoryAllocator* allocator,
+                           uint32_t slotCount)
+    : m_device(device), m_allocator(allocator), m_slots(slotCount), m_frameCount(0), m_stats() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(gpuDevice, &properties);
+    m_atomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+    for (uint32_t i = 0; i < slotCount; i++) {
+        m_slots[i].pending = false;
+        m_slots[i].frame = 0;
+    }
+}
+
+ReadbackRing::~ReadbackRing() {
+    for (uint32_t i = 0; i < m_slots.size(); i++) {
+        for (uint32_t j = 0; j < m_slots[i].buffers.size(); j++) {
+            m_allocator->DestroyBuffer(m_slots[i].buffers[j].buffer, &m_slots[i].buffers[j].memory);
+        }
+    }
+}
+
+bool ReadbackRing::AllocateBuffer(VkDeviceSize size, HostBuffer* hostBuffer) {
+    VkBufferCreateInfo createInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+    };
+    CALL_VK(vkCreateBuffer(m_device, &createInfo, nullptr, &hostBuffer->buffer));
+
+    // Aligned and sized to whole atoms so invalidating it never touches a neighbour in the same memory block
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(m_device, hostBuffer->buffer, &requirements);
+    requirements.alignment = std::max(requirements.alignment, m_atomSize);
+    requirements.size = AlignUp(requirements.size, m_atomSize);
+    bool allocated = m_allocator->Allocate(requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                             VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                           MEMORY_ALLOCATION_KIND_LINEAR, &hostBuffer->memory);
+    if (!allocated) {
+        allocated = m_allocator->Allocate(
+            requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            MEMORY_ALLOCATION_KIND_LINEAR, &hostBuffer->memory);
+    }
+    if (!allocated) {
+        vkDestroyBuffer(m_device, hostBuffer->buffer, nullptr);
+        hostBuffer->buffer = VK_NULL_HANDLE;
+        return false;
+    }
+    CALL_VK(vkBindBufferMemory(m_device, hostBuffer->buffer, hostBuffer->memory.memory, hostBuffer->memory.offset));
+    hostBuffer->capacity = requirements.size;
+
+    VkMemoryPropertyFlags flags = m_allocator->GetMemoryProperties(hostBuffer->memory.memoryTypeIndex);
+    bool cached = (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
+    bool coherent = (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    if (m_stats.bufferCount == 0) {
+        LOGI("Readback buffers in memory type %u, %s and %s", hostBuffer->memory.memoryTypeIndex,
+             cached ? "cached" : "uncached", coherent ? "coherent" : "invalidated");
+    }
+    hostBuffer->coherent = coherent;
+    m_stats.cached = cached;
+    m_stats.coherent = coherent;
+    m_stats.bufferCount++;
+    m_stats.bufferBytes += hostBuffer->capacity;
+    return true;
+}
+
+ReadbackRing::HostBuffer* ReadbackRing::NextBuffer(uint32_t slot, VkDeviceSize size) {
+    Slot& ring = m_slots[slot];
+    ASSERT(!ring.pending, "Readback slot %u records before its last frame was collected", slot);
+    uint32_t index = static_cast<uint32_t>(ring.requests.size());
+    if (index == ring.buffers.size()) {
+        HostBuffer hostBuffer{.buffer = VK_NULL_HANDLE, .memory = {}, .capacity = 0, .coherent = true};
+        ring.buffers.push_back(hostBuffer);
+    }
+    HostBuffer* hostBuffer = &ring.buffers[index];
+    if (hostBuffer->capacity < size) {
+        // The slot's fence signaled before it records again, nothing uses the old buffer anymore
+        if (hostBuffer->buffer != VK_NULL_HANDLE) {
+            m_stats.bufferCount--;
+            m_stats.bufferBytes -= hostBuffer->capacity;
+            m_allocator->DestroyBuffer(hostBuffer->buffer, &hostBuffer->memory);
+            hostBuffer->buffer = VK_NULL_HANDLE;
+            hostBuffer->capacity = 0;
+        }
+        if (!AllocateBuffer(size, hostBuffer)) {
+            LOGE("No host memory for a %llu byte readback", (unsigned long long)size);
+            return nullptr;
+        }
+    }
+    return hostBuffer;
+}
+
+void ReadbackRing::CopyBuffer(VkCommandBuffer cmdBuffer, uint32_t slot, VkBuffer buffer, VkDeviceSize offset,
+                              VkDeviceSize size, ReadbackCallback callback) {
+    HostBuffer* hostBuffer = NextBuffer(slot, size);
+    if (hostBuffer == nullptr) {
+        return;
+    }
+    VkBufferCopy copyRegion{
+        .srcOffset = offset,
+        .dstOffset = 0,
+        .size = size,
+    };
+    vkCmdCopyBuffer(cmdBuffer, buffer, hostBuffer->buffer, 1, &copyRegion);
+    m_slots[slot].requests.push_back({.size = size, .width = 0, .height = 0, .callback = callback});
+}
+
+void ReadbackRing::CopyImage(VkCommandBuffer cmdBuffer, uint32_t slot, VkImage image, VkImageLayout layout,
+                             uint32_t width, uint32_t height, uint32_t bytesPerPixel, ReadbackCallback callback) {
+    VkDeviceSize size = static_cast<VkDeviceSize>(width) * height * bytesPerPixel;
+    HostBuffer* hostBuffer = NextBuffer(slot, size);
+    if (hostBuffer == nullptr) {
+        return;
+    }
+    VkBufferImageCopy copyRegion{
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .imageOffset = {0, 0, 0},
+        .imageExtent = {width, height, 1},
+    };
+    vkCmdCopyImageToBuffer(cmdBuffer, image, layout, hostBuffer->buffer, 1, &copyRegion);
+    m_slots[slot].requests.push_back({.size = size, .width = width, .height = height, .callback = callback});
+}
+
+void ReadbackRing::EndFrame(VkCommandBuffer cmdBuffer, uint32_t slot) {
+    Slot& ring = m_slots[slot];
+    m_frameCount++;
+    if (ring.requests.empty()) {
+        return;
+    }
+    VkMemoryBarrier hostBarrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+    };
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0,
+                         nullptr, 0, nullptr);
+    ring.pending = true;
+    ring.frame = m_frameCount;
+}
+
+bool ReadbackRing::CollectIfReady(uint32_t slot, VkFence fence) {
+    Slot& ring = m_slots[slot];
+    if (!ring.pending) {
+        return true;
+    }
+    if (vkGetFenceStatus(m_device, fence) != VK_SUCCESS) {
+        return false;
+    }
+
+    // Taken off the slot first so a callback can record or rebuild without seeing them again
+    std::vector<Request> requests;
+    requests.swap(ring.requests);
+    ring.pending = false;
+    for (uint32_t i = 0; i < requests.size(); i++) {
+        const HostBuffer& hostBuffer = ring.buffers[i];
+        if (!hostBuffer.coherent) {
+            VkMappedMemoryRange range{
+                .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+                .pNext = nullptr,
+                .memory = hostBuffer.memory.memory,
+                .offset = hostBuffer.memory.offset,
+                .size = AlignUp(requests[i].size, m_atomSize),
+            };
+            CALL_VK(vkInvalidateMappedMemoryRanges(m_device, 1, &range));
+            m_stats.invalidateCount++;
+        }
+        ReadbackResult result{
+            .data = hostBuffer.memory.mappedData,
+            .size = requests[i].size,
+            .width = requests[i].width,
+            .height = requests[i].height,
+            .frame = ring.frame,
+        };
+        requests[i].callback(result);
+        m_stats.deliveredCount++;
+        m_stats.deliveredBytes += requests[i].size;
+    }
+    return true;
+}
+
+void ReadbackRing::LogStats(void) {
+    LOGI("Readback: %llu results, %llu KB delivered, %llu invalidations, %u host buffers of %llu KB, %s %s memory",
+         (unsigned long long)m_stats.deliveredCount, (unsigned long long)(m_stats.deliveredBytes / 1024),
+         (unsigned long long)m_stats.invalidateCount, m_stats.bufferCount,
+         (unsigned long long)(m_stats.bufferBytes / 1024), m_stats.cached ? "cached" : "uncached",
+         m_stats.coherent ? "coherent" : "non-coherent");
+}
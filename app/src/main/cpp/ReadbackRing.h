@@ -0,0 +1,96 @@
+#ifndef VARTIP_READBACKRING_H_
+#define VARTIP_READBACKRING_H_
+
+#include <vulkan_wrapper.h>
+#include <functional>
+#include <vector>
+#include "MemoryAllocator.h"
+
+// What a readback hands to its consumer, data is only valid during the callback
+struct ReadbackResult {
+    const void* data;
+    VkDeviceSize size;
+    uint32_t width;   // images only, 0 for buffers
+    uint32_t height;  // rows are width * bytes per pixel apart
+    uint64_t frame;   // frames ended by this ring so far when it was recorded
+};
+
+typedef std::function<void(const ReadbackResult& result)> ReadbackCallback;
+
+struct ReadbackRingStats {
+    uint64_t deliveredCount;  // callbacks run
+    uint64_t deliveredBytes;
+    uint64_t invalidateCount;  // vkInvalidateMappedMemoryRanges calls, 0 on coherent memory
+    uint32_t bufferCount;      // host buffers over every slot
+    VkDeviceSize bufferBytes;
+    bool cached;    // the host buffers are HOST_CACHED
+    bool coherent;  // HOST_COHERENT, no invalidation needed
+};
+
+// Copies of images and buffers the CPU wants from the GPU, recorded at the end of a frame slot's command buffer into
+// host buffers of that slot and handed to their callbacks once the slot's fence signaled. Nothing ever waits on the
+// GPU for them, a slot's results are delivered when the slot comes around again and its fence was waited for anyway.
+// The host buffers prefer HOST_CACHED memory so the CPU reads them at full speed, when that memory is not coherent
+// each result is invalidated before its callback. Each slot keeps its buffers from one frame to the next, the n-th copy
+// of a frame reuses the n-th buffer and only grows it when the copy got bigger
+class ReadbackRing {
+   public:
+    explicit ReadbackRing(VkPhysicalDevice gpuDevice, VkDevice device, MemoryAllocator* allocator, uint32_t slotCount);
+
+    ~ReadbackRing();
+
+    // Recording side, the source has to be visible to transfer reads by then. Copies are dropped with an error when
+    // no host memory is left for them
+    void CopyBuffer(VkCommandBuffer cmdBuffer, uint32_t slot, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+                    ReadbackCallback callback);
+    void CopyImage(VkCommandBuffer cmdBuffer, uint32_t slot, VkImage image, VkImageLayout layout, uint32_t width,
+                   uint32_t height, uint32_t bytesPerPixel, ReadbackCallback callback);
+
+    // Makes the slot's copies visible to the host, recorded after the last copy of the frame
+    void EndFrame(VkCommandBuffer cmdBuffer, uint32_t slot);
+
+    /**
+     * Runs the callbacks of the slot's last frame if fence signaled, the fence is the one its command buffer was
+     * submitted with. Has to be called before the slot records its next frame
+     * @return true if there is nothing left pending for the slot
+     */
+    bool CollectIfReady(uint32_t slot, VkFence fence);
+
+    ReadbackRingStats GetStats(void) { return m_stats; }
+    void LogStats(void);
+
+   private:
+    struct HostBuffer {
+        VkBuffer buffer;
+        MemoryAllocation memory;
+        VkDeviceSize capacity;
+        bool coherent;
+    };
+
+    struct Request {
+        VkDeviceSize size;
+        uint32_t width;
+        uint32_t height;
+        ReadbackCallback callback;
+    };
+
+    struct Slot {
+        std::vector<HostBuffer> buffers;
+        std::vector<Request> requests;  // request i is in buffers[i]
+        bool pending;                   // ended and not collected yet
+        uint64_t frame;
+    };
+
+    // Host buffer for the next request of the slot, nullptr if it could not be allocated
+    HostBuffer* NextBuffer(uint32_t slot, VkDeviceSize size);
+    bool AllocateBuffer(VkDeviceSize size, HostBuffer* hostBuffer);
+
+    VkDevice m_device;
+    MemoryAllocator* m_allocator;
+    VkDeviceSize m_atomSize;  // nonCoherentAtomSize, invalidated ranges have to be aligned to it
+    std::vector<Slot> m_slots;
+    uint64_t m_frameCount;
+    ReadbackRingStats m_stats;
+};
+
+#endif  // VARTIP_READBACKRING_H_
@@ -0,0 +1,89 @@
+#include "SyntheticFrameSource.h"
+
+SyntheticFrameSource::SyntheticFrameSource(int32_t width, int32_t height)
+    : m_width(width),
+      m_height(height),
+      m_frameCount(0),
+      m_scrolling(false),
+      m_scrollX(0),
+      m_scrollY(0),
+      m_conversionStep(1) {}
+
+void SyntheticFrameSource::SetScroll(int32_t dx, int32_t dy) {
+    m_scrolling = true;
+    m_scrollX = dx;
+    m_scrollY = dy;
+}
+
+// Value of the 8x8 block of the texture at (x, y), a hash so the texture never repeats where a tracker could see it
+static uint32_t TextureBlock(int32_t x, int32_t y) {
+    uint32_t h = static_cast<uint32_t>(x >> 3) * 0x8da6b343u ^ static_cast<uint32_t>(y >> 3) * 0xd8163841u;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return h;
+}
+
+void SyntheticFrameSource::NextFrame(uint32_t* buf, int32_t stride) {
+    if (m_conversionStep > 1) {
+        NextFrameSubsampled(buf, stride);
+        return;
+    }
+    if (m_scrolling) {
+        int32_t offsetX = static_cast<int32_t>(m_frameCount) * m_scrollX;
+        int32_t offsetY = static_cast<int32_t>(m_frameCount) * m_scrollY;
+        for (int32_t y = 0; y < m_height; y++) {
+            uint32_t* row = buf + y * stride;
+            for (int32_t x = 0; x < m_width; x++) {
+                row[x] = 0xff000000 | (TextureBlock(x - offsetX, y - offsetY) & 0xffffff);
+            }
+        }
+        m_frameCount++;
+        return;
+    }
+
+    int32_t barX = static_cast<int32_t>((m_frameCount * 4) % m_width);
+    uint32_t blue = (m_frameCount * 2) & 0xff;
+
+    for (int32_t y = 0; y < m_height; y++) {
+        uint32_t* row = buf + y * stride;
+        uint32_t green = static_cast<uint32_t>(y * 255 / m_height);
+        for (int32_t x = 0; x < m_width; x++) {
+            uint32_t red = static_cast<uint32_t>(x * 255 / m_width);
+            if (x >= barX && x < barX + 16) {
+                row[x] = 0xffffffff;
+            } else {
+                row[x] = 0xff000000 | (red << 16) | (green << 8) | blue;
+            }
+        }
+    }
+    m_frameCount++;
+}
+
+// Like a camera conversion at a lower resolution, the top left pixel of every step x step block is generated into a
+// frame step times smaller. The same frames as NextFrame otherwise
+void SyntheticFrameSource::NextFrameSubsampled(uint32_t* buf, int32_t stride) {
+    int32_t step = m_conversionStep;
+    int32_t offsetX = static_cast<int32_t>(m_frameCount) * m_scrollX;
+    int32_t offsetY = static_cast<int32_t>(m_frameCount) * m_scrollY;
+    int32_t barX = static_cast<int32_t>((m_frameCount * 4) % m_width);
+    uint32_t blue = (m_frameCount * 2) & 0xff;
+
+    for (int32_t y = 0; y < m_height; y += step) {
+        uint32_t* row = buf + (y / step) * stride;
+        uint32_t green = static_cast<uint32_t>(y * 255 / m_height);
+        for (int32_t x = 0; x < m_width; x += step) {
+            uint32_t color;
+            if (m_scrolling) {
+                color = 0xff000000 | (TextureBlock(x - offsetX, y - offsetY) & 0xffffff);
+            } else if (x >= barX && x < barX + 16) {
+                color = 0xffffffff;
+            } else {
+                uint32_t red = static_cast<uint32_t>(x * 255 / m_width);
+                color = 0xff000000 | (red << 16) | (green << 8) | blue;
+            }
+            row[x / step] = color;
+        }
+    }
+    m_frameCount++;
+}
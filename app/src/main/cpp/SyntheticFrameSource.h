@@ -0,0 +1,43 @@
+#ifndef VARTIP_SYNTHETICFRAMESOURCE_H_
+#define VARTIP_SYNTHETICFRAMESOURCE_H_
+
+#include <stdint.h>
+
+// Generates camera like frames so the render path can run without a camera, ex) headless benchmarking on a host.
+// Frames are in the same packed 0xAARRGGBB layout ImageReader::DisplayImage produces
+class SyntheticFrameSource {
+   public:
+    explicit SyntheticFrameSource(int32_t width, int32_t height);
+
+    /**
+     * Write the next frame: a gradient with a bar sweeping across it so consecutive frames differ
+     * @param buf destination, at least stride * height pixels
+     * @param stride distance between rows in pixels
+     */
+    void NextFrame(uint32_t* buf, int32_t stride);
+
+    /**
+     * Switch to a blocky random texture moving by (dx, dy) pixels every frame, ground truth for motion estimation.
+     * The gradient with the bar has next to nothing a tracker can lock on to
+     */
+    void SetScroll(int32_t dx, int32_t dy);
+
+    // Generate one pixel of every step x step block like ImageReader::SetConversionStep, 1 for every pixel. The frame
+    // comes out step times smaller each way, with the same stride
+    void SetConversionStep(int32_t step) { m_conversionStep = step; }
+
+    uint32_t GetFrameCount() { return m_frameCount; }
+
+   private:
+    void NextFrameSubsampled(uint32_t* buf, int32_t stride);
+
+    int32_t m_width;
+    int32_t m_height;
+    uint32_t m_frameCount;
+    bool m_scrolling;
+    int32_t m_scrollX;
+    int32_t m_scrollY;
+    int32_t m_conversionStep;
+};
+
+#endif  // VARTIP_SYNTHETICFRAMESOURCE_H_
@@ -1,13 +1,22 @@
 #ifndef VARTIP_UTIL_H_
 #define VARTIP_UTIL_H_
 
-#include <android/log.h>
+#include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <chrono>
+#ifdef __ANDROID__
+#include <android/log.h>
+#include <sys/system_properties.h>
+#else
+#include <stdio.h>
+#endif
 
 // used to get logcat outputs which can be regex filtered by the LOG_TAG we give
 // So in Logcat you can filter this example by putting "VARTIP"
 #define LOG_TAG "VARTIP"
+#ifdef __ANDROID__
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
 #define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
@@ -16,18 +25,57 @@
     if (!(cond)) {                                                \
         __android_log_assert(#cond, LOG_TAG, fmt, ##__VA_ARGS__); \
     }
+#else
+// Host builds of the modules without Android dependencies log to stderr, the format has to be a string literal
+#define VARTIP_HOST_LOG(level, fmt, ...) fprintf(stderr, level "/" LOG_TAG ": " fmt "\n", ##__VA_ARGS__)
+#define LOGI(...) VARTIP_HOST_LOG("I", __VA_ARGS__)
+#define LOGW(...) VARTIP_HOST_LOG("W", __VA_ARGS__)
+#define LOGE(...) VARTIP_HOST_LOG("E", __VA_ARGS__)
+#define LOGD(...) VARTIP_HOST_LOG("D", __VA_ARGS__)
+#define ASSERT(cond, fmt, ...)                                  \
+    if (!(cond)) {                                              \
+        VARTIP_HOST_LOG("F", "%s: " fmt, #cond, ##__VA_ARGS__); \
+        abort();                                                \
+    }
+#endif
 
 // Vulkan call wrapper
-#define CALL_VK(func)                                                                                                \
-    if (VK_SUCCESS != (func)) {                                                                                      \
-        __android_log_print(ANDROID_LOG_ERROR, "Tutorial ", "Vulkan error. File[%s], line[%d]", __FILE__, __LINE__); \
-        assert(false);                                                                                               \
+#define CALL_VK(func)                                                  \
+    if (VK_SUCCESS != (func)) {                                        \
+        LOGE("Vulkan error. File[%s], line[%d]", __FILE__, __LINE__); \
+        assert(false);                                                 \
     }
 
 // A macro to check value is VK_SUCCESS
 // Used also for non-vulkan functions but return VK_SUCCESS
 #define VK_CHECK(x) CALL_VK(x)
 
+// Monotonic time in milliseconds, used for startup and frame timings
+static inline double GetTimeMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Debug/benchmark switches are read from an environment variable, or on Android where the environment can't be set
+// for an app, from a system property (adb shell setprop debug.vartip.xxx value)
+// @return false if neither is set
+static inline bool GetDebugOption(const char* envName, const char* propertyName, char* value, size_t size) {
+    const char* env = getenv(envName);
+    if (env != nullptr && env[0] != '\0') {
+        strncpy(value, env, size - 1);
+        value[size - 1] = '\0';
+        return true;
+    }
+#ifdef __ANDROID__
+    char property[PROP_VALUE_MAX];
+    if (__system_property_get(propertyName, property) > 0) {
+        strncpy(value, property, size - 1);
+        value[size - 1] = '\0';
+        return true;
+    }
+#endif
+    return false;
+}
+
 // A Data Structure to communicate resolution between camera and ImageReader
 struct ImageFormat {
     int32_t width;
@@ -42,7 +90,7 @@ class DisplayDimension {
         if (height > width) {
             // make it landscape
             m_width = height;
-            m_height = m_width;
+            m_height = width;
             m_portrait = true;
         }
     }
@@ -67,7 +115,7 @@ class DisplayDimension {
     }
 
     bool IsSameRatio(DisplayDimension& other) { return (m_width * other.m_height == m_height * other.m_width); }
-    bool operator>(DisplayDimension& other) { return (m_width >= other.m_width & m_height >= other.m_height); }
+    bool operator>(DisplayDimension& other) { return (m_width >= other.m_width && m_height >= other.m_height); }
     bool operator==(DisplayDimension& other) {
         return ((m_width == other.m_width) && (m_height == other.m_height) && (m_portrait == other.m_portrait));
     }
@@ -1,5 +1,4 @@
 #include "ValidationLayers.h"
-#include <android/log.h>
 #include <assert.h>
 #include "Util.h"
 
@@ -1,15 +1,37 @@
-#include <android/log.h>
 #include <malloc.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
 #include <cassert>
+#include <string>
+#include <thread>
 #include <vector>
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_ONLY_PNG
 #include <stb/stb_image.h>
+#include "CpuProfiler.h"
 #include "CreateShaderModule.h"
+#include "DeviceSelection.h"
+#include "FilterReference.h"
+#include "Filters.h"
+#include "GpuProfiler.h"
+#include "KernelVariantCache.h"
+#include "MemoryAllocator.h"
+#include "PerfHud.h"
+#include "QualityGovernor.h"
+#include "ReadbackRing.h"
+#include "SyntheticFrameSource.h"
 #include "ValidationLayers.h"
 #include "VulkanMain.h"
 #include "vulkan_wrapper.h"
 
+#ifndef __ANDROID__
+// Windows only exist on Android, elsewhere the renderer only runs offscreen
+struct ANativeWindow;
+#endif
+
 // Global Variables ...
 struct VulkanDeviceInfo {
     bool initialized;
@@ -20,9 +42,15 @@ struct VulkanDeviceInfo {
     VkSurfaceKHR surface;
     VkQueue queue;
     uint32_t queueFamilyIndex;
+    // Queue of the camera upload, the graphics one when the device has no dedicated transfer family
+    VkQueue transferQueue;
+    uint32_t transferQueueFamilyIndex;
 };
 VulkanDeviceInfo device;
 
+// The camera upload goes on its own queue and hands the camera texture over to the graphics one
+static bool UsesTransferQueue(void) { return device.transferQueueFamilyIndex != device.queueFamilyIndex; }
+
 struct VulkanSwapchainInfo {
     VkSwapchainKHR swapchain;
     uint32_t swapchainLength;
@@ -37,42 +65,175 @@ typedef struct texture_object {
     VkSampler sampler;
     VkImage image;
     VkImageLayout imageLayout;
-    VkDeviceMemory memory;
+    MemoryAllocation memory;
     VkImageView view;
     int32_t texWidth, texHeight;
 } texture_object;
 
 #define VARTIP_TEXTURE_COUNT 1
 static const VkFormat kTextureFormat = VK_FORMAT_R8G8B8A8_UNORM;
-struct texture_object textures[VARTIP_TEXTURE_COUNT];
+// A camera texture for each conversion step, 1, 2 and 4, the size that step converts to. Frames are uploaded to the
+// one of the current step, see CameraTexture
+#define VARTIP_CAMERA_TEXTURE_COUNT 3
+struct texture_object cameraTextures[VARTIP_CAMERA_TEXTURE_COUNT];
+
+// Without a window the frames are rendered into a ring of device images instead of a swapchain, VulkanSwapchainInfo
+// still describes them (length, size, format, views and framebuffers) so the rest of the renderer is unchanged
+#define VARTIP_OFFSCREEN_IMAGE_COUNT 3
+struct VulkanOffscreenInfo {
+    bool enabled;
+    bool readback;  // copy each frame into a host visible buffer to verify the output
+    uint32_t nextIndex;
+    uint32_t lastIndex;
+    VkImage images[VARTIP_OFFSCREEN_IMAGE_COUNT];
+    MemoryAllocation memory[VARTIP_OFFSCREEN_IMAGE_COUNT];
+    VkBuffer readbackBuffers[VARTIP_OFFSCREEN_IMAGE_COUNT];
+    MemoryAllocation readbackMemory[VARTIP_OFFSCREEN_IMAGE_COUNT];
+    SyntheticFrameSource* frameSource;
+    double loadMs;  // busy work the headless benchmark did for the frame before drawing it, see VARTIP_CPU_LOAD_ENV
+};
+VulkanOffscreenInfo offscreen;
 
 struct VulkanBufferInfo {
     VkBuffer vertexBuffer;
+    MemoryAllocation vertexMemory;
 };
 VulkanBufferInfo buffers;
 
 struct VulkanGfxPipelineInfo {
     VkDescriptorSetLayout descriptorLayout;
-    VkDescriptorPool descriptorPool;
-    VkDescriptorSet descriptorSet;
+    VkDescriptorPool descriptorPool;  // a descriptor set for every frame slot
     VkPipelineLayout layout;
     VkPipelineCache cache;
     VkPipeline pipeline;
 };
 VulkanGfxPipelineInfo gfxPipeline;
 
+// Command buffers are recorded every frame, each slot has its own pool so resetting it never touches a command buffer
+// the GPU may still be running, and its own staging buffer the camera frame is written to before the recorded upload.
+// The CPU only waits for a slot's fence when the slot comes around again, so one frame records while the other runs
+#define VARTIP_FRAME_SLOT_COUNT 2
+struct VulkanFrameSlot {
+    VkCommandPool cmdPool;
+    VkCommandBuffer cmdBuffer;
+    VkFence fence;  // created signaled, the slot is free once it signals
+    VkSemaphore acquireSemaphore;  // the swapchain image the slot draws to is ready, its submit waits on it
+    VkDescriptorSet descriptorSet;  // what the display samples, only written while the slot is free
+    bool descriptorStale;           // the filters changed, descriptorSet is written before the slot records again
+    VkBuffer stagingBuffer;
+    MemoryAllocation stagingMemory;
+    // Camera upload on the transfer queue, unused when it is the graphics queue, see SubmitCameraUpload
+    VkCommandPool uploadCmdPool;
+    VkCommandBuffer uploadCmdBuffer;
+    VkSemaphore uploadSemaphore;   // the upload is done, the slot's submit waits on it
+    VkSemaphore releaseSemaphore;  // the slot's submit is done with the camera texture, the next upload waits on it
+};
+
 struct VulkanRenderInfo {
     VkRenderPass renderPass;
-    VkCommandPool cmdPool;
-    VkCommandBuffer* cmdBuffer;
-    uint32_t cmdBufferLength;
-    VkSemaphore semaphore;
-    VkFence fence;
+    VulkanFrameSlot slots[VARTIP_FRAME_SLOT_COUNT];
+    uint32_t currentSlot;
+    // The submit drawing to a swapchain image signals its semaphore and the present waits on it. They go by image
+    // rather than by slot, the present holds on to its semaphore until the image is acquired again, not until a fence
+    std::vector<VkSemaphore> renderSemaphores;
+    // Release semaphore of the last submitted slot, VK_NULL_HANDLE until a frame was drawn or once an upload waited
+    VkSemaphore pendingRelease;
+    VkClearColorValue clearColor;
 };
 VulkanRenderInfo render;
 
-void* mappedData;
+// Recording a frame is expected to stay well under this, a frame going over is counted and the first one logged
+#define VARTIP_RECORD_BUDGET_US 50.0
+
+// Timings of the last drawn frame: CPU from the start of the frame to the submit, record is the command buffer
+// recording part of it. GPU times come from the profiler's timestamps once the frame completed. The recording totals
+// cover every frame of the context and are logged against VARTIP_RECORD_BUDGET_US when it is deleted
+struct FrameTimingInfo {
+    double cpuMs;
+    double recordMs;
+    uint64_t recordCount;
+    double recordTotalMs;
+    double recordWorstMs;
+    uint64_t recordOverBudgetCount;
+};
+FrameTimingInfo frameTiming;
+
+// All buffers and images get their memory from here
+MemoryAllocator* memoryAllocator;
+
+// GPU timestamps per pass merged with the CPU timings of each frame
+GpuProfiler* gpuProfiler;
+
+// FPS, frame time graph and stage timings drawn over the camera image, nullptr unless debug.vartip.hud is set
+PerfHud* perfHud;
+
+// Steps the frame work down when it takes longer than debug.vartip.governor and back up when there is room again,
+// nullptr when it isn't set. Its levels apply to governedFilters, the full quality filter list, appliedFilters is what
+// the filter graph was last built from
+QualityGovernor* qualityGovernor;
+std::string governedFilters;
+std::string appliedFilters;
+uint32_t conversionStep = 1;
+
+// Shader modules of every pipeline, loaded once for the lifetime of the device
+ShaderModuleCache* shaderModules;
+
+// Pipelines of the filter kernels, kept across filter graphs so rebuilding them only creates new variants
+KernelVariantCache* kernelVariants;
+// Consecutive pointwise filters share a pass, read from debug.vartip.fuse once at start, the fusion benchmark
+// flips it
+bool fusePointwise = true;
+
+// Compute filters run on the camera texture, nullptr when none is enabled. The display samples filterOutput instead of
+// the camera texture and applies filterLut when the filters produce them
+FilterGraph* filterGraph;
+GraphResource filterOutput;
+GraphResource filterLut;
+GraphResource filterHistogram;
+GraphResource filterFlowPoints;
+GraphResource filterKeypoints;
+// Graphs RebuildFilterGraph replaced, alive until no frame in flight uses them
+struct RetiredFilterGraph {
+    FilterGraph* graph;
+    uint32_t pendingSlots;  // bit of every slot whose fence was not waited for since
+};
+std::vector<RetiredFilterGraph> retiredFilterGraphs;
+
+// Latest luma histogram read back from the GPU, a few frames behind the displayed one
+#define VARTIP_EXPOSURE_LOG_FRAMES 120
+struct LumaHistogramInfo {
+    uint64_t count;  // histograms read back so far
+    uint32_t bins[VARTIP_HISTOGRAM_BINS];
+};
+LumaHistogramInfo lumaHistogram;
+
+// Latest optical flow points read back from the GPU, as far behind as the histogram
+#define VARTIP_FLOW_LOG_FRAMES 120
+struct FlowTrackInfo {
+    uint64_t count;  // point sets read back so far
+    uint32_t pointCount;
+    FlowPoint points[VARTIP_FLOW_MAX_POINTS];
+};
+FlowTrackInfo flowTracks;
+
+// Latest FAST corners read back from the GPU, as far behind as the histogram
+#define VARTIP_KEYPOINT_LOG_FRAMES 120
+struct KeypointInfo {
+    uint64_t count;  // keypoint sets read back so far
+    uint32_t found;  // corners the GPU found, more than keypointCount when the buffer overflowed
+    uint32_t keypointCount;
+    Keypoint keypoints[VARTIP_FAST_MAX_KEYPOINTS];
+};
+KeypointInfo keypointList;
+// What the CPU reads of the filters, copied at the end of each frame and handed over once its slot's fence signaled
+ReadbackRing* readbackRing;
+
+// Headless readback of filterOutput, its RGBA8 pixels as of the last collected frame so filters can be checked on
+// their own
+bool filterReadback;
+std::vector<uint8_t> filterReadbackPixels;
 
+#ifdef __ANDROID__
 // Camera variables
 NativeCamera* m_nativeCamera;
 // Image Reader
@@ -80,20 +241,56 @@ ImageFormat m_view{0, 0, 0};
 ImageReader* m_imageReader;
 AImage* m_image;
 volatile bool m_cameraReady;
+#endif
 VkDebugReportCallbackEXT debugCallbackHandle;
 
-// Android Native App pointer...
-android_app* androidAppCtx = nullptr;
+// Where the shaders are loaded from, and where files named without a directory are written
+AssetSource assetSource;
+std::string dataDirectory;
+
+// Startup timings, each phase is measured on the thread running it and the
+// total is reported once the first frame has been presented
+struct StartupTimingInfo {
+    double startMs;
+    double cameraMs;
+    double pipelineMs;
+    double filtersMs;
+    double contextMs;
+    bool firstFrameReported;
+};
+StartupTimingInfo startupTiming;
+
+#ifdef __ANDROID__
+// Frames of a capture profile left out of its latencies, the old request's frames still in flight and AE settling
+#define VARTIP_CAPTURE_WARMUP_FRAMES 30
+
+// Capture latency benchmark, streams every capture profile in turn and measures each one's frames
+struct CaptureBenchmarkInfo {
+    uint32_t framesPerProfile;  // 0 when not benchmarking
+    uint32_t profileIndex;
+    uint32_t skippedFrames;
+    std::vector<double> latencyMs;            // sensor timestamp to present
+    const CaptureProfile* configuredProfile;  // streamed again once done
+};
+CaptureBenchmarkInfo captureBenchmark;
+#endif
 
 // Create vulkan device
+// platformWindow is nullptr when rendering offscreen, no surface or swapchain extensions are needed then
 void CreateVulkanDevice(ANativeWindow* platformWindow, VkApplicationInfo* appInfo) {
     std::vector<const char*> instanceExtensions;
     std::vector<const char*> instanceLayers;
     std::vector<const char*> deviceExtensions;
 
-    instanceExtensions.push_back("VK_KHR_surface");
-    instanceExtensions.push_back("VK_KHR_android_surface");
-    deviceExtensions.push_back("VK_KHR_swapchain");
+#ifdef __ANDROID__
+    if (platformWindow != nullptr) {
+        instanceExtensions.push_back("VK_KHR_surface");
+        instanceExtensions.push_back("VK_KHR_android_surface");
+        deviceExtensions.push_back("VK_KHR_swapchain");
+    }
+#else
+    ASSERT(platformWindow == nullptr, "Only offscreen rendering is supported off Android");
+#endif
 
 #if (VARTIP_VALIDATION_LAYERS)
     instanceExtensions.push_back("VK_EXT_debug_report");
@@ -122,55 +319,59 @@ void CreateVulkanDevice(ANativeWindow* platformWindow, VkApplicationInfo* appInf
     CreateDebugReportExt(device.instance, &debugCallbackHandle);
 #endif
 
-    VkAndroidSurfaceCreateInfoKHR createInfo{.sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR,
-                                             .pNext = nullptr,
-                                             .flags = 0,
-                                             .window = platformWindow};
-
-    CALL_VK(vkCreateAndroidSurfaceKHR(device.instance, &createInfo, nullptr, &device.surface));
-
-    uint32_t gpuCount = 0;
-    CALL_VK(vkEnumeratePhysicalDevices(device.instance, &gpuCount, nullptr));
-    VkPhysicalDevice tmpGpus[gpuCount];
-    CALL_VK(vkEnumeratePhysicalDevices(device.instance, &gpuCount, tmpGpus));
-    device.gpuDevice = tmpGpus[0];  // Pick up the first GPU Device
+    device.surface = VK_NULL_HANDLE;
+#ifdef __ANDROID__
+    if (platformWindow != nullptr) {
+        VkAndroidSurfaceCreateInfoKHR createInfo{.sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR,
+                                                 .pNext = nullptr,
+                                                 .flags = 0,
+                                                 .window = platformWindow};
 
-    // Find a Graphics queue family
-    uint32_t queueFamilyCount;
-    vkGetPhysicalDeviceQueueFamilyProperties(device.gpuDevice, &queueFamilyCount, nullptr);
-    assert(queueFamilyCount > 0);
-    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(device.gpuDevice, &queueFamilyCount, queueFamilyProperties.data());
-
-    uint32_t queueFamilyIndex;
-    for (queueFamilyIndex = 0; queueFamilyIndex < queueFamilyCount; queueFamilyIndex++) {
-        if (queueFamilyProperties[queueFamilyIndex].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-            break;
-        }
+        CALL_VK(vkCreateAndroidSurfaceKHR(device.instance, &createInfo, nullptr, &device.surface));
     }
-    assert(queueFamilyIndex < queueFamilyCount);
-    device.queueFamilyIndex = queueFamilyIndex;
+#endif
+
+    // Pick the best scoring GPU that can present to our surface
+    QueueFamilySelection queueFamilies;
+    bool foundDevice =
+        SelectPhysicalDevice(device.instance, device.surface, deviceExtensions, &device.gpuDevice, &queueFamilies);
+    ASSERT(foundDevice, "No GPU supports rendering (and presenting to the window)");
+    device.queueFamilyIndex = queueFamilies.graphics;
+    device.transferQueueFamilyIndex = queueFamilies.transfer;
 
     vkGetPhysicalDeviceMemoryProperties(device.gpuDevice, &device.gpuMemoryProperties);
 
-    // Create a logical device (vulkan device)
+    // Create a logical device (vulkan device) with the graphics queue and, if there is a dedicated family for it, a
+    // transfer queue the camera upload goes on. The filters stay on the graphics queue, their output is drawn in the
+    // same frame so an async compute queue would only add a semaphore between them
     float priorities[] = {
         1.0f,
     };
-    VkDeviceQueueCreateInfo queueCreateInfo{
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+    queueCreateInfos.push_back({
         .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
         .queueCount = 1,
         .queueFamilyIndex = device.queueFamilyIndex,
         .pQueuePriorities = priorities,
-    };
+    });
+    if (queueFamilies.hasDedicatedTransfer) {
+        queueCreateInfos.push_back({
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .queueCount = 1,
+            .queueFamilyIndex = device.transferQueueFamilyIndex,
+            .pQueuePriorities = priorities,
+        });
+    }
 
     VkDeviceCreateInfo deviceCreateInfo{
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .pNext = nullptr,
-        .queueCreateInfoCount = 1,
-        .pQueueCreateInfos = &queueCreateInfo,
+        .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
+        .pQueueCreateInfos = queueCreateInfos.data(),
         .enabledLayerCount = 0,
         .ppEnabledLayerNames = nullptr,
         .enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
@@ -180,6 +381,10 @@ void CreateVulkanDevice(ANativeWindow* platformWindow, VkApplicationInfo* appInf
 
     CALL_VK(vkCreateDevice(device.gpuDevice, &deviceCreateInfo, nullptr, &device.device));
     vkGetDeviceQueue(device.device, device.queueFamilyIndex, 0, &device.queue);
+    vkGetDeviceQueue(device.device, device.transferQueueFamilyIndex, 0, &device.transferQueue);
+    LOGI("Camera upload on the %s queue", queueFamilies.hasDedicatedTransfer ? "transfer" : "graphics");
+
+    memoryAllocator = new MemoryAllocator(device.gpuDevice, device.device);
 }
 
 void CreateSwapChain() {
@@ -233,12 +438,79 @@ void CreateSwapChain() {
     delete[] formats;
 }
 
+// Offscreen replacement of CreateSwapChain, the images are created with the same format the swapchain uses
+void CreateOffscreenTargets(uint32_t width, uint32_t height) {
+    memset(&swapchain, 0, sizeof(swapchain));
+    swapchain.swapchainLength = VARTIP_OFFSCREEN_IMAGE_COUNT;
+    swapchain.displaySize = {.width = width, .height = height};
+    swapchain.displayFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+    VkImageCreateInfo imageCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = nullptr,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = swapchain.displayFormat,
+        .extent = {width, height, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .flags = 0,
+    };
+    VkBufferCreateInfo bufferCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = nullptr,
+        .size = width * height * 4,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .flags = 0,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .pQueueFamilyIndices = &device.queueFamilyIndex,
+        .queueFamilyIndexCount = 1,
+    };
+
+    for (uint32_t i = 0; i < VARTIP_OFFSCREEN_IMAGE_COUNT; i++) {
+        bool allocated = memoryAllocator->CreateImage(&imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                      &offscreen.images[i], &offscreen.memory[i]);
+        ASSERT(allocated, "Failed to allocate offscreen image %u", i);
+
+        offscreen.readbackBuffers[i] = VK_NULL_HANDLE;
+        if (offscreen.readback) {
+            allocated = memoryAllocator->CreateBuffer(
+                &bufferCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &offscreen.readbackBuffers[i], &offscreen.readbackMemory[i]);
+            ASSERT(allocated, "Failed to allocate offscreen readback buffer %u", i);
+        }
+    }
+    offscreen.nextIndex = 0;
+    offscreen.lastIndex = 0;
+}
+
+void DeleteOffscreenTargets() {
+    for (uint32_t i = 0; i < VARTIP_OFFSCREEN_IMAGE_COUNT; i++) {
+        memoryAllocator->DestroyImage(offscreen.images[i], &offscreen.memory[i]);
+        if (offscreen.readbackBuffers[i] != VK_NULL_HANDLE) {
+            memoryAllocator->DestroyBuffer(offscreen.readbackBuffers[i], &offscreen.readbackMemory[i]);
+        }
+    }
+}
+
 void CreateFrameBuffers(VkRenderPass& renderPass, VkImageView depthView = VK_NULL_HANDLE) {
-    // query display attachment to swapchain
+    // query display attachment to swapchain, or take the offscreen ring
     uint32_t SwapchainImagesCount = 0;
-    CALL_VK(vkGetSwapchainImagesKHR(device.device, swapchain.swapchain, &SwapchainImagesCount, nullptr));
-    VkImage* displayImages = new VkImage[SwapchainImagesCount];
-    CALL_VK(vkGetSwapchainImagesKHR(device.device, swapchain.swapchain, &SwapchainImagesCount, displayImages));
+    VkImage* displayImages;
+    if (offscreen.enabled) {
+        SwapchainImagesCount = swapchain.swapchainLength;
+        displayImages = new VkImage[SwapchainImagesCount];
+        memcpy(displayImages, offscreen.images, SwapchainImagesCount * sizeof(VkImage));
+    } else {
+        CALL_VK(vkGetSwapchainImagesKHR(device.device, swapchain.swapchain, &SwapchainImagesCount, nullptr));
+        displayImages = new VkImage[SwapchainImagesCount];
+        CALL_VK(vkGetSwapchainImagesKHR(device.device, swapchain.swapchain, &SwapchainImagesCount, displayImages));
+    }
 
     // create image view for each swapchain image
     swapchain.imageViews = new VkImageView[SwapchainImagesCount];
@@ -293,223 +565,51 @@ void CreateFrameBuffers(VkRenderPass& renderPass, VkImageView depthView = VK_NUL
     }
 }
 
-// A help function to map required memory property into a VK memory type
-// memory type is an index into the array of 32 entries; or the bit index
-// for the memory type ( each BIT of an 32 bit integer is a type ).
-VkResult AllocateMemoryTypeFromProperties(uint32_t typeBits, VkFlags requirements_mask, uint32_t* typeIndex) {
-    // Search memtypes to find first index with those properties
-    for (uint32_t i = 0; i < 32; i++) {
-        if ((typeBits & 1) == 1) {
-            // Type is available, does it match user properties?
-            if ((device.gpuMemoryProperties.memoryTypes[i].propertyFlags & requirements_mask) == requirements_mask) {
-                *typeIndex = i;
-                return VK_SUCCESS;
-            }
-        }
-        typeBits >>= 1;
-    }
-    // No memory types matched, return failure
-    return VK_ERROR_MEMORY_MAP_FAILED;
-}
-
 uint32_t imgWidth = 480;
 uint32_t imgHeight = 720;
-uint32_t n = 4;
-uint32_t rowPitch = 1920;
-
-VkResult LoadTextureFromCamera(struct texture_object* textureObj, VkImageUsageFlags usage, VkFlags requiredProps) {
-    if (!(usage | requiredProps)) {
-        __android_log_print(ANDROID_LOG_ERROR, "texture", "No usage and required_pros");
-        return VK_ERROR_FORMAT_NOT_SUPPORTED;
-    }
 
-    // Check for linear supportability
+// The camera texture is a device local optimal image, every frame is written to the staging buffer of its frame slot
+// and copied in by the frame's command buffer. One pixel per step x step block of the camera image
+VkResult LoadTextureFromCamera(struct texture_object* textureObj, uint32_t step) {
     VkFormatProperties props;
-    bool needBlit = true;
     vkGetPhysicalDeviceFormatProperties(device.gpuDevice, kTextureFormat, &props);
-    assert((props.linearTilingFeatures | props.optimalTilingFeatures) & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
-
-    if (props.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) {
-        // linear format supporting the required texture
-        needBlit = false;
+    if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        LOGE("Camera texture format can't be sampled");
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
     }
 
-    unsigned char* imageData = (unsigned char*)malloc(n * imgHeight * imgHeight);
+    textureObj->texWidth = (imgWidth + step - 1) / step;
+    textureObj->texHeight = (imgHeight + step - 1) / step;
 
-    textureObj->texWidth = imgWidth;
-    textureObj->texHeight = imgHeight;
-
-    // Allocate the linear texture so texture could be copied over
     VkImageCreateInfo image_create_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .pNext = nullptr,
         .imageType = VK_IMAGE_TYPE_2D,
         .format = kTextureFormat,
-        .extent = {static_cast<uint32_t>(imgWidth), static_cast<uint32_t>(imgHeight), 1},
+        .extent = {static_cast<uint32_t>(textureObj->texWidth), static_cast<uint32_t>(textureObj->texHeight), 1},
         .mipLevels = 1,
         .arrayLayers = 1,
         .samples = VK_SAMPLE_COUNT_1_BIT,
-        .tiling = VK_IMAGE_TILING_LINEAR,
-        .usage = (needBlit ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : VK_IMAGE_USAGE_SAMPLED_BIT),
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        // Source of the copies into the filter pyramid
+        .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = 0,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
         .flags = 0,
     };
-    VkMemoryAllocateInfo memAlloc = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = nullptr,
-        .allocationSize = 0,
-        .memoryTypeIndex = 0,
-    };
-
-    VkMemoryRequirements memReqs;
-    CALL_VK(vkCreateImage(device.device, &image_create_info, nullptr, &textureObj->image));
-    vkGetImageMemoryRequirements(device.device, textureObj->image, &memReqs);
-    memAlloc.allocationSize = memReqs.size;
-    VK_CHECK(AllocateMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                                              &memAlloc.memoryTypeIndex));
-    CALL_VK(vkAllocateMemory(device.device, &memAlloc, nullptr, &textureObj->memory));
-    CALL_VK(vkBindImageMemory(device.device, textureObj->image, textureObj->memory, 0));
-
-    if (requiredProps & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
-        const VkImageSubresource subres = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .mipLevel = 0,
-            .arrayLayer = 0,
-        };
-        VkSubresourceLayout layout;
-        // void* data;
-
-        vkGetImageSubresourceLayout(device.device, textureObj->image, &subres, &layout);
-        CALL_VK(vkMapMemory(device.device, textureObj->memory, 0, memAlloc.allocationSize, 0, &mappedData));
-
-        LOGI("RowPitch = %d", (int)layout.rowPitch);
-
-        rowPitch = layout.rowPitch;
-
-        for (int32_t y = 0; y < imgHeight; y++) {
-            unsigned char* row = (unsigned char*)((char*)mappedData + layout.rowPitch * y);
-            for (int32_t x = 0; x < imgWidth; x++) {
-                row[x * 4] = imageData[(x + y * imgWidth) * 4];
-                row[x * 4 + 1] = imageData[(x + y * imgWidth) * 4 + 1];
-                row[x * 4 + 2] = imageData[(x + y * imgWidth) * 4 + 2];
-                row[x * 4 + 3] = imageData[(x + y * imgWidth) * 4 + 3];
-            }
-        }
-
-        // vkUnmapMemory(device.device, textureObj->memory);
-        free(imageData);
-        // stbi_image_free(imageData);
-    }
-    // delete [] fileContent;
-
-    textureObj->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    // If linear is supported, we are done
-    if (needBlit == false) {
-        return VK_SUCCESS;
-    }
-
-    // save current image and mem as staging image and memory
-    VkImage stageImage = textureObj->image;
-    VkDeviceMemory stageMem = textureObj->memory;
-    textureObj->image = VK_NULL_HANDLE;
-    textureObj->memory = VK_NULL_HANDLE;
-
-    // Create a tile texture to blit into
-    image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    CALL_VK(vkCreateImage(device.device, &image_create_info, nullptr, &textureObj->image));
-    vkGetImageMemoryRequirements(device.device, textureObj->image, &memReqs);
-
-    memAlloc.allocationSize = memReqs.size;
-    VK_CHECK(AllocateMemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                              &memAlloc.memoryTypeIndex));
-    CALL_VK(vkAllocateMemory(device.device, &memAlloc, nullptr, &textureObj->memory));
-    CALL_VK(vkBindImageMemory(device.device, textureObj->image, textureObj->memory, 0));
-
-    VkCommandPoolCreateInfo cmdPoolCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-        .queueFamilyIndex = 0,
-    };
-
-    VkCommandPool cmdPool;
-    CALL_VK(vkCreateCommandPool(device.device, &cmdPoolCreateInfo, nullptr, &cmdPool));
-
-    VkCommandBuffer graphicCmd;
-    const VkCommandBufferAllocateInfo cmd = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .pNext = nullptr,
-        .commandPool = cmdPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1,
-    };
-
-    CALL_VK(vkAllocateCommandBuffers(device.device, &cmd, &graphicCmd));
-    VkCommandBufferBeginInfo cmdBufferInfo = {.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-                                              .pNext = nullptr,
-                                              .flags = 0,
-                                              .pInheritanceInfo = nullptr};
-    CALL_VK(vkBeginCommandBuffer(graphicCmd, &cmdBufferInfo));
-
-    VkImageCopy bltInfo = {
-        .srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-        .srcSubresource.mipLevel = 0,
-        .srcSubresource.baseArrayLayer = 0,
-        .srcSubresource.layerCount = 1,
-        .srcOffset.x = 0,
-        .srcOffset.y = 0,
-        .srcOffset.z = 0,
-        .dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-        .dstSubresource.mipLevel = 0,
-        .dstSubresource.baseArrayLayer = 0,
-        .dstSubresource.layerCount = 1,
-        .dstOffset.x = 0,
-        .dstOffset.y = 0,
-        .dstOffset.z = 0,
-        .extent.width = imgWidth,
-        .extent.height = imgHeight,
-        .extent.depth = 1,
-    };
-    vkCmdCopyImage(graphicCmd, stageImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, textureObj->image,
-                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bltInfo);
-
-    CALL_VK(vkEndCommandBuffer(graphicCmd));
-    VkFenceCreateInfo fenceInfo = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = 0,
-    };
-    VkFence fence;
-    CALL_VK(vkCreateFence(device.device, &fenceInfo, nullptr, &fence));
+    bool allocated = memoryAllocator->CreateImage(&image_create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                  &textureObj->image, &textureObj->memory);
+    ASSERT(allocated, "Failed to allocate the camera texture");
 
-    VkSubmitInfo submitInfo = {
-        .pNext = nullptr,
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = nullptr,
-        .pWaitDstStageMask = nullptr,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &graphicCmd,
-        .signalSemaphoreCount = 0,
-        .pSignalSemaphores = nullptr,
-    };
-    CALL_VK(vkQueueSubmit(device.queue, 1, &submitInfo, fence) != VK_SUCCESS);
-    CALL_VK(vkWaitForFences(device.device, 1, &fence, VK_TRUE, 100000000) != VK_SUCCESS);
-    vkDestroyFence(device.device, fence, nullptr);
-
-    vkFreeCommandBuffers(device.device, cmdPool, 1, &graphicCmd);
-    vkDestroyCommandPool(device.device, cmdPool, nullptr);
-    vkDestroyImage(device.device, stageImage, nullptr);
-    vkFreeMemory(device.device, stageMem, nullptr);
+    // Every upload leaves it in the layout the descriptor set expects
+    textureObj->imageLayout = VK_IMAGE_LAYOUT_GENERAL;
     return VK_SUCCESS;
 }
 
 void CreateTexture() {
-    for (uint32_t i = 0; i < VARTIP_TEXTURE_COUNT; i++) {
-        LoadTextureFromCamera(&textures[i], VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    for (uint32_t i = 0; i < VARTIP_CAMERA_TEXTURE_COUNT; i++) {
+        CALL_VK(LoadTextureFromCamera(&cameraTextures[i], 1u << i));
 
         const VkSamplerCreateInfo sampler = {
             .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
@@ -545,28 +645,29 @@ void CreateTexture() {
             .flags = 0,
         };
 
-        CALL_VK(vkCreateSampler(device.device, &sampler, nullptr, &textures[i].sampler));
-        view.image = textures[i].image;
-        CALL_VK(vkCreateImageView(device.device, &view, nullptr, &textures[i].view));
+        CALL_VK(vkCreateSampler(device.device, &sampler, nullptr, &cameraTextures[i].sampler));
+        view.image = cameraTextures[i].image;
+        CALL_VK(vkCreateImageView(device.device, &view, nullptr, &cameraTextures[i].view));
     }
 }
 
-// A helper function
-bool MapMemoryTypeToIndex(uint32_t typeBits, VkFlags requirements_mask, uint32_t* typeIndex) {
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(device.gpuDevice, &memoryProperties);
-    // Search memtypes to find first index with those properties
-    for (uint32_t i = 0; i < 32; i++) {
-        if ((typeBits & 1) == 1) {
-            // Type is available, does it match user properties?
-            if ((memoryProperties.memoryTypes[i].propertyFlags & requirements_mask) == requirements_mask) {
-                *typeIndex = i;
-                return true;
-            }
+void DeleteTextures(void) {
+    for (uint32_t i = 0; i < VARTIP_CAMERA_TEXTURE_COUNT; i++) {
+        vkDestroyImageView(device.device, cameraTextures[i].view, nullptr);
+        vkDestroySampler(device.device, cameraTextures[i].sampler, nullptr);
+        memoryAllocator->DestroyImage(cameraTextures[i].image, &cameraTextures[i].memory);
+    }
+}
+
+// Camera texture of the current conversion step
+texture_object& CameraTexture(void) {
+    for (uint32_t i = 0; i < VARTIP_CAMERA_TEXTURE_COUNT; i++) {
+        if ((1u << i) == conversionStep) {
+            return cameraTextures[i];
         }
-        typeBits >>= 1;
     }
-    return false;
+    ASSERT(false, "No camera texture for conversion step %u", conversionStep);
+    return cameraTextures[0];
 }
 
 // Create our vertex buffer
@@ -589,63 +690,61 @@ bool CreateBuffers(void) {
         .queueFamilyIndexCount = 1,
     };
 
-    CALL_VK(vkCreateBuffer(device.device, &createBufferInfo, nullptr, &buffers.vertexBuffer));
-
-    VkMemoryRequirements memReq;
-    vkGetBufferMemoryRequirements(device.device, buffers.vertexBuffer, &memReq);
-
-    VkMemoryAllocateInfo allocInfo{
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = nullptr,
-        .allocationSize = sizeof(vertexData),
-        .memoryTypeIndex = 0,  // Memory type assigned in the next step
-    };
-
-    // Assign the proper memory type for that buffer
-    allocInfo.allocationSize = memReq.size;
-    MapMemoryTypeToIndex(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &allocInfo.memoryTypeIndex);
-
-    // Allocate memory for the buffer
-    VkDeviceMemory deviceMemory;
-    CALL_VK(vkAllocateMemory(device.device, &allocInfo, nullptr, &deviceMemory));
-
-    void* data;
-    CALL_VK(vkMapMemory(device.device, deviceMemory, 0, sizeof(vertexData), 0, &data));
-    memcpy(data, vertexData, sizeof(vertexData));
-    vkUnmapMemory(device.device, deviceMemory);
-
-    CALL_VK(vkBindBufferMemory(device.device, buffers.vertexBuffer, deviceMemory, 0));
+    // Host coherent as the data is written once through the mapping without a flush
+    if (memoryAllocator->CreateBuffer(&createBufferInfo,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                      &buffers.vertexBuffer, &buffers.vertexMemory) == false) {
+        LOGE("Failed to allocate the vertex buffer");
+        return false;
+    }
+    memcpy(buffers.vertexMemory.mappedData, vertexData, sizeof(vertexData));
     return true;
 }
 
-void DeleteBuffers(void) { vkDestroyBuffer(device.device, buffers.vertexBuffer, nullptr); }
+void DeleteBuffers(void) { memoryAllocator->DestroyBuffer(buffers.vertexBuffer, &buffers.vertexMemory); }
 
 // Create Graphics Pipeline
 VkResult CreateGraphicsPipeline() {
     memset(&gfxPipeline, 0, sizeof(gfxPipeline));
 
-    const VkDescriptorSetLayoutBinding descriptorSetLayoutBinding{
-        .binding = 0,
-        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .descriptorCount = VARTIP_TEXTURE_COUNT,
-        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-        .pImmutableSamplers = nullptr,
+    // The displayed texture and the curve applied to it
+    const VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[2]{
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = VARTIP_TEXTURE_COUNT,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = nullptr,
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = nullptr,
+        },
     };
     const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
         .pNext = nullptr,
-        .bindingCount = 1,
-        .pBindings = &descriptorSetLayoutBinding,
+        .bindingCount = 2,
+        .pBindings = descriptorSetLayoutBindings,
     };
     CALL_VK(vkCreateDescriptorSetLayout(device.device, &descriptorSetLayoutCreateInfo, nullptr,
                                         &gfxPipeline.descriptorLayout));
+    // useLut of shaders/camera.frag
+    VkPushConstantRange pushConstantRange{
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .offset = 0,
+        .size = sizeof(int32_t),
+    };
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .pNext = nullptr,
         .setLayoutCount = 1,
         .pSetLayouts = &gfxPipeline.descriptorLayout,
-        .pushConstantRangeCount = 0,
-        .pPushConstantRanges = nullptr,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
     };
     CALL_VK(vkCreatePipelineLayout(device.device, &pipelineLayoutCreateInfo, nullptr, &gfxPipeline.layout));
 
@@ -655,7 +754,7 @@ VkResult CreateGraphicsPipeline() {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .pNext = nullptr,
             .stage = VK_SHADER_STAGE_VERTEX_BIT,
-            .module = LoadSPIRVShader(androidAppCtx, "shaders/camera.vert.spv", device.device),
+            .module = shaderModules->GetModule("shaders/camera.vert.spv"),
             .pSpecializationInfo = nullptr,
             .flags = 0,
             .pName = "main",
@@ -664,34 +763,32 @@ VkResult CreateGraphicsPipeline() {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .pNext = nullptr,
             .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .module = LoadSPIRVShader(androidAppCtx, "shaders/camera.frag.spv", device.device),
+            .module = shaderModules->GetModule("shaders/camera.frag.spv"),
             .pSpecializationInfo = nullptr,
             .flags = 0,
             .pName = "main",
         }};
 
-    VkViewport viewports{
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f,
-        .x = 0,
-        .y = 0,
-        .width = (float)swapchain.displaySize.width,
-        .height = (float)swapchain.displaySize.height,
-    };
-
-    VkRect2D scissor = {.extent = swapchain.displaySize,
-                        .offset = {
-                            .x = 0,
-                            .y = 0,
-                        }};
-    // Specify viewport info
+    // Specify viewport info, viewport and scissor are set while recording so the pipeline doesn't depend on the
+    // output size
     VkPipelineViewportStateCreateInfo viewportInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .pNext = nullptr,
         .viewportCount = 1,
-        .pViewports = &viewports,
+        .pViewports = nullptr,
         .scissorCount = 1,
-        .pScissors = &scissor,
+        .pScissors = nullptr,
+    };
+    VkDynamicState dynamicStates[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+    };
+    VkPipelineDynamicStateCreateInfo dynamicInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates,
     };
 
     // Specify multisample info
@@ -797,7 +894,7 @@ VkResult CreateGraphicsPipeline() {
         .pMultisampleState = &multisampleInfo,
         .pDepthStencilState = nullptr,
         .pColorBlendState = &colorBlendInfo,
-        .pDynamicState = nullptr,
+        .pDynamicState = &dynamicInfo,
         .layout = gfxPipeline.layout,
         .renderPass = render.renderPass,
         .subpass = 0,
@@ -809,8 +906,6 @@ VkResult CreateGraphicsPipeline() {
                                                         nullptr, &gfxPipeline.pipeline);
 
     // We don't need the shaders anymore, we can release their memory
-    vkDestroyShaderModule(device.device, shaderStages[0].module, nullptr);
-    vkDestroyShaderModule(device.device, shaderStages[1].module, nullptr);
 
     return pipelineResult;
 }
@@ -819,21 +914,25 @@ void DeleteGraphicsPipeline(void) {
     if (gfxPipeline.pipeline == VK_NULL_HANDLE) return;
     vkDestroyPipeline(device.device, gfxPipeline.pipeline, nullptr);
     vkDestroyPipelineCache(device.device, gfxPipeline.cache, nullptr);
-    vkFreeDescriptorSets(device.device, gfxPipeline.descriptorPool, 1, &gfxPipeline.descriptorSet);
+    for (uint32_t i = 0; i < VARTIP_FRAME_SLOT_COUNT; i++) {
+        vkFreeDescriptorSets(device.device, gfxPipeline.descriptorPool, 1, &render.slots[i].descriptorSet);
+    }
     vkDestroyDescriptorPool(device.device, gfxPipeline.descriptorPool, nullptr);
     vkDestroyPipelineLayout(device.device, gfxPipeline.layout, nullptr);
 }
 
-// initialize descriptor set
+void UpdateDescriptorSet(uint32_t slotIndex);
+
+// initialize the descriptor set of every frame slot
 VkResult CreateDescriptorSet() {
     const VkDescriptorPoolSize type_count = {
         .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .descriptorCount = VARTIP_TEXTURE_COUNT,
+        .descriptorCount = (VARTIP_TEXTURE_COUNT + 1) * VARTIP_FRAME_SLOT_COUNT,
     };
     const VkDescriptorPoolCreateInfo descriptor_pool = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         .pNext = nullptr,
-        .maxSets = 1,
+        .maxSets = VARTIP_FRAME_SLOT_COUNT,
         .poolSizeCount = 1,
         .pPoolSizes = &type_count,
     };
@@ -845,201 +944,639 @@ VkResult CreateDescriptorSet() {
                                            .descriptorPool = gfxPipeline.descriptorPool,
                                            .descriptorSetCount = 1,
                                            .pSetLayouts = &gfxPipeline.descriptorLayout};
-    CALL_VK(vkAllocateDescriptorSets(device.device, &alloc_info, &gfxPipeline.descriptorSet));
+    for (uint32_t i = 0; i < VARTIP_FRAME_SLOT_COUNT; i++) {
+        CALL_VK(vkAllocateDescriptorSets(device.device, &alloc_info, &render.slots[i].descriptorSet));
+        UpdateDescriptorSet(i);
+    }
+    return VK_SUCCESS;
+}
 
+// Points the slot's display at the camera texture, or at the filter output when there is one. The slot has to be free,
+// a descriptor set can't be written while a submitted command buffer uses it
+void UpdateDescriptorSet(uint32_t slotIndex) {
+    VkDescriptorSet descriptorSet = render.slots[slotIndex].descriptorSet;
     VkDescriptorImageInfo texDsts[VARTIP_TEXTURE_COUNT];
     memset(texDsts, 0, sizeof(texDsts));
+    const texture_object& camera = CameraTexture();
     for (int32_t idx = 0; idx < VARTIP_TEXTURE_COUNT; idx++) {
-        texDsts[idx].sampler = textures[idx].sampler;
-        texDsts[idx].imageView = textures[idx].view;
-        texDsts[idx].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    }
-
-    VkWriteDescriptorSet writeDst{.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                                  .pNext = nullptr,
-                                  .dstSet = gfxPipeline.descriptorSet,
-                                  .dstBinding = 0,
-                                  .dstArrayElement = 0,
-                                  .descriptorCount = VARTIP_TEXTURE_COUNT,
-                                  .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                  .pImageInfo = texDsts,
-                                  .pBufferInfo = nullptr,
-                                  .pTexelBufferView = nullptr};
-    vkUpdateDescriptorSets(device.device, 1, &writeDst, 0, nullptr);
-    return VK_SUCCESS;
-}
-
-uint32_t* cameraBuffer;
-
-// Initialize Vulkan Context when android application window is created upon return, vulkan is ready to draw frames
-bool InitVulkanContext(android_app* app) {
-    androidAppCtx = app;
-
-    if (InitVulkan() == false) {
-        LOGW("Vulkan dlopen is unavailable, install vulkan and re-start");
-        return false;
+        texDsts[idx].sampler = camera.sampler;
+        texDsts[idx].imageView = camera.view;
+        texDsts[idx].imageLayout = camera.imageLayout;
+    }
+    if (filterOutput != VARTIP_GRAPH_NO_RESOURCE) {
+        texDsts[0].imageView = filterGraph->GetImageView(filterOutput);
+        texDsts[0].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+    // Without a curve the binding still needs a valid image, the shader doesn't read it then
+    VkDescriptorImageInfo lutDst = texDsts[0];
+    if (filterLut != VARTIP_GRAPH_NO_RESOURCE) {
+        lutDst.sampler = filterGraph->GetSampler(VK_FILTER_NEAREST);
+        lutDst.imageView = filterGraph->GetImageView(filterLut);
+        lutDst.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
     }
 
-    cameraBuffer = (uint32_t*)malloc(725 * 725 * sizeof(uint32_t));
-
-    VkApplicationInfo appInfo = {
-        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
-        .pNext = nullptr,
-        .apiVersion = VK_MAKE_VERSION(1, 0, 0),
-        .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
-        .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-        .pApplicationName = "VARTIP",
-        .pEngineName = "null",
-    };
-
-    // create a device
-    CreateVulkanDevice(app->window, &appInfo);
-
-    CreateSwapChain();
-
-    // Create render pass
-    VkAttachmentDescription attachmentDescriptions{
-        .format = swapchain.displayFormat,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_GENERAL,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-    };
-
-    VkAttachmentReference colourReference = {.attachment = 0, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-
-    VkSubpassDescription subpassDescription{
-        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-        .flags = 0,
-        .inputAttachmentCount = 0,
-        .pInputAttachments = nullptr,
-        .colorAttachmentCount = 1,
-        .pColorAttachments = &colourReference,
-        .pResolveAttachments = nullptr,
-        .pDepthStencilAttachment = nullptr,
-        .preserveAttachmentCount = 0,
-        .pPreserveAttachments = nullptr,
+    VkWriteDescriptorSet writeDst[2]{
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .pNext = nullptr,
+         .dstSet = descriptorSet,
+         .dstBinding = 0,
+         .dstArrayElement = 0,
+         .descriptorCount = VARTIP_TEXTURE_COUNT,
+         .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         .pImageInfo = texDsts,
+         .pBufferInfo = nullptr,
+         .pTexelBufferView = nullptr},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .pNext = nullptr,
+         .dstSet = descriptorSet,
+         .dstBinding = 1,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         .pImageInfo = &lutDst,
+         .pBufferInfo = nullptr,
+         .pTexelBufferView = nullptr},
     };
-    VkRenderPassCreateInfo renderPassCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-        .pNext = nullptr,
-        .attachmentCount = 1,
-        .pAttachments = &attachmentDescriptions,
-        .subpassCount = 1,
-        .pSubpasses = &subpassDescription,
-        .dependencyCount = 0,
-        .pDependencies = nullptr,
-    };
-    CALL_VK(vkCreateRenderPass(device.device, &renderPassCreateInfo, nullptr, &render.renderPass));
-
-    CreateFrameBuffers(render.renderPass);
-    CreateTexture();
-    CreateBuffers();
-
-    // Create graphics pipeline
-    CreateGraphicsPipeline();
-
-    CreateDescriptorSet();
+    vkUpdateDescriptorSets(device.device, 2, writeDst, 0, nullptr);
+    render.slots[slotIndex].descriptorStale = false;
+}
 
-    // Create a pool of command buffers to allocate command buffer from
+// Command pool, fence, acquire semaphore and camera staging buffer of every frame slot, and the render semaphores of
+// the swapchain images. With a transfer queue every slot also gets the command pool and semaphores of its upload
+void CreateFrameSlots(void) {
     VkCommandPoolCreateInfo cmdPoolCreateInfo{
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
         .pNext = nullptr,
-        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
         .queueFamilyIndex = device.queueFamilyIndex,
     };
-    CALL_VK(vkCreateCommandPool(device.device, &cmdPoolCreateInfo, nullptr, &render.cmdPool));
-
-    // Record a command buffer that just clear the screen
-    // 1 command buffer draw in 1 framebuffer
-    // In our case we need 2 command as we have 2 framebuffer
-    render.cmdBufferLength = swapchain.swapchainLength;
-    render.cmdBuffer = new VkCommandBuffer[swapchain.swapchainLength];
-    VkCommandBufferAllocateInfo cmdBufferCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .pNext = nullptr,
-        .commandPool = render.cmdPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = render.cmdBufferLength,
-    };
-    CALL_VK(vkAllocateCommandBuffers(device.device, &cmdBufferCreateInfo, render.cmdBuffer));
-
-    for (int bufferIndex = 0; bufferIndex < swapchain.swapchainLength; bufferIndex++) {
-        // We start by creating and declare the "beginning" our command buffer
-        VkCommandBufferBeginInfo cmdBufferBeginInfo{
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .pInheritanceInfo = nullptr,
-        };
-        CALL_VK(vkBeginCommandBuffer(render.cmdBuffer[bufferIndex], &cmdBufferBeginInfo));
-
-        // Now we start a renderpass. Any draw command has to be recorded in a
-        // renderpass
-        VkClearValue clearValues{
-            .color.float32[0] = 1.0f,
-            .color.float32[1] = 0.0f,
-            .color.float32[2] = 0.0f,
-            .color.float32[3] = 1.0f,
-        };
-        VkRenderPassBeginInfo renderPassBeginInfo{.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-                                                  .pNext = nullptr,
-                                                  .renderPass = render.renderPass,
-                                                  .framebuffer = swapchain.framebuffers[bufferIndex],
-                                                  .renderArea = {.offset =
-                                                                     {
-                                                                         .x = 0,
-                                                                         .y = 0,
-                                                                     },
-                                                                 .extent = swapchain.displaySize},
-                                                  .clearValueCount = 1,
-                                                  .pClearValues = &clearValues};
-        vkCmdBeginRenderPass(render.cmdBuffer[bufferIndex], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-        // Bind what is necessary to the command buffer
-        vkCmdBindPipeline(render.cmdBuffer[bufferIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipeline.pipeline);
-        vkCmdBindDescriptorSets(render.cmdBuffer[bufferIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipeline.layout, 0,
-                                1, &gfxPipeline.descriptorSet, 0, nullptr);
-        VkDeviceSize offset = 0;
-        vkCmdBindVertexBuffers(render.cmdBuffer[bufferIndex], 0, 1, &buffers.vertexBuffer, &offset);
-
-        // Draw quad
-        vkCmdDraw(render.cmdBuffer[bufferIndex], 6, 1, 0, 0);
-
-        vkCmdEndRenderPass(render.cmdBuffer[bufferIndex]);
-        CALL_VK(vkEndCommandBuffer(render.cmdBuffer[bufferIndex]));
-    }
-
-    // We need to create a fence to be able, in the main loop, to wait for our
-    // draw command(s) to finish before swapping the framebuffers
     VkFenceCreateInfo fenceCreateInfo{
         .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
         .pNext = nullptr,
-        .flags = 0,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
     };
-    CALL_VK(vkCreateFence(device.device, &fenceCreateInfo, nullptr, &render.fence));
-
-    // We need to create a semaphore to be able to wait, in the main loop, for our
-    // framebuffer to be available for us before drawing.
     VkSemaphoreCreateInfo semaphoreCreateInfo{
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
     };
-    CALL_VK(vkCreateSemaphore(device.device, &semaphoreCreateInfo, nullptr, &render.semaphore));
+    VkBufferCreateInfo stagingCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = nullptr,
+        .size = imgWidth * imgHeight * 4,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .flags = 0,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .pQueueFamilyIndices = &device.queueFamilyIndex,
+        .queueFamilyIndexCount = 1,
+    };
 
-    device.initialized = true;
-    return true;
-}
+    for (uint32_t i = 0; i < VARTIP_FRAME_SLOT_COUNT; i++) {
+        VulkanFrameSlot& slot = render.slots[i];
+        CALL_VK(vkCreateCommandPool(device.device, &cmdPoolCreateInfo, nullptr, &slot.cmdPool));
+        VkCommandBufferAllocateInfo cmdBufferCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .commandPool = slot.cmdPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        CALL_VK(vkAllocateCommandBuffers(device.device, &cmdBufferCreateInfo, &slot.cmdBuffer));
+        CALL_VK(vkCreateFence(device.device, &fenceCreateInfo, nullptr, &slot.fence));
+        CALL_VK(vkCreateSemaphore(device.device, &semaphoreCreateInfo, nullptr, &slot.acquireSemaphore));
+        if (UsesTransferQueue()) {
+            VkCommandPoolCreateInfo uploadPoolCreateInfo = cmdPoolCreateInfo;
+            uploadPoolCreateInfo.queueFamilyIndex = device.transferQueueFamilyIndex;
+            CALL_VK(vkCreateCommandPool(device.device, &uploadPoolCreateInfo, nullptr, &slot.uploadCmdPool));
+            cmdBufferCreateInfo.commandPool = slot.uploadCmdPool;
+            CALL_VK(vkAllocateCommandBuffers(device.device, &cmdBufferCreateInfo, &slot.uploadCmdBuffer));
+            CALL_VK(vkCreateSemaphore(device.device, &semaphoreCreateInfo, nullptr, &slot.uploadSemaphore));
+            CALL_VK(vkCreateSemaphore(device.device, &semaphoreCreateInfo, nullptr, &slot.releaseSemaphore));
+        }
 
-// InitCamera:
-// Sets camera and get a working capture request
-void InitCamera() {
-    m_nativeCamera = new NativeCamera();
+        // Written by the CPU every frame without flushes so it needs to be coherent
+        bool allocated = memoryAllocator->CreateBuffer(
+            &stagingCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &slot.stagingBuffer, &slot.stagingMemory);
+        ASSERT(allocated, "Failed to allocate the camera staging buffer %u", i);
+    }
+    render.currentSlot = 0;
+    render.pendingRelease = VK_NULL_HANDLE;
+    // Offscreen images are not presented, nothing signals or waits on theirs
+    render.renderSemaphores.resize(offscreen.enabled ? 0 : swapchain.swapchainLength);
+    for (VkSemaphore& semaphore : render.renderSemaphores) {
+        CALL_VK(vkCreateSemaphore(device.device, &semaphoreCreateInfo, nullptr, &semaphore));
+    }
+    readbackRing = new ReadbackRing(device.gpuDevice, device.device, memoryAllocator, VARTIP_FRAME_SLOT_COUNT);
+}
 
-    m_nativeCamera->MatchCaptureSizeRequest(&m_view, 720, 480);
+void DeleteFrameSlots(void) {
+    for (uint32_t i = 0; i < VARTIP_FRAME_SLOT_COUNT; i++) {
+        VulkanFrameSlot& slot = render.slots[i];
+        vkFreeCommandBuffers(device.device, slot.cmdPool, 1, &slot.cmdBuffer);
+        vkDestroyCommandPool(device.device, slot.cmdPool, nullptr);
+        vkDestroyFence(device.device, slot.fence, nullptr);
+        vkDestroySemaphore(device.device, slot.acquireSemaphore, nullptr);
+        if (UsesTransferQueue()) {
+            vkFreeCommandBuffers(device.device, slot.uploadCmdPool, 1, &slot.uploadCmdBuffer);
+            vkDestroyCommandPool(device.device, slot.uploadCmdPool, nullptr);
+            vkDestroySemaphore(device.device, slot.uploadSemaphore, nullptr);
+            vkDestroySemaphore(device.device, slot.releaseSemaphore, nullptr);
+        }
+        memoryAllocator->DestroyBuffer(slot.stagingBuffer, &slot.stagingMemory);
+    }
+    for (VkSemaphore semaphore : render.renderSemaphores) {
+        vkDestroySemaphore(device.device, semaphore, nullptr);
+    }
+    render.renderSemaphores.clear();
+    readbackRing->LogStats();
+    delete readbackRing;
+    readbackRing = nullptr;
+}
+
+// Readback callbacks, run on the render thread once the frame that copied them out is done
+void OnHistogramReadback(const ReadbackResult& result) {
+    memcpy(lumaHistogram.bins, result.data, sizeof(lumaHistogram.bins));
+    if (lumaHistogram.count++ % VARTIP_EXPOSURE_LOG_FRAMES == 0) {
+        LumaHistogramStats stats;
+        AnalyzeLumaHistogram(lumaHistogram.bins, &stats);
+        LOGI("Exposure: mean luma %.3f, 5%%-95%% %u-%u, %.1f%% black, %.1f%% white", stats.mean, stats.lowPercentile,
+             stats.highPercentile, stats.underexposed * 100.0f, stats.overexposed * 100.0f);
+    }
+}
+
+void OnFlowReadback(const ReadbackResult& result) {
+    flowTracks.pointCount = static_cast<uint32_t>(result.size / sizeof(FlowPoint));
+    memcpy(flowTracks.points, result.data, flowTracks.pointCount * sizeof(FlowPoint));
+    if (flowTracks.count++ % VARTIP_FLOW_LOG_FRAMES == 0) {
+        uint32_t tracked = 0;
+        uint32_t lost = 0;
+        float motion = 0.0f;
+        for (uint32_t i = 0; i < flowTracks.pointCount; i++) {
+            const FlowPoint& point = flowTracks.points[i];
+            if (point.status == FLOW_POINT_TRACKED) {
+                tracked++;
+                motion += sqrtf(point.dx * point.dx + point.dy * point.dy);
+            }
+            lost += (point.status == FLOW_POINT_LOST) ? 1 : 0;
+        }
+        LOGI("Flow: %u of %u points tracked, %u lost, mean motion %.2f pixels", tracked, flowTracks.pointCount, lost,
+             tracked > 0 ? motion / tracked : 0.0f);
+    }
+}
+
+void OnKeypointReadback(const ReadbackResult& result) {
+    const KeypointHeader* header = static_cast<const KeypointHeader*>(result.data);
+    keypointList.found = header->count;
+    keypointList.keypointCount = std::min(header->count, static_cast<uint32_t>(VARTIP_FAST_MAX_KEYPOINTS));
+    memcpy(keypointList.keypoints, header + 1, keypointList.keypointCount * sizeof(Keypoint));
+    if (keypointList.count++ % VARTIP_KEYPOINT_LOG_FRAMES == 0) {
+        LOGI("Keypoints: %u corners%s", keypointList.found,
+             keypointList.found > keypointList.keypointCount ? ", the buffer overflowed" : "");
+    }
+}
+
+void OnFilterOutputReadback(const ReadbackResult& result) {
+    const uint8_t* pixels = static_cast<const uint8_t*>(result.data);
+    filterReadbackPixels.assign(pixels, pixels + result.size);
+}
+
+// Copies out what the CPU reads of the filters, at the end of the frame so nothing else waits on them
+void RecordFilterReadbacks(VkCommandBuffer cmdBuffer, uint32_t slotIndex) {
+    if (filterGraph == nullptr) {
+        return;
+    }
+    if (filterHistogram != VARTIP_GRAPH_NO_RESOURCE) {
+        readbackRing->CopyBuffer(cmdBuffer, slotIndex, filterGraph->GetBuffer(filterHistogram), 0,
+                                 VARTIP_HISTOGRAM_BINS * sizeof(uint32_t), OnHistogramReadback);
+    }
+    if (filterFlowPoints != VARTIP_GRAPH_NO_RESOURCE) {
+        readbackRing->CopyBuffer(cmdBuffer, slotIndex, filterGraph->GetBuffer(filterFlowPoints), 0,
+                                 filterGraph->GetBufferSize(filterFlowPoints), OnFlowReadback);
+    }
+    if (filterKeypoints != VARTIP_GRAPH_NO_RESOURCE) {
+        readbackRing->CopyBuffer(cmdBuffer, slotIndex, filterGraph->GetBuffer(filterKeypoints), 0,
+                                 filterGraph->GetBufferSize(filterKeypoints), OnKeypointReadback);
+    }
+    if (filterReadback) {
+        VkExtent2D extent = filterGraph->GetExtent(filterOutput);
+        readbackRing->CopyImage(cmdBuffer, slotIndex, filterGraph->GetImage(filterOutput), VK_IMAGE_LAYOUT_GENERAL,
+                                extent.width, extent.height, 4, OnFilterOutputReadback);
+    }
+}
+
+// Stages reading the camera texture: the draw samples it, the filter graph's compute and transfer passes read it
+#define VARTIP_CAMERA_READ_STAGES \
+    (VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT)
+
+// Upload of the slot's staging buffer into the camera texture of the conversion step. The whole image is overwritten
+// so its previous content is discarded by transitioning from UNDEFINED, after every stage that read it last frame.
+// On the graphics queue it is recorded into the frame's command buffer, on a transfer queue into the slot's upload
+// one which ends by releasing the texture to the graphics family, see SubmitCameraUpload
+void RecordCameraUpload(VkCommandBuffer cmdBuffer, VulkanFrameSlot& slot) {
+    const texture_object& camera = CameraTexture();
+    bool transferQueue = UsesTransferQueue();
+    VkImageMemoryBarrier imageBarrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = camera.image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    // On the transfer queue the earlier reads are behind the semaphore it waits on at the transfer stage
+    vkCmdPipelineBarrier(cmdBuffer, transferQueue ? VK_PIPELINE_STAGE_TRANSFER_BIT : VARTIP_CAMERA_READ_STAGES,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+    VkBufferImageCopy copyRegion{
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .imageOffset = {0, 0, 0},
+        .imageExtent = {static_cast<uint32_t>(camera.texWidth), static_cast<uint32_t>(camera.texHeight), 1},
+    };
+    vkCmdCopyBufferToImage(cmdBuffer, slot.stagingBuffer, camera.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                           &copyRegion);
+
+    imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier.newLayout = camera.imageLayout;
+    if (transferQueue) {
+        // Release, the graphics queue makes it visible with the matching acquire in RecordCameraAcquire
+        imageBarrier.dstAccessMask = 0;
+        imageBarrier.srcQueueFamilyIndex = device.transferQueueFamilyIndex;
+        imageBarrier.dstQueueFamilyIndex = device.queueFamilyIndex;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                             nullptr, 0, nullptr, 1, &imageBarrier);
+        return;
+    }
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+                         nullptr, 0, nullptr, 1, &imageBarrier);
+}
+
+// Acquire of the camera texture the transfer queue released, the frame's submit waits on the upload semaphore at the
+// stages the barrier starts from
+void RecordCameraAcquire(VkCommandBuffer cmdBuffer) {
+    VkImageMemoryBarrier imageBarrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = CameraTexture().imageLayout,
+        .srcQueueFamilyIndex = device.transferQueueFamilyIndex,
+        .dstQueueFamilyIndex = device.queueFamilyIndex,
+        .image = CameraTexture().image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    vkCmdPipelineBarrier(cmdBuffer, VARTIP_CAMERA_READ_STAGES, VARTIP_CAMERA_READ_STAGES, 0, 0, nullptr, 0, nullptr, 1,
+                         &imageBarrier);
+}
+
+// Records and submits the slot's upload on the transfer queue. The camera textures are shared by the slots, it waits
+// for the previous frame to be done with them. The slot's fence covers it since the frame's submit waits on it
+void SubmitCameraUpload(VulkanFrameSlot& slot) {
+    CALL_VK(vkResetCommandPool(device.device, slot.uploadCmdPool, 0));
+    VkCommandBufferBeginInfo cmdBufferBeginInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr,
+    };
+    CALL_VK(vkBeginCommandBuffer(slot.uploadCmdBuffer, &cmdBufferBeginInfo));
+    RecordCameraUpload(slot.uploadCmdBuffer, slot);
+    CALL_VK(vkEndCommandBuffer(slot.uploadCmdBuffer));
+
+    VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkSubmitInfo submitInfo = {.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                               .pNext = nullptr,
+                               .waitSemaphoreCount = render.pendingRelease != VK_NULL_HANDLE ? 1u : 0u,
+                               .pWaitSemaphores = &render.pendingRelease,
+                               .pWaitDstStageMask = &waitStageMask,
+                               .commandBufferCount = 1,
+                               .pCommandBuffers = &slot.uploadCmdBuffer,
+                               .signalSemaphoreCount = 1,
+                               .pSignalSemaphores = &slot.uploadSemaphore};
+    CALL_VK(vkQueueSubmit(device.transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+    render.pendingRelease = VK_NULL_HANDLE;
+}
+
+// Records everything the frame in slotIndex draws into the framebuffer imageIndex, called every frame so anything
+// that changes between frames (output size, clear color, enabled passes) is just recorded differently
+void RecordFrameCommands(uint32_t slotIndex, uint32_t imageIndex) {
+    VARTIP_CPU_ZONE("record");
+    VulkanFrameSlot& slot = render.slots[slotIndex];
+    VkCommandBuffer cmdBuffer = slot.cmdBuffer;
+
+    VkCommandBufferBeginInfo cmdBufferBeginInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr,
+    };
+    CALL_VK(vkBeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo));
+    gpuProfiler->BeginCommands(cmdBuffer, slotIndex);
+    uint32_t frameScope = gpuProfiler->BeginScope(cmdBuffer, slotIndex, "frame");
+
+    // On the transfer queue the upload is not in the frame's timestamps, the frame only acquires its result
+    if (UsesTransferQueue()) {
+        RecordCameraAcquire(cmdBuffer);
+    } else {
+        uint32_t uploadScope = gpuProfiler->BeginScope(cmdBuffer, slotIndex, "upload");
+        RecordCameraUpload(cmdBuffer, slot);
+        gpuProfiler->EndScope(cmdBuffer, slotIndex, uploadScope);
+    }
+
+    if (filterGraph != nullptr) {
+        filterGraph->Execute(cmdBuffer, gpuProfiler, slotIndex);
+    }
+    if (perfHud != nullptr) {
+        perfHud->RecordUpload(cmdBuffer);
+    }
+    uint32_t renderPassScope = gpuProfiler->BeginScope(cmdBuffer, slotIndex, "render pass");
+    VkClearValue clearValues{
+        .color = render.clearColor,
+    };
+    VkRenderPassBeginInfo renderPassBeginInfo{.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                                              .pNext = nullptr,
+                                              .renderPass = render.renderPass,
+                                              .framebuffer = swapchain.framebuffers[imageIndex],
+                                              .renderArea = {.offset =
+                                                                 {
+                                                                     .x = 0,
+                                                                     .y = 0,
+                                                                 },
+                                                             .extent = swapchain.displaySize},
+                                              .clearValueCount = 1,
+                                              .pClearValues = &clearValues};
+    vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport{
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+        .x = 0,
+        .y = 0,
+        .width = (float)swapchain.displaySize.width,
+        .height = (float)swapchain.displaySize.height,
+    };
+    VkRect2D scissor = {.extent = swapchain.displaySize,
+                        .offset = {
+                            .x = 0,
+                            .y = 0,
+                        }};
+    vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+    // Bind what is necessary to the command buffer
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipeline.pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipeline.layout, 0, 1,
+                            &slot.descriptorSet, 0, nullptr);
+    int32_t useLut = (filterLut != VARTIP_GRAPH_NO_RESOURCE) ? 1 : 0;
+    vkCmdPushConstants(cmdBuffer, gfxPipeline.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(useLut), &useLut);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &buffers.vertexBuffer, &offset);
+
+    // Draw quad
+    vkCmdDraw(cmdBuffer, 6, 1, 0, 0);
+
+    // Overlay on top of it, timed on its own to keep it within VARTIP_HUD_BUDGET_MS
+    if (perfHud != nullptr) {
+        uint32_t hudScope = gpuProfiler->BeginScope(cmdBuffer, slotIndex, VARTIP_HUD_SCOPE);
+        perfHud->RecordDraw(cmdBuffer, slotIndex);
+        gpuProfiler->EndScope(cmdBuffer, slotIndex, hudScope);
+    }
+
+    vkCmdEndRenderPass(cmdBuffer);
+    gpuProfiler->EndScope(cmdBuffer, slotIndex, renderPassScope);
+
+    uint32_t readbackScope = gpuProfiler->BeginScope(cmdBuffer, slotIndex, "readback");
+    RecordFilterReadbacks(cmdBuffer, slotIndex);
+    readbackRing->EndFrame(cmdBuffer, slotIndex);
+    if (offscreen.readback) {
+        VkBufferImageCopy copyRegion{
+            .bufferOffset = 0,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+            .imageOffset = {0, 0, 0},
+            .imageExtent = {swapchain.displaySize.width, swapchain.displaySize.height, 1},
+        };
+        vkCmdCopyImageToBuffer(cmdBuffer, offscreen.images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               offscreen.readbackBuffers[imageIndex], 1, &copyRegion);
+
+        // Make the copy visible to the host once the fence signals
+        VkMemoryBarrier hostBarrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        };
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier,
+                             0, nullptr, 0, nullptr);
+    }
+    gpuProfiler->EndScope(cmdBuffer, slotIndex, readbackScope);
+    gpuProfiler->EndScope(cmdBuffer, slotIndex, frameScope);
+    CALL_VK(vkEndCommandBuffer(cmdBuffer));
+}
+
+// Builds the filters of filterList on top of the camera texture
+void CreateFilterGraph(const char* filterList) {
+    filterGraph = nullptr;
+    filterOutput = VARTIP_GRAPH_NO_RESOURCE;
+    filterLut = VARTIP_GRAPH_NO_RESOURCE;
+    filterHistogram = VARTIP_GRAPH_NO_RESOURCE;
+    filterFlowPoints = VARTIP_GRAPH_NO_RESOURCE;
+    filterKeypoints = VARTIP_GRAPH_NO_RESOURCE;
+    filterReadback = false;
+
+    FilterGraph* graph = new FilterGraph(device.device, memoryAllocator);
+    FilterContext context{
+        .assets = &assetSource,
+        .gpuDevice = device.gpuDevice,
+        .device = device.device,
+        .graph = graph,
+        .kernelVariants = kernelVariants,
+        .fusePointwise = fusePointwise,
+    };
+    const texture_object& cameraTexture = CameraTexture();
+    GraphResource camera = graph->ImportImage("camera", cameraTexture.image, cameraTexture.view, kTextureFormat,
+                                              cameraTexture.texWidth, cameraTexture.texHeight,
+                                              VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    FilterChainOutputs outputs = BuildFilterChain(&context, camera, filterList);
+    if (outputs.image == VARTIP_GRAPH_NO_RESOURCE && outputs.lut == VARTIP_GRAPH_NO_RESOURCE &&
+        outputs.histogram == VARTIP_GRAPH_NO_RESOURCE && outputs.flowPoints == VARTIP_GRAPH_NO_RESOURCE &&
+        outputs.keypoints == VARTIP_GRAPH_NO_RESOURCE) {
+        delete graph;
+        return;
+    }
+    if (outputs.image != VARTIP_GRAPH_NO_RESOURCE && offscreen.readback) {
+        graph->MarkOutput(outputs.image, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                          VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+    } else if (outputs.image != VARTIP_GRAPH_NO_RESOURCE) {
+        graph->MarkOutput(outputs.image, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+    if (outputs.lut != VARTIP_GRAPH_NO_RESOURCE) {
+        graph->MarkOutput(outputs.lut, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+    if (outputs.histogram != VARTIP_GRAPH_NO_RESOURCE) {
+        graph->MarkOutput(outputs.histogram, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    }
+    if (outputs.flowPoints != VARTIP_GRAPH_NO_RESOURCE) {
+        graph->MarkOutput(outputs.flowPoints, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    }
+    if (outputs.keypoints != VARTIP_GRAPH_NO_RESOURCE) {
+        graph->MarkOutput(outputs.keypoints, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    }
+    if (graph->Compile() == false) {
+        LOGE("Filters %s disabled, the graph failed to compile", filterList);
+        delete graph;
+        return;
+    }
+    graph->LogStats();
+    kernelVariants->LogStats();
+    filterGraph = graph;
+    filterOutput = outputs.image;
+    filterLut = outputs.lut;
+    filterHistogram = outputs.histogram;
+    filterFlowPoints = outputs.flowPoints;
+    filterKeypoints = outputs.keypoints;
+    if (filterFlowPoints != VARTIP_GRAPH_NO_RESOURCE) {
+        flowTracks.pointCount = static_cast<uint32_t>(graph->GetBufferSize(filterFlowPoints) / sizeof(FlowPoint));
+    }
+
+    filterReadback = (filterOutput != VARTIP_GRAPH_NO_RESOURCE && offscreen.readback);
+}
+
+// Filters named by debug.vartip.filters, none when it isn't set
+void CreateFilterGraph(void) {
+    filterGraph = nullptr;
+    filterOutput = VARTIP_GRAPH_NO_RESOURCE;
+    filterLut = VARTIP_GRAPH_NO_RESOURCE;
+    filterHistogram = VARTIP_GRAPH_NO_RESOURCE;
+    filterFlowPoints = VARTIP_GRAPH_NO_RESOURCE;
+    filterKeypoints = VARTIP_GRAPH_NO_RESOURCE;
+    filterReadback = false;
+    char fuse[8];
+    fusePointwise = !GetDebugOption(VARTIP_FUSE_ENV, VARTIP_FUSE_PROPERTY, fuse, sizeof(fuse)) || atoi(fuse) != 0;
+    char filterList[256];
+    if (GetDebugOption(VARTIP_FILTERS_ENV, VARTIP_FILTERS_PROPERTY, filterList, sizeof(filterList))) {
+        CreateFilterGraph(filterList);
+    }
+}
+
+void DeleteFilterGraph(void) {
+    filterReadback = false;
+    if (filterGraph != nullptr) {
+        delete filterGraph;
+        filterGraph = nullptr;
+    }
+    filterOutput = VARTIP_GRAPH_NO_RESOURCE;
+    filterLut = VARTIP_GRAPH_NO_RESOURCE;
+    filterHistogram = VARTIP_GRAPH_NO_RESOURCE;
+    filterFlowPoints = VARTIP_GRAPH_NO_RESOURCE;
+    filterKeypoints = VARTIP_GRAPH_NO_RESOURCE;
+}
+
+// Deletes the retired filter graphs no frame in flight uses anymore, slotIndex is the slot whose fence was just waited
+// for
+void ReleaseRetiredFilterGraphs(uint32_t slotIndex) {
+    for (uint32_t i = 0; i < retiredFilterGraphs.size();) {
+        retiredFilterGraphs[i].pendingSlots &= ~(1u << slotIndex);
+        if (retiredFilterGraphs[i].pendingSlots == 0) {
+            delete retiredFilterGraphs[i].graph;
+            retiredFilterGraphs.erase(retiredFilterGraphs.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+// Swaps the filters while the renderer runs, nothing waits for the GPU. The frames in flight keep the old graph, it is
+// deleted once their slots came around, and every slot points its descriptor set at the new one before recording
+void RebuildFilterGraph(const char* filterList) {
+    if (filterGraph != nullptr) {
+        retiredFilterGraphs.push_back({filterGraph, (1u << VARTIP_FRAME_SLOT_COUNT) - 1});
+        filterGraph = nullptr;
+    }
+    CreateFilterGraph(filterList);
+    for (uint32_t i = 0; i < VARTIP_FRAME_SLOT_COUNT; i++) {
+        render.slots[i].descriptorStale = true;
+    }
+}
+
+// Takes the governor's level from the next frame on. The filters are only rebuilt when the level changes them or the
+// conversion step, they are built on the camera texture of the step
+void ApplyGovernedQuality(void) {
+    const QualityLevel& level = qualityGovernor->GetLevel();
+    uint32_t previousStep = conversionStep;
+    conversionStep = level.conversionStep;
+    if (offscreen.frameSource != nullptr) {
+        offscreen.frameSource->SetConversionStep(conversionStep);
+    }
+#ifdef __ANDROID__
+    if (m_imageReader != nullptr) {
+        m_imageReader->SetConversionStep(conversionStep);
+    }
+#endif
+    std::string filters = ApplyQualityLevel(governedFilters.c_str(), level);
+    if (filters != appliedFilters || conversionStep != previousStep) {
+        RebuildFilterGraph(filters.c_str());
+        appliedFilters = filters;
+    }
+}
+
+#ifdef __ANDROID__
+// Takes the sensor timestamp of the frame just presented, the profile's latencies are logged once it has all its
+// frames and the next profile is streamed
+static void AddCaptureLatency(int64_t sensorNs) {
+    if (captureBenchmark.skippedFrames < VARTIP_CAPTURE_WARMUP_FRAMES) {
+        captureBenchmark.skippedFrames++;
+        return;
+    }
+    timespec now;
+    clock_gettime(m_nativeCamera->IsTimestampRealtime() ? CLOCK_BOOTTIME : CLOCK_MONOTONIC, &now);
+    int64_t nowNs = static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+    std::vector<double>& latency = captureBenchmark.latencyMs;
+    latency.push_back((nowNs - sensorNs) / 1e6);
+    if (latency.size() < captureBenchmark.framesPerProfile) {
+        return;
+    }
+
+    std::sort(latency.begin(), latency.end());
+    double totalMs = 0.0;
+    for (double ms : latency) {
+        totalMs += ms;
+    }
+    LOGI("Capture %s: sensor to present %.2f ms mean, %.2f ms p50, %.2f ms p95, %.2f ms max over %zu frames",
+         GetCaptureProfile(captureBenchmark.profileIndex).name, totalMs / latency.size(), latency[latency.size() / 2],
+         latency[latency.size() * 95 / 100], latency.back(), latency.size());
+    latency.clear();
+    captureBenchmark.skippedFrames = 0;
+
+    if (++captureBenchmark.profileIndex < GetCaptureProfileCount()) {
+        m_nativeCamera->SetCaptureProfile(GetCaptureProfile(captureBenchmark.profileIndex));
+    } else {
+        captureBenchmark.framesPerProfile = 0;
+        m_nativeCamera->SetCaptureProfile(*captureBenchmark.configuredProfile);
+    }
+}
+
+// InitCamera:
+// Sets camera and get a working capture request
+// Runs on its own thread during startup as it does not touch any Vulkan state
+void InitCamera() {
+    VARTIP_CPU_THREAD_NAME("camera");
+    VARTIP_CPU_ZONE("camera open");
+    double cameraStart = GetTimeMs();
+    m_nativeCamera = new NativeCamera();
+
+    m_nativeCamera->MatchCaptureSizeRequest(&m_view, 720, 480);
 
     ASSERT(m_view.width && m_view.height, "Could not find supportable resolution");
 
@@ -1050,13 +1587,205 @@ void InitCamera() {
 
     m_cameraReady = m_nativeCamera->CreateCaptureSession(imageReaderWindow);
 
+    char value[PROP_VALUE_MAX];
+    captureBenchmark.framesPerProfile = 0;
+    if (GetDebugOption(VARTIP_BENCH_CAPTURE_ENV, VARTIP_BENCH_CAPTURE_PROPERTY, value, sizeof(value)) &&
+        atoi(value) > 0) {
+        captureBenchmark.framesPerProfile = atoi(value);
+        captureBenchmark.profileIndex = 0;
+        captureBenchmark.skippedFrames = 0;
+        captureBenchmark.latencyMs.clear();
+        captureBenchmark.configuredProfile = &m_nativeCamera->GetCaptureProfile();
+        if (!m_nativeCamera->IsTimestampRealtime()) {
+            LOGW("Camera timestamps are not on CLOCK_BOOTTIME, capture latencies are against CLOCK_MONOTONIC and may "
+                 "be off by a constant");
+        }
+        m_nativeCamera->SetCaptureProfile(GetCaptureProfile(0));
+    }
+
     // m_imageReader->SetImageVk(&VulkanDrawFrame);
+    startupTiming.cameraMs = GetTimeMs() - cameraStart;
+}
+#endif
+
+uint32_t* cameraBuffer;
+
+// Shared by the windowed and the headless path, upon return vulkan is ready to draw frames
+// Startup is split so the independent pieces overlap:
+//   camera thread:   open camera, match stream size, create capture session (not used headless)
+//   pipeline thread: load shader modules, create the graphics pipeline (needs the render pass)
+//   this thread:     device, swapchain, render pass, framebuffers, texture, filter graph and buffers
+// Descriptor set creation joins on the pipeline, and the camera is joined before returning. Without a window it is
+// headless and renders width x height offscreen
+bool InitVulkanRenderer(ANativeWindow* window, uint32_t width, uint32_t height) {
+    bool headless = (window == nullptr);
+    memset(&startupTiming, 0, sizeof(startupTiming));
+    startupTiming.startMs = GetTimeMs();
+    memset(&frameTiming, 0, sizeof(frameTiming));
+    offscreen.enabled = headless;
+
+    if (InitVulkan() == false) {
+        LOGW("Vulkan dlopen is unavailable, install vulkan and re-start");
+        return false;
+    }
+
+    std::thread cameraThread;
+    if (headless) {
+        offscreen.frameSource = new SyntheticFrameSource(imgWidth, imgHeight);
+    } else {
+#ifdef __ANDROID__
+        cameraThread = std::thread(InitCamera);
+#endif
+    }
+
+    cameraBuffer = (uint32_t*)malloc(725 * 725 * sizeof(uint32_t));
+
+    VkApplicationInfo appInfo = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pNext = nullptr,
+        .apiVersion = VK_MAKE_VERSION(1, 0, 0),
+        .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
+        .engineVersion = VK_MAKE_VERSION(1, 0, 0),
+        .pApplicationName = "VARTIP",
+        .pEngineName = "null",
+    };
+
+    // create a device
+    CreateVulkanDevice(window, &appInfo);
+
+    if (headless) {
+        CreateOffscreenTargets(width, height);
+    } else {
+        CreateSwapChain();
+    }
+    gpuProfiler = new GpuProfiler(device.gpuDevice, device.device, device.queueFamilyIndex, VARTIP_FRAME_SLOT_COUNT);
+
+    // Create render pass, offscreen images end up ready to be copied out instead of presented
+    VkAttachmentDescription attachmentDescriptions{
+        .format = swapchain.displayFormat,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = headless ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_GENERAL,
+        .finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+    };
+
+    VkAttachmentReference colourReference = {.attachment = 0, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription subpassDescription{
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .flags = 0,
+        .inputAttachmentCount = 0,
+        .pInputAttachments = nullptr,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colourReference,
+        .pResolveAttachments = nullptr,
+        .pDepthStencilAttachment = nullptr,
+        .preserveAttachmentCount = 0,
+        .pPreserveAttachments = nullptr,
+    };
+    VkRenderPassCreateInfo renderPassCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .pNext = nullptr,
+        .attachmentCount = 1,
+        .pAttachments = &attachmentDescriptions,
+        .subpassCount = 1,
+        .pSubpasses = &subpassDescription,
+        .dependencyCount = 0,
+        .pDependencies = nullptr,
+    };
+    CALL_VK(vkCreateRenderPass(device.device, &renderPassCreateInfo, nullptr, &render.renderPass));
+
+    // Create graphics pipeline, shader loading and compilation overlaps with the resource creation below
+    shaderModules = new ShaderModuleCache(assetSource, device.device);
+    std::thread pipelineThread([]() {
+        VARTIP_CPU_THREAD_NAME("pipeline");
+        VARTIP_CPU_ZONE("graphics pipeline");
+        double pipelineStart = GetTimeMs();
+        CALL_VK(CreateGraphicsPipeline());
+        startupTiming.pipelineMs = GetTimeMs() - pipelineStart;
+    });
+
+    CreateFrameBuffers(render.renderPass);
+    CreateTexture();
+    double filtersStart = GetTimeMs();
+    kernelVariants = new KernelVariantCache(shaderModules, device.device);
+    CreateFilterGraph();
+    startupTiming.filtersMs = GetTimeMs() - filtersStart;
+    ASSERT(CreateBuffers(), "Failed to create the vertex buffer");
+    memoryAllocator->LogStats();
+
+    // Command buffers are recorded per frame from the slot pools
+    CreateFrameSlots();
+    frameTiming = FrameTimingInfo{};
+    render.clearColor = {.float32 = {0.0f, 0.0f, 0.0f, 1.0f}};
+
+    char hudOption[32];
+    perfHud = nullptr;
+    if (GetDebugOption(VARTIP_HUD_ENV, VARTIP_HUD_PROPERTY, hudOption, sizeof(hudOption))) {
+        perfHud =
+            new PerfHud(device.device, memoryAllocator, shaderModules, render.renderPass, VARTIP_FRAME_SLOT_COUNT);
+    }
+
+    char governorOption[32];
+    qualityGovernor = nullptr;
+    conversionStep = 1;
+    if (GetDebugOption(VARTIP_GOVERNOR_ENV, VARTIP_GOVERNOR_PROPERTY, governorOption, sizeof(governorOption))) {
+        qualityGovernor = new QualityGovernor(atof(governorOption));
+        char filterList[256];
+        bool hasFilters = GetDebugOption(VARTIP_FILTERS_ENV, VARTIP_FILTERS_PROPERTY, filterList, sizeof(filterList));
+        governedFilters = hasFilters ? filterList : "";
+        appliedFilters = governedFilters;
+        LOGI("Quality governor keeps frames under %.2f ms", qualityGovernor->GetTargetMs());
+    }
+
+    // Descriptor set needs the pipeline layout
+    pipelineThread.join();
+    CreateDescriptorSet();
+    startupTiming.contextMs = GetTimeMs() - startupTiming.startMs;
+
+    // The first frame needs the image reader so wait for the camera here
+    if (cameraThread.joinable()) {
+        cameraThread.join();
+    }
+    KernelVariantStats variantStats = kernelVariants->GetStats();
+    LOGI("Startup: vulkan context %.2f ms, pipeline %.2f ms, %u filter kernels %.2f ms, camera %.2f ms, joined after "
+         "%.2f ms",
+         startupTiming.contextMs, startupTiming.pipelineMs, variantStats.requestCount, startupTiming.filtersMs,
+         startupTiming.cameraMs, GetTimeMs() - startupTiming.startMs);
+    shaderModules->LogStats();
+
+    device.initialized = true;
+    return true;
+}
+
+#ifdef __ANDROID__
+// Initialize Vulkan Context when android application window is created
+bool InitVulkanContext(android_app* app) {
+    assetSource.assetManager = app->activity->assetManager;
+    dataDirectory = app->activity->internalDataPath;
+    return InitVulkanRenderer(app->window, 0, 0);
+}
+#endif
+
+bool InitVulkanHeadless(const AssetSource& assets, const char* dataDir, uint32_t width, uint32_t height,
+                        bool readback) {
+    assetSource = assets;
+    dataDirectory = dataDir;
+    offscreen.readback = readback;
+    return InitVulkanRenderer(nullptr, width, height);
 }
 
 // IsVulkanReady():
 //    native app poll to see if we are ready to draw...
 bool IsVulkanReady(void) { return device.initialized; }
 
+#ifdef __ANDROID__
+FrameEvent* GetCameraFrameEvent(void) { return (m_imageReader != nullptr) ? m_imageReader->GetFrameEvent() : nullptr; }
+#endif
+
 void DeleteSwapChain() {
     for (int i = 0; i < swapchain.swapchainLength; i++) {
         vkDestroyFramebuffer(device.device, swapchain.framebuffers[i], nullptr);
@@ -1065,86 +1794,250 @@ void DeleteSwapChain() {
     delete[] swapchain.framebuffers;
     delete[] swapchain.imageViews;
 
-    vkDestroySwapchainKHR(device.device, swapchain.swapchain, nullptr);
+    if (offscreen.enabled) {
+        DeleteOffscreenTargets();
+    } else {
+        vkDestroySwapchainKHR(device.device, swapchain.swapchain, nullptr);
+    }
+}
+
+// debug.vartip.trace set to a path, or to anything to use the data directory
+void WriteTraceIfRequested() {
+    char value[256];
+    if (GetDebugOption(VARTIP_TRACE_ENV, VARTIP_TRACE_PROPERTY, value, sizeof(value)) == false) {
+        return;
+    }
+
+    std::string path = value;
+    if (path.find('/') == std::string::npos) {
+        path = dataDirectory + "/vartip_trace.json";
+    }
+    gpuProfiler->WriteChromeTrace(path.c_str());
+}
+
+// Average and worst command buffer recording time of the context against VARTIP_RECORD_BUDGET_US
+void LogRecordingStats(void) {
+    if (frameTiming.recordCount == 0) {
+        return;
+    }
+    LOGI("Recording: %llu frames, %.1f us/frame, worst %.1f us, %llu over the %.0f us budget",
+         (unsigned long long)frameTiming.recordCount, frameTiming.recordTotalMs * 1000.0 / frameTiming.recordCount,
+         frameTiming.recordWorstMs * 1000.0, (unsigned long long)frameTiming.recordOverBudgetCount,
+         VARTIP_RECORD_BUDGET_US);
+}
+
+// Waits for the frames still in flight and hands over what they produced, their timestamps and readbacks, oldest slot
+// first. Only for teardown and the benchmarks, frames never wait on the GPU otherwise
+void FinishFrameSlots(void) {
+    CALL_VK(vkDeviceWaitIdle(device.device));
+    for (uint32_t i = 0; i < VARTIP_FRAME_SLOT_COUNT; i++) {
+        uint32_t slotIndex = (render.currentSlot + i) % VARTIP_FRAME_SLOT_COUNT;
+        readbackRing->CollectIfReady(slotIndex, render.slots[slotIndex].fence);
+        ReleaseRetiredFilterGraphs(slotIndex);
+    }
+    gpuProfiler->CollectResults();
 }
 
 void DeleteVulkanContext() {
-    vkFreeCommandBuffers(device.device, render.cmdPool, render.cmdBufferLength, render.cmdBuffer);
-    delete[] render.cmdBuffer;
+    FinishFrameSlots();
+    LogRecordingStats();
+    WriteTraceIfRequested();
+    delete gpuProfiler;
+    gpuProfiler = nullptr;
 
-    vkDestroyCommandPool(device.device, render.cmdPool, nullptr);
+    DeleteFrameSlots();
     vkDestroyRenderPass(device.device, render.renderPass, nullptr);
     DeleteSwapChain();
     DeleteGraphicsPipeline();
     DeleteBuffers();
+    if (qualityGovernor != nullptr) {
+        qualityGovernor->LogStats();
+        delete qualityGovernor;
+        qualityGovernor = nullptr;
+    }
+    if (perfHud != nullptr) {
+        perfHud->LogStats();
+        delete perfHud;
+        perfHud = nullptr;
+    }
+    DeleteFilterGraph();
+    kernelVariants->LogStats();
+    delete kernelVariants;
+    kernelVariants = nullptr;
+    delete shaderModules;
+    shaderModules = nullptr;
+    DeleteTextures();
+    delete memoryAllocator;
+    memoryAllocator = nullptr;
 
 #if (VARTIP_VALIDATION_LAYERS)
     DestroyDebugReportExt(device.instance, debugCallbackHandle);
 #endif
 
     vkDestroyDevice(device.device, nullptr);
+    if (device.surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(device.instance, device.surface, nullptr);
+    }
     vkDestroyInstance(device.instance, nullptr);
 
+    if (offscreen.frameSource != nullptr) {
+        delete offscreen.frameSource;
+        offscreen.frameSource = nullptr;
+    }
+    offscreen.enabled = false;
+    offscreen.readback = false;
     device.initialized = false;
 }
 
-bool VulkanDrawFrame(android_app* app) {
-    if (m_imageReader->GetBufferCount() == 0) {
+bool VulkanDrawFrame(void) {
+#ifdef __ANDROID__
+    // One draw takes however many images the frame events counted, only the latest is shown
+    if (!offscreen.enabled && m_imageReader->TakeBufferCount() == 0) {
         return false;
-    } else {
-        m_imageReader->DecBufferCount();
-    }
-
-    m_image = m_imageReader->GetLatestImage();
-    m_imageReader->DisplayImage(cameraBuffer, m_image);
-
-    // Read the file:
-    //          AAsset* file = AAssetManager_open(androidAppCtx->activity->assetManager, "sample_tex.png",
-    //          AASSET_MODE_BUFFER); size_t fileLength = AAsset_getLength(file); stbi_uc* fileContent = new unsigned
-    //          char[fileLength]; AAsset_read(file, fileContent, fileLength);
-    //
-    //          unsigned char* imageData = stbi_load_from_memory(
-    //              fileContent, fileLength, reinterpret_cast<int*>(&imgWidth),
-    //              reinterpret_cast<int*>(&imgHeight), reinterpret_cast<int*>(&n), 4);
-    //          assert(n == 4);
-
-    unsigned char* imageData = reinterpret_cast<unsigned char*>(cameraBuffer);
-
-    for (int32_t y = 0; y < imgHeight; y++) {
-        unsigned char* row = (unsigned char*)((char*)mappedData + rowPitch * y);
-        for (int32_t x = 0; x < imgWidth; x++) {
-            // When reading from File its imgWidth
-            // When reading from camera it seems to be a 720x720 buffer
-            // ... TODO
-            row[x * 4] = imageData[(x + (y * imgHeight)) * 4];
-            row[x * 4 + 1] = imageData[((x + (y * imgHeight)) * 4) + 1];
-            row[x * 4 + 2] = imageData[((x + (y * imgHeight)) * 4) + 2];
-            row[x * 4 + 3] = imageData[((x + (y * imgHeight)) * 4) + 3];
-        }
     }
+#endif
 
-    // uint32_t* row = static_cast<uint32_t *>(mappedData);
+    VARTIP_CPU_ZONE("VulkanDrawFrame");
+    double frameStart = GetTimeMs();
+    gpuProfiler->BeginFrame();
+#ifdef __ANDROID__
+    int64_t sensorNs = 0;
+    if (!offscreen.enabled) {
+        m_image = m_imageReader->GetLatestImage();
+        if (m_image != nullptr) {
+            AImage_getTimestamp(m_image, &sensorNs);
+        }
+        m_imageReader->DisplayImage(cameraBuffer, m_image);
+    }
+#endif
+    if (offscreen.enabled) {
+        // Same row stride the camera conversion leaves in cameraBuffer
+        offscreen.frameSource->NextFrame(cameraBuffer, imgHeight);
+    }
+    double slotStart = GetTimeMs();
+    gpuProfiler->AddCpuScope("convert", frameStart, slotStart - frameStart);
+
+    // The slot is reused once the GPU is done with the frame that last used it
+    uint32_t slotIndex = render.currentSlot;
+    VulkanFrameSlot& slot = render.slots[slotIndex];
+    {
+        VARTIP_CPU_ZONE("slot wait");
+        CALL_VK(vkWaitForFences(device.device, 1, &slot.fence, VK_TRUE, 100000000));
+    }
+    double copyStart = GetTimeMs();
+    gpuProfiler->AddCpuScope("slot wait", slotStart, copyStart - slotStart);
+    // The fence signaled, the readbacks of the frame that last used the slot are handed over before it records again
+    readbackRing->CollectIfReady(slotIndex, slot.fence);
+    gpuProfiler->CollectSlot(slotIndex);
+    ReleaseRetiredFilterGraphs(slotIndex);
+    if (slot.descriptorStale) {
+        UpdateDescriptorSet(slotIndex);
+    }
 
-    // memcpy(mappedData, (void*)cameraBuffer, 720 * 480 * 4);
+    // cameraBuffer rows are imgHeight pixels apart, the staging buffer is tightly packed. Only the converted size
+    // is copied, a smaller step leaves a smaller image in the top left of cameraBuffer
+    {
+        VARTIP_CPU_ZONE("texture copy");
+        const texture_object& camera = CameraTexture();
+        uint32_t rowBytes = camera.texWidth * 4;
+        uint8_t* staging = static_cast<uint8_t*>(slot.stagingMemory.mappedData);
+        for (int32_t y = 0; y < camera.texHeight; y++) {
+            memcpy(staging + y * rowBytes, cameraBuffer + y * imgHeight, rowBytes);
+        }
+        if (UsesTransferQueue()) {
+            SubmitCameraUpload(slot);
+        }
+    }
+    double acquireStart = GetTimeMs();
+    gpuProfiler->AddCpuScope("texture copy", copyStart, acquireStart - copyStart);
 
     uint32_t nextIndex;
-    // Get the framebuffer index we should draw in
-    CALL_VK(vkAcquireNextImageKHR(device.device, swapchain.swapchain, UINT64_MAX, render.semaphore, VK_NULL_HANDLE,
-                                  &nextIndex));
-    CALL_VK(vkResetFences(device.device, 1, &render.fence));
+    // Get the framebuffer index we should draw in, offscreen images are simply used round robin
+    if (offscreen.enabled) {
+        nextIndex = offscreen.nextIndex;
+        offscreen.nextIndex = (offscreen.nextIndex + 1) % swapchain.swapchainLength;
+    } else {
+        VARTIP_CPU_ZONE("acquire");
+        CALL_VK(vkAcquireNextImageKHR(device.device, swapchain.swapchain, UINT64_MAX, slot.acquireSemaphore,
+                                      VK_NULL_HANDLE, &nextIndex));
+    }
+    double recordStart = GetTimeMs();
+    gpuProfiler->AddCpuScope("acquire", acquireStart, recordStart - acquireStart);
+
+    // Shows the latest frame the profiler completed, a frame or two behind this one
+    if (perfHud != nullptr) {
+        VARTIP_CPU_ZONE("hud");
+        perfHud->Update(slotIndex, frameStart, gpuProfiler->GetLatestFrame(), gpuProfiler->GetDroppedFrameCount(),
+                        swapchain.displaySize);
+        double hudEnd = GetTimeMs();
+        gpuProfiler->AddCpuScope(VARTIP_HUD_SCOPE, recordStart, hudEnd - recordStart);
+        recordStart = hudEnd;
+    }
+
+    CALL_VK(vkResetCommandPool(device.device, slot.cmdPool, 0));
+    RecordFrameCommands(slotIndex, nextIndex);
+    double submitTime = GetTimeMs();
+    frameTiming.recordMs = submitTime - recordStart;
+    gpuProfiler->AddCpuScope("record", recordStart, frameTiming.recordMs);
+    frameTiming.recordCount++;
+    frameTiming.recordTotalMs += frameTiming.recordMs;
+    frameTiming.recordWorstMs = std::max(frameTiming.recordWorstMs, frameTiming.recordMs);
+    if (frameTiming.recordMs * 1000.0 > VARTIP_RECORD_BUDGET_US) {
+        if (frameTiming.recordOverBudgetCount++ == 0) {
+            LOGW("Recording took %.1f us, over the %.0f us budget", frameTiming.recordMs * 1000.0,
+                 VARTIP_RECORD_BUDGET_US);
+        }
+    }
 
-    VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // The swapchain image and, on the transfer queue, the upload are waited on, the present and the next upload wait
+    // on what the submit signals
+    VkSemaphore waitSemaphores[2];
+    VkPipelineStageFlags waitStageMasks[2];
+    VkSemaphore signalSemaphores[2];
+    uint32_t waitCount = 0;
+    uint32_t signalCount = 0;
+    if (!offscreen.enabled) {
+        waitSemaphores[waitCount] = slot.acquireSemaphore;
+        waitStageMasks[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        signalSemaphores[signalCount++] = render.renderSemaphores[nextIndex];
+    }
+    if (UsesTransferQueue()) {
+        waitSemaphores[waitCount] = slot.uploadSemaphore;
+        waitStageMasks[waitCount++] = VARTIP_CAMERA_READ_STAGES;
+        signalSemaphores[signalCount++] = slot.releaseSemaphore;
+    }
     VkSubmitInfo submit_info = {.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
                                 .pNext = nullptr,
-                                .waitSemaphoreCount = 1,
-                                .pWaitSemaphores = &render.semaphore,
-                                .pWaitDstStageMask = &waitStageMask,
+                                .waitSemaphoreCount = waitCount,
+                                .pWaitSemaphores = waitSemaphores,
+                                .pWaitDstStageMask = waitStageMasks,
                                 .commandBufferCount = 1,
-                                .pCommandBuffers = &render.cmdBuffer[nextIndex],
-                                .signalSemaphoreCount = 0,
-                                .pSignalSemaphores = nullptr};
-    CALL_VK(vkQueueSubmit(device.queue, 1, &submit_info, render.fence));
-    CALL_VK(vkWaitForFences(device.device, 1, &render.fence, VK_TRUE, 100000000));
+                                .pCommandBuffers = &slot.cmdBuffer,
+                                .signalSemaphoreCount = signalCount,
+                                .pSignalSemaphores = signalSemaphores};
+    {
+        VARTIP_CPU_ZONE("submit");
+        CALL_VK(vkResetFences(device.device, 1, &slot.fence));
+        CALL_VK(vkQueueSubmit(device.queue, 1, &submit_info, slot.fence));
+    }
+    if (UsesTransferQueue()) {
+        render.pendingRelease = slot.releaseSemaphore;
+    }
+    gpuProfiler->SubmitFrame(slotIndex);
+    render.currentSlot = (slotIndex + 1) % VARTIP_FRAME_SLOT_COUNT;
+
+    frameTiming.cpuMs = submitTime - frameStart;
+
+    // Everything but waiting for the camera counts, a new level applies from the next frame
+    if (qualityGovernor != nullptr && qualityGovernor->AddFrame(GetTimeMs() - frameStart + offscreen.loadMs)) {
+        ApplyGovernedQuality();
+    }
+
+    if (offscreen.enabled) {
+        offscreen.lastIndex = nextIndex;
+        gpuProfiler->EndFrame();
+        return true;
+    }
 
     VkResult result;
     VkPresentInfoKHR presentInfo{
@@ -1153,10 +2046,719 @@ bool VulkanDrawFrame(android_app* app) {
         .swapchainCount = 1,
         .pSwapchains = &swapchain.swapchain,
         .pImageIndices = &nextIndex,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = nullptr,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &render.renderSemaphores[nextIndex],
         .pResults = &result,
     };
-    vkQueuePresentKHR(device.queue, &presentInfo);
+    double presentStart = GetTimeMs();
+    {
+        VARTIP_CPU_ZONE("present");
+        vkQueuePresentKHR(device.queue, &presentInfo);
+    }
+    gpuProfiler->AddCpuScope("present", presentStart, GetTimeMs() - presentStart);
+#ifdef __ANDROID__
+    if (captureBenchmark.framesPerProfile > 0 && sensorNs > 0) {
+        AddCaptureLatency(sensorNs);
+    }
+#endif
+    gpuProfiler->EndFrame();
+
+    if (startupTiming.firstFrameReported == false) {
+        startupTiming.firstFrameReported = true;
+        LOGI("Time to first frame: %.2f ms", GetTimeMs() - startupTiming.startMs);
+    }
+    return true;
+}
+
+const uint32_t* ReadbackOffscreenFrame(void) {
+    if (!offscreen.enabled || !offscreen.readback) {
+        return nullptr;
+    }
+    return static_cast<const uint32_t*>(offscreen.readbackMemory[offscreen.lastIndex].mappedData);
+}
+
+// RGBA8 pixels to a binary PPM, alpha is dropped
+static void DumpOffscreenFrame(const char* path, const uint32_t* pixels) {
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        LOGE("Could not open %s to dump the frame", path);
+        return;
+    }
+    fprintf(file, "P6\n%u %u\n255\n", swapchain.displaySize.width, swapchain.displaySize.height);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(pixels);
+    uint32_t pixelCount = swapchain.displaySize.width * swapchain.displaySize.height;
+    for (uint32_t i = 0; i < pixelCount; i++) {
+        fwrite(bytes + i * 4, 1, 3, file);
+    }
+    fclose(file);
+    LOGI("Headless frame written to %s", path);
+}
+
+// Spins the calling thread for ms, stands in for conversion work where there is no camera
+static void BusyWait(double ms) {
+    double end = GetTimeMs() + ms;
+    while (GetTimeMs() < end) {
+    }
+}
+
+bool RunHeadlessBenchmark(uint32_t frameCount) {
+    ASSERT(offscreen.enabled, "RunHeadlessBenchmark needs InitVulkanHeadless");
+    char loadOption[32];
+    double cpuLoadMs = GetDebugOption(VARTIP_CPU_LOAD_ENV, VARTIP_CPU_LOAD_PROPERTY, loadOption, sizeof(loadOption))
+                           ? atof(loadOption)
+                           : 0.0;
+
+    double cpuTotalMs = 0.0;
+    double recordTotalMs = 0.0;
+    double recordWorstMs = 0.0;
+    uint64_t overBudgetStart = frameTiming.recordOverBudgetCount;
+    uint64_t firstFrame = gpuProfiler->GetFrameNumber();
+    double worstFrameMs = 0.0;
+    double start = GetTimeMs();
+    for (uint32_t i = 0; i < frameCount; i++) {
+        double frameStart = GetTimeMs();
+        // Less at lower conversion resolutions like a real conversion, the governor counts it as part of the frame
+        if (cpuLoadMs > 0.0) {
+            VARTIP_CPU_ZONE("cpu load");
+            BusyWait(cpuLoadMs / (conversionStep * conversionStep));
+            offscreen.loadMs = GetTimeMs() - frameStart;
+        }
+        VulkanDrawFrame();
+        double frameMs = GetTimeMs() - frameStart;
+
+        cpuTotalMs += frameTiming.cpuMs;
+        recordTotalMs += frameTiming.recordMs;
+        if (frameTiming.recordMs > recordWorstMs) recordWorstMs = frameTiming.recordMs;
+        if (frameMs > worstFrameMs) worstFrameMs = frameMs;
+    }
+    double elapsedMs = GetTimeMs() - start;
+    offscreen.loadMs = 0.0;
+    // The last frames' timestamps and readback
+    FinishFrameSlots();
+
+    // GPU time is first to last timestamp of each frame, averaged over the frames the profiler kept
+    LOGI("Headless %ux%u: %u frames in %.1f ms, %.1f FPS, CPU %.3f ms/frame, GPU %.3f ms/frame, worst %.3f ms",
+         swapchain.displaySize.width, swapchain.displaySize.height, frameCount, elapsedMs,
+         frameCount * 1000.0 / elapsedMs, cpuTotalMs / frameCount, gpuProfiler->GetAverageFrameGpuMs(firstFrame),
+         worstFrameMs);
+    double recordUs = recordTotalMs * 1000.0 / frameCount;
+    LOGI("Headless recording: %.1f us/frame, worst %.1f us, %llu frames over the %.0f us budget", recordUs,
+         recordWorstMs * 1000.0, (unsigned long long)(frameTiming.recordOverBudgetCount - overBudgetStart),
+         VARTIP_RECORD_BUDGET_US);
+    if (recordUs > VARTIP_RECORD_BUDGET_US) {
+        LOGW("Recording averages %.1f us a frame, over the %.0f us budget", recordUs, VARTIP_RECORD_BUDGET_US);
+    }
+    if (perfHud != nullptr) {
+        LOGI("Headless HUD: GPU %.3f ms/frame, %.1f ms budget",
+             gpuProfiler->GetAverageGpuMs(VARTIP_HUD_SCOPE, firstFrame), VARTIP_HUD_BUDGET_MS);
+    }
+    if (qualityGovernor != nullptr) {
+        qualityGovernor->LogStats();
+    }
+
+    // FNV-1a of the last frame, stable across runs for the same frame count so outputs can be compared
+    const uint32_t* pixels = ReadbackOffscreenFrame();
+    if (pixels != nullptr) {
+        uint32_t hash = 2166136261u;
+        uint32_t pixelCount = swapchain.displaySize.width * swapchain.displaySize.height;
+        for (uint32_t i = 0; i < pixelCount; i++) {
+            hash = (hash ^ pixels[i]) * 16777619u;
+        }
+        uint32_t center =
+            (swapchain.displaySize.height / 2) * swapchain.displaySize.width + swapchain.displaySize.width / 2;
+        LOGI("Headless readback: center pixel 0x%08x, hash 0x%08x", pixels[center], hash);
+
+        char dumpPath[256];
+        if (GetDebugOption(VARTIP_DUMP_ENV, VARTIP_DUMP_PROPERTY, dumpPath, sizeof(dumpPath))) {
+            DumpOffscreenFrame(dumpPath, pixels);
+        }
+    }
+    return true;
+}
+
+// Time of the two blur passes per radius and the error of the result against the CPU reference of the same frame
+bool RunBlurBenchmark(uint32_t frameCount) {
+    ASSERT(offscreen.enabled && offscreen.readback, "RunBlurBenchmark needs InitVulkanHeadless with readback");
+    static const uint32_t kRadii[] = {1, 2, 3, 5, 8, 12, 16, 24, VARTIP_BLUR_MAX_RADIUS};
+
+    std::vector<float> luma(imgWidth * imgHeight);
+    std::vector<float> blurred(imgWidth * imgHeight);
+    bool passed = true;
+    for (uint32_t i = 0; i < sizeof(kRadii) / sizeof(kRadii[0]); i++) {
+        uint32_t radius = kRadii[i];
+        float sigma = radius / 3.0f;
+        char filterList[64];
+        snprintf(filterList, sizeof(filterList), "gray,blur=%.4f:%u", sigma, radius);
+        RebuildFilterGraph(filterList);
+        if (filterGraph == nullptr) {
+            LOGE("Blur radius %u could not be built", radius);
+            passed = false;
+            continue;
+        }
+
+        uint64_t firstFrame = gpuProfiler->GetFrameNumber();
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            VulkanDrawFrame();
+        }
+        FinishFrameSlots();
+        double blurMs =
+            gpuProfiler->GetAverageGpuMs("blur h", firstFrame) + gpuProfiler->GetAverageGpuMs("blur v", firstFrame);
+
+        // cameraBuffer still holds the last frame, the visualized blur has it in every color channel
+        LumaReference(cameraBuffer, imgHeight, imgWidth, imgHeight, luma.data());
+        GaussianBlurReference(luma.data(), blurred.data(), imgWidth, imgHeight, sigma, radius);
+        const uint8_t* pixels = filterReadbackPixels.data();
+        int32_t maxError = 0;
+        for (uint32_t p = 0; p < imgWidth * imgHeight; p++) {
+            int32_t expected = static_cast<int32_t>(blurred[p] * 255.0f + 0.5f);
+            int32_t error = abs(expected - static_cast<int32_t>(pixels[p * 4]));
+            if (error > maxError) maxError = error;
+        }
+
+        double megapixels = imgWidth * imgHeight / 1000000.0;
+        LOGI("Blur radius %2u sigma %.2f: %.3f ms for both passes, %.1f Mpix/s, max error %d/255", radius, sigma,
+             blurMs, blurMs > 0.0 ? megapixels * 1000.0 / blurMs : 0.0, maxError);
+        if (maxError > 1) {
+            LOGE("Blur radius %u differs from the CPU reference by %d/255", radius, maxError);
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+// Per pass GPU time of the edge detection and the pixels where its edges differ from the CPU reference
+bool RunCannyBenchmark(uint32_t frameCount) {
+    ASSERT(offscreen.enabled && offscreen.readback, "RunCannyBenchmark needs InitVulkanHeadless with readback");
+    const float low = 0.1f;
+    const float high = 0.3f;
+    char filterList[64];
+    snprintf(filterList, sizeof(filterList), "edges=%.3f:%.3f", low, high);
+    RebuildFilterGraph(filterList);
+    if (filterGraph == nullptr) {
+        LOGE("Edge detection could not be built");
+        return false;
+    }
+
+    uint64_t firstFrame = gpuProfiler->GetFrameNumber();
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        VulkanDrawFrame();
+    }
+    FinishFrameSlots();
+    LOGI("Canny %ux%u: luma %.3f ms, sobel %.3f ms, nms %.3f ms, hysteresis %u x %.3f ms, visualize %.3f ms", imgWidth,
+         imgHeight, gpuProfiler->GetAverageGpuMs("luma", firstFrame), gpuProfiler->GetAverageGpuMs("sobel", firstFrame),
+         gpuProfiler->GetAverageGpuMs("nms", firstFrame), VARTIP_HYSTERESIS_PASSES,
+         gpuProfiler->GetAverageGpuMs("hysteresis", firstFrame),
+         gpuProfiler->GetAverageGpuMs("visualize", firstFrame));
+
+    // cameraBuffer still holds the last frame, the visualized edges are 255 in the red channel
+    std::vector<float> luma(imgWidth * imgHeight);
+    std::vector<uint8_t> edges(imgWidth * imgHeight);
+    LumaReference(cameraBuffer, imgHeight, imgWidth, imgHeight, luma.data());
+    CannyReference(luma.data(), imgWidth, imgHeight, low, high, edges.data());
+    const uint8_t* pixels = filterReadbackPixels.data();
+    uint32_t edgeCount = 0;
+    uint32_t mismatchCount = 0;
+    for (uint32_t p = 0; p < imgWidth * imgHeight; p++) {
+        bool edge = pixels[p * 4] > 191;
+        edgeCount += edges[p];
+        if (edge != (edges[p] != 0)) mismatchCount++;
+    }
+    LOGI("Canny readback: %u reference edge pixels, %u pixels differ", edgeCount, mismatchCount);
+    if (mismatchCount > 0) {
+        LOGE("Edges differ from the CPU reference in %u pixels", mismatchCount);
+        return false;
+    }
+    return true;
+}
+
+// GPU histogram and curve against building the histogram on the CPU, and how far apart their bins are
+bool RunHistogramBenchmark(uint32_t frameCount) {
+    ASSERT(offscreen.enabled, "RunHistogramBenchmark needs InitVulkanHeadless");
+    RebuildFilterGraph("equalize");
+    if (filterGraph == nullptr) {
+        LOGE("Histogram could not be built");
+        return false;
+    }
+
+    uint64_t firstFrame = gpuProfiler->GetFrameNumber();
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        VulkanDrawFrame();
+    }
+    FinishFrameSlots();
+    double gpuMs = gpuProfiler->GetAverageGpuMs("histogram clear", firstFrame) +
+                   gpuProfiler->GetAverageGpuMs("histogram", firstFrame) +
+                   gpuProfiler->GetAverageGpuMs("histogram lut", firstFrame);
+
+    // FinishFrameSlots collected the last frame's readbacks, lumaHistogram has the GPU bins of cameraBuffer's frame
+    uint32_t bins[VARTIP_HISTOGRAM_BINS];
+    double cpuStart = GetTimeMs();
+    LumaHistogramReference(cameraBuffer, imgHeight, imgWidth, imgHeight, bins);
+    double cpuMs = GetTimeMs() - cpuStart;
+
+    uint32_t misplaced = 0;
+    for (uint32_t i = 0; i < VARTIP_HISTOGRAM_BINS; i++) {
+        misplaced += (bins[i] > lumaHistogram.bins[i]) ? bins[i] - lumaHistogram.bins[i] : 0;
+    }
+    LOGI("Histogram %ux%u: GPU %.3f ms (histogram and curve), CPU %.3f ms, %u of %u pixels in another bin", imgWidth,
+         imgHeight, gpuMs, cpuMs, misplaced, imgWidth * imgHeight);
+    // Normalized texels round differently than bytes only right at a bin boundary
+    if (misplaced > imgWidth * imgHeight / 1000) {
+        LOGE("Histogram differs from the CPU reference for %u pixels", misplaced);
+        return false;
+    }
+    return true;
+}
+
+// GPU time of a 5 level pyramid of the color image and of luma, and the error of their second level against 2x2 means
+// on the CPU, which is what both the linear blit and the compute fallback compute for even sizes
+bool RunPyramidBenchmark(uint32_t frameCount) {
+    ASSERT(offscreen.enabled && offscreen.readback, "RunPyramidBenchmark needs InitVulkanHeadless with readback");
+    static const char* kFilterLists[] = {"pyramid=5:1", "gray,pyramid=5:1"};
+
+    uint32_t levelWidth = imgWidth / 2;
+    uint32_t levelHeight = imgHeight / 2;
+    std::vector<float> channel(imgWidth * imgHeight);
+    std::vector<float> level(levelWidth * levelHeight);
+    bool passed = true;
+    for (uint32_t i = 0; i < sizeof(kFilterLists) / sizeof(kFilterLists[0]); i++) {
+        RebuildFilterGraph(kFilterLists[i]);
+        if (filterGraph == nullptr) {
+            LOGE("Pyramid %s could not be built", kFilterLists[i]);
+            passed = false;
+            continue;
+        }
+
+        uint64_t firstFrame = gpuProfiler->GetFrameNumber();
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            VulkanDrawFrame();
+        }
+        FinishFrameSlots();
+        double pyramidMs = gpuProfiler->GetAverageGpuMs("pyramid", firstFrame);
+
+        // cameraBuffer still holds the last frame, luma is visualized in every color channel and the color image
+        // is checked one channel at a time
+        bool gray = (i == 1);
+        const uint8_t* pixels = filterReadbackPixels.data();
+        int32_t maxError = 0;
+        for (uint32_t c = 0; c < (gray ? 1u : 3u); c++) {
+            if (gray) {
+                LumaReference(cameraBuffer, imgHeight, imgWidth, imgHeight, channel.data());
+            } else {
+                for (uint32_t y = 0; y < imgHeight; y++) {
+                    for (uint32_t x = 0; x < imgWidth; x++) {
+                        channel[y * imgWidth + x] = ((cameraBuffer[y * imgHeight + x] >> (c * 8)) & 0xff) / 255.0f;
+                    }
+                }
+            }
+            DownsampleReference(channel.data(), imgWidth, imgHeight, level.data());
+            for (uint32_t p = 0; p < levelWidth * levelHeight; p++) {
+                int32_t expected = static_cast<int32_t>(level[p] * 255.0f + 0.5f);
+                int32_t error = abs(expected - static_cast<int32_t>(pixels[p * 4 + c]));
+                if (error > maxError) maxError = error;
+            }
+        }
+
+        LOGI("Pyramid %s (%ux%u): %.3f ms, max error of level 1 %d/255", kFilterLists[i], imgWidth, imgHeight,
+             pyramidMs, maxError);
+        if (maxError > 1) {
+            LOGE("Pyramid %s differs from the CPU reference by %d/255", kFilterLists[i], maxError);
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+// Points tracked on the GPU against the motion the synthetic frames really have, and the same tracking on the CPU
+bool RunFlowBenchmark(uint32_t frameCount) {
+    ASSERT(offscreen.enabled, "RunFlowBenchmark needs InitVulkanHeadless");
+    const int32_t scrollX = 3;
+    const int32_t scrollY = 2;
+    const uint32_t levels = 4;
+    offscreen.frameSource->SetScroll(scrollX, scrollY);
+    char filterList[64];
+    snprintf(filterList, sizeof(filterList), "flow=2048:%u", levels);
+    RebuildFilterGraph(filterList);
+    if (filterGraph == nullptr || frameCount < 2) {
+        LOGE("Optical flow could not be built or needs at least 2 frames");
+        return false;
+    }
+
+    // cameraBuffer holds a frame until the next one is drawn, the last two are the ones the points were tracked over
+    std::vector<float> previousLuma(imgWidth * imgHeight);
+    std::vector<float> luma(imgWidth * imgHeight);
+    uint64_t firstFrame = gpuProfiler->GetFrameNumber();
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        if (frame == frameCount - 1) {
+            LumaReference(cameraBuffer, imgHeight, imgWidth, imgHeight, previousLuma.data());
+        }
+        VulkanDrawFrame();
+    }
+    FinishFrameSlots();
+    LumaReference(cameraBuffer, imgHeight, imgWidth, imgHeight, luma.data());
+    double gpuMs = gpuProfiler->GetAverageGpuMs("pyramid", firstFrame) +
+                   gpuProfiler->GetAverageGpuMs("flow", firstFrame) +
+                   gpuProfiler->GetAverageGpuMs("flow history", firstFrame);
+
+    std::vector<float> points;
+    std::vector<float> gpuTracked;
+    uint32_t accurate = 0;
+    for (uint32_t i = 0; i < flowTracks.pointCount; i++) {
+        const FlowPoint& point = flowTracks.points[i];
+        if (point.status != FLOW_POINT_TRACKED) {
+            continue;
+        }
+        points.push_back(point.x - point.dx);
+        points.push_back(point.y - point.dy);
+        gpuTracked.push_back(point.x);
+        gpuTracked.push_back(point.y);
+        float errorX = point.dx - scrollX;
+        float errorY = point.dy - scrollY;
+        accurate += (errorX * errorX + errorY * errorY < 0.25f) ? 1 : 0;
+    }
+
+    uint32_t trackedCount = static_cast<uint32_t>(points.size() / 2);
+    std::vector<float> cpuTracked(points.size());
+    std::vector<uint8_t> found(trackedCount);
+    double cpuStart = GetTimeMs();
+    LucasKanadeReference(previousLuma.data(), luma.data(), imgWidth, imgHeight, levels, VARTIP_FLOW_ITERATIONS,
+                         VARTIP_FLOW_MIN_EIGENVALUE, trackedCount, points.data(), cpuTracked.data(), found.data());
+    double cpuMs = GetTimeMs() - cpuStart;
+    uint32_t differ = 0;
+    for (uint32_t i = 0; i < trackedCount; i++) {
+        float dx = cpuTracked[i * 2] - gpuTracked[i * 2];
+        float dy = cpuTracked[i * 2 + 1] - gpuTracked[i * 2 + 1];
+        differ += (!found[i] || dx * dx + dy * dy > 0.01f) ? 1 : 0;
+    }
+
+    LOGI("Flow %u points: GPU %.3f ms (pyramid, tracking and history), CPU %.3f ms for the %u tracked ones",
+         flowTracks.pointCount, gpuMs, cpuMs, trackedCount);
+    LOGI("Flow: %u of %u tracked points within 0.5 pixels of the true motion (%d, %d), %u more than 0.1 pixels from "
+         "the CPU",
+         accurate, trackedCount, scrollX, scrollY, differ);
+    if (differ > trackedCount / 100) {
+        LOGE("Flow differs from the CPU reference for %u points", differ);
+        return false;
+    }
     return true;
 }
+
+// FAST corners of textured frames found on the GPU against the CPU reference. Without a per tile cap both find the
+// same corners, up to the float rounding of scores that tie
+bool RunFastBenchmark(uint32_t frameCount) {
+    ASSERT(offscreen.enabled, "RunFastBenchmark needs InitVulkanHeadless");
+    const float threshold = 0.08f;
+    const uint32_t tilePixels = VARTIP_FAST_TILE_SIZE * VARTIP_FAST_TILE_SIZE;
+    offscreen.frameSource->SetScroll(1, 1);
+    static const uint32_t kPerTile[] = {8, tilePixels};
+    bool passed = true;
+    for (uint32_t perTile : kPerTile) {
+        char filterList[64];
+        snprintf(filterList, sizeof(filterList), "fast=%.2f:%u", threshold, perTile);
+        RebuildFilterGraph(filterList);
+        if (filterGraph == nullptr || frameCount == 0) {
+            LOGE("FAST could not be built");
+            return false;
+        }
+
+        uint64_t firstFrame = gpuProfiler->GetFrameNumber();
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            VulkanDrawFrame();
+        }
+        FinishFrameSlots();
+        double gpuMs = gpuProfiler->GetAverageGpuMs("fast score", firstFrame) +
+                       gpuProfiler->GetAverageGpuMs("fast clear", firstFrame) +
+                       gpuProfiler->GetAverageGpuMs("fast nms", firstFrame);
+
+        std::vector<float> luma(imgWidth * imgHeight);
+        LumaReference(cameraBuffer, imgHeight, imgWidth, imgHeight, luma.data());
+        std::vector<float> corners(VARTIP_FAST_MAX_KEYPOINTS * 3);
+        double cpuStart = GetTimeMs();
+        uint32_t cpuCount = FastCornersReference(luma.data(), imgWidth, imgHeight, threshold, perTile,
+                                                 VARTIP_FAST_MAX_KEYPOINTS, corners.data());
+        double cpuMs = GetTimeMs() - cpuStart;
+
+        // Both lists are in tile order, only the order of the tiles differs on the GPU
+        std::vector<uint8_t> cpuCorner(imgWidth * imgHeight, 0);
+        for (uint32_t i = 0; i < cpuCount; i++) {
+            cpuCorner[static_cast<uint32_t>(corners[i * 3 + 1]) * imgWidth + static_cast<uint32_t>(corners[i * 3])] = 1;
+        }
+        uint32_t matched = 0;
+        for (uint32_t i = 0; i < keypointList.keypointCount; i++) {
+            const Keypoint& keypoint = keypointList.keypoints[i];
+            matched += cpuCorner[static_cast<uint32_t>(keypoint.y) * imgWidth + static_cast<uint32_t>(keypoint.x)];
+        }
+
+        LOGI("FAST %u per tile: GPU %.3f ms (score, clear and compaction), CPU %.3f ms", perTile, gpuMs, cpuMs);
+        LOGI("FAST %u per tile: %u corners on the GPU, %u on the CPU, %u in both", perTile, keypointList.found,
+             cpuCount, matched);
+        if (perTile == tilePixels && (matched != cpuCount || keypointList.keypointCount != cpuCount)) {
+            LOGE("FAST corners differ from the CPU reference, %u of %u/%u match", matched, keypointList.keypointCount,
+                 cpuCount);
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+// Box filters from the integral image checked against the CPU at the camera size, then the integral image timed at
+// 720p, 1080p and 4K by resizing the camera image first
+bool RunIntegralBenchmark(uint32_t frameCount) {
+    ASSERT(offscreen.enabled && offscreen.readback, "RunIntegralBenchmark needs InitVulkanHeadless with readback");
+    const uint32_t radius = 8;
+    std::vector<float> luma(imgWidth * imgHeight);
+    std::vector<uint32_t> sums(imgWidth * imgHeight);
+    std::vector<uint32_t> squares(imgWidth * imgHeight);
+    std::vector<float> filtered(imgWidth * imgHeight);
+    static const char* kFilters[] = {"box", "stddev"};
+    bool passed = true;
+    for (uint32_t i = 0; i < sizeof(kFilters) / sizeof(kFilters[0]); i++) {
+        bool stddev = (i == 1);
+        char filterList[64];
+        snprintf(filterList, sizeof(filterList), "%s=%u", kFilters[i], radius);
+        RebuildFilterGraph(filterList);
+        if (filterGraph == nullptr || frameCount == 0) {
+            LOGE("Integral image could not be built");
+            return false;
+        }
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            VulkanDrawFrame();
+        }
+        FinishFrameSlots();
+
+        // cameraBuffer still holds the last frame, the visualized filter has it in every color channel
+        LumaReference(cameraBuffer, imgHeight, imgWidth, imgHeight, luma.data());
+        IntegralImageReference(luma.data(), imgWidth, imgHeight, sums.data(), squares.data());
+        BoxFilterReference(sums.data(), squares.data(), imgWidth, imgHeight, radius, stddev, filtered.data());
+        const uint8_t* pixels = filterReadbackPixels.data();
+        int32_t maxError = 0;
+        for (uint32_t p = 0; p < imgWidth * imgHeight; p++) {
+            int32_t expected = static_cast<int32_t>(filtered[p] * 255.0f + 0.5f);
+            int32_t error = abs(expected - static_cast<int32_t>(pixels[p * 4]));
+            if (error > maxError) maxError = error;
+        }
+        LOGI("Integral %s radius %u (%ux%u): max error %d/255", kFilters[i], radius, imgWidth, imgHeight, maxError);
+        if (maxError > 1) {
+            LOGE("Integral %s differs from the CPU reference by %d/255", kFilters[i], maxError);
+            passed = false;
+        }
+    }
+
+    static const VkExtent2D kSizes[] = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+    for (uint32_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++) {
+        uint32_t width = kSizes[i].width;
+        uint32_t height = kSizes[i].height;
+        char filterList[64];
+        snprintf(filterList, sizeof(filterList), "size=%ux%u,stddev=%u", width, height, radius);
+        RebuildFilterGraph(filterList);
+        if (filterGraph == nullptr) {
+            LOGE("Integral image at %ux%u could not be built", width, height);
+            passed = false;
+            continue;
+        }
+        uint64_t firstFrame = gpuProfiler->GetFrameNumber();
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            VulkanDrawFrame();
+        }
+        FinishFrameSlots();
+        double rowsMs = gpuProfiler->GetAverageGpuMs("integral rows", firstFrame);
+        double columnsMs = gpuProfiler->GetAverageGpuMs("integral columns", firstFrame);
+        double boxMs = gpuProfiler->GetAverageGpuMs("box filter", firstFrame);
+
+        // The CPU scan doesn't care about the content, the camera luma repeated over the size will do
+        std::vector<float> large(width * height);
+        LumaReference(cameraBuffer, imgHeight, imgWidth, imgHeight, luma.data());
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                large[y * width + x] = luma[(y % imgHeight) * imgWidth + x % imgWidth];
+            }
+        }
+        std::vector<uint32_t> largeSums(width * height);
+        std::vector<uint32_t> largeSquares(width * height);
+        double cpuStart = GetTimeMs();
+        IntegralImageReference(large.data(), width, height, largeSums.data(), largeSquares.data());
+        double cpuMs = GetTimeMs() - cpuStart;
+
+        double gpuMs = rowsMs + columnsMs;
+        double megapixels = width * height / 1000000.0;
+        LOGI("Integral %ux%u with squares: GPU %.3f ms (rows %.3f, columns %.3f), %.1f Mpix/s, CPU %.3f ms, box "
+             "stddev %.3f ms",
+             width, height, gpuMs, rowsMs, columnsMs, gpuMs > 0.0 ? megapixels * 1000.0 / gpuMs : 0.0, cpuMs, boxMs);
+    }
+    return passed;
+}
+
+// Background model and motion mask on the GPU against the same model kept on the CPU over the same frames, the bar
+// sweeping across the synthetic frames is the motion
+bool RunMotionBenchmark(uint32_t frameCount) {
+    ASSERT(offscreen.enabled && offscreen.readback, "RunMotionBenchmark needs InitVulkanHeadless with readback");
+    const float rate = 0.05f;
+    const float threshold = 3.0f;
+    const int32_t radius = 1;
+    char filterList[64];
+    snprintf(filterList, sizeof(filterList), "foreground=%.3f:%.1f:%d", rate, threshold, radius);
+    RebuildFilterGraph(filterList);
+    if (filterGraph == nullptr || frameCount == 0) {
+        LOGE("Motion mask could not be built");
+        return false;
+    }
+
+    // The CPU side is the read-modify-write of the model every frame the GPU version saves
+    uint32_t pixelCount = imgWidth * imgHeight;
+    std::vector<float> luma(pixelCount);
+    std::vector<float> model(pixelCount * 3, 0.0f);
+    std::vector<uint8_t> mask(pixelCount);
+    std::vector<uint8_t> scratch(pixelCount);
+    double cpuMs = 0.0;
+    uint64_t firstFrame = gpuProfiler->GetFrameNumber();
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        VulkanDrawFrame();
+        double cpuStart = GetTimeMs();
+        LumaReference(cameraBuffer, imgHeight, imgWidth, imgHeight, luma.data());
+        BackgroundModelReference(luma.data(), imgWidth, imgHeight, rate, threshold, VARTIP_MOTION_MIN_VARIANCE,
+                                 VARTIP_MOTION_WARMUP_FRAMES, model.data(), mask.data());
+        MorphologyReference(mask.data(), imgWidth, imgHeight, radius, false, scratch.data());
+        MorphologyReference(scratch.data(), imgWidth, imgHeight, radius, true, mask.data());
+        MorphologyReference(mask.data(), imgWidth, imgHeight, radius, true, scratch.data());
+        MorphologyReference(scratch.data(), imgWidth, imgHeight, radius, false, mask.data());
+        cpuMs += GetTimeMs() - cpuStart;
+    }
+    FinishFrameSlots();
+    double backgroundMs = gpuProfiler->GetAverageGpuMs("background", firstFrame);
+    double morphologyMs = 2.0 * (gpuProfiler->GetAverageGpuMs("erode", firstFrame) +
+                                 gpuProfiler->GetAverageGpuMs("dilate", firstFrame));
+
+    // The visualized mask of the last frame has it in every color channel
+    const uint8_t* pixels = filterReadbackPixels.data();
+    uint32_t gpuMotion = 0;
+    uint32_t cpuMotion = 0;
+    uint32_t differ = 0;
+    for (uint32_t p = 0; p < pixelCount; p++) {
+        uint8_t gpu = pixels[p * 4] > 127 ? 1 : 0;
+        gpuMotion += gpu;
+        cpuMotion += mask[p];
+        differ += (gpu != mask[p]) ? 1 : 0;
+    }
+
+    LOGI("Motion %ux%u: GPU %.3f ms (model %.3f, morphology %.3f), CPU %.3f ms per frame", imgWidth, imgHeight,
+         backgroundMs + morphologyMs, backgroundMs, morphologyMs, cpuMs / frameCount);
+    LOGI("Motion: %u pixels moving on the GPU, %u on the CPU, %u differ", gpuMotion, cpuMotion, differ);
+    if (differ > pixelCount / 1000) {
+        LOGE("Motion mask differs from the CPU reference for %u pixels", differ);
+        return false;
+    }
+    return true;
+}
+
+// Builds the chain with its pointwise filters fused into one pass and with a pass each. Every rounding to 8 bits
+// between unfused passes may be off by a step (the conversion to unorm is allowed to truncate), and the later
+// operations scale it: after gamma by the largest sepia row sum 1.351 and the contrast 0.8, after sepia by 0.8, after
+// contrast not at all. With the last rounding of both that is 1.081 + 0.8 + 1 + 1 = 3.88, more than 3 steps is a
+// real difference
+#define VARTIP_FUSION_CHAIN "gamma=0.5,sepia,contrast=0.8,swizzle=bgra"
+#define VARTIP_FUSION_MAX_ERROR 3
+
+bool RunFusionBenchmark(uint32_t frameCount) {
+    ASSERT(offscreen.enabled && offscreen.readback, "RunFusionBenchmark needs InitVulkanHeadless with readback");
+    static const char* const kPasses[] = {"pointwise gamma", "pointwise color matrix", "pointwise contrast",
+                                          "pointwise swizzle"};
+    bool fuseSaved = fusePointwise;
+    std::vector<uint8_t> fused;
+    bool passed = true;
+    for (uint32_t run = 0; run < 2 && passed; run++) {
+        fusePointwise = (run == 0);
+        const char* label = fusePointwise ? "Fused" : "Unfused";
+        RebuildFilterGraph(VARTIP_FUSION_CHAIN);
+        if (filterGraph == nullptr) {
+            LOGE("%s pointwise chain could not be built", label);
+            passed = false;
+            break;
+        }
+
+        // Both runs start the synthetic frames over so they end on the same one
+        delete offscreen.frameSource;
+        offscreen.frameSource = new SyntheticFrameSource(imgWidth, imgHeight);
+        uint64_t firstFrame = gpuProfiler->GetFrameNumber();
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            VulkanDrawFrame();
+        }
+        FinishFrameSlots();
+        double totalMs = 0.0;
+        if (fusePointwise) {
+            totalMs = gpuProfiler->GetAverageGpuMs("pointwise fused", firstFrame);
+            LOGI("%s: pointwise fused %.3f ms", label, totalMs);
+        } else {
+            for (uint32_t i = 0; i < sizeof(kPasses) / sizeof(kPasses[0]); i++) {
+                double passMs = gpuProfiler->GetAverageGpuMs(kPasses[i], firstFrame);
+                LOGI("%s: %s %.3f ms", label, kPasses[i], passMs);
+                totalMs += passMs;
+            }
+        }
+        LOGI("%s: %.3f ms in total for %s", label, totalMs, VARTIP_FUSION_CHAIN);
+
+        if (fusePointwise) {
+            fused = filterReadbackPixels;
+            continue;
+        }
+        const uint8_t* pixels = filterReadbackPixels.data();
+        int32_t maxError = 0;
+        for (uint32_t p = 0; p < imgWidth * imgHeight; p++) {
+            for (uint32_t c = 0; c < 3; c++) {
+                int32_t error = abs(static_cast<int32_t>(fused[p * 4 + c]) - static_cast<int32_t>(pixels[p * 4 + c]));
+                if (error > maxError) maxError = error;
+            }
+        }
+        LOGI("Fusion: max difference %d/255 between fused and unfused", maxError);
+        if (maxError > VARTIP_FUSION_MAX_ERROR) {
+            LOGE("Fused and unfused pointwise chains differ by %d/255, more than %d", maxError,
+                 VARTIP_FUSION_MAX_ERROR);
+            passed = false;
+        }
+    }
+    fusePointwise = fuseSaved;
+    return passed;
+}
+
+bool RunHeadlessIfRequested(const AssetSource& assets, const char* dataDirectory) {
+    char value[32];
+    if (GetDebugOption(VARTIP_HEADLESS_ENV, VARTIP_HEADLESS_PROPERTY, value, sizeof(value)) == false) {
+        return false;
+    }
+    uint32_t frameCount = static_cast<uint32_t>(atoi(value));
+    if (frameCount == 0 || !InitVulkanHeadless(assets, dataDirectory, 1280, 720, true)) {
+        return false;
+    }
+
+    char bench[8];
+    bool passed;
+    if (GetDebugOption(VARTIP_BENCH_BLUR_ENV, VARTIP_BENCH_BLUR_PROPERTY, bench, sizeof(bench)) && atoi(bench) != 0) {
+        passed = RunBlurBenchmark(frameCount);
+    } else if (GetDebugOption(VARTIP_BENCH_CANNY_ENV, VARTIP_BENCH_CANNY_PROPERTY, bench, sizeof(bench)) &&
+               atoi(bench) != 0) {
+        passed = RunCannyBenchmark(frameCount);
+    } else if (GetDebugOption(VARTIP_BENCH_HISTOGRAM_ENV, VARTIP_BENCH_HISTOGRAM_PROPERTY, bench, sizeof(bench)) &&
+               atoi(bench) != 0) {
+        passed = RunHistogramBenchmark(frameCount);
+    } else if (GetDebugOption(VARTIP_BENCH_PYRAMID_ENV, VARTIP_BENCH_PYRAMID_PROPERTY, bench, sizeof(bench)) &&
+               atoi(bench) != 0) {
+        passed = RunPyramidBenchmark(frameCount);
+    } else if (GetDebugOption(VARTIP_BENCH_FLOW_ENV, VARTIP_BENCH_FLOW_PROPERTY, bench, sizeof(bench)) &&
+               atoi(bench) != 0) {
+        passed = RunFlowBenchmark(frameCount);
+    } else if (GetDebugOption(VARTIP_BENCH_FAST_ENV, VARTIP_BENCH_FAST_PROPERTY, bench, sizeof(bench)) &&
+               atoi(bench) != 0) {
+        passed = RunFastBenchmark(frameCount);
+    } else if (GetDebugOption(VARTIP_BENCH_INTEGRAL_ENV, VARTIP_BENCH_INTEGRAL_PROPERTY, bench, sizeof(bench)) &&
+               atoi(bench) != 0) {
+        passed = RunIntegralBenchmark(frameCount);
+    } else if (GetDebugOption(VARTIP_BENCH_MOTION_ENV, VARTIP_BENCH_MOTION_PROPERTY, bench, sizeof(bench)) &&
+               atoi(bench) != 0) {
+        passed = RunMotionBenchmark(frameCount);
+    } else if (GetDebugOption(VARTIP_BENCH_FUSION_ENV, VARTIP_BENCH_FUSION_PROPERTY, bench, sizeof(bench)) &&
+               atoi(bench) != 0) {
+        passed = RunFusionBenchmark(frameCount);
+    } else {
+        passed = RunHeadlessBenchmark(frameCount);
+    }
+    DeleteVulkanContext();
+    return passed;
+}
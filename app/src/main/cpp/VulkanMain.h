@@ -1,21 +1,132 @@
 #ifndef VARTIP_VULKANMAIN_H_
 #define VARTIP_VULKANMAIN_H_
 
+#include "CreateShaderModule.h"
+#include "EventLoop.h"
+#include "Util.h"
+#ifdef __ANDROID__
 #include <android_native_app_glue.h>
 #include "ImageReader.h"
 #include "NativeCamera.h"
-#include "Util.h"
+#endif
 
+// Host builds have no layers of those names and set it to 0
+#ifndef VARTIP_VALIDATION_LAYERS
 #define VARTIP_VALIDATION_LAYERS true
+#endif
 
+#ifdef __ANDROID__
+// Also opens the camera on a worker thread, the camera is ready once this returns
 bool InitVulkanContext(android_app* app);
 
-void InitCamera();
+// Posted by the camera for every frame it delivers, nullptr while there is no camera
+FrameEvent* GetCameraFrameEvent(void);
+#endif
 
 void DeleteVulkanContext(void);
 
 bool IsVulkanReady(void);
 
-bool VulkanDrawFrame(android_app* app);
+// @return false when there was no new camera frame to draw
+bool VulkanDrawFrame(void);
+
+// Headless mode renders offscreen, without a window or swapchain, with frames coming from a synthetic source
+#define VARTIP_HEADLESS_ENV "VARTIP_HEADLESS"
+#define VARTIP_HEADLESS_PROPERTY "debug.vartip.headless"
+
+// File the last headless frame is written to as a binary PPM, so outputs of two runs can be diffed
+#define VARTIP_DUMP_ENV "VARTIP_DUMP"
+#define VARTIP_DUMP_PROPERTY "debug.vartip.dump"
+
+/**
+ * @param dataDirectory where files given without a directory are written, ex) the trace
+ * @param readback copies every frame out so it can be verified
+ */
+bool InitVulkanHeadless(const AssetSource& assets, const char* dataDirectory, uint32_t width, uint32_t height,
+                        bool readback);
+
+/**
+ * VARTIP_HEADLESS=<frame count> renders that many synthetic frames offscreen, one of the VARTIP_BENCH_* options below
+ * set to 1 runs that filter's benchmark instead
+ * @return false if headless mode isn't requested, Vulkan could not be initialized or the benchmark failed
+ */
+bool RunHeadlessIfRequested(const AssetSource& assets, const char* dataDirectory);
+
+// Draws frameCount frames back to back and logs sustained FPS with the CPU and GPU time per frame
+bool RunHeadlessBenchmark(uint32_t frameCount);
+
+// Headless blur benchmark, runs every blur radius for the given number of frames instead of the plain benchmark. The
+// filter benchmarks fail when their filter could not be built or its result is off the CPU reference
+#define VARTIP_BENCH_BLUR_ENV "VARTIP_BENCH_BLUR"
+#define VARTIP_BENCH_BLUR_PROPERTY "debug.vartip.bench.blur"
+
+// GPU time and throughput of the blur per radius, checked against the CPU reference
+bool RunBlurBenchmark(uint32_t frameCount);
+
+// Headless edge detection benchmark, like the blur one
+#define VARTIP_BENCH_CANNY_ENV "VARTIP_BENCH_CANNY"
+#define VARTIP_BENCH_CANNY_PROPERTY "debug.vartip.bench.canny"
+
+// Per pass GPU time of the edge detection, checked against the CPU reference
+bool RunCannyBenchmark(uint32_t frameCount);
+
+// Headless histogram benchmark, GPU against CPU
+#define VARTIP_BENCH_HISTOGRAM_ENV "VARTIP_BENCH_HISTOGRAM"
+#define VARTIP_BENCH_HISTOGRAM_PROPERTY "debug.vartip.bench.histogram"
+
+// GPU time of the luma histogram and its curve next to the CPU time of the same histogram, checked against each other
+bool RunHistogramBenchmark(uint32_t frameCount);
+
+// Headless pyramid benchmark, of the color image and of luma
+#define VARTIP_BENCH_PYRAMID_ENV "VARTIP_BENCH_PYRAMID"
+#define VARTIP_BENCH_PYRAMID_PROPERTY "debug.vartip.bench.pyramid"
+
+// GPU time of building the pyramid, with its second level checked against the CPU reference
+bool RunPyramidBenchmark(uint32_t frameCount);
+
+// Headless optical flow benchmark, on frames scrolling by a known motion
+#define VARTIP_BENCH_FLOW_ENV "VARTIP_BENCH_FLOW"
+#define VARTIP_BENCH_FLOW_PROPERTY "debug.vartip.bench.flow"
+
+// GPU time of tracking the flow points next to the CPU time of the same tracking, checked against the true motion
+bool RunFlowBenchmark(uint32_t frameCount);
+
+// Headless FAST corner benchmark, on textured frames
+#define VARTIP_BENCH_FAST_ENV "VARTIP_BENCH_FAST"
+#define VARTIP_BENCH_FAST_PROPERTY "debug.vartip.bench.fast"
+
+// GPU time of finding the corners next to the CPU time of the same detection, checked against each other
+bool RunFastBenchmark(uint32_t frameCount);
+
+// Headless integral image benchmark, box filters at the camera size and the scans up to 4K
+#define VARTIP_BENCH_INTEGRAL_ENV "VARTIP_BENCH_INTEGRAL"
+#define VARTIP_BENCH_INTEGRAL_PROPERTY "debug.vartip.bench.integral"
+
+// GPU time of the integral image next to the CPU time of the same scans, its box filters checked against the CPU
+bool RunIntegralBenchmark(uint32_t frameCount);
+
+// Headless motion mask benchmark, the moving bar of the synthetic frames against its background
+#define VARTIP_BENCH_MOTION_ENV "VARTIP_BENCH_MOTION"
+#define VARTIP_BENCH_MOTION_PROPERTY "debug.vartip.bench.motion"
+
+// GPU time of the background model and the mask clean up next to the CPU time of the same, checked against each other
+bool RunMotionBenchmark(uint32_t frameCount);
+
+// Headless pointwise fusion benchmark, the same chain of pointwise filters fused and with a pass each
+#define VARTIP_BENCH_FUSION_ENV "VARTIP_BENCH_FUSION"
+#define VARTIP_BENCH_FUSION_PROPERTY "debug.vartip.bench.fusion"
+
+// GPU time per pass and in total of both, failing when their results differ by more than the 8-bit rounding between
+// the unfused passes
+bool RunFusionBenchmark(uint32_t frameCount);
+
+// Capture latency benchmark with the camera on screen, VARTIP_BENCH_CAPTURE=<frame count> streams every capture
+// profile for that many frames and logs the sensor timestamp to present latency of each, then goes back to the
+// configured one
+#define VARTIP_BENCH_CAPTURE_ENV "VARTIP_BENCH_CAPTURE"
+#define VARTIP_BENCH_CAPTURE_PROPERTY "debug.vartip.bench.capture"
+
+// Pixels of the last offscreen frame, nullptr unless headless with readback
+const uint32_t* ReadbackOffscreenFrame(void);
 
 #endif  // VARTIP_VULKANMAIN_H_
@@ -17,14 +17,20 @@ def buildShaders():
         print("ANDROID_NDK_HOME environment variable needs to be set")
         sys.exit(1)
 
+    # Same place the gradle compileShaders task writes to, so the SPIR-V is never also a source asset
     scriptPath = os.path.dirname(os.path.realpath(__file__))
     srcDir = os.path.join(scriptPath, "app", "src", "main", "assets", "shaders")
+    outDir = os.path.join(scriptPath, "app", "build", "generated", "assets", "shaders", "shaders")
+    if len(sys.argv) > 1:
+        outDir = sys.argv[1]
+    if not os.path.isdir(outDir):
+        os.makedirs(outDir)
     glslcExe = os.path.join(ndkHome, "shader-tools", osPathName, exeName)
 
     for file in os.listdir(srcDir):
         if not file.endswith(".spv"):
             filePath = str(os.path.join(srcDir, file))
-            exe = glslcExe + " " + filePath + " -o " + filePath + ".spv"
+            exe = glslcExe + " " + filePath + " -o " + str(os.path.join(outDir, file)) + ".spv"
             print(exe)
             os.system(exe)
 